@@ -0,0 +1,99 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include "access_tracker.h"
+#include "logger.h"
+#include "resource_pool.h"
+
+namespace mabain {
+
+AccessTracker::AccessTracker(const std::string& fpath, uint32_t size, int policy_in,
+    bool writer)
+    : counters(NULL)
+    , mask(size - 1)
+    , policy(policy_in)
+{
+    bool map_file = true;
+    file = ResourcePool::getInstance().OpenFile(fpath, CONSTS::ACCESS_MODE_WRITER, size,
+        map_file, writer);
+    if (file == NULL || !map_file) {
+        Logger::Log(LOG_LEVEL_WARN, "failed to open access table %s", fpath.c_str());
+        return;
+    }
+    counters = reinterpret_cast<std::atomic<uint8_t>*>(file->GetMapAddr());
+}
+
+AccessTracker::~AccessTracker()
+{
+}
+
+bool AccessTracker::IsValid() const
+{
+    return counters != NULL;
+}
+
+int AccessTracker::GetPolicy() const
+{
+    return policy;
+}
+
+void AccessTracker::Age()
+{
+    if (policy == MB_EVICTION_LFU) {
+        // Halve the counters only if some have saturated so that the
+        // frequencies seen over several sweeps are kept.
+        bool saturated = false;
+        for (uint32_t i = 0; i <= mask && !saturated; i++)
+            saturated = counters[i].load(std::memory_order_relaxed) == MB_ACCESS_COUNT_MAX;
+        if (!saturated)
+            return;
+    }
+
+    for (uint32_t i = 0; i <= mask; i++) {
+        uint8_t count = counters[i].load(std::memory_order_relaxed);
+        if (count == 0)
+            continue;
+        if (policy == MB_EVICTION_CLOCK)
+            counters[i].store(0, std::memory_order_relaxed);
+        else
+            counters[i].store(count >> 1, std::memory_order_relaxed);
+    }
+}
+
+void AccessTracker::PrintStats(std::ostream& out_stream) const
+{
+    uint64_t num_used = 0;
+    for (uint32_t i = 0; i <= mask; i++) {
+        if (counters[i].load(std::memory_order_relaxed) != 0)
+            num_used++;
+    }
+    out_stream << "Access table size: " << mask + 1 << std::endl;
+    out_stream << "\tNonzero access counters: " << num_used << std::endl;
+}
+
+uint32_t AccessTracker::TableSize(uint32_t size)
+{
+    if (size == 0)
+        return MB_ACCESS_TABLE_SIZE;
+    uint32_t table_size = 1;
+    while (table_size < size && table_size < 0x80000000U)
+        table_size <<= 1;
+    return table_size;
+}
+
+}
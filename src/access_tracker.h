@@ -0,0 +1,130 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __ACCESS_TRACKER_H__
+#define __ACCESS_TRACKER_H__
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <stdint.h>
+#include <string>
+
+#include "db.h"
+#include "mmap_file.h"
+
+namespace mabain {
+
+// Default number of access counters
+#define MB_ACCESS_TABLE_SIZE (1024 * 1024)
+#define MB_ACCESS_COUNT_MAX 255
+// LFU counters count every hit up to MB_LFU_LINEAR_COUNT. Above it, a hit
+// increments the counter c with probability 1 / ((c - MB_LFU_LINEAR_COUNT) *
+// MB_LFU_LOG_FACTOR + 1), so that the counter does not saturate on hot keys.
+#define MB_LFU_LINEAR_COUNT 16
+#define MB_LFU_LOG_FACTOR 8
+
+// Access counters in shared memory for access-aware eviction. Keys are hashed
+// to one byte counters. Readers update the counter of a key when a lookup
+// succeeds and the writer uses the counters to choose the entries to evict.
+// The counters are approximate: updates use relaxed loads and stores, so
+// concurrent readers may lose increments, and keys hashed to the same
+// counter share it.
+class AccessTracker {
+public:
+    AccessTracker(const std::string& fpath, uint32_t size, int policy, bool writer);
+    ~AccessTracker();
+
+    bool IsValid() const;
+    int GetPolicy() const;
+
+    // Record a lookup hit. Called by readers.
+    inline void Touch(const uint8_t* key, int len);
+    // Count an update as one reference so that new entries are not evicted
+    // before they are read. Called by the writer.
+    inline void Insert(const uint8_t* key, int len);
+    inline uint8_t Get(const uint8_t* key, int len) const;
+    // Called by the writer after an eviction sweep. CLOCK clears the
+    // reference bits. LFU halves the counters once some have saturated.
+    void Age();
+    void PrintStats(std::ostream& out_stream) const;
+
+    // Round the table size up to a power of 2
+    static uint32_t TableSize(uint32_t size);
+
+private:
+    inline uint32_t Slot(const uint8_t* key, int len) const;
+    static inline bool LFUIncrement(uint8_t count);
+
+    std::shared_ptr<MmapFileIO> file;
+    std::atomic<uint8_t>* counters;
+    uint32_t mask;
+    int policy;
+};
+
+inline uint32_t AccessTracker::Slot(const uint8_t* key, int len) const
+{
+    // FNV-1a
+    uint32_t hash = 2166136261U;
+    for (int i = 0; i < len; i++) {
+        hash ^= key[i];
+        hash *= 16777619U;
+    }
+    return hash & mask;
+}
+
+inline bool AccessTracker::LFUIncrement(uint8_t count)
+{
+    if (count < MB_LFU_LINEAR_COUNT)
+        return true;
+    // xorshift32
+    static thread_local uint32_t rand_state = 2463534242U;
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state % ((count - MB_LFU_LINEAR_COUNT) * MB_LFU_LOG_FACTOR + 1) == 0;
+}
+
+inline void AccessTracker::Touch(const uint8_t* key, int len)
+{
+    std::atomic<uint8_t>& counter = counters[Slot(key, len)];
+    uint8_t count = counter.load(std::memory_order_relaxed);
+    // Avoid writing to the cache line of hot keys if nothing changes.
+    if (policy == MB_EVICTION_CLOCK) {
+        if (count == 0)
+            counter.store(1, std::memory_order_relaxed);
+    } else if (count < MB_ACCESS_COUNT_MAX && LFUIncrement(count)) {
+        counter.store(count + 1, std::memory_order_relaxed);
+    }
+}
+
+inline void AccessTracker::Insert(const uint8_t* key, int len)
+{
+    std::atomic<uint8_t>& counter = counters[Slot(key, len)];
+    if (counter.load(std::memory_order_relaxed) == 0)
+        counter.store(1, std::memory_order_relaxed);
+}
+
+inline uint8_t AccessTracker::Get(const uint8_t* key, int len) const
+{
+    return counters[Slot(key, len)].load(std::memory_order_relaxed);
+}
+
+}
+
+#endif
@@ -0,0 +1,280 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define __MB_IO_URING__
+#endif
+#endif
+#endif
+
+#include "async_reader.h"
+#include "error.h"
+
+// Result of a read that has not completed
+#define ASYNC_READ_PENDING (-EINPROGRESS)
+
+namespace mabain {
+
+AsyncReader::AsyncReader()
+    : ring_fd(-1)
+    , sq_ring(NULL)
+    , sq_ring_size(0)
+    , sq_head(NULL)
+    , sq_tail(NULL)
+    , sq_mask(NULL)
+    , sq_array(NULL)
+    , sqes(NULL)
+    , sqes_size(0)
+    , sq_entries(0)
+    , cq_ring(NULL)
+    , cq_ring_size(0)
+    , cq_head(NULL)
+    , cq_tail(NULL)
+    , cq_mask(NULL)
+    , cqes(NULL)
+    , in_flight(0)
+{
+    if (SetupRing() != MBError::SUCCESS)
+        CloseRing();
+}
+
+AsyncReader::~AsyncReader()
+{
+    CloseRing();
+}
+
+bool AsyncReader::UsingIoUring() const
+{
+    return ring_fd >= 0;
+}
+
+int AsyncReader::SetupRing()
+{
+#ifdef __MB_IO_URING__
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = syscall(__NR_io_uring_setup, MB_ASYNC_READ_DEPTH, &params);
+    if (fd < 0)
+        return MBError::NOT_ALLOWED;
+    ring_fd = fd;
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    // Both rings are in one mapping on kernels 5.4 and later.
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        if (cq_ring_size > sq_ring_size)
+            sq_ring_size = cq_ring_size;
+        cq_ring_size = sq_ring_size;
+    }
+
+    void* ptr = mmap(NULL, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        ring_fd, IORING_OFF_SQ_RING);
+    if (ptr == MAP_FAILED)
+        return MBError::MMAP_FAILED;
+    sq_ring = ptr;
+    if (single_mmap) {
+        cq_ring = sq_ring;
+    } else {
+        ptr = mmap(NULL, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            ring_fd, IORING_OFF_CQ_RING);
+        if (ptr == MAP_FAILED)
+            return MBError::MMAP_FAILED;
+        cq_ring = ptr;
+    }
+
+    sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ptr = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        ring_fd, IORING_OFF_SQES);
+    if (ptr == MAP_FAILED)
+        return MBError::MMAP_FAILED;
+    sqes = ptr;
+
+    uint8_t* sq_ptr = reinterpret_cast<uint8_t*>(sq_ring);
+    sq_head = reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.array);
+    sq_entries = params.sq_entries;
+
+    uint8_t* cq_ptr = reinterpret_cast<uint8_t*>(cq_ring);
+    cq_head = reinterpret_cast<unsigned*>(cq_ptr + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq_ptr + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned*>(cq_ptr + params.cq_off.ring_mask);
+    cqes = cq_ptr + params.cq_off.cqes;
+    return MBError::SUCCESS;
+#else
+    return MBError::NOT_ALLOWED;
+#endif
+}
+
+void AsyncReader::CloseRing()
+{
+    if (sqes != NULL)
+        munmap(sqes, sqes_size);
+    if (cq_ring != NULL && cq_ring != sq_ring)
+        munmap(cq_ring, cq_ring_size);
+    if (sq_ring != NULL)
+        munmap(sq_ring, sq_ring_size);
+    sqes = NULL;
+    cq_ring = NULL;
+    sq_ring = NULL;
+    if (ring_fd >= 0)
+        close(ring_fd);
+    ring_fd = -1;
+}
+
+void AsyncReader::SyncRead(AsyncRead& read)
+{
+    size_t bytes_read = 0;
+    while (bytes_read < read.size) {
+        ssize_t nread = pread(read.fd, read.buff + bytes_read, read.size - bytes_read,
+            read.offset + bytes_read);
+        if (nread < 0) {
+            if (errno == EINTR)
+                continue;
+            if (bytes_read == 0) {
+                read.result = -errno;
+                return;
+            }
+            break;
+        }
+        if (nread == 0)
+            break;
+        bytes_read += nread;
+    }
+    read.result = bytes_read;
+}
+
+void AsyncReader::Read(std::vector<AsyncRead>& reads)
+{
+    for (auto& read : reads)
+        read.result = ASYNC_READ_PENDING;
+
+#ifdef __MB_IO_URING__
+    if (ring_fd >= 0) {
+        size_t next = 0;
+        // Reads queued in the ring but not taken by the kernel yet
+        unsigned queued = 0;
+        bool failed = false;
+        in_flight = 0;
+        while (!failed && (next < reads.size() || queued > 0 || in_flight > 0)) {
+            size_t count = Submit(reads, next);
+            next += count;
+            queued += count;
+            int ret = syscall(__NR_io_uring_enter, ring_fd, queued, 1,
+                IORING_ENTER_GETEVENTS, NULL, 0);
+            if (ret >= 0) {
+                queued -= ret;
+                in_flight += ret;
+            } else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                failed = true;
+            }
+            Reap(reads);
+        }
+
+        if (failed) {
+            // Wait for the reads in flight before the ring is closed. The
+            // remaining reads are done with pread from now on.
+            while (in_flight > 0) {
+                int ret = syscall(__NR_io_uring_enter, ring_fd, 0, 1,
+                    IORING_ENTER_GETEVENTS, NULL, 0);
+                if (ret < 0 && errno != EINTR)
+                    break;
+                Reap(reads);
+            }
+            CloseRing();
+        }
+    }
+#endif
+
+    for (auto& read : reads) {
+        if (read.result != static_cast<ssize_t>(read.size))
+            SyncRead(read);
+    }
+}
+
+size_t AsyncReader::Submit(std::vector<AsyncRead>& reads, size_t next)
+{
+#ifdef __MB_IO_URING__
+    unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *sq_tail;
+    unsigned mask = *sq_mask;
+    size_t count = 0;
+    struct io_uring_sqe* sqe_array = reinterpret_cast<struct io_uring_sqe*>(sqes);
+    // The completion ring has room for all reads in flight since it is at
+    // least as large as the submission ring.
+    while (next + count < reads.size() && tail - head < sq_entries
+        && in_flight + (tail - head) < sq_entries) {
+        AsyncRead& read = reads[next + count];
+        unsigned index = tail & mask;
+        struct io_uring_sqe* sqe = &sqe_array[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = read.fd;
+        sqe->addr = reinterpret_cast<uint64_t>(read.buff);
+        sqe->len = read.size;
+        sqe->off = read.offset;
+        sqe->user_data = next + count;
+        sq_array[index] = index;
+        tail++;
+        count++;
+    }
+    __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+    return count;
+#else
+    (void)reads;
+    (void)next;
+    return 0;
+#endif
+}
+
+size_t AsyncReader::Reap(std::vector<AsyncRead>& reads)
+{
+#ifdef __MB_IO_URING__
+    unsigned head = *cq_head;
+    unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    unsigned mask = *cq_mask;
+    struct io_uring_cqe* cqe_array = reinterpret_cast<struct io_uring_cqe*>(cqes);
+    size_t count = 0;
+    while (head != tail) {
+        struct io_uring_cqe* cqe = &cqe_array[head & mask];
+        if (cqe->user_data < reads.size())
+            reads[cqe->user_data].result = cqe->res;
+        head++;
+        count++;
+    }
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    in_flight -= count;
+    return count;
+#else
+    (void)reads;
+    return 0;
+#endif
+}
+
+}
@@ -0,0 +1,88 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __ASYNC_READER_H__
+#define __ASYNC_READER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <vector>
+
+namespace mabain {
+
+// Number of reads in flight
+#define MB_ASYNC_READ_DEPTH 128
+
+typedef struct _AsyncRead {
+    int fd;
+    uint8_t* buff;
+    size_t size;
+    off_t offset;
+    // Number of bytes read, or -errno
+    ssize_t result;
+} AsyncRead;
+
+// Reads from files with io_uring. The ring is set up with raw syscalls so
+// that liburing is not needed. If io_uring is not available in the kernel
+// or is not allowed, the reads are done with pread one by one.
+class AsyncReader {
+public:
+    AsyncReader();
+    ~AsyncReader();
+
+    // Submit all reads, at most MB_ASYNC_READ_DEPTH at a time, and wait for
+    // them to complete. Reads that fail or come back short are done again
+    // with pread. Sets the result of each read.
+    void Read(std::vector<AsyncRead>& reads);
+    bool UsingIoUring() const;
+
+private:
+    int SetupRing();
+    void CloseRing();
+    // Queue the reads from next, returns the number queued.
+    size_t Submit(std::vector<AsyncRead>& reads, size_t next);
+    // Wait for at least one completion and return the number reaped.
+    size_t Reap(std::vector<AsyncRead>& reads);
+    static void SyncRead(AsyncRead& read);
+
+    int ring_fd;
+    // Submission ring
+    void* sq_ring;
+    size_t sq_ring_size;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    void* sqes;
+    size_t sqes_size;
+    unsigned sq_entries;
+    // Completion ring
+    void* cq_ring;
+    size_t cq_ring_size;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    void* cqes;
+    // Reads submitted but not completed
+    size_t in_flight;
+};
+
+}
+
+#endif
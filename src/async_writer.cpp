@@ -20,6 +20,8 @@
 #include <sys/time.h>
 #include <unistd.h>
 
+#include <climits>
+
 #include "async_writer.h"
 #include "dict.h"
 #include "error.h"
@@ -27,37 +29,56 @@
 #include "logger.h"
 #include "mb_data.h"
 #include "mb_rc.h"
+#include "util/utils.h"
+#include "writer_pool.h"
 
 namespace mabain {
 
-AsyncWriter* AsyncWriter::writer_instance = NULL;
+std::mutex AsyncWriter::registry_mutex;
+std::map<std::string, AsyncWriter*> AsyncWriter::writer_registry;
 
-AsyncWriter* AsyncWriter::CreateInstance(DB* db_ptr)
+AsyncWriter* AsyncWriter::CreateInstance(DB* db_ptr, uint32_t pool_size,
+    uint32_t defrag_step_time)
 {
-    writer_instance = new AsyncWriter(db_ptr);
-    return writer_instance;
+    AsyncWriter* awr = new AsyncWriter(db_ptr, pool_size, defrag_step_time);
+
+    std::lock_guard<std::mutex> guard(registry_mutex);
+    writer_registry[awr->db_dir] = awr;
+    return awr;
 }
 
-AsyncWriter* AsyncWriter::GetInstance()
+AsyncWriter* AsyncWriter::GetInstance(const std::string& dir)
 {
-    return writer_instance;
+    std::lock_guard<std::mutex> guard(registry_mutex);
+    auto it = writer_registry.find(dir);
+    if (it == writer_registry.end())
+        return NULL;
+    return it->second;
 }
 
-AsyncWriter::AsyncWriter(DB* db_ptr)
+AsyncWriter::AsyncWriter(DB* db_ptr, uint32_t pool_size, uint32_t defrag_step_time)
     : db(db_ptr)
     , tid(0)
     , stop_processing(false)
+    , pooled(pool_size > 0)
+    , pool_busy(false)
+    , pool_refs(0)
     , queue(NULL)
     , header(NULL)
+    , stall_index(0)
+    , stall_start(0)
+    , defrag(NULL)
+    , defrag_step_time(defrag_step_time)
 {
     dict = NULL;
-    if (!(db_ptr->GetDBOptions() & CONSTS::ACCESS_MODE_WRITER))
-        throw(int) MBError::NOT_ALLOWED;
     if (db == NULL)
         throw(int) MBError::INVALID_ARG;
+    if (!(db_ptr->GetDBOptions() & CONSTS::ACCESS_MODE_WRITER))
+        throw(int) MBError::NOT_ALLOWED;
     dict = db->GetDictPtr();
     if (dict == NULL)
         throw(int) MBError::NOT_INITIALIZED;
+    db_dir = db->GetDBDir();
 
     // initialize shared memory queue pointer
     header = dict->GetHeaderPtr();
@@ -67,6 +88,15 @@ AsyncWriter::AsyncWriter(DB* db_ptr)
     header->rc_flag.store(0, std::memory_order_release);
 
     rc_backup_dir = NULL;
+    if (pooled) {
+        // No thread of its own. Recover before the pool starts serving the queue.
+        Recover();
+        int rval = WriterPool::getInstance().Register(this, pool_size);
+        if (rval != MBError::SUCCESS)
+            throw rval;
+        return;
+    }
+
     // start the thread
     if (pthread_create(&tid, NULL, async_thread_wrapper, this) != 0) {
         Logger::Log(LOG_LEVEL_ERROR, "failed to create async thread");
@@ -77,18 +107,36 @@ AsyncWriter::AsyncWriter(DB* db_ptr)
 
 AsyncWriter::~AsyncWriter()
 {
+    std::lock_guard<std::mutex> guard(registry_mutex);
+    auto it = writer_registry.find(db_dir);
+    if (it != writer_registry.end() && it->second == this)
+        writer_registry.erase(it);
+    if (defrag != NULL)
+        delete defrag;
 }
 
 int AsyncWriter::StopAsyncThread()
 {
     stop_processing = true;
-    dict->SHMQ_Signal();
-
-    if (tid != 0) {
-        Logger::Log(LOG_LEVEL_DEBUG, "joining async writer thread");
-        pthread_join(tid, NULL);
+    if (pooled) {
+        // Returns after no pool thread is serving this queue.
+        WriterPool::getInstance().Unregister(this);
+        pooled = false;
+    } else {
+        dict->SHMQ_Signal();
+
+        if (tid != 0) {
+            Logger::Log(LOG_LEVEL_DEBUG, "joining async writer thread");
+            pthread_join(tid, NULL);
+            tid = 0;
+        }
     }
 
+    // Updates in the rc tree are only added to the main tree when the
+    // defragmentation is done.
+    while (defrag != NULL)
+        RunDefragStep(header->async_queue_size);
+
     return MBError::SUCCESS;
 }
 
@@ -102,15 +150,17 @@ int AsyncWriter::ProcessTask(int ntasks, bool rc_mode)
     int count = 0;
 
     while (count < ntasks) {
-        node_ptr = &queue[header->writer_index % header->async_queue_size];
+        uint32_t windex = header->writer_index;
+        node_ptr = &queue[windex % header->async_queue_size];
 
-        if (node_ptr->in_use.load(std::memory_order_consume)) {
+        if (node_ptr->seq.load(std::memory_order_acquire) == MB_ASYNC_SHM_SEQ_READY(windex)) {
             switch (node_ptr->type) {
             case MABAIN_ASYNC_TYPE_ADD:
                 if (rc_mode)
                     mbd.options = CONSTS::OPTION_RC_MODE;
                 mbd.buff = (uint8_t*)node_ptr->data;
                 mbd.data_len = node_ptr->data_len;
+                mbd.expire_time = node_ptr->expire_time;
                 try {
                     rval = dict->Add((uint8_t*)node_ptr->key, node_ptr->key_len, mbd, node_ptr->overwrite);
                 } catch (int err) {
@@ -119,16 +169,37 @@ int AsyncWriter::ProcessTask(int ntasks, bool rc_mode)
                         MBError::get_error_str(err));
                 }
                 break;
+            case MABAIN_ASYNC_TYPE_MERGE: {
+                // mbd.buff may point to a queue slot, so the merged value is
+                // kept in its own buffer.
+                MBData merged;
+                if (rc_mode)
+                    merged.options = CONSTS::OPTION_RC_MODE;
+                try {
+                    rval = dict->Merge((uint8_t*)node_ptr->key, node_ptr->key_len,
+                        node_ptr->merge_op, (uint8_t*)node_ptr->data, node_ptr->data_len, merged);
+                } catch (int err) {
+                    rval = err;
+                    Logger::Log(LOG_LEVEL_ERROR, "dict->Merge throws error %s",
+                        MBError::get_error_str(err));
+                }
+                break;
+            }
             case MABAIN_ASYNC_TYPE_REMOVE:
-                // FIXME
-                // Removing entries during rc is currently not supported.
-                // The index or data index could have been reset in fucntion ResourceColletion::Finish.
-                // However, the deletion may be run for some entry which still exist in the rc root tree.
-                // This requires modifying buffer in high end, where the offset for writing is greather than
-                // header->m_index_offset. This causes exception thrown from DictMem::WriteData.
-                // Note this is not a problem for Dict::Add since Add does not modify buffers in high end.
-                // This problem will be fixed when resolving issue: https://github.com/chxdeng/mabain/issues/21
-                rval = MBError::SUCCESS;
+                // The entry is removed from the rc tree and the main tree. In rc mode,
+                // the removal from the main tree is deferred by Dict::Remove since the
+                // main tree buffers are being relocated.
+                mbd.options = CONSTS::OPTION_FIND_AND_STORE_PARENT;
+                if (rc_mode)
+                    mbd.options |= CONSTS::OPTION_RC_MODE;
+                try {
+                    rval = dict->Remove((uint8_t*)node_ptr->key, node_ptr->key_len, mbd);
+                } catch (int err) {
+                    rval = err;
+                    Logger::Log(LOG_LEVEL_ERROR, "dict->Remove throws error %s",
+                        MBError::get_error_str(err));
+                }
+                mbd.options = 0;
                 break;
             case MABAIN_ASYNC_TYPE_REMOVE_ALL:
                 if (!rc_mode) {
@@ -164,10 +235,16 @@ int AsyncWriter::ProcessTask(int ntasks, bool rc_mode)
                 break;
             }
 
-            header->writer_index++;
-            node_ptr->num_reader.store(0, std::memory_order_release);
-            node_ptr->type = MABAIN_ASYNC_TYPE_NONE;
-            node_ptr->in_use.store(false, std::memory_order_release);
+            // Updates are added to the main tree while the rc tree is being
+            // added to it. Drop the older value from the rc tree so that it
+            // does not replace the update.
+            if (!rc_mode && rval == MBError::SUCCESS
+                && (node_ptr->type == MABAIN_ASYNC_TYPE_ADD || node_ptr->type == MABAIN_ASYNC_TYPE_MERGE)
+                && header->rc_root_offset.load(std::memory_order_relaxed) != 0) {
+                dict->Remove_RC((uint8_t*)node_ptr->key, node_ptr->key_len);
+            }
+
+            dict->SHMQ_ReleaseSlot(node_ptr, windex);
             mbd.Clear();
             count++;
         } else {
@@ -186,174 +263,305 @@ int AsyncWriter::ProcessTask(int ntasks, bool rc_mode)
     return MBError::SUCCESS;
 }
 
-uint32_t AsyncWriter::NextShmSlot(uint32_t windex, uint32_t qindex)
+// Check if the producer claiming position windex has not published the update
+// for MB_ASYNC_SHM_STALL_TMOUT. This happens if the producer process exited
+// unexpectedly. The stalled slot is skipped so that the queue can move on.
+// Once the queue wraps around to a skipped slot, the slot is released if its
+// producer has exited.
+bool AsyncWriter::SkipStalledSlot(AsyncNode* node_ptr, uint32_t windex)
 {
-    int cnt = 0;
-    while (windex != qindex) {
-        if (queue[windex % header->async_queue_size].in_use.load(std::memory_order_consume))
-            break;
-        if (++cnt > header->async_queue_size) {
-            windex = qindex;
-            break;
-        }
+    if (header->queue_index.load(std::memory_order_acquire) == windex) {
+        // Nothing has been claimed.
+        stall_index = windex;
+        stall_start = 0;
+        uint32_t pos;
+        if (dict->SHMQ_ReleaseBlockedSlot(pos))
+            Logger::Log(LOG_LEVEL_WARN, "released async queue slot %u skipped by exited producer",
+                pos);
+        return false;
+    }
 
-        windex++;
+    int64_t now = get_current_time_ms();
+    if (stall_index != windex || stall_start == 0) {
+        stall_index = windex;
+        stall_start = now;
+        return false;
     }
+    if (now - stall_start < MB_ASYNC_SHM_STALL_TMOUT)
+        return false;
+
+    stall_start = 0;
+    if (!dict->SHMQ_SkipSlot(node_ptr, windex))
+        return false; // published in the meantime
+    Logger::Log(LOG_LEVEL_WARN, "skipped async queue slot %u not published in %d ms",
+        windex, MB_ASYNC_SHM_STALL_TMOUT);
+    return true;
+}
 
-    return windex;
+bool AsyncWriter::IsBatchUpdate(int type) const
+{
+    return type == MABAIN_ASYNC_TYPE_ADD || type == MABAIN_ASYNC_TYPE_REMOVE
+        || type == MABAIN_ASYNC_TYPE_REMOVE_ALL || type == MABAIN_ASYNC_TYPE_MERGE;
 }
 
-void* AsyncWriter::async_writer_thread()
+// Apply one add, merge or remove from the queue. Caller must hold writer_lock.
+int AsyncWriter::ProcessUpdate(AsyncNode* node_ptr, MBData& mbd)
 {
-    AsyncNode* node_ptr;
-    MBData mbd;
     int rval;
-    int64_t min_index_size = 0;
-    int64_t min_data_size = 0;
-    int64_t max_dbsize = MAX_6B_OFFSET;
-    int64_t max_dbcount = MAX_6B_OFFSET;
-    bool skip;
-    MBPipe mbp(db->GetDBDir(), CONSTS::ACCESS_MODE_WRITER);
 
-    Logger::Log(LOG_LEVEL_DEBUG, "async writer started");
+    switch (node_ptr->type) {
+    case MABAIN_ASYNC_TYPE_ADD:
+        mbd.buff = (uint8_t*)node_ptr->data;
+        mbd.data_len = node_ptr->data_len;
+        mbd.expire_time = node_ptr->expire_time;
+        try {
+            rval = dict->Add((uint8_t*)node_ptr->key, node_ptr->key_len, mbd,
+                node_ptr->overwrite);
+        } catch (int err) {
+            Logger::Log(LOG_LEVEL_ERROR, "dict->Add throws error %s",
+                MBError::get_error_str(err));
+            rval = err;
+        }
+        break;
+    case MABAIN_ASYNC_TYPE_MERGE: {
+        MBData merged;
+        try {
+            rval = dict->Merge((uint8_t*)node_ptr->key, node_ptr->key_len,
+                node_ptr->merge_op, (uint8_t*)node_ptr->data, node_ptr->data_len, merged);
+        } catch (int err) {
+            Logger::Log(LOG_LEVEL_ERROR, "dict->Merge throws error %s",
+                MBError::get_error_str(err));
+            rval = err;
+        }
+        break;
+    }
+    case MABAIN_ASYNC_TYPE_REMOVE:
+        mbd.options |= CONSTS::OPTION_FIND_AND_STORE_PARENT;
+        try {
+            rval = dict->Remove((uint8_t*)node_ptr->key, node_ptr->key_len, mbd);
+        } catch (int err) {
+            Logger::Log(LOG_LEVEL_ERROR, "dict->Remmove throws error %s",
+                MBError::get_error_str(err));
+            rval = err;
+        }
+        mbd.options &= ~CONSTS::OPTION_FIND_AND_STORE_PARENT;
+        break;
+    case MABAIN_ASYNC_TYPE_REMOVE_ALL:
+        try {
+            rval = dict->RemoveAll();
+        } catch (int err) {
+            Logger::Log(LOG_LEVEL_ERROR, "dict->RemoveAll throws error %s",
+                MBError::get_error_str(err));
+            rval = err;
+        }
+        break;
+    default:
+        rval = MBError::INVALID_ARG;
+        break;
+    }
+
+    if (rval != MBError::SUCCESS) {
+        Logger::Log(LOG_LEVEL_DEBUG, "failed to run update %d: %s",
+            (int)node_ptr->type, MBError::get_error_str(rval));
+    }
+    mbd.Clear();
+    return rval;
+}
+
+// Give up the next slot if it was claimed but has not been published for
+// MB_ASYNC_SHM_STALL_TMOUT, or release the skipped slot blocking producers.
+// Used by the writer pool.
+void AsyncWriter::CheckStalledSlot()
+{
+    uint32_t windex = header->writer_index;
+    AsyncNode* node_ptr = &queue[windex % header->async_queue_size];
+    if (node_ptr->seq.load(std::memory_order_acquire) != MB_ASYNC_SHM_SEQ_READY(windex))
+        SkipStalledSlot(node_ptr, windex);
+}
+
+void AsyncWriter::Recover()
+{
     if (!(db->GetDBOptions() & CONSTS::OPTION_JEMALLOC)) {
         ResourceCollection rc(*db);
         writer_lock.lock();
         rc.ExceptionRecovery();
+        dict->ReplayRedoLog();
+        dict->RebuildExpiryLog(*db);
         writer_lock.unlock();
     }
+}
 
-    while (!stop_processing) {
-        node_ptr = &queue[header->writer_index % header->async_queue_size];
+int AsyncWriter::ServiceQueue(int max_updates)
+{
+    if (defrag != NULL)
+        return RunDefragStep(max_updates);
 
-        skip = false;
-        while (!node_ptr->in_use.load(std::memory_order_consume)) {
-            if (stop_processing) {
-                skip = true;
-                break;
-            }
+    uint32_t windex = header->writer_index;
+    AsyncNode* node_ptr = &queue[windex % header->async_queue_size];
+    if (node_ptr->seq.load(std::memory_order_acquire) != MB_ASYNC_SHM_SEQ_READY(windex))
+        return 0;
 
-#define __ASYNC_THREAD_SLEEP_TIME 1000
-            mbp.Wait(__ASYNC_THREAD_SLEEP_TIME);
-
-            auto windex = header->writer_index;
-            auto qindex = header->queue_index.load(std::memory_order_consume);
-            if (windex != qindex) {
-                // Reader process may have exited unexpectedly. Recover index.
-                skip = true;
-                header->writer_index = NextShmSlot(windex, qindex);
-                break;
-            }
+    if (!IsBatchUpdate(node_ptr->type)) {
+        RunTask(node_ptr, windex);
+        return 1;
+    }
+
+    // Drain consecutive ready updates under one lock acquisition and release
+    // the slots together.
+    MBData mbd;
+    uint32_t end = windex;
+    writer_lock.lock();
+    do {
+        ProcessUpdate(node_ptr, mbd);
+        end++;
+        node_ptr = &queue[end % header->async_queue_size];
+    } while (!stop_processing && static_cast<int>(end - windex) < max_updates
+        && node_ptr->seq.load(std::memory_order_acquire) == MB_ASYNC_SHM_SEQ_READY(end)
+        && IsBatchUpdate(node_ptr->type));
+    writer_lock.unlock();
+    dict->SHMQ_ReleaseSlots(windex, end);
+    mbd.buff = NULL;
+    return static_cast<int>(end - windex);
+}
+
+// Run a task other than add/remove. Resource collection requested by the task
+// runs to completion here unless defrag_step_time is set.
+void AsyncWriter::RunTask(AsyncNode* node_ptr, uint32_t windex)
+{
+    int rval;
+    int64_t min_index_size = 0;
+    int64_t min_data_size = 0;
+    int64_t max_dbsize = MAX_6B_OFFSET;
+    int64_t max_dbcount = MAX_6B_OFFSET;
+
+    switch (node_ptr->type) {
+    case MABAIN_ASYNC_TYPE_RC:
+        rval = MBError::SUCCESS;
+        header->rc_flag.store(1, std::memory_order_release);
+        {
+            int64_t* data_ptr = reinterpret_cast<int64_t*>(node_ptr->data);
+            min_index_size = data_ptr[0];
+            min_data_size = data_ptr[1];
+            max_dbsize = data_ptr[2];
+            max_dbcount = data_ptr[3];
+        }
+        break;
+    case MABAIN_ASYNC_TYPE_NONE:
+        rval = MBError::SUCCESS;
+        break;
+    case MABAIN_ASYNC_TYPE_BACKUP:
+        try {
+            DBBackup mbbk(*db);
+            rval = mbbk.Backup((const char*)node_ptr->data);
+        } catch (int error) {
+            rval = error;
         }
+        break;
+    default:
+        rval = MBError::INVALID_ARG;
+        break;
+    }
 
-        if (skip)
-            continue;
+    if (rval != MBError::SUCCESS) {
+        Logger::Log(LOG_LEVEL_DEBUG, "failed to run update %d: %s",
+            (int)node_ptr->type, MBError::get_error_str(rval));
+    }
+    dict->SHMQ_ReleaseSlot(node_ptr, windex);
 
-        // process the node
-        switch (node_ptr->type) {
-        case MABAIN_ASYNC_TYPE_ADD:
-            mbd.buff = (uint8_t*)node_ptr->data;
-            mbd.data_len = node_ptr->data_len;
-            writer_lock.lock();
-            try {
-                rval = dict->Add((uint8_t*)node_ptr->key, node_ptr->key_len, mbd,
-                    node_ptr->overwrite);
-            } catch (int err) {
-                Logger::Log(LOG_LEVEL_ERROR, "dict->Add throws error %s",
-                    MBError::get_error_str(err));
-                rval = err;
-            }
-            writer_lock.unlock();
-            break;
-        case MABAIN_ASYNC_TYPE_REMOVE:
-            mbd.options |= CONSTS::OPTION_FIND_AND_STORE_PARENT;
-            writer_lock.lock();
-            try {
-                rval = dict->Remove((uint8_t*)node_ptr->key, node_ptr->key_len, mbd);
-            } catch (int err) {
-                Logger::Log(LOG_LEVEL_ERROR, "dict->Remmove throws error %s",
-                    MBError::get_error_str(err));
-                rval = err;
-            }
-            writer_lock.unlock();
-            mbd.options &= ~CONSTS::OPTION_FIND_AND_STORE_PARENT;
-            break;
-        case MABAIN_ASYNC_TYPE_REMOVE_ALL:
-            writer_lock.lock();
-            try {
-                rval = dict->RemoveAll();
-            } catch (int err) {
-                Logger::Log(LOG_LEVEL_ERROR, "dict->RemoveAll throws error %s",
-                    MBError::get_error_str(err));
-                rval = err;
+    if (header->rc_flag.load(std::memory_order_consume) == 1) {
+        rval = MBError::SUCCESS;
+        writer_lock.lock();
+        try {
+            if (defrag_step_time > 0) {
+                defrag = new ResourceCollection(*db);
+                defrag->StartDefrag(min_index_size, min_data_size, max_dbsize, max_dbcount, this);
+            } else {
+                ResourceCollection rc = ResourceCollection(*db);
+                rc.ReclaimResource(min_index_size, min_data_size, max_dbsize, max_dbcount, this);
             }
-            writer_lock.unlock();
-            break;
-        case MABAIN_ASYNC_TYPE_RC:
-            rval = MBError::SUCCESS;
-            header->rc_flag.store(1, std::memory_order_release);
-            {
-                int64_t* data_ptr = reinterpret_cast<int64_t*>(node_ptr->data);
-                min_index_size = data_ptr[0];
-                min_data_size = data_ptr[1];
-                max_dbsize = data_ptr[2];
-                max_dbcount = data_ptr[3];
+        } catch (int error) {
+            if (defrag != NULL) {
+                delete defrag;
+                defrag = NULL;
             }
-            break;
-        case MABAIN_ASYNC_TYPE_NONE:
-            rval = MBError::SUCCESS;
-            break;
-        case MABAIN_ASYNC_TYPE_BACKUP:
-            try {
-                DBBackup mbbk(*db);
-                rval = mbbk.Backup((const char*)node_ptr->data);
-            } catch (int error) {
+            if (error != MBError::RC_SKIPPED) {
+                Logger::Log(LOG_LEVEL_WARN, "rc failed :%s", MBError::get_error_str(error));
                 rval = error;
             }
-            break;
-        default:
-            rval = MBError::INVALID_ARG;
-            break;
         }
+        writer_lock.unlock();
+
+        if (defrag == NULL)
+            EndResourceCollection(rval);
+    }
+}
 
-        header->writer_index++;
-        node_ptr->num_reader.store(0, std::memory_order_release);
-        node_ptr->type = MABAIN_ASYNC_TYPE_NONE;
-        node_ptr->in_use.store(false, std::memory_order_release);
+// Process up to max_updates queued updates in rc mode and run one step of the
+// defragmentation. Returns the number of slots released.
+int AsyncWriter::RunDefragStep(int max_updates)
+{
+    uint32_t windex = header->writer_index;
+    int rval = MBError::SUCCESS;
+    bool done;
+
+    if (max_updates > header->async_queue_size)
+        max_updates = header->async_queue_size;
+    writer_lock.lock();
+    try {
+        ProcessTask(max_updates, true);
+        done = defrag->RunDefragStep(defrag_step_time);
+    } catch (int error) {
+        Logger::Log(LOG_LEVEL_WARN, "rc failed :%s", MBError::get_error_str(error));
+        rval = error;
+        done = true;
+    }
+    writer_lock.unlock();
 
-        if (rval != MBError::SUCCESS) {
-            Logger::Log(LOG_LEVEL_DEBUG, "failed to run update %d: %s",
-                (int)node_ptr->type, MBError::get_error_str(rval));
+    if (done) {
+        delete defrag;
+        defrag = NULL;
+        EndResourceCollection(rval);
+    }
+    return static_cast<int>(header->writer_index - windex);
+}
+
+// Run the backup requested during resource collection.
+void AsyncWriter::EndResourceCollection(int rval)
+{
+    header->rc_flag.store(0, std::memory_order_release);
+    if (rc_backup_dir != NULL) {
+        if (rval == MBError::SUCCESS) {
+            dict->SHMQ_Backup(rc_backup_dir);
         }
+        free(rc_backup_dir);
+        rc_backup_dir = NULL;
+    }
+}
 
-        mbd.Clear();
+void* AsyncWriter::async_writer_thread()
+{
+    AsyncNode* node_ptr;
 
-        if (header->rc_flag.load(std::memory_order_consume) == 1) {
-            rval = MBError::SUCCESS;
-            writer_lock.lock();
-            try {
-                ResourceCollection rc = ResourceCollection(*db);
-                rc.ReclaimResource(min_index_size, min_data_size, max_dbsize, max_dbcount, this);
-            } catch (int error) {
-                if (error != MBError::RC_SKIPPED) {
-                    Logger::Log(LOG_LEVEL_WARN, "rc failed :%s", MBError::get_error_str(error));
-                    rval = error;
-                }
-            }
-            writer_lock.unlock();
+    Logger::Log(LOG_LEVEL_DEBUG, "async writer started");
+    Recover();
 
-            header->rc_flag.store(0, std::memory_order_release);
-            if (rc_backup_dir != NULL) {
-                if (rval == MBError::SUCCESS) {
-                    dict->SHMQ_Backup(rc_backup_dir);
-                }
-                free(rc_backup_dir);
-                rc_backup_dir = NULL;
-            }
+    while (!stop_processing) {
+        uint32_t windex = header->writer_index;
+        node_ptr = &queue[windex % header->async_queue_size];
+
+        if (defrag == NULL
+            && node_ptr->seq.load(std::memory_order_acquire) != MB_ASYNC_SHM_SEQ_READY(windex)) {
+#define __ASYNC_THREAD_SLEEP_TIME 1000
+            if (!dict->SHMQ_WaitForSlot(node_ptr, windex, __ASYNC_THREAD_SLEEP_TIME))
+                SkipStalledSlot(node_ptr, windex);
+            SweepExpired();
+            continue;
         }
+
+        ServiceQueue(INT_MAX);
+        SweepExpired();
     }
 
-    mbd.buff = NULL;
     Logger::Log(LOG_LEVEL_DEBUG, "async writer exiting");
     return NULL;
 }
@@ -384,4 +592,49 @@ int AsyncWriter::AddWithLock(const char* key, int len, MBData& mbdata, bool over
     return MBError::TRY_AGAIN;
 }
 
+int AsyncWriter::MergeWithLock(const char* key, int len, int op, const char* operand,
+    int operand_len)
+{
+    if (header->rc_flag.load(std::memory_order_relaxed))
+        return MBError::TRY_AGAIN;
+
+    using Ms = std::chrono::milliseconds;
+    if (writer_lock.try_lock_for(Ms(1000))) {
+        int rval;
+        MBData mbd;
+        try {
+            rval = dict->Merge(reinterpret_cast<const uint8_t*>(key), len, op,
+                reinterpret_cast<const uint8_t*>(operand), operand_len, mbd);
+        } catch (int error) {
+            rval = error;
+        }
+        writer_lock.unlock();
+        return rval;
+    }
+
+    return MBError::TRY_AGAIN;
+}
+
+int AsyncWriter::RegisterMergeOperator(int op, MergeOperator merge_op)
+{
+    std::lock_guard<std::timed_mutex> lock(writer_lock);
+    return dict->RegisterMergeOperator(op, merge_op);
+}
+
+// Remove a limited number of expired entries between updates
+void AsyncWriter::SweepExpired()
+{
+    if (!dict->ExpiryDue() || header->rc_flag.load(std::memory_order_relaxed))
+        return;
+
+    writer_lock.lock();
+    try {
+        dict->RemoveExpired(MB_EXPIRY_SWEEP_COUNT);
+    } catch (int error) {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to remove expired entries: %s",
+            MBError::get_error_str(error));
+    }
+    writer_lock.unlock();
+}
+
 }
@@ -19,8 +19,10 @@
 #ifndef __ASYNC_WRITER_H__
 #define __ASYNC_WRITER_H__
 
+#include <map>
 #include <mutex>
 #include <pthread.h>
+#include <string>
 
 #include "db.h"
 #include "dict.h"
@@ -31,41 +33,79 @@
 
 namespace mabain {
 
+class WriterPool;
+class ResourceCollection;
+
+// Each DB opened with ASYNC_WRITER_MODE has its own async writer. The queue is
+// served either by a dedicated thread or, if pool_size is not zero, by the
+// process-wide writer pool shared with other DBs.
 class AsyncWriter {
+    friend class WriterPool;
+
 public:
     ~AsyncWriter();
 
     int StopAsyncThread();
     int ProcessTask(int ntasks, bool rc_mode);
     int AddWithLock(const char* key, int len, MBData& mbdata, bool overwrite);
-
-    static AsyncWriter* CreateInstance(DB* db_ptr);
-    static AsyncWriter* GetInstance();
+    int MergeWithLock(const char* key, int len, int op, const char* operand, int operand_len);
+    int RegisterMergeOperator(int op, MergeOperator merge_op);
+    // Process the updates in the queue. At most max_updates adds/merges/removes are
+    // applied in one batch. Returns the number of slots released.
+    int ServiceQueue(int max_updates);
+    // Remove expired entries if any is due.
+    void SweepExpired();
+
+    static AsyncWriter* CreateInstance(DB* db_ptr, uint32_t pool_size = 0,
+        uint32_t defrag_step_time = 0);
+    // Find the async writer of the DB in dir opened in this process.
+    static AsyncWriter* GetInstance(const std::string& dir);
 
 private:
-    AsyncWriter(DB* db_ptr);
+    AsyncWriter(DB* db_ptr, uint32_t pool_size, uint32_t defrag_step_time);
     static void* async_thread_wrapper(void* context);
     AsyncNode* AcquireSlot();
     int PrepareSlot(AsyncNode* node_ptr) const;
     void* async_writer_thread();
-    uint32_t NextShmSlot(uint32_t windex, uint32_t qindex);
+    void Recover();
+    bool SkipStalledSlot(AsyncNode* node_ptr, uint32_t windex);
+    void CheckStalledSlot();
+    bool IsBatchUpdate(int type) const;
+    int ProcessUpdate(AsyncNode* node_ptr, MBData& mbd);
+    void RunTask(AsyncNode* node_ptr, uint32_t windex);
+    int RunDefragStep(int max_updates);
+    void EndResourceCollection(int rval);
 
     // db pointer
     DB* db;
     Dict* dict;
+    std::string db_dir;
 
     // thread id
     pthread_t tid;
     bool stop_processing;
+    // Served by the writer pool instead of a dedicated thread
+    bool pooled;
+    // Pool scheduling states, guarded by the pool mutex
+    bool pool_busy;
+    int pool_refs;
 
     AsyncNode* queue;
     IndexHeader* header;
+    // stalled slot detection
+    uint32_t stall_index;
+    int64_t stall_start;
 
     bool is_rc_running;
     char* rc_backup_dir;
+    // Defragmentation run in steps of defrag_step_time microseconds
+    ResourceCollection* defrag;
+    uint32_t defrag_step_time;
 
     std::timed_mutex writer_lock;
-    static AsyncWriter* writer_instance;
+
+    static std::mutex registry_mutex;
+    static std::map<std::string, AsyncWriter*> writer_registry;
 };
 
 }
@@ -0,0 +1,168 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "block_prealloc.h"
+#include "error.h"
+#include "logger.h"
+#include "mabain_consts.h"
+#include "numa_policy.h"
+#include "resource_pool.h"
+#include "rollable_file.h"
+
+namespace mabain {
+
+BlockPreallocator::BlockPreallocator(const std::string& fpath, int access_mode,
+    size_t blocksize, std::shared_ptr<MmapRegion> block_region)
+    : path(fpath)
+    , mode(access_mode)
+    , block_size(blocksize)
+    , region(block_region)
+    , pending(false)
+    , busy(false)
+    , stop_prealloc(false)
+    , req_order(0)
+    , req_numa_policy(MB_NUMA_DEFAULT)
+    , req_numa_nodes(0)
+    , count(0)
+    , tid(0)
+{
+    if (pthread_create(&tid, NULL, prealloc_thread_wrapper, this) != 0) {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to create block preallocation thread");
+        throw(int) MBError::THREAD_FAILED;
+    }
+}
+
+BlockPreallocator::~BlockPreallocator()
+{
+    {
+        std::lock_guard<std::mutex> lock(req_mutex);
+        stop_prealloc = true;
+    }
+    req_cond.notify_all();
+    pthread_join(tid, NULL);
+}
+
+void BlockPreallocator::Request(size_t block_order, int numa_policy, uint64_t numa_nodes)
+{
+    {
+        std::lock_guard<std::mutex> lock(req_mutex);
+        pending = true;
+        req_order = block_order;
+        req_numa_policy = numa_policy;
+        req_numa_nodes = numa_nodes;
+    }
+    req_cond.notify_all();
+}
+
+void BlockPreallocator::Wait()
+{
+    std::unique_lock<std::mutex> lock(req_mutex);
+    while (pending || busy)
+        req_cond.wait(lock);
+}
+
+size_t BlockPreallocator::GetCount() const
+{
+    return count.load(std::memory_order_relaxed);
+}
+
+void* BlockPreallocator::prealloc_thread_wrapper(void* context)
+{
+    BlockPreallocator* prealloc = reinterpret_cast<BlockPreallocator*>(context);
+    return prealloc->prealloc_thread();
+}
+
+void* BlockPreallocator::prealloc_thread()
+{
+    std::unique_lock<std::mutex> lock(req_mutex);
+    while (true) {
+        while (!pending && !stop_prealloc)
+            req_cond.wait(lock);
+        if (stop_prealloc)
+            break;
+
+        size_t order = req_order;
+        int numa_policy = req_numa_policy;
+        uint64_t numa_nodes = req_numa_nodes;
+        pending = false;
+        busy = true;
+        lock.unlock();
+
+        Preallocate(order, numa_policy, numa_nodes);
+
+        lock.lock();
+        busy = false;
+        req_cond.notify_all();
+    }
+
+    return NULL;
+}
+
+// The block is opened the same way as by the writer so that the writer only
+// picks it up from the pool. Nothing is written to the mapping since the
+// writer may be using it already.
+void BlockPreallocator::Preallocate(size_t block_order, int numa_policy, uint64_t numa_nodes)
+{
+    std::string fpath = path + std::to_string(block_order);
+    if (ResourcePool::getInstance().GetResourceByPath(fpath) != NULL)
+        return;
+
+    bool map_file = true;
+    std::shared_ptr<MmapFileIO> file = ResourcePool::getInstance().OpenFile(fpath, mode,
+        block_size, map_file, true, region, block_order);
+    if (file == nullptr || !map_file || !file->IsMapped())
+        return;
+
+#ifdef __linux__
+    // Allocate the disk blocks so that the page faults do not have to.
+    if (!(mode & CONSTS::MEMORY_ONLY_MODE)) {
+        int fd = open(fpath.c_str(), O_RDWR);
+        if (fd >= 0) {
+            if (fallocate(fd, 0, 0, block_size) != 0)
+                Logger::Log(LOG_LEVEL_DEBUG, "failed to fallocate %s errno %d",
+                    fpath.c_str(), errno);
+            close(fd);
+        }
+    }
+#endif
+
+    uint8_t* addr = file->GetMapAddr();
+    if (numa_policy != MB_NUMA_DEFAULT)
+        NumaPolicy::Apply(addr, block_size, numa_policy, numa_nodes, block_order);
+#ifdef MADV_POPULATE_WRITE
+    if (madvise(addr, block_size, MADV_POPULATE_WRITE) != 0)
+#endif
+    {
+        // Read faults still map the pages. The writer only has to make them
+        // writable.
+        volatile uint8_t sum = 0;
+        for (size_t off = 0; off < block_size; off += RollableFile::page_size)
+            sum += addr[off];
+        (void)sum;
+    }
+
+    count.fetch_add(1, std::memory_order_relaxed);
+    Logger::Log(LOG_LEVEL_DEBUG, "preallocated block %s", fpath.c_str());
+}
+
+}
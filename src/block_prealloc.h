@@ -0,0 +1,76 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __BLOCK_PREALLOC_H__
+#define __BLOCK_PREALLOC_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <stdint.h>
+#include <string>
+
+#include "mmap_file.h"
+
+namespace mabain {
+
+// Background thread that opens the next block file of a rollable file before
+// the writer reaches it. The block is created, allocated on disk, mapped into
+// its slot of the region and prefaulted. It is left in the resource pool, where
+// the writer finds it when opening the block.
+class BlockPreallocator {
+public:
+    BlockPreallocator(const std::string& fpath, int mode, size_t block_size,
+        std::shared_ptr<MmapRegion> region);
+    ~BlockPreallocator();
+
+    // Preallocate the block of the given order. The request replaces the
+    // pending one if the thread is busy.
+    void Request(size_t block_order, int numa_policy, uint64_t numa_nodes);
+    // Wait for the pending request to finish
+    void Wait();
+    // Number of blocks preallocated
+    size_t GetCount() const;
+
+private:
+    static void* prealloc_thread_wrapper(void* context);
+    void* prealloc_thread();
+    void Preallocate(size_t block_order, int numa_policy, uint64_t numa_nodes);
+
+    std::string path;
+    int mode;
+    size_t block_size;
+    std::shared_ptr<MmapRegion> region;
+
+    std::mutex req_mutex;
+    std::condition_variable req_cond;
+    bool pending;
+    bool busy;
+    bool stop_prealloc;
+    size_t req_order;
+    int req_numa_policy;
+    uint64_t req_numa_nodes;
+    std::atomic<size_t> count;
+    pthread_t tid;
+};
+
+}
+
+#endif
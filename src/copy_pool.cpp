@@ -0,0 +1,114 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string.h>
+
+#include "copy_pool.h"
+
+// number of buffers taken by a thread at a time
+#define COPY_POOL_CHUNK 32
+
+namespace mabain {
+
+CopyPool::CopyPool(int nthread)
+    : batch(NULL)
+    , next_task(0)
+    , num_active(0)
+    , generation(0)
+    , stop(false)
+{
+    if (nthread > MB_COPY_POOL_MAX_THREAD)
+        nthread = MB_COPY_POOL_MAX_THREAD;
+    for (int i = 0; i < nthread; i++)
+        threads.push_back(std::thread(&CopyPool::Worker, this));
+}
+
+CopyPool::~CopyPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(pool_mutex);
+        stop = true;
+    }
+    start_cond.notify_all();
+    for (auto& th : threads)
+        th.join();
+}
+
+void CopyPool::CopyBuffers()
+{
+    size_t num = batch->size();
+    while (true) {
+        size_t start = next_task.fetch_add(COPY_POOL_CHUNK, std::memory_order_relaxed);
+        if (start >= num)
+            break;
+        size_t end = start + COPY_POOL_CHUNK < num ? start + COPY_POOL_CHUNK : num;
+        for (size_t i = start; i < end; i++) {
+            const CopyTask& task = (*batch)[i];
+            memcpy(task.dst, task.src, task.size);
+        }
+    }
+}
+
+void CopyPool::Run(const std::vector<CopyTask>& tasks)
+{
+    if (tasks.empty())
+        return;
+    if (threads.empty() || tasks.size() <= COPY_POOL_CHUNK) {
+        for (const CopyTask& task : tasks)
+            memcpy(task.dst, task.src, task.size);
+        return;
+    }
+
+    std::unique_lock<std::mutex> guard(pool_mutex);
+    batch = &tasks;
+    next_task.store(0, std::memory_order_relaxed);
+    num_active = static_cast<int>(threads.size());
+    generation++;
+    guard.unlock();
+    start_cond.notify_all();
+
+    CopyBuffers();
+
+    guard.lock();
+    while (num_active > 0)
+        done_cond.wait(guard);
+    batch = NULL;
+}
+
+void CopyPool::Worker()
+{
+    uint64_t curr_gen = 0;
+    std::unique_lock<std::mutex> guard(pool_mutex);
+
+    while (true) {
+        while (!stop && generation == curr_gen)
+            start_cond.wait(guard);
+        if (stop)
+            break;
+        curr_gen = generation;
+        guard.unlock();
+
+        CopyBuffers();
+
+        guard.lock();
+        if (--num_active == 0)
+            done_cond.notify_one();
+    }
+}
+
+}
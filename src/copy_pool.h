@@ -0,0 +1,68 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __COPY_POOL_H__
+#define __COPY_POOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace mabain {
+
+#define MB_COPY_POOL_MAX_THREAD 32
+
+typedef struct _CopyTask {
+    uint8_t* dst;
+    const uint8_t* src;
+    int size;
+} CopyTask;
+
+// A pool of threads copying buffers for the writer. The buffers in one call
+// to Run must not overlap each other.
+class CopyPool {
+public:
+    CopyPool(int nthread);
+    ~CopyPool();
+
+    // Copy all buffers in tasks and return when done. The calling thread
+    // copies buffers as well.
+    void Run(const std::vector<CopyTask>& tasks);
+
+private:
+    void Worker();
+    void CopyBuffers();
+
+    std::vector<std::thread> threads;
+    std::mutex pool_mutex;
+    std::condition_variable start_cond;
+    std::condition_variable done_cond;
+    const std::vector<CopyTask>* batch;
+    std::atomic<size_t> next_task;
+    // number of workers still copying the current batch
+    int num_active;
+    uint64_t generation;
+    bool stop;
+};
+
+}
+
+#endif
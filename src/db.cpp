@@ -18,11 +18,13 @@
 
 #include <iostream>
 #include <sys/syscall.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <errno.h>
 
 #include "async_writer.h"
+#include "copy_pool.h"
 #include "db.h"
 #include "dict.h"
 #include "drm_base.h"
@@ -36,6 +38,7 @@
 #include "util/shm_mutex.h"
 #include "util/utils.h"
 #include "version.h"
+#include "window_cache.h"
 
 namespace mabain {
 
@@ -154,11 +157,59 @@ int DB::ValidateConfig(MBConfig& config)
             }
         }
     }
+    if ((config.options & CONSTS::REDO_LOG)
+        && (config.options & (CONSTS::MEMORY_ONLY_MODE | CONSTS::OPTION_JEMALLOC))) {
+        std::cerr << "redo log is not supported in memory-only or jemalloc mode\n";
+        config.options &= ~CONSTS::REDO_LOG;
+    }
+    if (config.flush_rate > 0
+        && (config.options & (CONSTS::MEMORY_ONLY_MODE | CONSTS::OPTION_JEMALLOC))) {
+        std::cerr << "background flusher is not supported in memory-only or jemalloc mode\n";
+        config.flush_rate = 0;
+    }
+    if (config.prealloc_threshold < 0 || config.prealloc_threshold > 100) {
+        std::cerr << "invalid block preallocation threshold " << config.prealloc_threshold << "\n";
+        return MBError::INVALID_ARG;
+    }
+    if (config.prealloc_threshold > 0 && (config.options & CONSTS::OPTION_JEMALLOC)) {
+        std::cerr << "block preallocation is not supported in jemalloc mode\n";
+        config.prealloc_threshold = 0;
+    }
+    if (config.snapshot_dir != NULL
+        && (!(config.options & CONSTS::MEMORY_ONLY_MODE)
+            || !(config.options & CONSTS::ACCESS_MODE_WRITER)
+            || (config.options & CONSTS::OPTION_JEMALLOC))) {
+        std::cerr << "snapshot is only loaded by memory-only writers\n";
+        config.snapshot_dir = NULL;
+    }
+    if (config.spill_dir != NULL
+        && (!(config.options & CONSTS::MEMORY_ONLY_MODE)
+            || !(config.options & CONSTS::ACCESS_MODE_WRITER)
+            || (config.options & CONSTS::OPTION_JEMALLOC))) {
+        std::cerr << "blocks are only spilled by memory-only writers\n";
+        config.spill_dir = NULL;
+    }
     if (config.options & CONSTS::USE_SLIDING_WINDOW) {
         std::cout << "sliding window option is deprecated\n";
         config.options &= ~CONSTS::USE_SLIDING_WINDOW;
     }
 
+    if ((config.options & CONSTS::HUGE_PAGE_HUGETLB)
+        && !(config.options & CONSTS::MEMORY_ONLY_MODE)) {
+        std::cerr << "hugetlb pages are only supported in memory-only mode, "
+                  << "using transparent huge pages\n";
+        config.options &= ~CONSTS::HUGE_PAGE_HUGETLB;
+        config.options |= CONSTS::HUGE_PAGE_ADVISE;
+    }
+    if (config.options & (CONSTS::HUGE_PAGE_HUGETLB | CONSTS::HUGE_PAGE_ADVISE)) {
+        size_t huge_page_size = RollableFile::HugePageSize(config.options);
+        if (config.block_size_index % huge_page_size != 0
+            || config.block_size_data % huge_page_size != 0) {
+            std::cerr << "block size must be multiple of huge page size "
+                      << huge_page_size << "\n";
+            return MBError::INVALID_ARG;
+        }
+    }
     if (config.block_size_index != 0 && (config.block_size_index % BLOCK_SIZE_ALIGN != 0)) {
         std::cerr << "block size must be multiple of " << BLOCK_SIZE_ALIGN << "\n";
         return MBError::INVALID_ARG;
@@ -176,6 +227,20 @@ int DB::ValidateConfig(MBConfig& config)
         std::cerr << "async queue size exceeds maximum\n";
     if (config.queue_size == 0 || config.queue_size > MB_MAX_NUM_SHM_QUEUE_NODE)
         config.queue_size = MB_MAX_NUM_SHM_QUEUE_NODE;
+    if (config.queue_timeout == 0)
+        config.queue_timeout = MB_SHM_WAIT_TIMEOUT;
+    if (config.defrag_threads > MB_COPY_POOL_MAX_THREAD) {
+        std::cerr << "number of defragmentation threads exceeds maximum\n";
+        config.defrag_threads = MB_COPY_POOL_MAX_THREAD;
+    }
+    if (config.numa_policy < MB_NUMA_DEFAULT || config.numa_policy > MB_NUMA_BIND_BLOCK) {
+        std::cerr << "invalid NUMA policy " << config.numa_policy << "\n";
+        return MBError::INVALID_ARG;
+    }
+    if (config.eviction_policy < MB_EVICTION_BUCKET || config.eviction_policy > MB_EVICTION_LFU) {
+        std::cerr << "invalid eviction policy " << config.eviction_policy << "\n";
+        return MBError::INVALID_ARG;
+    }
 #ifdef __APPLE__
     if (config.queue_dir == nullptr)
         config.queue_dir = config.mbdir;
@@ -209,7 +274,15 @@ void DB::PreCheckDB(const MBConfig& config, bool& init_header, bool& update_head
 
     if (config.options & CONSTS::MEMORY_ONLY_MODE) {
         if (config.options & CONSTS::ACCESS_MODE_WRITER) {
+            // The header is loaded from the snapshot if there is one.
             init_header = true;
+            if (config.snapshot_dir != NULL) {
+                std::string snapshot_header = std::string(config.snapshot_dir) + "/_mabain_h";
+                if (access(snapshot_header.c_str(), R_OK) == 0)
+                    init_header = false;
+                else
+                    Logger::Log(LOG_LEVEL_INFO, "no snapshot in %s", config.snapshot_dir);
+            }
         } else {
             init_header = false;
             if (!ResourcePool::getInstance().CheckExistence(mb_dir + "_mabain_h"))
@@ -252,6 +325,11 @@ void DB::PreCheckDB(const MBConfig& config, bool& init_header, bool& update_head
 
 void DB::PostDBUpdate(const MBConfig& config, bool init_header, bool update_header)
 {
+    if (config.numa_policy != MB_NUMA_DEFAULT)
+        dict->SetNumaPolicy(config.numa_policy, config.numa_nodes);
+    if (config.window_cache_size > 0)
+        WindowCache::getInstance().SetCapacity(config.window_cache_size);
+
     if ((config.options & CONSTS::ACCESS_MODE_WRITER) && (init_header || update_header)) {
         if (init_header) {
             Logger::Log(LOG_LEVEL_DEBUG, "opened a new db %s", mb_dir.c_str());
@@ -275,9 +353,39 @@ void DB::PostDBUpdate(const MBConfig& config, bool init_header, bool update_head
     lock.Init(dict->GetShmLockPtr());
     UpdateNumHandlers(config.options, 1);
 
+    if (dict->OpenAccessTracker(config.eviction_policy, config.access_table_size,
+            config.queue_dir)
+        != MBError::SUCCESS) {
+        Logger::Log(LOG_LEVEL_WARN, "access-aware eviction disabled for %s", mb_dir.c_str());
+    }
+    if (dict->OpenReaderRegistry(config.queue_dir) == MBError::MMAP_FAILED)
+        Logger::Log(LOG_LEVEL_WARN, "retired blocks are not removed for %s", mb_dir.c_str());
+
     if (config.options & CONSTS::ACCESS_MODE_WRITER) {
+        if (config.options & CONSTS::REDO_LOG) {
+            int rval = dict->OpenRedoLog(mb_dir, init_header, config.redo_sync_interval,
+                config.redo_sync_size, config.redo_checkpoint_size);
+            if (rval != MBError::SUCCESS) {
+                Logger::Log(LOG_LEVEL_ERROR, "failed to open redo log: %s",
+                    MBError::get_error_str(rval));
+                status = rval;
+                return;
+            }
+        }
+        dict->OpenEvictionLog(mb_dir);
+        dict->OpenExpiryLog(mb_dir);
+        dict->SetDefragThreads(config.defrag_threads);
+        if (config.flush_rate > 0 && dict->StartFlusher(config.flush_rate) != MBError::SUCCESS)
+            Logger::Log(LOG_LEVEL_WARN, "background flusher not started for %s", mb_dir.c_str());
+        if (config.prealloc_threshold > 0
+            && dict->EnablePrealloc(config.prealloc_threshold) != MBError::SUCCESS)
+            Logger::Log(LOG_LEVEL_WARN, "block preallocation not enabled for %s", mb_dir.c_str());
+        if (config.spill_dir != NULL && dict->EnableSpill(config.spill_dir) != MBError::SUCCESS)
+            Logger::Log(LOG_LEVEL_WARN, "blocks of %s not spilled to %s", mb_dir.c_str(),
+                config.spill_dir);
         if (config.options & CONSTS::ASYNC_WRITER_MODE)
-            async_writer = AsyncWriter::CreateInstance(this);
+            async_writer = AsyncWriter::CreateInstance(this, config.writer_pool_size,
+                config.defrag_step_time);
     }
 
     if (!(init_header || update_header)) {
@@ -318,6 +426,10 @@ void DB::PostDBUpdate(const MBConfig& config, bool init_header, bool update_head
                 } else {
                     Logger::Log(LOG_LEVEL_WARN, "rc exception recovery failed: %s", MBError::get_error_str(rval));
                 }
+                dict->ReplayRedoLog();
+                dict->RebuildExpiryLog(*this);
+                // Blocks left by a writer that exited before they were removed
+                dict->RetireBlocks();
             }
         }
     }
@@ -350,6 +462,13 @@ void DB::InitDB(MBConfig& config)
         ReInit(config);
     }
     release_file_lock(fd);
+
+    if (is_open() && config.warmup_options != 0) {
+        int rval = Warmup(config.warmup_options, config.warmup_threads);
+        if (rval != MBError::SUCCESS)
+            Logger::Log(LOG_LEVEL_WARN, "failed to warm up %s: %s", mb_dir.c_str(),
+                MBError::get_error_str(rval));
+    }
 }
 
 void DB::InitDBEx(MBConfig& config)
@@ -363,6 +482,8 @@ void DB::InitDBEx(MBConfig& config)
     // save the configuration
     memcpy(&dbConfig, &config, sizeof(MBConfig));
     dbConfig.mbdir = NULL;
+    dbConfig.snapshot_dir = NULL;
+    dbConfig.spill_dir = NULL;
 
     // If id not given, use thread ID
     if (config.connect_id == 0) {
@@ -387,7 +508,11 @@ void DB::InitDBEx(MBConfig& config)
         return;
     }
 
+    bool load_snapshot = (config.options & CONSTS::MEMORY_ONLY_MODE) && !init_header
+        && config.snapshot_dir != NULL;
     try {
+        if (load_snapshot)
+            Dict::LoadSnapshotHeader(config.snapshot_dir, mb_dir, config.options);
         dict = new Dict(mb_dir, init_header, config.data_size, config.options,
             config.memcap_index, config.memcap_data,
             config.block_size_index, config.block_size_data,
@@ -403,6 +528,16 @@ void DB::InitDBEx(MBConfig& config)
         return;
     }
 
+    if (load_snapshot) {
+        int rval = dict->LoadSnapshot(config.snapshot_dir, config.snapshot_threads);
+        if (rval != MBError::SUCCESS) {
+            Logger::Log(LOG_LEVEL_ERROR, "failed to load snapshot %s: %s", config.snapshot_dir,
+                MBError::get_error_str(rval));
+            status = rval;
+            return;
+        }
+    }
+
     PostDBUpdate(config, init_header, update_header);
 }
 
@@ -484,6 +619,7 @@ int DB::Find(const char* key, int len, MBData& mdata) const
     if (options & CONSTS::ASYNC_WRITER_MODE)
         return MBError::NOT_ALLOWED;
 
+    dict->CheckRetiredBlocks();
     return dict->Find(reinterpret_cast<const uint8_t*>(key), len, mdata);
 }
 
@@ -492,6 +628,21 @@ int DB::Find(const std::string& key, MBData& mdata) const
     return Find(key.data(), key.size(), mdata);
 }
 
+int DB::FindBatch(const std::vector<std::string>& keys, MBData* data, int* rvals) const
+{
+    if (data == NULL || rvals == NULL)
+        return MBError::INVALID_ARG;
+    if (status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+    // Writer in async mode cannot be used for lookup
+    if (options & CONSTS::ASYNC_WRITER_MODE)
+        return MBError::NOT_ALLOWED;
+
+    dict->CheckRetiredBlocks();
+    dict->FindBatch(keys, data, rvals);
+    return MBError::SUCCESS;
+}
+
 int DB::FindLowerBound(const std::string& key, MBData& data) const
 {
     return FindLowerBound(key.data(), key.size(), data);
@@ -508,6 +659,7 @@ int DB::FindLowerBound(const char* key, int len, MBData& data) const
         return MBError::NOT_ALLOWED;
 
     data.options = 0;
+    dict->CheckRetiredBlocks();
     return dict->FindBound(0, reinterpret_cast<const uint8_t*>(key), len, data);
 }
 
@@ -523,7 +675,7 @@ int DB::FindLongestPrefix(const char* key, int len, MBData& data) const
         return MBError::NOT_ALLOWED;
 
     data.match_len = 0;
-
+    dict->CheckRetiredBlocks();
     return dict->FindPrefix(reinterpret_cast<const uint8_t*>(key), len, data);
 }
 
@@ -573,7 +725,9 @@ int DB::Add(const char* key, int len, MBData& mbdata, bool overwrite)
     if (async_writer == NULL && (options & CONSTS::ACCESS_MODE_WRITER)) {
         rval = dict->Add(reinterpret_cast<const uint8_t*>(key), len, mbdata, overwrite);
     } else {
-        AsyncWriter* awr = AsyncWriter::GetInstance();
+        AsyncWriter* awr = async_writer;
+        if (awr == NULL)
+            awr = AsyncWriter::GetInstance(mb_dir);
         if (awr) {
             try {
                 rval = awr->AddWithLock(key, len, mbdata, overwrite);
@@ -586,23 +740,105 @@ int DB::Add(const char* key, int len, MBData& mbdata, bool overwrite)
             rval = MBError::TRY_AGAIN;
         }
 
-        int retry_cnt = 0;
-        while (rval == MBError::TRY_AGAIN) {
+        if (rval == MBError::TRY_AGAIN) {
             rval = dict->SHMQ_Add(reinterpret_cast<const char*>(key), len,
-                reinterpret_cast<const char*>(mbdata.buff), mbdata.data_len, overwrite);
-            if (!(mbdata.options & CONSTS::OPTION_SHMQ_RETRY)) {
-                break;
-            }
-            if (retry_cnt++ > MB_SHM_RETRY_TIMEOUT) {
-                break;
+                reinterpret_cast<const char*>(mbdata.buff), mbdata.data_len, overwrite,
+                GetShmqTimeout(mbdata.options), mbdata.expire_time);
+        }
+    }
+
+    return rval;
+}
+
+// Merge operators are applied by the writer. Writer errors, such as
+// VALUE_MISMATCH, are only returned if the update is not sent through the
+// shared memory queue.
+int DB::Merge(const char* key, int len, int op, const char* operand, int operand_len)
+{
+    int rval = MBError::SUCCESS;
+
+    if (key == NULL || (operand == NULL && operand_len > 0))
+        return MBError::INVALID_ARG;
+    if (status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+
+    if (async_writer == NULL && (options & CONSTS::ACCESS_MODE_WRITER)) {
+        MBData mbd;
+        rval = dict->Merge(reinterpret_cast<const uint8_t*>(key), len, op,
+            reinterpret_cast<const uint8_t*>(operand), operand_len, mbd);
+    } else {
+        AsyncWriter* awr = async_writer;
+        if (awr == NULL)
+            awr = AsyncWriter::GetInstance(mb_dir);
+        if (awr) {
+            try {
+                rval = awr->MergeWithLock(key, len, op, operand, operand_len);
+            } catch (int error) {
+                rval = error;
             }
-            usleep(1);
+        } else {
+            rval = MBError::TRY_AGAIN;
+        }
+
+        if (rval == MBError::TRY_AGAIN) {
+            rval = dict->SHMQ_Merge(key, len, op, operand, operand_len,
+                GetShmqTimeout(CONSTS::OPTION_SHMQ_RETRY));
         }
     }
 
     return rval;
 }
 
+int DB::Increment(const char* key, int len, int64_t delta)
+{
+    return Merge(key, len, MB_MERGE_INT_ADD, reinterpret_cast<const char*>(&delta),
+        sizeof(delta));
+}
+
+int DB::Append(const char* key, int len, const char* data, int data_len, uint32_t max_len)
+{
+    if (data == NULL || data_len < 0)
+        return MBError::INVALID_ARG;
+    std::string operand(reinterpret_cast<const char*>(&max_len), sizeof(max_len));
+    operand.append(data, data_len);
+    return Merge(key, len, MB_MERGE_APPEND, operand.data(), operand.size());
+}
+
+int DB::CompareAndSwap(const char* key, int len, const char* expected, int expected_len,
+    const char* value, int value_len)
+{
+    if (value == NULL || value_len < 0 || (expected != NULL && expected_len < 0))
+        return MBError::INVALID_ARG;
+    uint32_t elen = MB_MERGE_CAS_ABSENT;
+    if (expected != NULL)
+        elen = expected_len;
+    std::string operand(reinterpret_cast<const char*>(&elen), sizeof(elen));
+    if (expected != NULL)
+        operand.append(expected, expected_len);
+    operand.append(value, value_len);
+    return Merge(key, len, MB_MERGE_CAS, operand.data(), operand.size());
+}
+
+int DB::RegisterMergeOperator(int op, MergeOperator merge_op)
+{
+    if (status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+    if (!(options & CONSTS::ACCESS_MODE_WRITER))
+        return MBError::NOT_ALLOWED;
+
+    if (async_writer != NULL)
+        return async_writer->RegisterMergeOperator(op, merge_op);
+    return dict->RegisterMergeOperator(op, merge_op);
+}
+
+// Time to wait for a free slot in async queue. No wait if zero.
+int DB::GetShmqTimeout(int data_options) const
+{
+    if ((options & CONSTS::SHMQ_BLOCKING_MODE) || (data_options & CONSTS::OPTION_SHMQ_RETRY))
+        return static_cast<int>(dbConfig.queue_timeout);
+    return 0;
+}
+
 int DB::AddAsync(const char* key, int len, const char* data, int data_len, bool overwrite)
 {
     MBData mbdata;
@@ -626,6 +862,20 @@ int DB::Add(const char* key, int len, const char* data, int data_len, bool overw
     return rval;
 }
 
+int DB::AddWithTTL(const char* key, int len, const char* data, int data_len, uint32_t ttl,
+    bool overwrite)
+{
+    MBData mbdata;
+    mbdata.data_len = data_len;
+    mbdata.buff = (uint8_t*)data;
+    if (ttl > 0)
+        mbdata.expire_time = static_cast<uint32_t>(time(NULL)) + ttl;
+
+    int rval = Add(key, len, mbdata, overwrite);
+    mbdata.buff = NULL;
+    return rval;
+}
+
 int DB::Add(const std::string& key, const std::string& value, bool overwrite)
 {
     return Add(key.data(), key.size(), value.data(), value.size(), overwrite);
@@ -643,7 +893,7 @@ int DB::Remove(const char* key, int len)
     if (async_writer == NULL && (options & CONSTS::ACCESS_MODE_WRITER)) {
         rval = dict->Remove(reinterpret_cast<const uint8_t*>(key), len);
     } else {
-        rval = dict->SHMQ_Remove(reinterpret_cast<const char*>(key), len);
+        rval = dict->SHMQ_Remove(reinterpret_cast<const char*>(key), len, GetShmqTimeout(0));
     }
 
     return rval;
@@ -656,16 +906,8 @@ int DB::RemoveAsync(const char* key, int len)
     if (status != MBError::SUCCESS)
         return MBError::NOT_INITIALIZED;
 
-    int rval = MBError::SUCCESS;
-    int retry_cnt = 0;
-    do {
-        rval = dict->SHMQ_Remove(reinterpret_cast<const char*>(key), len);
-        if (rval != MBError::TRY_AGAIN || retry_cnt++ > MB_SHM_RETRY_TIMEOUT) {
-            break;
-        }
-        usleep(1);
-    } while (true);
-    return rval;
+    return dict->SHMQ_Remove(reinterpret_cast<const char*>(key), len,
+        GetShmqTimeout(CONSTS::OPTION_SHMQ_RETRY));
 }
 
 int DB::Remove(const std::string& key)
@@ -673,6 +915,27 @@ int DB::Remove(const std::string& key)
     return Remove(key.data(), key.size());
 }
 
+// Remove expired entries. Writers in async mode remove them in the async
+// writer thread. Returns the number of entries removed.
+int DB::RemoveExpired(int max_count)
+{
+    if (status != MBError::SUCCESS || async_writer != NULL)
+        return 0;
+    if (!(options & CONSTS::ACCESS_MODE_WRITER))
+        return 0;
+    return dict->RemoveExpired(max_count);
+}
+
+int DB::Warmup(int warmup_options, int num_threads, const WarmupProgress& progress)
+{
+    if (status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+    // The block files of an async writer are opened by the writer thread.
+    if (options & CONSTS::ASYNC_WRITER_MODE)
+        return MBError::NOT_ALLOWED;
+    return dict->Warmup(warmup_options, num_threads, progress);
+}
+
 int DB::RemoveAll()
 {
     if (status != MBError::SUCCESS)
@@ -682,7 +945,7 @@ int DB::RemoveAll()
     if (async_writer == NULL && (options & CONSTS::ACCESS_MODE_WRITER)) {
         rval = dict->RemoveAll();
     } else {
-        rval = dict->SHMQ_RemoveAll();
+        rval = dict->SHMQ_RemoveAll(GetShmqTimeout(0));
     }
     return rval;
 }
@@ -716,7 +979,7 @@ int DB::Backup(const char* bk_dir)
             DBBackup bk(*this);
             rval = bk.Backup(bk_dir);
         } else {
-            rval = dict->SHMQ_Backup(bk_dir);
+            rval = dict->SHMQ_Backup(bk_dir, GetShmqTimeout(0));
         }
     } catch (int error) {
         Logger::Log(LOG_LEVEL_WARN, "Backup failed :%s", MBError::get_error_str(error));
@@ -726,6 +989,17 @@ int DB::Backup(const char* bk_dir)
     return rval;
 }
 
+int DB::DumpSnapshot(const char* snapshot_dir, int num_threads)
+{
+    if (snapshot_dir == NULL)
+        return MBError::INVALID_ARG;
+    if (status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+    if (!(options & CONSTS::ACCESS_MODE_WRITER) || (options & CONSTS::ASYNC_WRITER_MODE))
+        return MBError::NOT_ALLOWED;
+    return dict->DumpSnapshot(snapshot_dir, num_threads);
+}
+
 void DB::Flush() const
 {
     if (options & CONSTS::MEMORY_ONLY_MODE)
@@ -756,7 +1030,8 @@ int DB::CollectResource(int64_t min_index_rc_size, int64_t min_data_rc_size,
             ResourceCollection rc(*this);
             rc.ReclaimResource(min_index_rc_size, min_data_rc_size, max_dbsz, max_dbcnt);
         } else {
-            dict->SHMQ_CollectResource(min_index_rc_size, min_data_rc_size, max_dbsz, max_dbcnt);
+            dict->SHMQ_CollectResource(min_index_rc_size, min_data_rc_size, max_dbsz, max_dbcnt,
+                GetShmqTimeout(0));
         }
     } catch (int error) {
         if (error != MBError::RC_SKIPPED) {
@@ -798,6 +1073,8 @@ void DB::PrintStats(std::ostream& out_stream) const
         return;
 
     dict->PrintStats(out_stream);
+    if (WindowCache::getInstance().GetCapacity() > 0)
+        WindowCache::getInstance().PrintStats(out_stream);
 }
 
 void DB::PrintHeader(std::ostream& out_stream) const
@@ -806,6 +1083,12 @@ void DB::PrintHeader(std::ostream& out_stream) const
         dict->PrintHeader(out_stream);
 }
 
+void DB::PrintNumaStats(std::ostream& out_stream) const
+{
+    if (status == MBError::SUCCESS)
+        dict->PrintNumaStats(out_stream);
+}
+
 int DB::Lock()
 {
     return lock.Lock();
@@ -888,4 +1171,11 @@ int DB::GetDataHeaderSize()
     return DATA_HDR_BYTE;
 }
 
+int DB::GetDataHeaderSize(const MBData& data)
+{
+    if (data.expire_time != 0)
+        return DATA_HDR_BYTE + DATA_TTL_BYTE;
+    return DATA_HDR_BYTE;
+}
+
 } // namespace mabain
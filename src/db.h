@@ -27,11 +27,24 @@
 #include "integer_4b_5b.h"
 #include "lock.h"
 #include "mb_data.h"
+#include "mb_merge.h"
+#include "mb_warmup.h"
+#include "numa_policy.h"
 
 namespace mabain {
 
 #define MB_MAX_NUM_SHM_QUEUE_NODE 8
-#define MB_SHM_RETRY_TIMEOUT 1000000 // 1 second
+#define MB_SHM_WAIT_TIMEOUT 1000 // 1 second
+// Maximum number of entries checked in one expiry sweep
+#define MB_EXPIRY_SWEEP_COUNT 256
+
+// Eviction policies
+// Evict the entries in the oldest insertion buckets
+#define MB_EVICTION_BUCKET 0
+// Evict entries not read since the last eviction (one reference bit)
+#define MB_EVICTION_CLOCK 1
+// Evict the least frequently read entries (8-bit logarithmic counters)
+#define MB_EVICTION_LFU 2
 
 class Dict;
 class MBlsq;
@@ -54,8 +67,84 @@ typedef struct _MBConfig {
     // For automatic eviction
     // All entries in the oldest buckets will be pruned.
     int num_entry_per_bucket;
+    // Eviction policy set by the writer. For MB_EVICTION_CLOCK and
+    // MB_EVICTION_LFU, readers record lookups in a shared memory table of
+    // access_table_size counters (rounded up to a power of 2, default
+    // MB_ACCESS_TABLE_SIZE). Keys are hashed to the counters, so a table
+    // smaller than the number of keys makes eviction less accurate.
+    int eviction_policy;
+    uint32_t access_table_size;
     uint32_t queue_size;
     const char* queue_dir;
+    // Time in millisecond to wait for a free slot when the async queue is full.
+    // Applies to AddAsync, RemoveAsync and all updates in SHMQ_BLOCKING_MODE.
+    // Default is MB_SHM_WAIT_TIMEOUT if not set.
+    uint32_t queue_timeout;
+    // Number of threads in the process-wide writer pool. If not zero, the async
+    // writer of this DB has no thread of its own and its queue is served by the
+    // pool together with other DBs opened in the same way. Only applies to
+    // writers opened with ASYNC_WRITER_MODE.
+    uint32_t writer_pool_size;
+    // Group commit settings for REDO_LOG. Logged updates are synced to disk every
+    // redo_sync_interval milliseconds or once redo_sync_size bytes are pending,
+    // whichever comes first. The mmapped files are flushed and the log is
+    // truncated once it grows beyond redo_checkpoint_size bytes. Defaults are
+    // used if not set.
+    uint32_t redo_sync_interval;
+    uint32_t redo_sync_size;
+    uint64_t redo_checkpoint_size;
+    // Rate in bytes per second at which a background thread syncs the pages
+    // updated by the writer. The thread is not started if not set. Only
+    // applies to writers not in memory-only or jemalloc mode.
+    uint64_t flush_rate;
+    // Time in microsecond for each step of defragmentation run by the async
+    // writer. If set, defragmentation requested by CollectResource moves
+    // buffers in steps of this time and queued updates are processed between
+    // the steps. Otherwise it runs to completion and queued updates are only
+    // processed every few buffers. Only applies to writers opened with
+    // ASYNC_WRITER_MODE.
+    uint32_t defrag_step_time;
+    // Number of threads copying data buffers in parallel with the writer
+    // during defragmentation, at most MB_COPY_POOL_MAX_THREAD. Data buffers
+    // are copied by the writer if not set.
+    uint32_t defrag_threads;
+    // MB_WARMUP_* options for prefaulting the DB when it is opened. The DB is
+    // only returned once the warm-up is done. Runs with warmup_threads
+    // threads, or one per CPU if not set.
+    int warmup_options;
+    uint32_t warmup_threads;
+    // NUMA policy (MB_NUMA_*) of the index and data blocks mapped by this
+    // handle. numa_nodes is the mask of nodes to use, or all online nodes if
+    // not set. Pages of shared file mappings are placed by the thread that
+    // reads them first, so the policy only moves pages already in memory
+    // for DBs on disk.
+    int numa_policy;
+    uint64_t numa_nodes;
+    // Size in bytes of the process-wide cache of read-only windows mapped
+    // from the index and data blocks beyond the memcaps. The cache is shared
+    // by all DB handles and its size is the largest one set. Buffers in
+    // these blocks are read with pread if not set.
+    size_t window_cache_size;
+    // Percentage of the current index or data block written before the next
+    // block is created, mapped and prefaulted by a background thread, so that
+    // the writer does not stall when it moves to the next block. Only blocks
+    // within the memcaps are preallocated. Disabled if not set. Only applies
+    // to writers not in jemalloc mode.
+    int prealloc_threshold;
+    // Directory of a snapshot written by DB::DumpSnapshot. A memory-only
+    // writer loads the DB from the snapshot when it is opened, with
+    // snapshot_threads threads or one per CPU if not set. The DB is opened
+    // empty if there is no snapshot in the directory. Only applies to
+    // writers in memory-only mode.
+    const char* snapshot_dir;
+    uint32_t snapshot_threads;
+    // Directory for the index and data blocks beyond memcap_index and
+    // memcap_data. Inserts then go on instead of failing with NO_MEMORY. The
+    // data blocks with the fewest sampled lookups are moved out of memory
+    // first, so that memcap_data holds the hot blocks. The blocks are backed
+    // by unlinked files that are removed when the DB is closed. Only applies
+    // to writers in memory-only mode.
+    const char* spill_dir;
 } MBConfig;
 
 // Database handle class
@@ -74,7 +163,7 @@ public:
         iterator(const DB& db, int iter_state);
         // Copy constructor
         iterator(const iterator& rhs);
-        void init(bool check_async_mode = true);
+        void init(bool check_async_mode = true, bool include_expired = false);
         int init_no_next();
         ~iterator();
 
@@ -102,6 +191,10 @@ public:
         MBlsq* node_stack;
         MBlsq* kv_per_node;
         LockFree* lfree;
+        // Iterate the rc tree instead of the main tree
+        bool rc_mode;
+        // Return entries that expired but are not removed yet
+        bool include_expired;
     };
 
     // db_path: database directory
@@ -122,12 +215,37 @@ public:
     int Add(const char* key, int len, const char* data, int data_len, bool overwrite = false);
     int Add(const char* key, int len, MBData& data, bool overwrite = false);
     int Add(const std::string& key, const std::string& value, bool overwrite = false);
+    // Add a key-value pair that expires in ttl seconds. Expired entries are
+    // not returned by Find and are removed by the writer.
+    int AddWithTTL(const char* key, int len, const char* data, int data_len, uint32_t ttl,
+        bool overwrite = false);
     int AddAsync(const char* key, int len, const char* data, int data_len, bool overwrite = false);
+    // Update the value using a merge operator applied by the writer. See
+    // mb_merge.h for the operand format of the built-in operators.
+    int Merge(const char* key, int len, int op, const char* operand, int operand_len);
+    // Add delta to the int64_t value of the key.
+    int Increment(const char* key, int len, int64_t delta);
+    // Append data to the value. The value is truncated from the front to
+    // max_len bytes if max_len is not zero.
+    int Append(const char* key, int len, const char* data, int data_len, uint32_t max_len = 0);
+    // Replace the value if it is equal to expected. If expected is NULL, the
+    // key is added only if it does not exist. VALUE_MISMATCH is returned if
+    // the value does not match.
+    int CompareAndSwap(const char* key, int len, const char* expected, int expected_len,
+        const char* value, int value_len);
+    // Register a merge operator between MB_MERGE_USER_MIN and MB_MERGE_USER_MAX.
+    // Only the writer can register merge operators.
+    int RegisterMergeOperator(int op, MergeOperator merge_op);
     // Check if a key exists in DB
     bool InDB(const char* key, int len, int& err);
     // Find an entry by exact match using a key
     int Find(const char* key, int len, MBData& mdata) const;
     int Find(const std::string& key, MBData& mdata) const;
+    // Find a batch of keys. data and rvals hold one entry for each key and
+    // the result of keys[i] is returned in data[i] and rvals[i]. Values beyond
+    // memcap_data are read from the block files together using io_uring if
+    // available.
+    int FindBatch(const std::vector<std::string>& keys, MBData* data, int* rvals) const;
     // Find the longest prefix match using a key
     int FindLongestPrefix(const char* key, int len, MBData& data) const;
     int FindLongestPrefix(const std::string& key, MBData& data) const;
@@ -145,8 +263,21 @@ public:
     int Remove(const std::string& key);
     int RemoveAll();
     int RemoveAllSync();
+    // Remove up to max_count expired entries. Only needed by writers not
+    // running in async mode.
+    int RemoveExpired(int max_count = MB_EXPIRY_SWEEP_COUNT);
+    // Prefault the pages of the index and optionally the data blocks within
+    // the memcap with num_threads threads (one per CPU if 0). The top levels
+    // of the trie are read first. progress is called in the calling thread.
+    int Warmup(int warmup_options = MB_WARMUP_INDEX, int num_threads = 0,
+        const WarmupProgress& progress = nullptr);
     // DB Backup
     int Backup(const char* backup_dir);
+    // Write the header, index, data and free lists of a memory-only DB to
+    // snapshot_dir with num_threads threads (one per CPU if 0). Only allowed
+    // for writers not in async mode. The DB must not be updated until it
+    // returns. See MBConfig::snapshot_dir.
+    int DumpSnapshot(const char* snapshot_dir, int num_threads = 0);
 
     // Close the DB handle
     int Close();
@@ -187,6 +318,8 @@ public:
     // Print database stats
     void PrintStats(std::ostream& out_stream = std::cout) const;
     void PrintHeader(std::ostream& out_stream = std::cout) const;
+    // Print the number of resident pages of the mapped blocks on each NUMA node
+    void PrintNumaStats(std::ostream& out_stream = std::cout) const;
     // current count of key-value pair
     int64_t Count() const;
     int64_t GetPendingDataBufferSize() const;
@@ -204,10 +337,14 @@ public:
 
     void GetDBConfig(MBConfig& config) const;
 
+    // Size of the data header of entries without expiry time
     static int GetDataHeaderSize();
+    // Size of the data header of the entry added or found with data
+    static int GetDataHeaderSize(const MBData& data);
 
     //iterator
-    const iterator begin(bool check_async_mode = true, bool rc_mode = false) const;
+    const iterator begin(bool check_async_mode = true, bool rc_mode = false,
+        bool include_expired = false) const;
     const iterator begin(const std::string& prefix) const;
     const iterator end() const;
 
@@ -218,6 +355,7 @@ private:
     void PreCheckDB(const MBConfig& config, bool& init_header, bool& update_header);
     void PostDBUpdate(const MBConfig& config, bool init_header, bool update_header);
     static int ValidateConfig(MBConfig& config);
+    int GetShmqTimeout(int data_options) const;
 
     // DB directory
     std::string mb_dir;
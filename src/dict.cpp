@@ -16,6 +16,7 @@
 
 // @author Changxue Deng <chadeng@cisco.com>
 
+#include <chrono>
 #include <errno.h>
 #include <iostream>
 #include <stdlib.h>
@@ -27,8 +28,16 @@
 #include "error.h"
 #include "integer_4b_5b.h"
 #include "mabain_consts.h"
+#include "redo_log.h"
 
 #define DATA_HEADER_SIZE 32
+#define MAX_DATA_READ_RETRY 1000
+// Time in milliseconds a reader waits for an in-place update of a data buffer.
+// The sequence is left odd if the writer exits during the update.
+#define MAX_DATA_READ_WAIT 1000
+// Bytes read for a value not in memory in FindBatch. Larger values are read
+// again once the length is known.
+#define COLD_DATA_READ_SIZE 512
 
 #define READER_LOCK_FREE_START \
     LockFreeData snapshot;     \
@@ -54,6 +63,20 @@ Dict::Dict(const std::string& mbdir, bool init_header, int datasize,
     status = MBError::NOT_INITIALIZED;
     reader_rc_off = 0;
     slaq = NULL;
+    shmq_producer = NULL;
+    redo_log = NULL;
+    flusher = NULL;
+    access_tracker = NULL;
+    evict_log = NULL;
+    expiry_log = NULL;
+    async_reader = NULL;
+    last_bucket_index = 0;
+    defrag_threads = 0;
+    reader_registry = NULL;
+    retired_gen = 0;
+    retired_check = 0;
+    num_find = 0;
+    next_expire.store(0, std::memory_order_relaxed);
 
     header = mm.GetHeaderPtr();
     if (header == NULL) {
@@ -77,12 +100,18 @@ Dict::Dict(const std::string& mbdir, bool init_header, int datasize,
     if (!(db_options & CONSTS::READ_ONLY_DB)) {
         // initialize shared memory queue
         ShmQueueMgr qmgr;
-        slaq = qmgr.CreateFile(header->shm_queue_id, queue_size, queue_dir, db_options);
+        slaq = qmgr.CreateFile(header->shm_queue_id, queue_size, queue_dir, db_options, header);
         queue = slaq->queue;
+        shmq_producer = new ShmQueueProducer(ShmQueueMgr::GetFilePath(header->shm_queue_id,
+                                                 queue_dir),
+            db_options & CONSTS::ACCESS_MODE_WRITER);
     }
     lfree.LockFreeInit(&header->lock_free, header, db_options);
     mm.InitLockFreePtr(&lfree);
-    mbp = MBPipe(mbdir, 0);
+    if (db_options & CONSTS::ACCESS_MODE_WRITER) {
+        for (int i = 0; i < MB_DATA_UPDATE_SEQ_NUM; i++)
+            header->data_update_seq[i].store(0, std::memory_order_release);
+    }
 
     // Open data file
     kv_file = new RollableFile(mbdir + "_mabain_d",
@@ -100,6 +129,8 @@ Dict::Dict(const std::string& mbdir, bool init_header, int datasize,
         header->data_size = datasize;
         header->count = 0;
         header->m_data_offset = GetStartDataOffset(); // start from a non-zero offset
+        if (free_lists != NULL)
+            free_lists->Empty();
     } else {
         if (options & CONSTS::ACCESS_MODE_WRITER) {
             if (header->entry_per_bucket != entry_per_bucket) {
@@ -116,6 +147,9 @@ Dict::Dict(const std::string& mbdir, bool init_header, int datasize,
                 Destroy();
                 throw(int) MBError::INVALID_ARG;
             }
+            if (free_lists != NULL
+                && free_lists->GetTotSize() > (size_t)header->pending_data_buff_size)
+                free_lists->Empty();
         }
     }
     if (mm.IsValid())
@@ -162,6 +196,40 @@ int Dict::Init(uint32_t id)
 
 void Dict::Destroy()
 {
+    StopFlusher();
+
+    if (redo_log != NULL) {
+        CheckpointRedoLog();
+        delete redo_log;
+        redo_log = NULL;
+    }
+
+    if (access_tracker != NULL) {
+        delete access_tracker;
+        access_tracker = NULL;
+    }
+    if (evict_log != NULL) {
+        delete evict_log;
+        evict_log = NULL;
+    }
+    if (expiry_log != NULL) {
+        delete expiry_log;
+        expiry_log = NULL;
+    }
+    if (async_reader != NULL) {
+        delete async_reader;
+        async_reader = NULL;
+    }
+    if (shmq_producer != NULL) {
+        delete shmq_producer;
+        shmq_producer = NULL;
+    }
+    if (reader_registry != NULL) {
+        UnlinkRetiredBlocks();
+        delete reader_registry;
+        reader_registry = NULL;
+    }
+
     mm.Destroy();
 
     if (free_lists != NULL)
@@ -180,6 +248,30 @@ int Dict::Status() const
 // if overwrite is true and an entry with input key already exists, the old data will
 // be overwritten. Otherwise, IN_DICT will be returned.
 int Dict::Add(const uint8_t* key, int len, MBData& data, bool overwrite)
+{
+    const uint8_t* buff = data.buff;
+    int data_len = data.data_len;
+
+    CheckRetiredBlocks();
+    // The record is added to the expiry log first so that the entry is
+    // removed when it expires even if the writer exits in between.
+    if (data.expire_time != 0)
+        AddExpiry(key, len, data.expire_time);
+    int rval = Add_Internal(key, len, data, overwrite);
+    if (rval == MBError::SUCCESS && access_tracker != NULL)
+        access_tracker->Insert(key, len);
+    if (rval == MBError::SUCCESS && evict_log != NULL)
+        evict_log->Append(last_bucket_index, key, len);
+    if (rval == MBError::SUCCESS && redo_log != NULL
+        && !(data.options & CONSTS::OPTION_NO_REDO_LOG)) {
+        redo_log->LogAdd(key, len, buff, data_len, data.expire_time);
+        if (redo_log->CheckpointDue())
+            CheckpointRedoLog();
+    }
+    return rval;
+}
+
+int Dict::Add_Internal(const uint8_t* key, int len, MBData& data, bool overwrite)
 {
     if (!(options & CONSTS::ACCESS_MODE_WRITER)) {
         return MBError::NOT_ALLOWED;
@@ -195,7 +287,7 @@ int Dict::Add(const uint8_t* key, int len, MBData& data, bool overwrite)
         return rval;
 
     if (edge_ptrs.len_ptr[0] == 0) {
-        ReserveData(data.buff, data.data_len, data.data_offset);
+        ReserveData(data.buff, data.data_len, data.data_offset, data.expire_time);
         // Add the first edge along this edge
         mm.AddRootEdge(edge_ptrs, key, len, data.data_offset);
         if (data.options & CONSTS::OPTION_RC_MODE) {
@@ -241,22 +333,22 @@ int Dict::Add(const uint8_t* key, int len, MBData& data, bool overwrite)
                     break;
             }
             if (!next) {
-                ReserveData(data.buff, data.data_len, data.data_offset);
+                ReserveData(data.buff, data.data_len, data.data_offset, data.expire_time);
                 rval = mm.UpdateNode(edge_ptrs, p, len, data.data_offset);
             } else if (match_len < static_cast<int>(edge_ptrs.len_ptr[0])) {
                 if (len > match_len) {
-                    ReserveData(data.buff, data.data_len, data.data_offset);
+                    ReserveData(data.buff, data.data_len, data.data_offset, data.expire_time);
                     rval = mm.AddLink(edge_ptrs, match_len, p + match_len, len - match_len,
                         data.data_offset, data);
                 } else if (len == match_len) {
-                    ReserveData(data.buff, data.data_len, data.data_offset);
+                    ReserveData(data.buff, data.data_len, data.data_offset, data.expire_time);
                     rval = mm.InsertNode(edge_ptrs, match_len, data.data_offset, data);
                 }
             } else if (len == 0) {
                 rval = UpdateDataBuffer(edge_ptrs, overwrite, data, inc_count);
             }
         } else {
-            ReserveData(data.buff, data.data_len, data.data_offset);
+            ReserveData(data.buff, data.data_len, data.data_offset, data.expire_time);
             rval = mm.AddLink(edge_ptrs, i, p + i, len - i, data.data_offset, data);
         }
     } else {
@@ -265,11 +357,11 @@ int Dict::Add(const uint8_t* key, int len, MBData& data, bool overwrite)
                 break;
         }
         if (i < len) {
-            ReserveData(data.buff, data.data_len, data.data_offset);
+            ReserveData(data.buff, data.data_len, data.data_offset, data.expire_time);
             rval = mm.AddLink(edge_ptrs, i, p + i, len - i, data.data_offset, data);
         } else {
             if (edge_ptrs.len_ptr[0] > len) {
-                ReserveData(data.buff, data.data_len, data.data_offset);
+                ReserveData(data.buff, data.data_len, data.data_offset, data.expire_time);
                 rval = mm.InsertNode(edge_ptrs, i, data.data_offset, data);
             } else {
                 rval = UpdateDataBuffer(edge_ptrs, overwrite, data, inc_count);
@@ -304,24 +396,7 @@ int Dict::ReadDataFromEdge(MBData& data, const EdgePtrs& edge_ptrs) const
         data_off = Get6BInteger(node_buff + 2);
     }
     data.data_offset = data_off;
-
-    uint16_t data_len[2];
-    // Read data length first
-    if (ReadData(reinterpret_cast<uint8_t*>(&data_len[0]), DATA_HDR_BYTE, data_off)
-        != DATA_HDR_BYTE)
-        return MBError::READ_ERROR;
-    data_off += DATA_HDR_BYTE;
-    if (data.buff_len < data_len[0] + 1) {
-        if (data.Resize(data_len[0]) != MBError::SUCCESS)
-            return MBError::NO_MEMORY;
-    }
-
-    if (ReadData(data.buff, data_len[0], data_off) != data_len[0])
-        return MBError::READ_ERROR;
-
-    data.data_len = data_len[0];
-    data.bucket_index = data_len[1];
-    return MBError::SUCCESS;
+    return ReadDataBuffer(data, data_off);
 }
 
 // Delete operations:
@@ -341,9 +416,9 @@ int Dict::DeleteDataFromEdge(MBData& data, EdgePtrs& edge_ptrs)
             != DATA_SIZE_BYTE)
             return MBError::READ_ERROR;
         if (options & CONSTS::OPTION_JEMALLOC) {
-            rel_size = data_len + DATA_HDR_BYTE;
+            rel_size = DataBufferSize(data_len);
         } else {
-            rel_size = free_lists->GetAlignmentSize(data_len + DATA_HDR_BYTE);
+            rel_size = free_lists->GetAlignmentSize(DataBufferSize(data_len));
         }
         ReleaseBuffer(data_off, rel_size);
 
@@ -372,9 +447,9 @@ int Dict::DeleteDataFromEdge(MBData& data, EdgePtrs& edge_ptrs)
                 return MBError::READ_ERROR;
 
             if (options & CONSTS::OPTION_JEMALLOC) {
-                rel_size = data_len + DATA_HDR_BYTE;
+                rel_size = DataBufferSize(data_len);
             } else {
-                rel_size = free_lists->GetAlignmentSize(data_len + DATA_HDR_BYTE);
+                rel_size = free_lists->GetAlignmentSize(DataBufferSize(data_len));
             }
             ReleaseBuffer(data_off, rel_size);
         } else {
@@ -392,24 +467,76 @@ int Dict::ReadDataFromNode(MBData& data, const uint8_t* node_ptr) const
         return MBError::NOT_EXIST;
 
     data.data_offset = data_off;
+    return ReadDataBuffer(data, data_off);
+}
+
+// Read the data buffer at data_off. The writer may overwrite the buffer in place
+// while it is being read, in which case it is read again. TRY_AGAIN is returned
+// if the buffer is changed in all MAX_DATA_READ_RETRY reads. DATA_UPDATING is
+// returned if an update does not complete in MAX_DATA_READ_WAIT milliseconds,
+// which is not retried by the callers since the writer may have exited in the
+// middle of the update.
+int Dict::ReadDataBuffer(MBData& data, size_t data_off) const
+{
+    if (data.options & CONSTS::OPTION_DEFER_COLD_READ) {
+        int fd;
+        off_t file_off;
+        if (kv_file->GetReadFile(data_off, fd, file_off) > 0)
+            return MBError::IN_DICT;
+    }
 
-    // Read data length first
     uint16_t data_len[2];
-    if (ReadData(reinterpret_cast<uint8_t*>(&data_len[0]), DATA_HDR_BYTE, data_off)
-        != DATA_HDR_BYTE)
-        return MBError::READ_ERROR;
-    data_off += DATA_HDR_BYTE;
+    uint32_t expire_time;
+    int hdr_size;
+    std::atomic<uint32_t>& update_seq = DataUpdateSeq(data_off);
+    std::chrono::steady_clock::time_point wait_start;
+    bool waiting = false;
+    for (int retry = 0; retry < MAX_DATA_READ_RETRY;) {
+        uint32_t seq = update_seq.load(std::memory_order_acquire);
+        if (seq & 1) {
+            if (!waiting) {
+                wait_start = std::chrono::steady_clock::now();
+                waiting = true;
+            } else if (std::chrono::steady_clock::now() - wait_start
+                > std::chrono::milliseconds(MAX_DATA_READ_WAIT)) {
+                return MBError::DATA_UPDATING;
+            }
+            nanosleep((const struct timespec[]) { { 0, 10L } }, NULL);
+            continue;
+        }
+
+        // Read data length first
+        if (ReadData(reinterpret_cast<uint8_t*>(&data_len[0]), DATA_HDR_BYTE, data_off)
+            != DATA_HDR_BYTE)
+            return MBError::READ_ERROR;
+        expire_time = 0;
+        hdr_size = DataHeaderSize(data_len[0]);
+        if (hdr_size > DATA_HDR_BYTE) {
+            if (ReadData(reinterpret_cast<uint8_t*>(&expire_time), DATA_TTL_BYTE,
+                    data_off + DATA_HDR_BYTE)
+                != DATA_TTL_BYTE)
+                return MBError::READ_ERROR;
+            data_len[0] &= DATA_SIZE_MASK;
+        }
+
+        if (data.buff_len < data_len[0] + 1) {
+            if (data.Resize(data_len[0]) != MBError::SUCCESS)
+                return MBError::NO_MEMORY;
+        }
+        if (ReadData(data.buff, data_len[0], data_off + hdr_size) != data_len[0])
+            return MBError::READ_ERROR;
 
-    if (data.buff_len < data_len[0] + 1) {
-        if (data.Resize(data_len[0]) != MBError::SUCCESS)
-            return MBError::NO_MEMORY;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (update_seq.load(std::memory_order_relaxed) == seq) {
+            data.data_len = data_len[0];
+            data.bucket_index = data_len[1];
+            data.expire_time = expire_time;
+            return MBError::SUCCESS;
+        }
+        retry++;
     }
-    if (ReadData(data.buff, data_len[0], data_off) != data_len[0])
-        return MBError::READ_ERROR;
 
-    data.data_len = data_len[0];
-    data.bucket_index = data_len[1];
-    return MBError::SUCCESS;
+    return MBError::TRY_AGAIN;
 }
 
 int Dict::FindPrefix(const uint8_t* key, int len, MBData& data)
@@ -447,11 +574,23 @@ int Dict::FindPrefix(const uint8_t* key, int len, MBData& data)
     }
 #endif
 
-    // The longer match wins.
-    if (data_rc.match_len > data.match_len) {
-        data_rc.TransferValueTo(data.buff, data.data_len);
-        rval = MBError::SUCCESS;
+    // The longer match wins. The rc tree has the newer value if both match
+    // the same key, and a tombstone there hides the main tree entry.
+    if (data_rc.match_len > 0 && data_rc.match_len >= data.match_len) {
+        if (!data_rc.Expired()) {
+            uint8_t* buff;
+            int buff_len;
+            data_rc.TransferValueTo(buff, buff_len);
+            data.TransferValueFrom(buff, buff_len);
+            data.expire_time = data_rc.expire_time;
+            data.match_len = data_rc.match_len;
+            rval = MBError::SUCCESS;
+        } else if (data_rc.match_len == data.match_len) {
+            rval = MBError::NOT_EXIST;
+        }
     }
+    if (rval == MBError::SUCCESS && data.Expired())
+        rval = MBError::NOT_EXIST;
     return rval;
 }
 
@@ -463,7 +602,7 @@ int Dict::FindPrefix_Internal(size_t root_off, const uint8_t* key, int len, MBDa
     READER_LOCK_FREE_START
 #endif
 
-    rval = mm.GetRootEdge(data.options & CONSTS::OPTION_RC_MODE, key[0], edge_ptrs);
+    rval = mm.GetRootEdge(root_off, key[0], edge_ptrs);
     if (rval != MBError::SUCCESS)
         return MBError::READ_ERROR;
 
@@ -596,6 +735,13 @@ int Dict::Find(const uint8_t* key, int len, MBData& data)
         }
 #endif
         if (rval == MBError::SUCCESS) {
+            // Expired entries are treated as missing until they are removed.
+            // Tombstones of removed main tree entries are expired too.
+            if (data.Expired())
+                return MBError::NOT_EXIST;
+            if (access_tracker != NULL)
+                access_tracker->Touch(key, len);
+            SampleAccess(data.data_offset);
             data.match_len = len;
             return rval;
         } else if (rval != MBError::NOT_EXIST)
@@ -616,12 +762,156 @@ int Dict::Find(const uint8_t* key, int len, MBData& data)
         rval = Find_Internal(0, key, len, data);
     }
 #endif
-    if (rval == MBError::SUCCESS)
+    if (rval == MBError::SUCCESS) {
+        if (data.Expired())
+            return MBError::NOT_EXIST;
+        if (access_tracker != NULL)
+            access_tracker->Touch(key, len);
+        SampleAccess(data.data_offset);
         data.match_len = len;
+    }
 
     return rval;
 }
 
+// The keys are looked up with OPTION_DEFER_COLD_READ first. Values in memory
+// are read as in Find. For the other keys only the data offset is returned,
+// and the values are then read from the block files with the async reader.
+// The keys whose edges were modified by the writer since the first lookup, or
+// whose buffers were overwritten in place, are looked up again with Find.
+void Dict::FindBatch(const std::vector<std::string>& keys, MBData* data, int* rvals)
+{
+    int defer_option = 0;
+    if (!(options & (CONSTS::MEMORY_ONLY_MODE | CONSTS::OPTION_JEMALLOC)))
+        defer_option = CONSTS::OPTION_DEFER_COLD_READ;
+
+    LockFreeData snapshot;
+    lfree.ReaderLockFreeStart(snapshot);
+
+    std::vector<size_t> cold;
+    std::vector<uint32_t> cold_seq;
+    // offset of the edge or node edge pointing to the data buffer
+    std::vector<size_t> cold_edge;
+    for (size_t i = 0; i < keys.size(); i++) {
+        data[i].options |= defer_option;
+        rvals[i] = Find(reinterpret_cast<const uint8_t*>(keys[i].data()), keys[i].size(), data[i]);
+        data[i].options &= ~defer_option;
+        if (rvals[i] == MBError::IN_DICT) {
+            cold.push_back(i);
+            cold_seq.push_back(DataUpdateSeq(data[i].data_offset).load(std::memory_order_acquire));
+            cold_edge.push_back(data[i].edge_ptrs.offset);
+        }
+    }
+    if (cold.empty())
+        return;
+
+    if (async_reader == NULL)
+        async_reader = new AsyncReader();
+
+    // Read the header and the value if it is small enough.
+    std::vector<AsyncRead> reads;
+    std::vector<size_t> read_index;
+    for (auto i : cold) {
+        AsyncRead read;
+        size_t block_left = kv_file->GetReadFile(data[i].data_offset, read.fd, read.offset);
+        if (block_left == 0) {
+            rvals[i] = MBError::READ_ERROR;
+            continue;
+        }
+        read.size = block_left < COLD_DATA_READ_SIZE ? block_left : COLD_DATA_READ_SIZE;
+        if (data[i].Resize(read.size) != MBError::SUCCESS) {
+            rvals[i] = MBError::NO_MEMORY;
+            continue;
+        }
+        read.buff = data[i].buff;
+        reads.push_back(read);
+        read_index.push_back(i);
+    }
+    async_reader->Read(reads);
+
+    // Read the values not in the first read.
+    std::vector<AsyncRead> value_reads;
+    std::vector<size_t> value_index;
+    for (size_t n = 0; n < reads.size(); n++) {
+        size_t i = read_index[n];
+        int hdr_size;
+        rvals[i] = ParseColdData(data[i], reads[n].result, hdr_size);
+        if (rvals[i] != MBError::SUCCESS || hdr_size + data[i].data_len <= reads[n].result)
+            continue;
+        AsyncRead read = reads[n];
+        read.offset += hdr_size;
+        read.size = data[i].data_len;
+        if (data[i].Resize(read.size) != MBError::SUCCESS) {
+            rvals[i] = MBError::NO_MEMORY;
+            continue;
+        }
+        read.buff = data[i].buff;
+        value_reads.push_back(read);
+        value_index.push_back(i);
+    }
+    if (!value_reads.empty()) {
+        async_reader->Read(value_reads);
+        for (size_t n = 0; n < value_reads.size(); n++) {
+            if (value_reads[n].result != static_cast<ssize_t>(value_reads[n].size))
+                rvals[value_index[n]] = MBError::READ_ERROR;
+        }
+    }
+
+    // The values are valid if the writer did not modify their edges after the
+    // snapshot. The data buffers are not reused before that.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    for (size_t n = 0; n < cold.size(); n++) {
+        size_t i = cold[n];
+        const uint8_t* key = reinterpret_cast<const uint8_t*>(keys[i].data());
+        int len = keys[i].size();
+        uint32_t seq = DataUpdateSeq(data[i].data_offset).load(std::memory_order_relaxed);
+        bool overwritten = (cold_seq[n] & 1) || seq != cold_seq[n];
+        bool valid = rvals[i] == MBError::SUCCESS && !overwritten;
+        if (valid && lfree.ReaderLockFreeStop(snapshot, cold_edge[n], data[i]) != MBError::SUCCESS)
+            valid = false;
+        if (!valid) {
+            data[i].options &= ~CONSTS::OPTION_READ_SAVED_EDGE;
+            rvals[i] = Find(key, len, data[i]);
+            continue;
+        }
+
+        if (data[i].Expired()) {
+            rvals[i] = MBError::NOT_EXIST;
+            continue;
+        }
+        if (access_tracker != NULL)
+            access_tracker->Touch(key, len);
+        SampleAccess(data[i].data_offset);
+        data[i].match_len = len;
+    }
+}
+
+// Parse the data buffer read from the block file into data.buff. The value is
+// moved to the start of data.buff if it was read in full. Otherwise it needs
+// to be read again after the header of hdr_size bytes.
+int Dict::ParseColdData(MBData& data, ssize_t bytes_read, int& hdr_size) const
+{
+    uint16_t data_len[2];
+    uint32_t expire_time = 0;
+    if (bytes_read < DATA_HDR_BYTE)
+        return MBError::READ_ERROR;
+    memcpy(&data_len[0], data.buff, DATA_HDR_BYTE);
+    hdr_size = DataHeaderSize(data_len[0]);
+    if (hdr_size > DATA_HDR_BYTE) {
+        if (bytes_read < hdr_size)
+            return MBError::READ_ERROR;
+        memcpy(&expire_time, data.buff + DATA_HDR_BYTE, DATA_TTL_BYTE);
+        data_len[0] &= DATA_SIZE_MASK;
+    }
+
+    data.data_len = data_len[0];
+    data.bucket_index = data_len[1];
+    data.expire_time = expire_time;
+    if (hdr_size + data_len[0] <= bytes_read)
+        memmove(data.buff, data.buff + hdr_size, data_len[0]);
+    return MBError::SUCCESS;
+}
+
 int Dict::Find_Internal(size_t root_off, const uint8_t* key, int len, MBData& data)
 {
     EdgePtrs& edge_ptrs = data.edge_ptrs;
@@ -729,7 +1019,7 @@ int Dict::Find_Internal(size_t root_off, const uint8_t* key, int len, MBData& da
         } else {
             // If this is for remove operation, return IN_DICT to caller.
             if (data.options & CONSTS::OPTION_FIND_AND_STORE_PARENT) {
-                data.edge_ptrs.curr_node_offset = mm.GetRootOffset();
+                data.edge_ptrs.curr_node_offset = root_off != 0 ? root_off : mm.GetRootOffset();
                 data.edge_ptrs.curr_nt = 1;
                 data.edge_ptrs.curr_edge_index = 0;
                 data.edge_ptrs.parent_offset = data.edge_ptrs.offset;
@@ -765,6 +1055,13 @@ void Dict::PrintStats(std::ostream& out_stream) const
     out_stream << "\tEntry count in DB: " << header->count << std::endl;
     out_stream << "\tEntry count per bucket: " << header->entry_per_bucket << std::endl;
     out_stream << "\tEviction bucket index: " << header->eviction_bucket_index << std::endl;
+    out_stream << "\tEviction policy: " << header->eviction_policy << std::endl;
+    if (access_tracker != NULL)
+        access_tracker->PrintStats(out_stream);
+    if (evict_log != NULL)
+        evict_log->PrintStats(out_stream);
+    if (expiry_log != NULL)
+        expiry_log->PrintStats(out_stream);
     out_stream << "\tData block size: " << header->data_block_size << std::endl;
     // The pending_data_buff_size in jemalloc mode is the total size of all allocated data buffers
     // The pending_data_buff_size in non-jemalloc mode is the total size of all free data buffers
@@ -774,10 +1071,19 @@ void Dict::PrintStats(std::ostream& out_stream) const
         out_stream << "\tData size: " << header->m_data_offset << std::endl;
         out_stream << "\tPending buffer size: " << header->pending_data_buff_size << std::endl;
         out_stream << "\tTrackable buffer size: " << free_lists->GetTotSize() << std::endl;
+        out_stream << "\tFree buffer count: " << free_lists->Count() << std::endl;
+    }
+    out_stream << "\tAsync queue full/wait/timeout count: " << header->shmq_full_count
+               << "/" << header->shmq_wait_count << "/" << header->shmq_timeout_count << std::endl;
+    if (slaq != NULL) {
+        out_stream << "\tAsync writer park/doorbell count: " << slaq->num_park << "/"
+                   << slaq->num_ring << std::endl;
     }
     mm.PrintStats(out_stream);
 
     kv_file->PrintStats(out_stream);
+    if (redo_log != NULL)
+        redo_log->PrintStats(out_stream);
 
 #ifdef __DEBUG__
     out_stream << "Size of tracking buffer: " << buffer_map.size() << std::endl;
@@ -929,21 +1235,145 @@ int Dict::Remove(const uint8_t* key, int len)
 }
 
 int Dict::Remove(const uint8_t* key, int len, MBData& data)
+{
+    CheckRetiredBlocks();
+    int rval = RemoveEntry(key, len, data);
+    if (rval == MBError::SUCCESS && redo_log != NULL) {
+        redo_log->LogRemove(key, len);
+        if (redo_log->CheckpointDue())
+            CheckpointRedoLog();
+    }
+    return rval;
+}
+
+int Dict::RemoveEntry(const uint8_t* key, int len, MBData& data)
 {
     if (!(options & CONSTS::ACCESS_MODE_WRITER)) {
         return MBError::NOT_ALLOWED;
     }
-    if (data.options & CONSTS::OPTION_RC_MODE) {
-        // FIXME Remove in RC mode not implemented yet!!!
-        return MBError::INVALID_ARG;
-    }
 
     // The DELETE flag must be set
     if (!(data.options & CONSTS::OPTION_FIND_AND_STORE_PARENT))
         return MBError::INVALID_ARG;
 
+    size_t rc_root_offset = header->rc_root_offset.load(std::memory_order_relaxed);
+    if (rc_root_offset == 0) {
+        int rval = Remove_Internal(0, key, len, data);
+        if (rval == MBError::SUCCESS)
+            header->count--;
+        return rval;
+    }
+
+    // Resource collection is running. The entry may exist in both the rc
+    // tree and the main tree. Buffers of the rc tree can be above the current
+    // index and data offsets once ResourceCollection::Finish has reset them.
+    int rval;
+    if (data.options & CONSTS::OPTION_RC_MODE) {
+        // Buffers in the main tree are being relocated and cannot be modified.
+        // A tombstone is added to the rc tree instead. It hides the main tree
+        // entry from lookups and iterators until the rc tree is merged.
+        rval = Find_Internal(0, key, len, data);
+        if (rval == MBError::IN_DICT) {
+            if (Tombstone_RC(key, len))
+                return MBError::NOT_EXIST;
+            MBData tombstone(1, CONSTS::OPTION_RC_MODE);
+            tombstone.buff[0] = 0;
+            tombstone.data_len = 1;
+            tombstone.expire_time = MB_RC_TOMBSTONE_EXPIRE;
+            return Add_Internal(key, len, tombstone, true);
+        } else if (rval != MBError::NOT_EXIST) {
+            return rval;
+        }
+
+        data.Clear();
+        rval = Remove_Internal(rc_root_offset, key, len, data);
+        if (rval == MBError::SUCCESS)
+            header->rc_count--;
+        return rval;
+    }
+
+    int rval_rc = Remove_Internal(rc_root_offset, key, len, data);
+    if (rval_rc == MBError::SUCCESS)
+        header->rc_count--;
+    else if (rval_rc != MBError::NOT_EXIST)
+        return rval_rc;
+
+    data.Clear();
+    rval = Remove_Internal(0, key, len, data);
+    if (rval == MBError::SUCCESS)
+        header->count--;
+
+    if (rval_rc == MBError::SUCCESS && rval == MBError::NOT_EXIST)
+        rval = MBError::SUCCESS;
+    return rval;
+}
+
+int Dict::Remove_RC(const uint8_t* key, int len)
+{
+    size_t rc_root_offset = header->rc_root_offset.load(std::memory_order_relaxed);
+    if (rc_root_offset == 0)
+        return MBError::NOT_EXIST;
+
+    MBData data(0, CONSTS::OPTION_FIND_AND_STORE_PARENT);
+    int rval = Remove_Internal(rc_root_offset, key, len, data);
+    if (rval == MBError::SUCCESS)
+        header->rc_count--;
+    return rval;
+}
+
+bool Dict::InTree_RC(const uint8_t* key, int len)
+{
+    size_t rc_root_offset = header->rc_root_offset.load(std::memory_order_relaxed);
+    if (rc_root_offset == 0)
+        return false;
+
+    MBData data(0, CONSTS::OPTION_FIND_AND_STORE_PARENT);
+    int rval = Find_Internal(rc_root_offset, key, len, data);
+    while (rval == MBError::TRY_AGAIN)
+        rval = Find_Internal(rc_root_offset, key, len, data);
+    return rval == MBError::IN_DICT;
+}
+
+// Check if the rc tree has a tombstone or an expired entry for the key.
+bool Dict::Tombstone_RC(const uint8_t* key, int len)
+{
+    size_t rc_root_offset = header->rc_root_offset.load(MEMORY_ORDER_READER);
+    if (rc_root_offset == 0)
+        return false;
+
+    MBData data;
+    int rval = Find_Internal(rc_root_offset, key, len, data);
+    while (rval == MBError::TRY_AGAIN)
+        rval = Find_Internal(rc_root_offset, key, len, data);
+    return rval == MBError::SUCCESS && data.Expired();
+}
+
+// Remove the main tree entry of a tombstone in the rc tree. The removal was
+// logged when the tombstone was added.
+int Dict::RemoveTombstone_RC(const uint8_t* key, int len)
+{
+    MBData data(0, CONSTS::OPTION_FIND_AND_STORE_PARENT);
+    int rval = Remove_Internal(0, key, len, data);
+    if (rval == MBError::SUCCESS)
+        header->count--;
+    return rval;
+}
+
+int Dict::FindEdge(bool rc_tree, const uint8_t* key, int len, MBData& data)
+{
+    size_t root_off = 0;
+    if (rc_tree) {
+        root_off = header->rc_root_offset.load(MEMORY_ORDER_READER);
+        if (root_off == 0)
+            return MBError::NOT_EXIST;
+    }
+    return Find_Internal(root_off, key, len, data);
+}
+
+int Dict::Remove_Internal(size_t root_off, const uint8_t* key, int len, MBData& data)
+{
     int rval;
-    rval = Find(key, len, data);
+    rval = Find_Internal(root_off, key, len, data);
     if (rval == MBError::IN_DICT) {
         rval = DeleteDataFromEdge(data, data.edge_ptrs);
         while (rval == MBError::TRY_AGAIN) {
@@ -952,17 +1382,13 @@ int Dict::Remove(const uint8_t* key, int len, MBData& data)
 #ifdef __DEBUG__
             assert(len > 0);
 #endif
-            rval = Find(key, len, data);
+            rval = Find_Internal(root_off, key, len, data);
             if (MBError::IN_DICT == rval) {
                 rval = mm.RemoveEdgeByIndex(data.edge_ptrs, data);
             }
         }
     }
 
-    if (rval == MBError::SUCCESS) {
-        header->count--;
-    }
-
     return rval;
 }
 
@@ -992,6 +1418,13 @@ int Dict::RemoveAll()
     header->count = 0;
     header->eviction_bucket_index = 0;
     header->num_update = 0;
+    header->ttl_in_use = 0;
+    ResetExpiryLog();
+    if (evict_log != NULL)
+        evict_log->Reset();
+
+    if (rval == MBError::SUCCESS && redo_log != NULL)
+        redo_log->LogRemoveAll();
     return rval;
 }
 
@@ -1008,28 +1441,23 @@ AsyncNode* Dict::GetAsyncQueuePtr() const
 // Reserve buffer and write to it
 // The pending_data_buff_size in jemalloc mode is the total size of all allocated data buffers
 // The pending_data_buff_size in non-jemalloc mode is the total size of all free data buffers
-void Dict::ReserveData(const uint8_t* buff, int size, size_t& offset)
+void Dict::ReserveData(const uint8_t* buff, int size, size_t& offset, uint32_t expire_time)
 {
     if (options & CONSTS::OPTION_JEMALLOC) {
-        int buf_size = size + DATA_HDR_BYTE;
+        uint8_t hdr[DATA_HDR_BYTE + DATA_TTL_BYTE];
+        int hdr_size = BuildDataHeader(hdr, size, expire_time);
+        int buf_size = size + hdr_size;
         void* ptr = kv_file->Malloc(buf_size, offset);
         if (ptr == NULL) {
             Logger::Log(LOG_LEVEL_ERROR, "failed to allocate memory for data buffer");
             throw MBError::NO_MEMORY;
         }
-        uint16_t dsize[2];
-        dsize[0] = static_cast<uint16_t>(size);
-        // store bucket index for LRU eviction
-        dsize[1] = (header->num_update / header->entry_per_bucket) % 0xFFFF;
-        if (dsize[1] == header->eviction_bucket_index && header->num_update > header->entry_per_bucket) {
-            header->eviction_bucket_index++;
-        }
-        memcpy(ptr, &dsize[0], DATA_HDR_BYTE);
-        memcpy(static_cast<uint8_t*>(ptr) + DATA_HDR_BYTE, buff, size);
+        memcpy(ptr, hdr, hdr_size);
+        memcpy(static_cast<uint8_t*>(ptr) + hdr_size, buff, size);
         // update the size of pending data buffer in the header
         header->pending_data_buff_size += (buf_size + JEMALLOC_ALIGNMENT - 1) & ~(JEMALLOC_ALIGNMENT - 1);
     } else {
-        reserveDataFL(buff, size, offset);
+        reserveDataFL(buff, size, offset, expire_time);
     }
 
 #ifdef __DEBUG__
@@ -1039,25 +1467,48 @@ void Dict::ReserveData(const uint8_t* buff, int size, size_t& offset)
 #endif
 }
 
-void Dict::reserveDataFL(const uint8_t* buff, int size, size_t& offset)
+// Fill in the data header and return its size. The expiry time is only stored
+// for entries that expire.
+int Dict::BuildDataHeader(uint8_t* hdr, int size, uint32_t expire_time)
 {
-#ifdef __DEBUG__
-    assert(size <= CONSTS::MAX_DATA_SIZE);
-#endif
-    int buf_size = free_lists->GetAlignmentSize(size + DATA_HDR_BYTE);
-    int buf_index = free_lists->GetBufferIndex(buf_size);
     uint16_t dsize[2];
     dsize[0] = static_cast<uint16_t>(size);
-    // store bucket index for LRU eviction
-    dsize[1] = (header->num_update / header->entry_per_bucket) % 0xFFFF;
-    if (dsize[1] == header->eviction_bucket_index && header->num_update > header->entry_per_bucket) {
+    dsize[1] = NextBucketIndex();
+    last_bucket_index = dsize[1];
+    if (expire_time == 0) {
+        memcpy(hdr, &dsize[0], DATA_HDR_BYTE);
+        return DATA_HDR_BYTE;
+    }
+
+    dsize[0] |= DATA_SIZE_TTL_FLAG;
+    memcpy(hdr, &dsize[0], DATA_HDR_BYTE);
+    memcpy(hdr + DATA_HDR_BYTE, &expire_time, DATA_TTL_BYTE);
+    return DATA_HDR_BYTE + DATA_TTL_BYTE;
+}
+
+// Bucket index stored with the data for LRU eviction
+uint16_t Dict::NextBucketIndex()
+{
+    uint16_t index = (header->num_update / header->entry_per_bucket) % 0xFFFF;
+    if (index == header->eviction_bucket_index && header->num_update > header->entry_per_bucket) {
         header->eviction_bucket_index++;
     }
+    return index;
+}
 
-    if (free_lists->GetBufferCountByIndex(buf_index) > 0) {
-        offset = free_lists->RemoveBufferByIndex(buf_index);
-        WriteData(reinterpret_cast<const uint8_t*>(&dsize[0]), DATA_HDR_BYTE, offset);
-        WriteData(buff, size, offset + DATA_HDR_BYTE);
+void Dict::reserveDataFL(const uint8_t* buff, int size, size_t& offset, uint32_t expire_time)
+{
+#ifdef __DEBUG__
+    assert(size <= CONSTS::MAX_DATA_SIZE);
+#endif
+    uint8_t hdr[DATA_HDR_BYTE + DATA_TTL_BYTE];
+    int hdr_size = BuildDataHeader(hdr, size, expire_time);
+    int buf_size = free_lists->GetAlignmentSize(size + hdr_size);
+    int buf_index = free_lists->GetBufferIndex(buf_size);
+
+    if (free_lists->GetBufferByIndex(buf_index, offset)) {
+        WriteData(hdr, hdr_size, offset);
+        WriteData(buff, size, offset + hdr_size);
         header->pending_data_buff_size -= buf_size;
     } else {
         size_t old_off = header->m_data_offset;
@@ -1076,11 +1527,12 @@ void Dict::reserveDataFL(const uint8_t* buff, int size, size_t& offset)
         offset = header->m_data_offset;
         header->m_data_offset += buf_size;
         if (ptr != NULL) {
-            memcpy(ptr, &dsize[0], DATA_HDR_BYTE);
-            memcpy(ptr + DATA_HDR_BYTE, buff, size);
+            memcpy(ptr, hdr, hdr_size);
+            memcpy(ptr + hdr_size, buff, size);
+            MarkDirty(offset, size + hdr_size);
         } else {
-            WriteData(reinterpret_cast<const uint8_t*>(&dsize[0]), DATA_HDR_BYTE, offset);
-            WriteData(buff, size, offset + DATA_HDR_BYTE);
+            WriteData(hdr, hdr_size, offset);
+            WriteData(buff, size, offset + hdr_size);
         }
     }
 }
@@ -1101,6 +1553,8 @@ int Dict::ReleaseBuffer(size_t offset, int size)
         }
         return MBError::SUCCESS;
     } else {
+        if (IsRCBuffer(offset))
+            return MBError::SUCCESS;
         header->pending_data_buff_size += size;
         return free_lists->ReleaseBuffer(offset, size);
     }
@@ -1130,7 +1584,7 @@ int Dict::ReleaseBuffer(size_t offset)
         }
         return MBError::READ_ERROR;
     }
-    data_size += DATA_HDR_BYTE;
+    data_size = DataBufferSize(data_size);
     if (options & CONSTS::OPTION_JEMALLOC) {
         kv_file->Free(offset);
 
@@ -1143,24 +1597,84 @@ int Dict::ReleaseBuffer(size_t offset)
         }
         return MBError::SUCCESS;
     } else {
+        if (IsRCBuffer(offset))
+            return MBError::SUCCESS;
         int rel_size = free_lists->GetAlignmentSize(data_size);
         header->pending_data_buff_size += rel_size;
         return free_lists->ReleaseBuffer(offset, rel_size);
     }
 }
 
+// Overwrite the existing data buffer at offset if the new value has the same
+// aligned size. The edge or node pointing to the buffer does not change. Returns
+// false if a new buffer is needed.
+bool Dict::OverwriteData(const uint8_t* buff, int size, uint32_t expire_time, size_t offset)
+{
+    uint16_t old_size;
+    if (ReadData(reinterpret_cast<uint8_t*>(&old_size), DATA_SIZE_BYTE, offset) != DATA_SIZE_BYTE)
+        return false;
+
+    int hdr_size = (expire_time == 0) ? DATA_HDR_BYTE : DATA_HDR_BYTE + DATA_TTL_BYTE;
+    if (options & CONSTS::OPTION_JEMALLOC) {
+        size_t old_buf_size = ((size_t)DataBufferSize(old_size) + JEMALLOC_ALIGNMENT - 1)
+            & ~(JEMALLOC_ALIGNMENT - 1);
+        size_t new_buf_size = ((size_t)size + hdr_size + JEMALLOC_ALIGNMENT - 1)
+            & ~(JEMALLOC_ALIGNMENT - 1);
+        if (old_buf_size != new_buf_size)
+            return false;
+    } else if (free_lists->GetAlignmentSize(DataBufferSize(old_size))
+        != free_lists->GetAlignmentSize(size + hdr_size)) {
+        return false;
+    }
+
+    // The old bytes are saved in the header first so that ExceptionRecovery can
+    // restore the old value if the writer exits in the middle of the update.
+    // DBs in memory-only and jemalloc modes do not outlive the writer.
+    bool save_old = !(options & (CONSTS::MEMORY_ONLY_MODE | CONSTS::OPTION_JEMALLOC));
+    int write_size = hdr_size + size;
+    if (save_old) {
+        if (write_size > MB_INPLACE_UNDO_SIZE)
+            return false;
+        if (ReadData(header->inplace_undo, write_size, offset) != write_size)
+            return false;
+        header->inplace_undo_len = write_size;
+        header->excep_offset = offset;
+        std::atomic_signal_fence(std::memory_order_release);
+        header->excep_updating_status = EXCEP_STATUS_OVERWRITE_DATA;
+    }
+
+    uint8_t hdr[DATA_HDR_BYTE + DATA_TTL_BYTE];
+    BuildDataHeader(hdr, size, expire_time);
+
+    std::atomic<uint32_t>& update_seq = DataUpdateSeq(offset);
+    uint32_t seq = update_seq.load(std::memory_order_relaxed);
+    update_seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    WriteData(hdr, hdr_size, offset);
+    WriteData(buff, size, offset + hdr_size);
+    update_seq.store(seq + 2, std::memory_order_release);
+
+    if (save_old)
+        header->excep_updating_status = EXCEP_STATUS_NONE;
+    header->num_inplace_update++;
+    return true;
+}
+
 int Dict::UpdateDataBuffer(EdgePtrs& edge_ptrs, bool overwrite, MBData& mbd, bool& inc_count)
 {
     if (edge_ptrs.flag_ptr[0] & EDGE_FLAG_DATA_OFF) {
         inc_count = false;
         // leaf node
         mbd.data_offset = Get6BInteger(edge_ptrs.offset_ptr);
-        if (!overwrite)
+        // An expired entry is replaced as if it did not exist.
+        if (!overwrite && !DataExpired(mbd.data_offset))
             return MBError::IN_DICT;
+        if (OverwriteData(mbd.buff, mbd.data_len, mbd.expire_time, mbd.data_offset))
+            return MBError::SUCCESS;
 
         if (ReleaseBuffer(mbd.data_offset) != MBError::SUCCESS)
             Logger::Log(LOG_LEVEL_WARN, "failed to release data buffer: %llu", mbd.data_offset);
-        ReserveData(mbd.buff, mbd.data_len, mbd.data_offset);
+        ReserveData(mbd.buff, mbd.data_len, mbd.data_offset, mbd.expire_time);
         Write6BInteger(edge_ptrs.offset_ptr, mbd.data_offset);
 
         header->excep_lf_offset = edge_ptrs.offset;
@@ -1184,8 +1698,10 @@ int Dict::UpdateDataBuffer(EdgePtrs& edge_ptrs, bool overwrite, MBData& mbd, boo
         if (node_buff[0] & FLAG_NODE_MATCH) {
             inc_count = false;
             mbd.data_offset = Get6BInteger(node_buff + 2);
-            if (!overwrite)
+            if (!overwrite && !DataExpired(mbd.data_offset))
                 return MBError::IN_DICT;
+            if (OverwriteData(mbd.buff, mbd.data_len, mbd.expire_time, mbd.data_offset))
+                return MBError::SUCCESS;
             if (ReleaseBuffer(mbd.data_offset) != MBError::SUCCESS)
                 Logger::Log(LOG_LEVEL_WARN, "failed to release data buffer %llu", mbd.data_offset);
 
@@ -1197,7 +1713,7 @@ int Dict::UpdateDataBuffer(EdgePtrs& edge_ptrs, bool overwrite, MBData& mbd, boo
             node_buff[NODE_EDGE_KEY_FIRST] = 1;
         }
 
-        ReserveData(mbd.buff, mbd.data_len, mbd.data_offset);
+        ReserveData(mbd.buff, mbd.data_len, mbd.data_offset, mbd.expire_time);
         Write6BInteger(node_buff + 2, mbd.data_offset);
 
         header->excep_offset = node_off;
@@ -1275,6 +1791,242 @@ void Dict::Flush() const
     if (kv_file != NULL)
         kv_file->Flush();
     mm.Flush();
+    if (expiry_log != NULL)
+        expiry_log->Flush();
+}
+
+int Dict::OpenRedoLog(const std::string& mbdir, bool discard, uint32_t sync_interval, uint32_t sync_size,
+    uint64_t checkpoint_size)
+{
+    if (!(options & CONSTS::ACCESS_MODE_WRITER))
+        return MBError::NOT_ALLOWED;
+
+    try {
+        redo_log = new RedoLog(mbdir, sync_interval, sync_size, checkpoint_size);
+    } catch (int error) {
+        redo_log = NULL;
+        return error;
+    }
+
+    // Records left over from a previous DB with the same directory
+    if (discard)
+        redo_log->Truncate();
+    return MBError::SUCCESS;
+}
+
+// Apply the updates logged after the last checkpoint. This is called when the
+// writer starts. Updates already in the mmapped files are applied again, which
+// leaves the same results since each record is either an overwrite or a removal.
+int64_t Dict::ReplayRedoLog()
+{
+    if (redo_log == NULL)
+        return 0;
+
+    RedoLog* log = redo_log;
+    redo_log = NULL;
+    int64_t count = log->Replay(this);
+    redo_log = log;
+
+    if (count > 0)
+        Logger::Log(LOG_LEVEL_INFO, "replayed %lld records from redo log", count);
+    CheckpointRedoLog();
+    return count;
+}
+
+// Flush the mmapped files and drop the logged updates. The checkpoint is skipped
+// while resource collection is running since the rc tree is not merged yet.
+void Dict::CheckpointRedoLog()
+{
+    if (redo_log == NULL || header->rc_root_offset.load(std::memory_order_relaxed) != 0)
+        return;
+
+    Flush();
+    redo_log->Truncate();
+}
+
+int Dict::StartFlusher(uint64_t flush_rate)
+{
+    if (!(options & CONSTS::ACCESS_MODE_WRITER) || flush_rate == 0 || flusher != NULL)
+        return MBError::NOT_ALLOWED;
+
+    std::vector<DirtyTracker*> trackers;
+    if (mm.GetDirtyTracker() != NULL)
+        trackers.push_back(mm.GetDirtyTracker());
+    if (kv_file->GetDirtyTracker() != NULL)
+        trackers.push_back(kv_file->GetDirtyTracker());
+    if (trackers.empty())
+        return MBError::NOT_ALLOWED;
+
+    try {
+        flusher = new DirtyFlusher(trackers, flush_rate);
+    } catch (int error) {
+        flusher = NULL;
+        return error;
+    }
+    return MBError::SUCCESS;
+}
+
+void Dict::StopFlusher()
+{
+    if (flusher != NULL) {
+        delete flusher;
+        flusher = NULL;
+    }
+}
+
+int Dict::OpenAccessTracker(int policy, uint32_t table_size, const char* queue_dir)
+{
+    if (options & CONSTS::ACCESS_MODE_WRITER) {
+        header->eviction_policy = policy;
+        header->access_table_size = (policy == MB_EVICTION_BUCKET) ? 0
+                                                                    : AccessTracker::TableSize(table_size);
+    }
+    if (header->eviction_policy == MB_EVICTION_BUCKET || header->access_table_size == 0)
+        return MBError::SUCCESS;
+
+    std::string fpath;
+    if (queue_dir != NULL)
+        fpath = std::string(queue_dir) + "/_mabain_a" + std::to_string(header->shm_queue_id);
+    else
+        fpath = "/dev/shm/_mabain_a" + std::to_string(header->shm_queue_id);
+    access_tracker = new AccessTracker(fpath, header->access_table_size, header->eviction_policy,
+        options & CONSTS::ACCESS_MODE_WRITER);
+    if (!access_tracker->IsValid()) {
+        delete access_tracker;
+        access_tracker = NULL;
+        return MBError::MMAP_FAILED;
+    }
+    return MBError::SUCCESS;
+}
+
+AccessTracker* Dict::GetAccessTracker() const
+{
+    return access_tracker;
+}
+
+// The eviction log is only kept for bucket eviction and is not supported in
+// memory-only or jemalloc mode. Eviction falls back to a full scan without it.
+int Dict::OpenEvictionLog(const std::string& mbdir)
+{
+    if (!(options & CONSTS::ACCESS_MODE_WRITER))
+        return MBError::NOT_ALLOWED;
+    if (access_tracker != NULL || (options & (CONSTS::MEMORY_ONLY_MODE | CONSTS::OPTION_JEMALLOC))) {
+        // Records are not appended, so the log has to be rebuilt if used again.
+        header->evict_log_state = EVICTION_LOG_INVALID;
+        return MBError::SUCCESS;
+    }
+
+    evict_log = new EvictionLog(mbdir, header);
+    return MBError::SUCCESS;
+}
+
+EvictionLog* Dict::GetEvictionLog() const
+{
+    return evict_log;
+}
+
+void Dict::SetDefragThreads(int nthread)
+{
+    defrag_threads = nthread;
+}
+
+int Dict::GetDefragThreads() const
+{
+    return defrag_threads;
+}
+
+void Dict::SetNumaPolicy(int policy, uint64_t nodes)
+{
+    mm.GetRollableFile()->SetNumaPolicy(policy, nodes);
+    kv_file->SetNumaPolicy(policy, nodes);
+}
+
+// Not used in memory-only and jemalloc modes, where the blocks are not files
+// shared with other processes.
+int Dict::OpenReaderRegistry(const char* queue_dir)
+{
+    if (options & (CONSTS::MEMORY_ONLY_MODE | CONSTS::OPTION_JEMALLOC))
+        return MBError::NOT_ALLOWED;
+
+    std::string fpath;
+    if (queue_dir != NULL)
+        fpath = std::string(queue_dir) + "/_mabain_r" + std::to_string(header->shm_queue_id);
+    else
+        fpath = "/dev/shm/_mabain_r" + std::to_string(header->shm_queue_id);
+    reader_registry = new ReaderRegistry(fpath, options & CONSTS::ACCESS_MODE_WRITER);
+    if (!reader_registry->IsValid()) {
+        delete reader_registry;
+        reader_registry = NULL;
+        return MBError::MMAP_FAILED;
+    }
+    return MBError::SUCCESS;
+}
+
+// Called by the writer once the DB has shrunk. Blocks still used by the
+// resource collection are not retired.
+void Dict::RetireBlocks()
+{
+    if (reader_registry == NULL || !(options & CONSTS::ACCESS_MODE_WRITER))
+        return;
+    if (header->rc_root_offset.load(std::memory_order_relaxed) != 0
+        || header->rc_m_index_off_pre != 0 || header->rc_m_data_off_pre != 0)
+        return;
+
+    size_t num_retired = kv_file->RetireBlocks(header->m_data_offset);
+    num_retired += mm.GetRollableFile()->RetireBlocks(header->m_index_offset);
+    if (num_retired == 0)
+        return;
+    retired_gen = reader_registry->Retire(header->m_index_offset, header->m_data_offset);
+    Logger::Log(LOG_LEVEL_INFO, "retired %d blocks", (int)num_retired);
+    UnlinkRetiredBlocks();
+}
+
+void Dict::UnlinkRetiredBlocks()
+{
+    if (retired_gen == 0 || !reader_registry->Released(retired_gen))
+        return;
+    kv_file->UnlinkRetired();
+    mm.GetRollableFile()->UnlinkRetired();
+    retired_gen = 0;
+}
+
+// Called by readers. Lookups started after the blocks were retired do not
+// use them.
+void Dict::ReleaseRetiredBlocks()
+{
+    size_t index_size;
+    size_t data_size;
+    uint64_t gen = reader_registry->GetRetired(index_size, data_size);
+    kv_file->ReleaseBlocks(data_size);
+    mm.GetRollableFile()->ReleaseBlocks(index_size);
+    reader_registry->Release(gen);
+}
+
+int Dict::EnablePrealloc(int percentage)
+{
+    int rval = mm.GetRollableFile()->EnablePrealloc(percentage);
+    if (rval != MBError::SUCCESS)
+        return rval;
+    return kv_file->EnablePrealloc(percentage);
+}
+
+// Index blocks are not demoted since lookups go through the whole tree.
+int Dict::EnableSpill(const char* spill_dir)
+{
+    int rval = mm.GetRollableFile()->EnableSpill(spill_dir, false);
+    if (rval != MBError::SUCCESS)
+        return rval;
+    rval = kv_file->EnableSpill(spill_dir, true);
+    if (rval != MBError::SUCCESS)
+        return rval;
+    header->spill_in_use = 1;
+    return rval;
+}
+
+void Dict::PrintNumaStats(std::ostream& out_stream) const
+{
+    mm.GetRollableFile()->PrintNumaStats(out_stream);
+    kv_file->PrintNumaStats(out_stream);
 }
 
 void Dict::Purge() const
@@ -1361,6 +2113,14 @@ int Dict::ExceptionRecovery()
 #endif
         mm.WriteData(header->excep_buff, OFFSET_SIZE - 1, header->excep_offset);
         break;
+    case EXCEP_STATUS_OVERWRITE_DATA:
+        // Put the old value back.
+        if (header->inplace_undo_len > MB_INPLACE_UNDO_SIZE) {
+            rval = MBError::INVALID_SIZE;
+            break;
+        }
+        WriteData(header->inplace_undo, header->inplace_undo_len, header->excep_offset);
+        break;
     default:
         Logger::Log(LOG_LEVEL_ERROR, "unknown exception status: %d",
             header->excep_updating_status);
@@ -1385,7 +2145,7 @@ void Dict::WriteData(const uint8_t* buff, unsigned len, size_t offset) const
     if (options & CONSTS::OPTION_JEMALLOC) {
         kv_file->MemWrite(buff, len, offset);
     } else {
-        if (offset + len > header->m_data_offset) {
+        if (offset + len > header->m_data_offset && !IsRCBuffer(offset)) {
             std::cerr << "invalid dict write: " << offset << " " << len << " "
                       << header->m_data_offset << "\n";
             throw(int) MBError::OUT_OF_BOUND;
@@ -1403,13 +2163,23 @@ int Dict::ReadDataByOffset(size_t offset, MBData& data) const
         return MBError::READ_ERROR;
     }
 
+    data.expire_time = 0;
+    int hdr_size = DataHeaderSize(hdr[0]);
+    if (hdr_size > DATA_HDR_BYTE) {
+        if (ReadData(reinterpret_cast<uint8_t*>(&data.expire_time), DATA_TTL_BYTE,
+                offset + DATA_HDR_BYTE)
+            != DATA_TTL_BYTE)
+            return MBError::READ_ERROR;
+        hdr[0] &= DATA_SIZE_MASK;
+    }
+
     // store data length
     data.data_len = hdr[0];
     // store bucket index
     data.bucket_index = hdr[1];
     // resize data buffer using size from header
     data.Resize(hdr[0]);
-    offset += DATA_HDR_BYTE;
+    offset += hdr_size;
     if (ReadData(data.buff, hdr[0], offset) != hdr[0]) {
         return MBError::READ_ERROR;
     }
@@ -19,20 +19,36 @@
 #ifndef __DICT_H__
 #define __DICT_H__
 
+#include <map>
 #include <stdint.h>
 #include <string>
+#include <vector>
 
+#include "access_tracker.h"
+#include "async_reader.h"
 #include "async_writer.h"
 #include "dict_mem.h"
+#include "eviction_log.h"
+#include "expiry_log.h"
 #include "drm_base.h"
 #include "lock_free.h"
 #include "mb_data.h"
-#include "mb_pipe.h"
+#include "mb_merge.h"
+#include "mb_warmup.h"
+#include "reader_registry.h"
 #include "rollable_file.h"
 #include "shm_queue_mgr.h"
 
 namespace mabain {
 
+#define MB_RETIRED_CHECK_INTERVAL 1024
+#define MB_SPILL_SAMPLE_RATE 16
+// Expiry time of the tombstone added to the rc tree when a main tree entry is
+// removed during resource collection. Expired entries in the rc tree hide the
+// main tree entries of the same keys.
+#define MB_RC_TOMBSTONE_EXPIRE 1
+
+class RedoLog;
 struct _AsyncNode;
 typedef struct _AsyncNode AsyncNode;
 struct _shm_lock_and_queue;
@@ -57,6 +73,10 @@ public:
     int Add(const uint8_t* key, int len, MBData& data, bool overwrite);
     // Find value by key
     int Find(const uint8_t* key, int len, MBData& data);
+    // Find values of a batch of keys. The result of keys[i] is returned in
+    // rvals[i] and data[i]. Values in the blocks beyond the memcap are read
+    // together instead of one by one.
+    void FindBatch(const std::vector<std::string>& keys, MBData* data, int* rvals);
     // Find value by key using longest prefix match
     int FindPrefix(const uint8_t* key, int len, MBData& data);
     int FindBound(size_t root_off, const uint8_t* key, int len, MBData& data);
@@ -67,21 +87,74 @@ public:
     // Delete entry by key
     int Remove(const uint8_t* key, int len, MBData& data);
 
+    // Apply merge operator op to the current value of the key and store the
+    // result. Called by writer only.
+    int Merge(const uint8_t* key, int len, int op, const uint8_t* operand,
+        int operand_len, MBData& data);
+    int RegisterMergeOperator(int op, MergeOperator merge_op);
+
+    // Entries with expiry time are tracked by the writer in the expiry log.
+    // RemoveExpired removes at most max_count expired entries.
+    void AddExpiry(const uint8_t* key, int len, uint32_t expire_time);
+    int RemoveExpired(int max_count);
+    // Check if an entry in the expiry log is due. Can be called without
+    // holding the writer lock.
+    bool ExpiryDue() const;
+    void ResetExpiryLog();
+    int OpenExpiryLog(const std::string& mbdir);
+    // Rebuild the expiry log with a pass over the DB if it was not maintained.
+    void RebuildExpiryLog(const DB& db);
+
+    // Prefault the index and data blocks. See DB::Warmup.
+    int Warmup(int warmup_options, int num_threads, const WarmupProgress& progress);
+
+    // Snapshot of a memory-only DB. See DB::DumpSnapshot and
+    // MBConfig::snapshot_dir. The header is loaded before the DB is opened and
+    // the blocks and free lists after.
+    int DumpSnapshot(const std::string& snapshot_dir, int num_threads);
+    static void LoadSnapshotHeader(const std::string& snapshot_dir, const std::string& mbdir,
+        int mode);
+    int LoadSnapshot(const std::string& snapshot_dir, int num_threads);
+
     // Delete all entries
     int RemoveAll();
+    // Remove an entry from the rc tree only, or check if it is still there
+    int Remove_RC(const uint8_t* key, int len);
+    bool InTree_RC(const uint8_t* key, int len);
+    // Check if the entry was removed from the main tree during resource
+    // collection, and remove the main tree entry once the rc tree is merged.
+    bool Tombstone_RC(const uint8_t* key, int len);
+    int RemoveTombstone_RC(const uint8_t* key, int len);
+    // Find the edge of the key in the rc tree or the main tree. Used by the
+    // DB iterator.
+    int FindEdge(bool rc_tree, const uint8_t* key, int len, MBData& data);
 
     // multiple-process updates using shared memory queue
+    // timeout is the time in millisecond to wait for a free slot when the
+    // queue is full. TRY_AGAIN is returned immediately if timeout is 0.
     int SHMQ_Add(const char* key, int key_len, const char* data, int data_len,
-        bool overwrite);
-    int SHMQ_Remove(const char* key, int len);
-    int SHMQ_RemoveAll();
-    int SHMQ_Backup(const char* backup_dir);
+        bool overwrite, int timeout = 0, uint32_t expire_time = 0);
+    int SHMQ_Remove(const char* key, int len, int timeout = 0);
+    int SHMQ_Merge(const char* key, int key_len, int op, const char* operand,
+        int operand_len, int timeout = 0);
+    int SHMQ_RemoveAll(int timeout = 0);
+    int SHMQ_Backup(const char* backup_dir, int timeout = 0);
     int SHMQ_CollectResource(int64_t m_index_rc_size, int64_t m_data_rc_size,
-        int64_t max_dbsz, int64_t max_dbcnt);
+        int64_t max_dbsz, int64_t max_dbcnt, int timeout = 0);
     void SHMQ_Signal();
     bool SHMQ_Busy() const;
+    // Used by async writer to wait for an update and release the slot for the next round.
+    bool SHMQ_WaitForSlot(AsyncNode* node_ptr, uint32_t pos, int timeout);
+    bool SHMQ_ReleaseSlot(AsyncNode* node_ptr, uint32_t pos);
+    bool SHMQ_SkipSlot(AsyncNode* node_ptr, uint32_t pos);
+    bool SHMQ_ReleaseBlockedSlot(uint32_t& pos);
+    void SHMQ_ReleaseSlots(uint32_t start, uint32_t end);
+    // Used by writer pool threads serving multiple queues.
+    bool SHMQ_UpdateReady() const;
+    std::atomic<uint32_t>* SHMQ_ParkWriter(uint32_t& bell);
+    void SHMQ_UnparkWriter();
 
-    void ReserveData(const uint8_t* buff, int size, size_t& offset);
+    void ReserveData(const uint8_t* buff, int size, size_t& offset, uint32_t expire_time = 0);
     void WriteData(const uint8_t* buff, unsigned len, size_t offset) const;
 
     // Print dictinary stats
@@ -117,24 +190,78 @@ public:
     void Purge() const;
     int ExceptionRecovery();
 
+    // Redo log of the writer updates. If discard is true, records in an
+    // existing log are dropped instead of being replayed.
+    int OpenRedoLog(const std::string& mbdir, bool discard, uint32_t sync_interval,
+        uint32_t sync_size, uint64_t checkpoint_size);
+    int64_t ReplayRedoLog();
+    void CheckpointRedoLog();
+    // Background thread syncing dirty pages of the index and data files at
+    // flush_rate bytes per second
+    int StartFlusher(uint64_t flush_rate);
+    void StopFlusher();
+    // Access counters for MB_EVICTION_CLOCK and MB_EVICTION_LFU. The writer
+    // sets the policy in the header and readers follow the header.
+    int OpenAccessTracker(int policy, uint32_t table_size, const char* queue_dir);
+    AccessTracker* GetAccessTracker() const;
+    // Keys in bucket order for bucket eviction. Called by writer only.
+    int OpenEvictionLog(const std::string& mbdir);
+    EvictionLog* GetEvictionLog() const;
+    // Threads copying data buffers for the writer during defragmentation
+    void SetDefragThreads(int nthread);
+    int GetDefragThreads() const;
+    // NUMA policy of the index and data block mappings
+    void SetNumaPolicy(int policy, uint64_t nodes);
+    void PrintNumaStats(std::ostream& out_stream) const;
+    // Background preallocation of the next index and data blocks
+    int EnablePrealloc(int percentage);
+    // Reader handles in shared memory so that the blocks left beyond the end
+    // of the DB after defragmentation can be removed. The writer retires the
+    // blocks and unlinks them once all the readers have released them.
+    // Readers release them before lookups.
+    int OpenReaderRegistry(const char* queue_dir);
+    void RetireBlocks();
+    void UnlinkRetiredBlocks();
+    inline void CheckRetiredBlocks();
+    // Memory-only writer: back the blocks beyond the memory caps with files
+    // in spill_dir. Cold data blocks are moved there first based on the
+    // lookups sampled by all handles.
+    int EnableSpill(const char* spill_dir);
+
 private:
+    inline void SampleAccess(size_t data_offset);
+    int Add_Internal(const uint8_t* key, int len, MBData& data, bool overwrite);
+    int RemoveEntry(const uint8_t* key, int len, MBData& data);
     int Find_Internal(size_t root_off, const uint8_t* key, int len, MBData& data);
     int FindPrefix_Internal(size_t root_off, const uint8_t* key, int len, MBData& data);
+    int FindMergeValue(const uint8_t* key, int len, MBData& data);
+    int ApplyMerge(int op, const uint8_t* value, int value_len, const uint8_t* operand,
+        int operand_len, std::string& result);
+    int Remove_Internal(size_t root_off, const uint8_t* key, int len, MBData& data);
     int ReleaseBuffer(size_t offset);
     int UpdateDataBuffer(EdgePtrs& edge_ptrs, bool overwrite, MBData& mbd, bool& inc_count);
     int ReadDataFromEdge(MBData& data, const EdgePtrs& edge_ptrs) const;
     int ReadDataFromNode(MBData& data, const uint8_t* node_ptr) const;
+    int ReadDataBuffer(MBData& data, size_t data_off) const;
+    inline std::atomic<uint32_t>& DataUpdateSeq(size_t data_off) const;
+    int ParseColdData(MBData& data, ssize_t bytes_read, int& hdr_size) const;
+    bool OverwriteData(const uint8_t* buff, int size, uint32_t expire_time, size_t offset);
+    int BuildDataHeader(uint8_t* hdr, int size, uint32_t expire_time);
+    uint16_t NextBucketIndex();
+    bool DataExpired(size_t data_off) const;
     int DeleteDataFromEdge(MBData& data, EdgePtrs& edge_ptrs);
     int ReadNodeMatch(size_t node_off, int& match, MBData& data) const;
-    int SHMQ_PrepareSlot(AsyncNode* node_ptr);
-    AsyncNode* SHMQ_AcquireSlot(int& err) const;
+    int SHMQ_PrepareSlot(AsyncNode* node_ptr, uint32_t pos);
+    AsyncNode* SHMQ_AcquireSlot(int& err, uint32_t& pos, int timeout) const;
+    void RingDoorbell(bool force);
     int ReadLowerBound(EdgePtrs& edge_ptrs, MBData& data) const;
     int ReadUpperBound(EdgePtrs& edge_ptrs, MBData& data) const;
     int ReadDataFromBoundEdge(bool use_curr_edge, EdgePtrs& edge_ptrs,
         EdgePtrs& bound_edge_ptrs, MBData& data, int root_key) const;
-    void reserveDataFL(const uint8_t* buff, int size, size_t& offset);
+    void reserveDataFL(const uint8_t* buff, int size, size_t& offset, uint32_t expire_time);
     int ReleaseBuffer(size_t offset, int size);
     void ReleaseAlignmentBuffer(size_t offset, size_t alignment_off);
+    void ReleaseRetiredBlocks();
 
     // Memory management
     DictMem mm;
@@ -145,11 +272,56 @@ private:
     LockFree lfree;
 
     size_t reader_rc_off;
+    // merge operators registered by the writer
+    std::map<int, MergeOperator> merge_ops;
+    // keys in buckets of expiry time; stale records are skipped by RemoveExpired
+    ExpiryLog* expiry_log;
+    std::atomic<uint32_t> next_expire;
     AsyncNode* queue;
     shm_lock_and_queue* slaq;
-    MBPipe mbp;
+    ShmQueueProducer* shmq_producer;
+    RedoLog* redo_log;
+    DirtyFlusher* flusher;
+    AccessTracker* access_tracker;
+    EvictionLog* evict_log;
+    // created by the first FindBatch reading values from the block files
+    AsyncReader* async_reader;
+    // bucket index of the last data header written
+    uint16_t last_bucket_index;
+    int defrag_threads;
+    ReaderRegistry* reader_registry;
+    // Generation of the blocks retired by the writer and not unlinked yet
+    uint64_t retired_gen;
+    uint32_t retired_check;
+    uint32_t num_find;
 };
 
+// Called by readers before lookups. The writer checks if the retired blocks
+// can be unlinked every MB_RETIRED_CHECK_INTERVAL updates.
+inline void Dict::CheckRetiredBlocks()
+{
+    if (reader_registry == NULL)
+        return;
+    if (options & CONSTS::ACCESS_MODE_WRITER) {
+        if (retired_gen != 0 && ++retired_check % MB_RETIRED_CHECK_INTERVAL == 0)
+            UnlinkRetiredBlocks();
+    } else if (reader_registry->Retired()) {
+        ReleaseRetiredBlocks();
+    }
+}
+
+// Sequence number of in-place updates to the data buffer at data_off
+inline std::atomic<uint32_t>& Dict::DataUpdateSeq(size_t data_off) const
+{
+    return header->data_update_seq[(data_off * 0x9E3779B97F4A7C15ULL) >> 58];
+}
+
+inline void Dict::SampleAccess(size_t data_offset)
+{
+    if (header->spill_in_use && ++num_find % MB_SPILL_SAMPLE_RATE == 0)
+        kv_file->RecordAccess(data_offset);
+}
+
 }
 
 #endif
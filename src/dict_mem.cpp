@@ -148,6 +148,12 @@ DictMem::DictMem(const std::string& mbdir, bool init_header, size_t memsize,
     } else {
         is_valid = true;
     }
+    // The free list file is left from another DB if its buffers are not
+    // counted in the pending buffer size.
+    if (free_lists != NULL && (init_header
+            || free_lists->GetTotSize() > (size_t)header->pending_index_buff_size)) {
+        free_lists->Empty();
+    }
     Logger::Log(LOG_LEVEL_DEBUG, "set mabain db version to %u.%u.%u",
         header->version[0], header->version[1], header->version[2]);
 }
@@ -178,6 +184,8 @@ void DictMem::InitRootNode()
 
     if (node_move)
         WriteData(root_node, node_size[NUM_ALPHABET - 1], root_offset);
+    else
+        MarkDirty(root_offset, node_size[NUM_ALPHABET - 1]);
 
     // Everything is running fine if reaching this point.
     is_valid = true;
@@ -347,6 +355,8 @@ int DictMem::InsertNode(EdgePtrs& edge_ptrs, int match_len,
 
     if (node_move)
         WriteData(node, node_size[0], node_ptrs.offset);
+    else
+        MarkDirty(node_ptrs.offset, node_size[0]);
 
     if (release_buffer_size > 0)
         ReleaseBuffer(edge_str_off, release_buffer_size);
@@ -419,6 +429,8 @@ int DictMem::AddLink(EdgePtrs& edge_ptrs, int match_len, const uint8_t* key,
 
     if (node_move)
         WriteData(node, node_size[1], node_ptrs.offset);
+    else
+        MarkDirty(node_ptrs.offset, node_size[1]);
 
     // Update the parent edge
     if (release_buffer_size > 0)
@@ -508,6 +520,8 @@ int DictMem::UpdateNode(EdgePtrs& edge_ptrs, const uint8_t* key, int key_len,
 
     if (node_move)
         WriteData(node, node_size[nt], node_ptrs.offset);
+    else
+        MarkDirty(node_ptrs.offset, node_size[nt]);
 
     if (release_node_index >= 0)
         ReleaseNode(old_node_off, release_node_index);
@@ -620,22 +634,12 @@ bool DictMem::reserveNodeFL(int nt, size_t& offset, uint8_t*& ptr)
     int buf_index = free_lists->GetBufferIndex(buf_size);
 
     header->n_states++;
-#ifdef __LOCK_FREE__
     if (free_lists->GetBufferByIndex(buf_index, offset)) {
         ptr = node_ptr;
         memset(ptr, 0, buf_size);
         header->pending_index_buff_size -= buf_size;
         return true;
     }
-#else
-    if (free_lists->GetBufferCountByIndex(buf_index) > 0) {
-        offset = free_lists->RemoveBufferByIndex(buf_index);
-        ptr = node_ptr;
-        memset(ptr, 0, buf_size);
-        header->pending_index_buff_size -= buf_size;
-        return true;
-    }
-#endif
 
     ptr = NULL;
     size_t old_off = header->m_index_offset;
@@ -687,19 +691,10 @@ void DictMem::reserveDataFL(const uint8_t* key, int size, size_t& offset, bool m
     int buf_index = free_lists->GetBufferIndex(size);
     int buf_size = free_lists->GetAlignmentSize(size);
 
-#ifdef __LOCK_FREE__
     if (free_lists->GetBufferByIndex(buf_index, offset)) {
         WriteData(key, size, offset);
         header->pending_index_buff_size -= buf_size;
-    }
-#else
-    if (free_lists->GetBufferCountByIndex(buf_index) > 0) {
-        offset = free_lists->RemoveBufferByIndex(buf_index);
-        WriteData(key, size, offset);
-        header->pending_index_buff_size -= buf_size;
-    }
-#endif
-    else {
+    } else {
         size_t old_off = header->m_index_offset;
         uint8_t* ptr;
 
@@ -716,10 +711,12 @@ void DictMem::reserveDataFL(const uint8_t* key, int size, size_t& offset, bool m
 
         offset = header->m_index_offset;
         header->m_index_offset += buf_size;
-        if (ptr != NULL)
+        if (ptr != NULL) {
             memcpy(ptr, key, size);
-        else
+            MarkDirty(offset, size);
+        } else {
             WriteData(key, size, offset);
+        }
     }
 
     header->edge_str_size += buf_size;
@@ -742,7 +739,7 @@ void DictMem::ReleaseNode(size_t offset, int nt)
 
 void DictMem::releaseNodeFL(size_t offset, int nt)
 {
-    if (nt < 0)
+    if (nt < 0 || IsRCBuffer(offset))
         return;
 
     int buf_index = free_lists->GetBufferIndex(node_size[nt]);
@@ -771,6 +768,8 @@ void DictMem::ReleaseBuffer(size_t offset, int size)
 
 void DictMem::releaseBufferFL(size_t offset, int size)
 {
+    if (IsRCBuffer(offset))
+        return;
     int rval = free_lists->ReleaseBuffer(offset, size);
     if (rval != MBError::SUCCESS)
         Logger::Log(LOG_LEVEL_ERROR, "failed to release buffer");
@@ -831,6 +830,8 @@ size_t DictMem::InitRootNode_RC()
 
     if (node_move)
         WriteData(root_node, node_size[NUM_ALPHABET - 1], root_offset_rc);
+    else
+        MarkDirty(root_offset_rc, node_size[NUM_ALPHABET - 1]);
 
     return root_offset_rc;
 }
@@ -1093,6 +1094,8 @@ int DictMem::RemoveEdgeSizeN(const EdgePtrs& edge_ptrs,
     // Write the new node before free
     if (node_move)
         WriteData(node, node_size[nt - 2], new_node_offset);
+    else
+        MarkDirty(new_node_offset, node_size[nt - 2]);
 
     // Update the link from parent edge to the new node offset
     Write6BInteger(header->excep_buff, new_node_offset);
@@ -1150,7 +1153,9 @@ int DictMem::RemoveEdgeByIndex(const EdgePtrs& edge_ptrs, MBData& data)
 {
     header->excep_offset = edge_ptrs.curr_node_offset;
 
-    if (header->excep_offset == root_offset) {
+    size_t rc_root_offset = header->rc_root_offset.load(std::memory_order_relaxed);
+    if (header->excep_offset == root_offset
+        || (rc_root_offset != 0 && header->excep_offset == rc_root_offset)) {
         RemoveRootEdge(edge_ptrs);
         return MBError::SUCCESS;
     }
@@ -1219,6 +1224,7 @@ void DictMem::PrintStats(std::ostream& out_stream) const
     } else if (free_lists != nullptr) {
         out_stream << "\tPending buffer size: " << header->pending_index_buff_size << std::endl;
         out_stream << "\tTrackable buffer size: " << free_lists->GetTotSize() << std::endl;
+        out_stream << "\tFree buffer count: " << free_lists->Count() << std::endl;
     }
     kv_file->PrintStats(out_stream);
 
@@ -1256,7 +1262,7 @@ void DictMem::WriteData(const uint8_t* buff, unsigned len, size_t offset) const
     if (options & CONSTS::OPTION_JEMALLOC) {
         kv_file->MemWrite(buff, len, offset);
     } else {
-        if (offset + len > header->m_index_offset) {
+        if (offset + len > header->m_index_offset && !IsRCBuffer(offset)) {
             std::cerr << "invalid dmm write: " << offset << " " << len << " "
                       << header->m_index_offset << "\n";
             throw(int) MBError::OUT_OF_BOUND;
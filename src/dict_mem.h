@@ -89,6 +89,8 @@ public:
     const int* GetNodeSizePtr() const;
 
     void InitLockFreePtr(LockFree* lf);
+    // Read the top levels of the trie to warm up the index
+    size_t WarmupTopLevels(size_t max_nodes) const;
 
     void Flush() const;
     void Purge() const;
@@ -144,7 +146,7 @@ inline void DictMem::WriteEdge(const EdgePtrs& edge_ptrs) const
     if (options & CONSTS::OPTION_JEMALLOC) {
         kv_file->MemWrite(edge_ptrs.ptr, EDGE_SIZE, edge_ptrs.offset);
     } else {
-        if (edge_ptrs.offset + EDGE_SIZE > header->m_index_offset) {
+        if (edge_ptrs.offset + EDGE_SIZE > header->m_index_offset && !IsRCBuffer(edge_ptrs.offset)) {
             std::cerr << "invalid edge write: " << edge_ptrs.offset << " " << EDGE_SIZE
                       << " " << header->m_index_offset << "\n";
             throw(int) MBError::OUT_OF_BOUND;
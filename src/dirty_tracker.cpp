@@ -0,0 +1,267 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <chrono>
+
+#include "dirty_tracker.h"
+#include "error.h"
+#include "logger.h"
+
+namespace mabain {
+
+#define DIRTY_RUN_NONE ((size_t)-1)
+
+DirtyTracker::DirtyTracker(size_t blocksize, size_t max_block, size_t pagesize)
+    : block_size(blocksize)
+    , page_size(pagesize)
+    , num_dirty(0)
+    , cursor_block(0)
+    , cursor_page(0)
+    , num_sync(0)
+    , flushed_bytes(0)
+{
+    pages_per_block = (block_size + page_size - 1) / page_size;
+    words_per_block = (pages_per_block + 63) / 64;
+    if (max_block == 0)
+        max_block = 1;
+    DirtyBlock blk;
+    blk.bits = NULL;
+    blocks.assign(max_block, blk);
+}
+
+DirtyTracker::~DirtyTracker()
+{
+    for (size_t i = 0; i < blocks.size(); i++) {
+        if (blocks[i].bits != NULL)
+            delete[] blocks[i].bits;
+    }
+}
+
+void DirtyTracker::AddBlock(size_t order, std::shared_ptr<MmapFileIO> file)
+{
+    if (order >= blocks.size())
+        return;
+
+    std::lock_guard<std::mutex> lock(flush_mutex);
+    if (blocks[order].bits == NULL) {
+        blocks[order].bits = new std::atomic<uint64_t>[words_per_block];
+        for (size_t i = 0; i < words_per_block; i++)
+            blocks[order].bits[i].store(0, std::memory_order_relaxed);
+    }
+    blocks[order].file = file;
+}
+
+// Called when the block file is removed. The pages do not need to be synced.
+void DirtyTracker::RemoveBlock(size_t order)
+{
+    if (order >= blocks.size())
+        return;
+
+    std::lock_guard<std::mutex> lock(flush_mutex);
+    if (blocks[order].bits != NULL) {
+        int64_t count = 0;
+        for (size_t i = 0; i < words_per_block; i++) {
+            uint64_t old = blocks[order].bits[i].exchange(0, std::memory_order_relaxed);
+            count += __builtin_popcountll(old);
+        }
+        num_dirty.fetch_sub(count, std::memory_order_relaxed);
+    }
+    blocks[order].file.reset();
+}
+
+size_t DirtyTracker::Flush(size_t max_bytes)
+{
+    std::lock_guard<std::mutex> lock(flush_mutex);
+
+    size_t flushed = 0;
+    // Visit the starting block twice since the last flush may have stopped
+    // in the middle of it.
+    for (size_t n = 0; n <= blocks.size(); n++) {
+        if (num_dirty.load(std::memory_order_relaxed) <= 0)
+            break;
+
+        if (blocks[cursor_block].file != NULL) {
+            size_t budget = 0;
+            if (max_bytes > 0)
+                budget = max_bytes - flushed;
+            flushed += FlushBlock(cursor_block, cursor_page, budget);
+            if (max_bytes > 0 && flushed >= max_bytes)
+                break;
+        }
+
+        cursor_block = (cursor_block + 1) % blocks.size();
+        cursor_page = 0;
+    }
+
+    flushed_bytes += flushed;
+    return flushed;
+}
+
+// Sync the dirty pages of a block starting at page. Stops after max_bytes if
+// not zero and sets page to where the next flush starts.
+size_t DirtyTracker::FlushBlock(size_t order, size_t& page, size_t max_bytes)
+{
+    DirtyBlock& blk = blocks[order];
+    MmapFileIO* file = blk.file.get();
+    size_t flushed = 0;
+    size_t run_start = DIRTY_RUN_NONE;
+    size_t run_end = 0;
+
+    while (page < pages_per_block) {
+        size_t wi = page / 64;
+        size_t bit = page % 64;
+        uint64_t dirty = blk.bits[wi].load(std::memory_order_relaxed) & (~0ULL << bit);
+        if (dirty == 0) {
+            page = (wi + 1) * 64;
+            continue;
+        }
+
+        uint64_t take = dirty;
+        bool stop = false;
+        if (max_bytes > 0) {
+            size_t left = (max_bytes - flushed + page_size - 1) / page_size;
+            while ((size_t)__builtin_popcountll(take) > left) {
+                take &= ~(1ULL << (63 - __builtin_clzll(take)));
+                stop = true;
+            }
+        }
+
+        // Clear the bits before syncing the pages. A page updated after
+        // this point is marked again.
+        blk.bits[wi].fetch_and(~take, std::memory_order_relaxed);
+        int count = __builtin_popcountll(take);
+        num_dirty.fetch_sub(count, std::memory_order_relaxed);
+        flushed += count * page_size;
+
+        for (size_t b = bit; b < 64; b++) {
+            if (!(take & (1ULL << b)))
+                continue;
+            size_t p = wi * 64 + b;
+            if (run_start != DIRTY_RUN_NONE && p != run_end) {
+                SyncRange(file, run_start, run_end);
+                run_start = DIRTY_RUN_NONE;
+            }
+            if (run_start == DIRTY_RUN_NONE)
+                run_start = p;
+            run_end = p + 1;
+        }
+
+        if (stop) {
+            page = run_end;
+            break;
+        }
+        page = (wi + 1) * 64;
+        if (max_bytes > 0 && flushed >= max_bytes) {
+            // Resume after the last page synced, not past the bits of this
+            // word that were not dirty when scanned.
+            page = run_end;
+            break;
+        }
+    }
+
+    if (run_start != DIRTY_RUN_NONE)
+        SyncRange(file, run_start, run_end);
+    return flushed;
+}
+
+void DirtyTracker::SyncRange(MmapFileIO* file, size_t start_page, size_t end_page)
+{
+    size_t offset = start_page * page_size;
+    size_t size = end_page * page_size - offset;
+    if (offset + size > block_size)
+        size = block_size - offset;
+    file->FlushRange(offset, size);
+    num_sync++;
+}
+
+size_t DirtyTracker::DirtySize() const
+{
+    int64_t count = num_dirty.load(std::memory_order_relaxed);
+    if (count < 0)
+        count = 0;
+    return count * page_size;
+}
+
+void DirtyTracker::PrintStats(std::ostream& out_stream) const
+{
+    out_stream << "\tdirty size: " << DirtySize() << std::endl;
+    out_stream << "\tflushed size: " << flushed_bytes << std::endl;
+    out_stream << "\tnumber of range syncs: " << num_sync << std::endl;
+}
+
+/////////////////////////////////////////////////////////////////////
+
+DirtyFlusher::DirtyFlusher(const std::vector<DirtyTracker*>& dirty_trackers, uint64_t flush_rate)
+    : trackers(dirty_trackers)
+    , rate(flush_rate)
+    , stop_flush(false)
+    , tid(0)
+{
+    if (pthread_create(&tid, NULL, flush_thread_wrapper, this) != 0) {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to create flusher thread");
+        throw(int) MBError::THREAD_FAILED;
+    }
+    Logger::Log(LOG_LEVEL_DEBUG, "started flusher with rate %llu bytes per second", rate);
+}
+
+DirtyFlusher::~DirtyFlusher()
+{
+    {
+        std::lock_guard<std::mutex> lock(stop_mutex);
+        stop_flush = true;
+    }
+    stop_cond.notify_all();
+    pthread_join(tid, NULL);
+}
+
+void* DirtyFlusher::flush_thread_wrapper(void* context)
+{
+    DirtyFlusher* flusher = reinterpret_cast<DirtyFlusher*>(context);
+    return flusher->flush_thread();
+}
+
+void* DirtyFlusher::flush_thread()
+{
+    size_t budget = rate * DIRTY_FLUSH_INTERVAL / 1000;
+    if (budget == 0)
+        budget = 1;
+
+    std::unique_lock<std::mutex> lock(stop_mutex);
+    while (!stop_flush) {
+        stop_cond.wait_for(lock, std::chrono::milliseconds(DIRTY_FLUSH_INTERVAL));
+        if (stop_flush)
+            break;
+        lock.unlock();
+
+        // Split the budget evenly. What one tracker does not use is left for
+        // the following ones.
+        size_t flushed = 0;
+        for (size_t i = 0; i < trackers.size() && flushed < budget; i++) {
+            size_t share = (budget - flushed) / (trackers.size() - i);
+            if (share == 0)
+                share = 1;
+            flushed += trackers[i]->Flush(share);
+        }
+
+        lock.lock();
+    }
+
+    return NULL;
+}
+
+}
@@ -0,0 +1,138 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __DIRTY_TRACKER_H__
+#define __DIRTY_TRACKER_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <stdint.h>
+#include <vector>
+
+#include "mmap_file.h"
+
+namespace mabain {
+
+#define DIRTY_FLUSH_INTERVAL 100 // millisecond
+
+// Pages written by the writer in each block file of a rollable file. Only the
+// dirty pages are synced when flushing instead of the whole mapping. Pages are
+// marked by the writer after they are updated, and the bits are cleared before
+// the pages are synced, so that a page updated during a flush is synced again
+// by the next flush.
+class DirtyTracker {
+public:
+    DirtyTracker(size_t block_size, size_t max_block, size_t page_size);
+    ~DirtyTracker();
+
+    void AddBlock(size_t order, std::shared_ptr<MmapFileIO> file);
+    void RemoveBlock(size_t order);
+    inline void MarkDirty(size_t offset, size_t size);
+
+    // Sync up to max_bytes of dirty pages, all of them if max_bytes is 0.
+    // Flushing resumes where the last call stopped so that a rate-limited
+    // flusher goes over all blocks. Returns the number of bytes synced.
+    size_t Flush(size_t max_bytes = 0);
+    size_t DirtySize() const;
+    void PrintStats(std::ostream& out_stream) const;
+
+private:
+    typedef struct _DirtyBlock {
+        std::atomic<uint64_t>* bits;
+        std::shared_ptr<MmapFileIO> file;
+    } DirtyBlock;
+
+    size_t FlushBlock(size_t order, size_t& page, size_t max_bytes);
+    void SyncRange(MmapFileIO* file, size_t start_page, size_t end_page);
+
+    size_t block_size;
+    size_t page_size;
+    size_t pages_per_block;
+    size_t words_per_block;
+    // Blocks are added and removed by the writer. The file pointers are
+    // guarded by flush_mutex, which also serializes flushing.
+    std::vector<DirtyBlock> blocks;
+    std::mutex flush_mutex;
+    std::atomic<int64_t> num_dirty;
+    // Position of the next flush
+    size_t cursor_block;
+    size_t cursor_page;
+    uint64_t num_sync;
+    uint64_t flushed_bytes;
+};
+
+inline void DirtyTracker::MarkDirty(size_t offset, size_t size)
+{
+    if (size == 0)
+        return;
+    size_t order = offset / block_size;
+    if (order >= blocks.size() || blocks[order].bits == NULL)
+        return;
+
+    size_t index = offset % block_size;
+    size_t end = index + size;
+    if (end > block_size)
+        end = block_size;
+    size_t page = index / page_size;
+    size_t last = (end - 1) / page_size;
+    std::atomic<uint64_t>* bits = blocks[order].bits;
+    int64_t count = 0;
+    while (page <= last) {
+        size_t bit = page % 64;
+        size_t nbits = last - page + 1;
+        if (nbits > 64 - bit)
+            nbits = 64 - bit;
+        uint64_t mask = (nbits == 64) ? ~0ULL : (((1ULL << nbits) - 1) << bit);
+        std::atomic<uint64_t>& word = bits[page / 64];
+        // Most updates hit pages that are already dirty.
+        if ((word.load(std::memory_order_relaxed) & mask) != mask) {
+            uint64_t old = word.fetch_or(mask, std::memory_order_relaxed);
+            count += __builtin_popcountll(mask & ~old);
+        }
+        page += nbits;
+    }
+    if (count > 0)
+        num_dirty.fetch_add(count, std::memory_order_relaxed);
+}
+
+// Background thread that trickles dirty pages to disk at a limited rate
+class DirtyFlusher {
+public:
+    DirtyFlusher(const std::vector<DirtyTracker*>& trackers, uint64_t rate);
+    ~DirtyFlusher();
+
+private:
+    static void* flush_thread_wrapper(void* context);
+    void* flush_thread();
+
+    std::vector<DirtyTracker*> trackers;
+    // bytes per second
+    uint64_t rate;
+    std::mutex stop_mutex;
+    std::condition_variable stop_cond;
+    bool stop_flush;
+    pthread_t tid;
+};
+
+}
+
+#endif
@@ -155,6 +155,8 @@ void DRMBase::PrintHeader(std::ostream& out_stream) const
     out_stream << "number of updates: " << header->num_update << std::endl;
     out_stream << "entry count per bucket: " << header->entry_per_bucket << std::endl;
     out_stream << "eviction bucket index: " << header->eviction_bucket_index << std::endl;
+    out_stream << "eviction policy: " << header->eviction_policy << std::endl;
+    out_stream << "access table size: " << header->access_table_size << std::endl;
     out_stream << "exception data: " << std::endl;
     out_stream << "\tupdating status: " << header->excep_updating_status << std::endl;
     out_stream << "\texception data buffer: ";
@@ -170,10 +172,17 @@ void DRMBase::PrintHeader(std::ostream& out_stream) const
     out_stream << "max data offset before rc: " << header->rc_m_data_off_pre << std::endl;
     out_stream << "rc root offset: " << header->rc_root_offset << std::endl;
     out_stream << "rc count: " << header->rc_count << std::endl;
+    out_stream << "rc phase: " << header->rc_phase << std::endl;
+    out_stream << "rc progress: " << header->rc_progress << std::endl;
     out_stream << "shared memory queue size: " << header->async_queue_size << std::endl;
     out_stream << "shared memory queue index: " << header->queue_index << std::endl;
     out_stream << "shared memory writer index: " << header->writer_index << std::endl;
     out_stream << "resource flag: " << header->rc_flag << std::endl;
+    out_stream << "shared memory queue full count: " << header->shmq_full_count << std::endl;
+    out_stream << "shared memory queue wait count: " << header->shmq_wait_count << std::endl;
+    out_stream << "shared memory queue timeout count: " << header->shmq_timeout_count << std::endl;
+    out_stream << "in-place data update count: " << header->num_inplace_update << std::endl;
+    out_stream << "expired entry count: " << header->num_expired << std::endl;
     out_stream << "---------------- END OF HEADER ----------------" << std::endl;
 }
 
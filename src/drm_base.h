@@ -23,11 +23,18 @@
 #endif
 
 #include "free_list.h"
+#include "lock_free.h"
+#include "mabain_consts.h"
 #include "rollable_file.h"
 
 #define DATA_BUFFER_ALIGNMENT 1
 #define DATA_SIZE_BYTE 2
 #define DATA_HDR_BYTE 4
+// The size field of a data buffer has the TTL flag set if the entry expires.
+// The expiry time in seconds (uint32_t) follows the data header in this case.
+#define DATA_SIZE_TTL_FLAG 0x8000
+#define DATA_SIZE_MASK 0x7FFF
+#define DATA_TTL_BYTE 4
 #define OFFSET_SIZE 6
 #define EDGE_SIZE 13
 #define EDGE_LEN_POS 5
@@ -49,7 +56,12 @@
 #define EXCEP_STATUS_RC_EDGE_STR 7
 #define EXCEP_STATUS_RC_DATA 8
 #define EXCEP_STATUS_RC_TREE 9
+#define EXCEP_STATUS_OVERWRITE_DATA 10
 #define MB_EXCEPTION_BUFF_SIZE 16
+// Number of sequence numbers for in-place data updates
+#define MB_DATA_UPDATE_SEQ_NUM 64
+// Largest data buffer overwritten in place in DBs on disk
+#define MB_INPLACE_UNDO_SIZE 1024
 
 #define MAX_BUFFER_RESERVE_SIZE 8192
 #define NUM_BUFFER_RESERVE MAX_BUFFER_RESERVE_SIZE / BUFFER_ALIGNMENT
@@ -111,8 +123,57 @@ typedef struct _IndexHeader {
     std::atomic<uint32_t> queue_index;
     uint32_t writer_index;
     std::atomic<uint32_t> rc_flag;
+
+    // async queue backpressure counters
+    std::atomic<uint64_t> shmq_full_count; // enqueues that found the queue full
+    std::atomic<uint64_t> shmq_wait_count; // producer waits for a free slot
+    std::atomic<uint64_t> shmq_timeout_count; // enqueues that timed out
+    // Odd while the writer overwrites a data buffer in place. The buffer uses
+    // the sequence number selected by its offset. Readers read the buffer
+    // again if the value changed while they were reading.
+    std::atomic<uint32_t> data_update_seq[MB_DATA_UPDATE_SEQ_NUM];
+    uint64_t num_inplace_update;
+    // Old bytes of the buffer being overwritten in place at excep_offset,
+    // restored by ExceptionRecovery if the writer exits during the update
+    uint32_t inplace_undo_len;
+    uint8_t inplace_undo[MB_INPLACE_UNDO_SIZE];
+    // Set once an entry with expiry time is added. The writer rebuilds the
+    // expiry log when opening the DB if it is set and the log was not
+    // maintained; see expiry_log.h
+    uint32_t ttl_in_use;
+    uint32_t expiry_log_state;
+    uint64_t num_expired;
+    // Access-aware eviction set by the writer; see MB_EVICTION_* in db.h.
+    // Readers open the access table if the policy is not MB_EVICTION_BUCKET.
+    uint32_t eviction_policy;
+    uint32_t access_table_size;
+    // Eviction log for bucket eviction; see eviction_log.h
+    uint32_t evict_log_state;
+    uint64_t evict_log_head;
+    uint64_t evict_log_tail;
+    // Progress of resource collection so that it can be resumed after the
+    // writer exits abnormally. rc_progress is the number of buffers done in
+    // rc_phase, which is zero if no resource collection is running.
+    uint32_t rc_phase;
+    uint32_t rc_type;
+    int64_t rc_progress;
+    // Set by a memory-only writer spilling blocks to disk. Lookups are
+    // sampled for demoting cold data blocks.
+    uint32_t spill_in_use;
 } IndexHeader;
 
+// Offset of the value in a data buffer given the size field
+inline int DataHeaderSize(uint16_t size_field)
+{
+    return (size_field & DATA_SIZE_TTL_FLAG) ? DATA_HDR_BYTE + DATA_TTL_BYTE : DATA_HDR_BYTE;
+}
+
+// Size of a data buffer before alignment given the size field
+inline int DataBufferSize(uint16_t size_field)
+{
+    return (size_field & DATA_SIZE_MASK) + DataHeaderSize(size_field);
+}
+
 // An abstract interface class for Dict and DictMem
 class DRMBase {
 public:
@@ -125,10 +186,14 @@ public:
         free_lists = nullptr;
         if (opts & CONSTS::ACCESS_MODE_WRITER) {
             if (!(opts & CONSTS::OPTION_JEMALLOC)) {
+                // The free lists of a memory-only DB are not kept in files.
+                bool mem_only = opts & CONSTS::MEMORY_ONLY_MODE;
                 if (index) {
-                    free_lists = new FreeList(mbdir + "_ibfl", BUFFER_ALIGNMENT, NUM_BUFFER_RESERVE);
+                    free_lists = new FreeList(mem_only ? "" : mbdir + "_ibfl", BUFFER_ALIGNMENT,
+                        NUM_BUFFER_RESERVE);
                 } else {
-                    free_lists = new FreeList(mbdir + "_dbfl", BUFFER_ALIGNMENT, NUM_BUFFER_RESERVE);
+                    free_lists = new FreeList(mem_only ? "" : mbdir + "_dbfl", DATA_BUFFER_ALIGNMENT,
+                        NUM_DATA_BUFFER_RESERVE);
                 }
             }
         }
@@ -141,9 +206,11 @@ public:
     inline virtual void WriteData(const uint8_t* buff, unsigned len, size_t offset) const = 0;
     inline int Reserve(size_t& offset, int size, uint8_t*& ptr);
     inline uint8_t* GetShmPtr(size_t offset, int size) const;
+    inline void MarkDirty(size_t offset, int size) const;
     inline size_t CheckAlignment(size_t offset, int size) const;
     inline int ReadData(uint8_t* buff, unsigned len, size_t offset) const;
     inline size_t GetResourceCollectionOffset() const;
+    inline bool IsRCBuffer(size_t offset) const;
     inline void RemoveUnused(size_t max_size, bool writer_mode = false);
 
     FreeList* GetFreeList() const
@@ -156,6 +223,16 @@ public:
         return header;
     }
 
+    RollableFile* GetRollableFile() const
+    {
+        return kv_file;
+    }
+
+    DirtyTracker* GetDirtyTracker() const
+    {
+        return kv_file->GetDirtyTracker();
+    }
+
     void PrintHeader(std::ostream& out_stream) const;
 
     static void ValidateHeaderFile(const std::string& header_path, int mode, int queue_size,
@@ -222,6 +299,11 @@ inline uint8_t* DRMBase::GetShmPtr(size_t offset, int size) const
     return kv_file->GetShmPtr(offset, size);
 }
 
+inline void DRMBase::MarkDirty(size_t offset, int size) const
+{
+    kv_file->MarkDirty(offset, size);
+}
+
 inline size_t DRMBase::CheckAlignment(size_t offset, int size) const
 {
     return kv_file->CheckAlignment(offset, size);
@@ -241,6 +323,16 @@ inline size_t DRMBase::GetResourceCollectionOffset() const
     return kv_file->GetResourceCollectionOffset();
 }
 
+// Buffers of the rc tree are allocated above the resource collection offset.
+// They can be modified while the rc tree is in use, even after the index and
+// data offsets are reset in ResourceCollection::Finish, but must never be put
+// back into the free lists.
+inline bool DRMBase::IsRCBuffer(size_t offset) const
+{
+    return header->rc_root_offset.load(std::memory_order_relaxed) != 0
+        && offset >= kv_file->GetResourceCollectionOffset();
+}
+
 inline void DRMBase::RemoveUnused(size_t max_size, bool writer_mode)
 {
     return kv_file->RemoveUnused(max_size, writer_mode);
@@ -47,6 +47,8 @@ const char* MBError::error_str[] = {
     "rc skipped",
     "version mismatch",
     "jemalloc error",
+    "value mismatch",
+    "data being updated",
 
     ///////////////////////////////////
     "DB not exist",
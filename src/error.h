@@ -52,6 +52,8 @@ public:
         RC_SKIPPED = 22,
         VERSION_MISMATCH = 23,
         JEMALLOC_ERROR = 24,
+        VALUE_MISMATCH = 25,
+        DATA_UPDATING = 26,
 
         // NO_DB should be the last enum.
         NO_DB
@@ -0,0 +1,274 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "db.h"
+#include "error.h"
+#include "eviction_log.h"
+#include "logger.h"
+
+namespace mabain {
+
+// Each record is the uint16_t bucket index, the uint16_t key length and the key.
+#define EVICTION_RECORD_HDR_SIZE 4
+#define NUM_BUCKET_INDEX 0xFFFF
+
+EvictionLog::EvictionLog(const std::string& mbdir, IndexHeader* hdr)
+    : path_prefix(mbdir + EVICTION_LOG_FILE)
+    , header(hdr)
+{
+    if (header->evict_log_state == EVICTION_LOG_CLOSED) {
+        header->evict_log_state = EVICTION_LOG_ACTIVE;
+        Logger::Log(LOG_LEVEL_DEBUG, "opened eviction log with %llu bytes",
+            header->evict_log_tail - header->evict_log_head);
+    } else if (header->count == 0) {
+        Reset();
+    } else {
+        // The writer did not close the DB or the log was not maintained.
+        Invalidate();
+    }
+}
+
+EvictionLog::~EvictionLog()
+{
+    if (IsValid()) {
+        Flush();
+        header->evict_log_state = EVICTION_LOG_CLOSED;
+    }
+    for (auto& seg : segments)
+        close(seg.second);
+}
+
+bool EvictionLog::IsValid() const
+{
+    return header->evict_log_state == EVICTION_LOG_ACTIVE;
+}
+
+void EvictionLog::Append(uint16_t bucket, const uint8_t* key, int len)
+{
+    if (!IsValid())
+        return;
+
+    uint16_t key_len = static_cast<uint16_t>(len);
+    pending.append(reinterpret_cast<const char*>(&bucket), sizeof(bucket));
+    pending.append(reinterpret_cast<const char*>(&key_len), sizeof(key_len));
+    pending.append(reinterpret_cast<const char*>(key), len);
+    if (pending.size() >= EVICTION_LOG_BUFFER_SIZE)
+        Flush();
+}
+
+void EvictionLog::Flush()
+{
+    if (pending.empty() || !IsValid())
+        return;
+    if (WriteAt(header->evict_log_tail, pending.data(), pending.size()) != MBError::SUCCESS) {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to write eviction log");
+        Invalidate();
+        return;
+    }
+    header->evict_log_tail += pending.size();
+    pending.clear();
+}
+
+bool EvictionLog::Read(uint64_t& pos, uint16_t& bucket, std::string& key)
+{
+    uint8_t hdr[EVICTION_RECORD_HDR_SIZE];
+    uint16_t key_len;
+    if (pos + EVICTION_RECORD_HDR_SIZE > header->evict_log_tail)
+        return false;
+    if (ReadAt(pos, reinterpret_cast<char*>(hdr), EVICTION_RECORD_HDR_SIZE) != MBError::SUCCESS)
+        return false;
+    memcpy(&bucket, hdr, sizeof(bucket));
+    memcpy(&key_len, hdr + sizeof(bucket), sizeof(key_len));
+    if (pos + EVICTION_RECORD_HDR_SIZE + key_len > header->evict_log_tail)
+        return false;
+    key.resize(key_len);
+    if (ReadAt(pos + EVICTION_RECORD_HDR_SIZE, &key[0], key_len) != MBError::SUCCESS)
+        return false;
+    pos += EVICTION_RECORD_HDR_SIZE + key_len;
+    return true;
+}
+
+void EvictionLog::Advance(uint64_t pos)
+{
+    if (pos <= header->evict_log_head)
+        return;
+    RemoveSegments(header->evict_log_head / EVICTION_LOG_SEGMENT_SIZE,
+        pos / EVICTION_LOG_SEGMENT_SIZE);
+    header->evict_log_head = pos;
+}
+
+void EvictionLog::Reset()
+{
+    pending.clear();
+    RemoveSegments(header->evict_log_head / EVICTION_LOG_SEGMENT_SIZE,
+        header->evict_log_tail / EVICTION_LOG_SEGMENT_SIZE + 1);
+    header->evict_log_head = 0;
+    header->evict_log_tail = 0;
+    header->evict_log_state = EVICTION_LOG_ACTIVE;
+}
+
+void EvictionLog::Invalidate()
+{
+    header->evict_log_state = EVICTION_LOG_INVALID;
+    pending.clear();
+}
+
+int EvictionLog::Rebuild(const DB& db)
+{
+    Reset();
+    // Stay invalid until done
+    header->evict_log_state = EVICTION_LOG_INVALID;
+
+    // Size of the records in each bucket
+    std::vector<uint64_t> bucket_pos(NUM_BUCKET_INDEX, 0);
+    for (DB::iterator iter = db.begin(false); iter != db.end(); ++iter)
+        bucket_pos[iter.value.bucket_index % NUM_BUCKET_INDEX] += EVICTION_RECORD_HDR_SIZE + iter.key.size();
+
+    // Start of each bucket. Buckets are circular and the one after the
+    // current bucket is the oldest.
+    uint16_t curr = (header->num_update / header->entry_per_bucket) % NUM_BUCKET_INDEX;
+    std::vector<uint64_t> bucket_end(NUM_BUCKET_INDEX, 0);
+    uint64_t total = 0;
+    for (int i = 1; i <= NUM_BUCKET_INDEX; i++) {
+        int bucket = (curr + i) % NUM_BUCKET_INDEX;
+        uint64_t size = bucket_pos[bucket];
+        bucket_pos[bucket] = total;
+        total += size;
+        bucket_end[bucket] = total;
+    }
+
+    int rval = MBError::SUCCESS;
+    std::string record;
+    uint64_t count = 0;
+    for (DB::iterator iter = db.begin(false); iter != db.end(); ++iter) {
+        int bucket = iter.value.bucket_index % NUM_BUCKET_INDEX;
+        uint16_t bucket_index = iter.value.bucket_index;
+        uint16_t key_len = iter.key.size();
+        record.assign(reinterpret_cast<const char*>(&bucket_index), sizeof(bucket_index));
+        record.append(reinterpret_cast<const char*>(&key_len), sizeof(key_len));
+        record.append(iter.key);
+        if (bucket_pos[bucket] + record.size() > bucket_end[bucket]) {
+            rval = MBError::TRY_AGAIN;
+            break;
+        }
+        rval = WriteAt(bucket_pos[bucket], record.data(), record.size());
+        if (rval != MBError::SUCCESS)
+            break;
+        bucket_pos[bucket] += record.size();
+        count++;
+    }
+    if (rval != MBError::SUCCESS) {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to rebuild eviction log: %s",
+            MBError::get_error_str(rval));
+        Reset();
+        Invalidate();
+        return rval;
+    }
+
+    header->evict_log_tail = total;
+    header->evict_log_state = EVICTION_LOG_ACTIVE;
+    Logger::Log(LOG_LEVEL_INFO, "rebuilt eviction log with %llu entries", count);
+    return MBError::SUCCESS;
+}
+
+void EvictionLog::PrintStats(std::ostream& out_stream) const
+{
+    out_stream << "Eviction log: " << (IsValid() ? "valid" : "invalid") << std::endl;
+    out_stream << "\tSize: " << header->evict_log_tail - header->evict_log_head << std::endl;
+}
+
+/////////////////////////////////////////////////////////
+////////////////// Private Methods //////////////////////
+/////////////////////////////////////////////////////////
+
+int EvictionLog::GetSegment(uint64_t seg)
+{
+    auto it = segments.find(seg);
+    if (it != segments.end())
+        return it->second;
+
+    std::string path = path_prefix + std::to_string(seg);
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to open %s errno %d", path.c_str(), errno);
+        return -1;
+    }
+    segments[seg] = fd;
+    return fd;
+}
+
+void EvictionLog::RemoveSegments(uint64_t start, uint64_t end)
+{
+    for (uint64_t seg = start; seg < end; seg++) {
+        auto it = segments.find(seg);
+        if (it != segments.end()) {
+            close(it->second);
+            segments.erase(it);
+        }
+        std::string path = path_prefix + std::to_string(seg);
+        unlink(path.c_str());
+    }
+}
+
+int EvictionLog::WriteAt(uint64_t pos, const char* buff, size_t len)
+{
+    while (len > 0) {
+        uint64_t seg = pos / EVICTION_LOG_SEGMENT_SIZE;
+        uint64_t off = pos % EVICTION_LOG_SEGMENT_SIZE;
+        size_t size = len;
+        if (off + size > (uint64_t)EVICTION_LOG_SEGMENT_SIZE)
+            size = EVICTION_LOG_SEGMENT_SIZE - off;
+        int fd = GetSegment(seg);
+        if (fd < 0)
+            return MBError::OPEN_FAILURE;
+        if (pwrite(fd, buff, size, off) != (ssize_t)size)
+            return MBError::WRITE_ERROR;
+        pos += size;
+        buff += size;
+        len -= size;
+    }
+    return MBError::SUCCESS;
+}
+
+int EvictionLog::ReadAt(uint64_t pos, char* buff, size_t len)
+{
+    while (len > 0) {
+        uint64_t seg = pos / EVICTION_LOG_SEGMENT_SIZE;
+        uint64_t off = pos % EVICTION_LOG_SEGMENT_SIZE;
+        size_t size = len;
+        if (off + size > (uint64_t)EVICTION_LOG_SEGMENT_SIZE)
+            size = EVICTION_LOG_SEGMENT_SIZE - off;
+        int fd = GetSegment(seg);
+        if (fd < 0)
+            return MBError::OPEN_FAILURE;
+        if (pread(fd, buff, size, off) != (ssize_t)size)
+            return MBError::READ_ERROR;
+        pos += size;
+        buff += size;
+        len -= size;
+    }
+    return MBError::SUCCESS;
+}
+
+}
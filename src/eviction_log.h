@@ -0,0 +1,89 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __EVICTION_LOG_H__
+#define __EVICTION_LOG_H__
+
+#include <iostream>
+#include <map>
+#include <stdint.h>
+#include <string>
+
+#include "drm_base.h"
+
+namespace mabain {
+
+#define EVICTION_LOG_FILE "_mabain_e"
+// The log is a byte stream split into segment files of this size.
+#define EVICTION_LOG_SEGMENT_SIZE (16 * 1024 * 1024LL)
+#define EVICTION_LOG_BUFFER_SIZE (64 * 1024)
+
+// States of the log in the header
+#define EVICTION_LOG_INVALID 0
+#define EVICTION_LOG_ACTIVE 1
+#define EVICTION_LOG_CLOSED 2
+
+class DB;
+
+// Keys in the order of their bucket index for bucket eviction. A record with
+// the bucket index and the key is appended for every update. Since bucket
+// indexes are assigned in the order of updates, the oldest buckets are at
+// the head of the log and eviction only reads the records of the entries it
+// prunes. Records of keys that were removed or updated later are skipped by
+// comparing the bucket index with the one stored in the data buffer.
+//
+// The log is not synced. It is only valid if the previous writer closed the
+// DB, and otherwise rebuilt by Rebuild before the next eviction. No records
+// are appended while the log is invalid.
+class EvictionLog {
+public:
+    EvictionLog(const std::string& mbdir, IndexHeader* header);
+    ~EvictionLog();
+
+    bool IsValid() const;
+    void Append(uint16_t bucket, const uint8_t* key, int len);
+    void Flush();
+    // Read the record at pos and move pos to the next record. Returns false at
+    // the end of the log.
+    bool Read(uint64_t& pos, uint16_t& bucket, std::string& key);
+    // Records before pos are no longer needed.
+    void Advance(uint64_t pos);
+    // Drop all records. Called when all entries are removed.
+    void Reset();
+    void Invalidate();
+    // Rebuild the log by sorting the entries in db by bucket index. Called by
+    // the writer when no update can happen.
+    int Rebuild(const DB& db);
+    void PrintStats(std::ostream& out_stream) const;
+
+private:
+    int GetSegment(uint64_t seg);
+    void RemoveSegments(uint64_t start, uint64_t end);
+    int WriteAt(uint64_t pos, const char* buff, size_t len);
+    int ReadAt(uint64_t pos, char* buff, size_t len);
+
+    std::string path_prefix;
+    IndexHeader* header;
+    // file descriptors of the open segments
+    std::map<uint64_t, int> segments;
+    std::string pending;
+};
+
+}
+
+#endif
@@ -0,0 +1,351 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "db.h"
+#include "error.h"
+#include "expiry_log.h"
+#include "logger.h"
+
+namespace mabain {
+
+#define EXPIRY_LOG_MAGIC 0x4D425831
+// Each record is the uint32_t expiry time, the uint16_t key length and the key.
+#define EXPIRY_RECORD_HDR_SIZE 6
+#define EXPIRY_HEADER_CHUNK ((sizeof(ExpiryLogHeader) + EXPIRY_CHUNK_SIZE - 1) / EXPIRY_CHUNK_SIZE)
+#define EXPIRY_LOG_INIT_SIZE (EXPIRY_HEADER_CHUNK * EXPIRY_CHUNK_SIZE + EXPIRY_LOG_MIN_GROW)
+
+// Records are read from offset read and appended at offset used of the chunk
+// payload.
+typedef struct _ExpiryChunk {
+    uint32_t next;
+    uint16_t used;
+    uint16_t read;
+} ExpiryChunk;
+
+#define EXPIRY_CHUNK_PAYLOAD (EXPIRY_CHUNK_SIZE - sizeof(ExpiryChunk))
+
+ExpiryLog::ExpiryLog(const std::string& mbdir, IndexHeader* hdr, bool anonymous)
+    : path(mbdir + EXPIRY_LOG_FILE)
+    , header(hdr)
+    , fd(-1)
+    , addr(NULL)
+    , mapped_size(0)
+    , log_header(NULL)
+{
+    size_t size = EXPIRY_LOG_INIT_SIZE;
+    if (!anonymous) {
+        fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            Logger::Log(LOG_LEVEL_ERROR, "failed to open %s errno %d", path.c_str(), errno);
+            throw(int) MBError::OPEN_FAILURE;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && (size_t)st.st_size > size)
+            size = st.st_size - st.st_size % EXPIRY_CHUNK_SIZE;
+    }
+    int rval = Map(size);
+    if (rval != MBError::SUCCESS) {
+        if (fd >= 0)
+            close(fd);
+        throw rval;
+    }
+
+    if (header->expiry_log_state == EXPIRY_LOG_ACTIVE && log_header->magic == EXPIRY_LOG_MAGIC
+        && (size_t)log_header->num_chunk * EXPIRY_CHUNK_SIZE <= mapped_size) {
+        Logger::Log(LOG_LEVEL_DEBUG, "opened expiry log with %llu records", log_header->num_record);
+        return;
+    }
+
+    // The log was not maintained for the DB. It has to be rebuilt if the DB
+    // has entries with expiry time.
+    Reset();
+    if (header->ttl_in_use)
+        header->expiry_log_state = EXPIRY_LOG_INVALID;
+}
+
+ExpiryLog::~ExpiryLog()
+{
+    if (addr != NULL)
+        munmap(addr, mapped_size);
+    if (fd >= 0)
+        close(fd);
+}
+
+bool ExpiryLog::IsValid() const
+{
+    return header->expiry_log_state == EXPIRY_LOG_ACTIVE;
+}
+
+int ExpiryLog::Append(const uint8_t* key, int len, uint32_t expire_time)
+{
+    uint16_t key_len = static_cast<uint16_t>(len);
+    uint16_t rec_size = EXPIRY_RECORD_HDR_SIZE + key_len;
+    ExpiryBucket* bucket = &GetBucket(expire_time);
+    ExpiryChunk* chunk = NULL;
+    if (bucket->tail != 0)
+        chunk = reinterpret_cast<ExpiryChunk*>(GetChunk(bucket->tail));
+    if (chunk == NULL || chunk->used + rec_size > EXPIRY_CHUNK_PAYLOAD) {
+        uint32_t index = AllocChunk();
+        if (index == 0) {
+            // The entry is not removed when it expires until the log is rebuilt.
+            header->expiry_log_state = EXPIRY_LOG_INVALID;
+            return MBError::NO_RESOURCE;
+        }
+        // The log may be remapped by AllocChunk.
+        bucket = &GetBucket(expire_time);
+        if (bucket->tail != 0)
+            reinterpret_cast<ExpiryChunk*>(GetChunk(bucket->tail))->next = index;
+        else
+            bucket->head = index;
+        bucket->tail = index;
+        chunk = reinterpret_cast<ExpiryChunk*>(GetChunk(index));
+    }
+
+    uint8_t* rec = reinterpret_cast<uint8_t*>(chunk) + sizeof(ExpiryChunk) + chunk->used;
+    memcpy(rec, &expire_time, sizeof(expire_time));
+    memcpy(rec + sizeof(expire_time), &key_len, sizeof(key_len));
+    memcpy(rec + EXPIRY_RECORD_HDR_SIZE, key, key_len);
+    // The record is complete before it can be read.
+    std::atomic_signal_fence(std::memory_order_release);
+    chunk->used += rec_size;
+    log_header->num_record++;
+    return MBError::SUCCESS;
+}
+
+bool ExpiryLog::Peek(uint32_t now, uint32_t& expire_time, std::string& key)
+{
+    while (log_header->num_record > 0) {
+        ExpiryBucket& bucket = log_header->buckets[log_header->curr_time % EXPIRY_NUM_BUCKET];
+        if (bucket.head != 0) {
+            ExpiryChunk* chunk = reinterpret_cast<ExpiryChunk*>(GetChunk(bucket.head));
+            if (chunk->read < chunk->used) {
+                const uint8_t* rec = reinterpret_cast<uint8_t*>(chunk) + sizeof(ExpiryChunk) + chunk->read;
+                uint16_t key_len;
+                memcpy(&expire_time, rec, sizeof(expire_time));
+                memcpy(&key_len, rec + sizeof(expire_time), sizeof(key_len));
+                key.assign(reinterpret_cast<const char*>(rec + EXPIRY_RECORD_HDR_SIZE), key_len);
+                return true;
+            }
+            // Left by a writer that exited in Pop
+            ReleaseHead(bucket);
+            continue;
+        }
+        if (log_header->curr_time >= now)
+            return false;
+        log_header->curr_time++;
+    }
+
+    if (log_header->curr_time < now)
+        log_header->curr_time = now;
+    return false;
+}
+
+void ExpiryLog::Pop()
+{
+    ExpiryBucket& bucket = log_header->buckets[log_header->curr_time % EXPIRY_NUM_BUCKET];
+    ExpiryChunk* chunk = reinterpret_cast<ExpiryChunk*>(GetChunk(bucket.head));
+    uint16_t key_len;
+    memcpy(&key_len, reinterpret_cast<uint8_t*>(chunk) + sizeof(ExpiryChunk) + chunk->read
+            + sizeof(uint32_t),
+        sizeof(key_len));
+    chunk->read += EXPIRY_RECORD_HDR_SIZE + key_len;
+    if (log_header->num_record > 0)
+        log_header->num_record--;
+    if (chunk->read >= chunk->used)
+        ReleaseHead(bucket);
+}
+
+uint32_t ExpiryLog::NextExpire() const
+{
+    if (log_header->num_record == 0)
+        return 0;
+    uint32_t curr = log_header->curr_time;
+    for (uint32_t i = 0; i < EXPIRY_NUM_BUCKET; i++) {
+        if (log_header->buckets[(curr + i) % EXPIRY_NUM_BUCKET].head != 0)
+            return curr + i;
+    }
+    return 0;
+}
+
+void ExpiryLog::Reset()
+{
+    if (mapped_size > EXPIRY_LOG_INIT_SIZE && Map(EXPIRY_LOG_INIT_SIZE) != MBError::SUCCESS)
+        Logger::Log(LOG_LEVEL_WARN, "failed to shrink expiry log");
+    memset(log_header, 0, sizeof(ExpiryLogHeader));
+    log_header->curr_time = static_cast<uint32_t>(time(NULL));
+    log_header->num_chunk = EXPIRY_HEADER_CHUNK;
+    log_header->magic = EXPIRY_LOG_MAGIC;
+    header->expiry_log_state = EXPIRY_LOG_ACTIVE;
+}
+
+int ExpiryLog::Rebuild(const DB& db)
+{
+    Reset();
+    // Stay invalid until done
+    header->expiry_log_state = EXPIRY_LOG_INVALID;
+
+    int rval = MBError::SUCCESS;
+    uint64_t count = 0;
+    for (DB::iterator iter = db.begin(false, false, true); iter != db.end(); ++iter) {
+        if (iter.value.expire_time == 0)
+            continue;
+        rval = Append(reinterpret_cast<const uint8_t*>(iter.key.data()), iter.key.size(),
+            iter.value.expire_time);
+        if (rval != MBError::SUCCESS)
+            break;
+        count++;
+    }
+    if (rval != MBError::SUCCESS) {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to rebuild expiry log: %s",
+            MBError::get_error_str(rval));
+        header->expiry_log_state = EXPIRY_LOG_INVALID;
+        return rval;
+    }
+
+    header->expiry_log_state = EXPIRY_LOG_ACTIVE;
+    if (count == 0)
+        header->ttl_in_use = 0;
+    Logger::Log(LOG_LEVEL_INFO, "rebuilt expiry log with %llu entries", count);
+    return MBError::SUCCESS;
+}
+
+void ExpiryLog::Flush() const
+{
+    if (fd >= 0)
+        msync(addr, (size_t)log_header->num_chunk * EXPIRY_CHUNK_SIZE, MS_SYNC);
+}
+
+void ExpiryLog::PrintStats(std::ostream& out_stream) const
+{
+    out_stream << "Expiry log: " << (IsValid() ? "valid" : "invalid") << std::endl;
+    out_stream << "\tRecords: " << log_header->num_record << std::endl;
+    out_stream << "\tChunks: " << log_header->num_chunk - EXPIRY_HEADER_CHUNK << std::endl;
+}
+
+/////////////////////////////////////////////////////////
+////////////////// Private Methods //////////////////////
+/////////////////////////////////////////////////////////
+
+// Map the log with the given size. The log is remapped if it is already
+// mapped.
+int ExpiryLog::Map(size_t size)
+{
+    // The file is truncated after the mapping shrinks.
+    bool shrink = addr != NULL && size < mapped_size;
+    if (fd >= 0 && !shrink && ftruncate(fd, size) != 0) {
+        Logger::Log(LOG_LEVEL_ERROR, "cannot resize file %s: %d", path.c_str(), errno);
+        return MBError::WRITE_ERROR;
+    }
+
+    void* ptr;
+    if (addr == NULL) {
+        if (fd >= 0)
+            ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        else
+            ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    } else {
+        ptr = mremap(addr, mapped_size, size, MREMAP_MAYMOVE);
+    }
+    if (ptr == MAP_FAILED) {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to map expiry log %s with size %llu: %d",
+            path.c_str(), size, errno);
+        return MBError::MMAP_FAILED;
+    }
+
+    if (fd >= 0 && shrink && ftruncate(fd, size) != 0)
+        Logger::Log(LOG_LEVEL_WARN, "cannot resize file %s: %d", path.c_str(), errno);
+
+    addr = static_cast<uint8_t*>(ptr);
+    mapped_size = size;
+    log_header = reinterpret_cast<ExpiryLogHeader*>(addr);
+    return MBError::SUCCESS;
+}
+
+uint8_t* ExpiryLog::GetChunk(uint32_t index) const
+{
+    return addr + (size_t)index * EXPIRY_CHUNK_SIZE;
+}
+
+// Returns zero if no chunk can be allocated.
+uint32_t ExpiryLog::AllocChunk()
+{
+    uint32_t index = log_header->free_chunk;
+    if (index != 0) {
+        log_header->free_chunk = reinterpret_cast<ExpiryChunk*>(GetChunk(index))->next;
+    } else {
+        if ((size_t)(log_header->num_chunk + 1) * EXPIRY_CHUNK_SIZE > mapped_size) {
+            size_t grow = mapped_size / 2;
+            if (grow < EXPIRY_LOG_MIN_GROW)
+                grow = EXPIRY_LOG_MIN_GROW;
+            if (Map(mapped_size + grow - grow % EXPIRY_CHUNK_SIZE) != MBError::SUCCESS)
+                return 0;
+        }
+        index = log_header->num_chunk++;
+    }
+
+    ExpiryChunk* chunk = reinterpret_cast<ExpiryChunk*>(GetChunk(index));
+    chunk->next = 0;
+    chunk->used = 0;
+    chunk->read = 0;
+    return index;
+}
+
+void ExpiryLog::FreeChunk(uint32_t index)
+{
+    reinterpret_cast<ExpiryChunk*>(GetChunk(index))->next = log_header->free_chunk;
+    log_header->free_chunk = index;
+}
+
+// Remove the first chunk of the bucket after all its records are read. The
+// tail is cleared first so that a chunk is at most leaked but never reused
+// while it is still in the bucket if the writer exits in between.
+void ExpiryLog::ReleaseHead(ExpiryBucket& bucket)
+{
+    uint32_t index = bucket.head;
+    uint32_t next = reinterpret_cast<ExpiryChunk*>(GetChunk(index))->next;
+    if (next != 0) {
+        bucket.head = next;
+    } else {
+        bucket.tail = 0;
+        bucket.head = 0;
+    }
+    FreeChunk(index);
+}
+
+// Records expiring before the current bucket are added to the current bucket
+// and records expiring after the last bucket to the last bucket.
+ExpiryBucket& ExpiryLog::GetBucket(uint32_t expire_time) const
+{
+    uint32_t curr = log_header->curr_time;
+    if (expire_time < curr)
+        expire_time = curr;
+    else if (expire_time - curr >= EXPIRY_NUM_BUCKET)
+        expire_time = curr + EXPIRY_NUM_BUCKET - 1;
+    return log_header->buckets[expire_time % EXPIRY_NUM_BUCKET];
+}
+
+}
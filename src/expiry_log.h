@@ -0,0 +1,111 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __EXPIRY_LOG_H__
+#define __EXPIRY_LOG_H__
+
+#include <iostream>
+#include <stdint.h>
+#include <string>
+
+#include "drm_base.h"
+
+namespace mabain {
+
+#define EXPIRY_LOG_FILE "_mabain_x"
+// One bucket per second. Records expiring later than the last bucket are kept
+// in the last bucket and appended again when it is due.
+#define EXPIRY_NUM_BUCKET 65536
+#define EXPIRY_CHUNK_SIZE 4096
+#define EXPIRY_LOG_MIN_GROW (1024 * 1024LL)
+
+// States of the log in the header
+#define EXPIRY_LOG_INVALID 0
+#define EXPIRY_LOG_ACTIVE 1
+
+class DB;
+
+typedef struct _ExpiryBucket {
+    // chunk indexes of the first and last chunk; zero if empty
+    uint32_t head;
+    uint32_t tail;
+} ExpiryBucket;
+
+typedef struct _ExpiryLogHeader {
+    uint32_t magic;
+    // time of the first bucket that is not removed yet
+    uint32_t curr_time;
+    uint32_t num_chunk;
+    uint32_t free_chunk;
+    uint64_t num_record;
+    ExpiryBucket buckets[EXPIRY_NUM_BUCKET];
+} ExpiryLogHeader;
+
+// Keys of the entries with expiry time in buckets of their expiry time for
+// removing expired entries. The log is a timer wheel of EXPIRY_NUM_BUCKET
+// buckets in a memory-mapped file. Each bucket is a list of chunks holding
+// the expiry time and the key of the records. Records are appended before the
+// entry is added, so that the log has all entries with expiry time if the
+// writer exits abnormally. Records of keys that were removed or updated later
+// are skipped by comparing the expiry time with the one stored in the data
+// buffer.
+//
+// The writer opens the log without reading the DB. The log is rebuilt only if
+// the DB has entries with expiry time and the log was not maintained, e.g.
+// when the file is missing. The log is not backed by a file in memory-only or
+// jemalloc mode.
+class ExpiryLog {
+public:
+    ExpiryLog(const std::string& mbdir, IndexHeader* header, bool anonymous);
+    ~ExpiryLog();
+
+    bool IsValid() const;
+    int Append(const uint8_t* key, int len, uint32_t expire_time);
+    // Get the first record in the buckets that are due at now. The record
+    // is removed by Pop.
+    bool Peek(uint32_t now, uint32_t& expire_time, std::string& key);
+    void Pop();
+    // Time of the first bucket with records; zero if the log is empty.
+    uint32_t NextExpire() const;
+    // Drop all records. Called when all entries are removed.
+    void Reset();
+    // Rebuild the log if it was not maintained. Called by the writer when no
+    // update can happen.
+    int Rebuild(const DB& db);
+    void Flush() const;
+    void PrintStats(std::ostream& out_stream) const;
+
+private:
+    int Map(size_t size);
+    uint8_t* GetChunk(uint32_t index) const;
+    uint32_t AllocChunk();
+    void FreeChunk(uint32_t index);
+    void ReleaseHead(ExpiryBucket& bucket);
+    ExpiryBucket& GetBucket(uint32_t expire_time) const;
+
+    std::string path;
+    IndexHeader* header;
+    int fd;
+    uint8_t* addr;
+    size_t mapped_size;
+    ExpiryLogHeader* log_header;
+};
+
+}
+
+#endif
@@ -41,7 +41,7 @@ FileIO::~FileIO()
 int FileIO::Open()
 {
     mode_t prev_mask = umask(0);
-    fd = open(path.c_str(), options, mode);
+    fd = open(path.c_str(), options & ~MMAP_MODE_MASK, mode);
     umask(prev_mask);
 
     return fd;
@@ -115,9 +115,9 @@ size_t FileIO::RandomRead(void* buff, size_t size, off_t offset)
     return bytes_read;
 }
 
-void* FileIO::MapFile(size_t size, int prot, int flags, off_t offset)
+void* FileIO::MapFile(size_t size, int prot, int flags, off_t offset, void* start)
 {
-    return mmap(NULL, size, prot, flags, fd, offset);
+    return mmap(start, size, prot, flags, fd, offset);
 }
 
 off_t FileIO::SetOffset(off_t offset)
@@ -138,6 +138,11 @@ bool FileIO::IsOpen() const
     return fd > 0;
 }
 
+int FileIO::GetFd() const
+{
+    return fd;
+}
+
 int FileIO::TruncateFile(off_t filesize)
 {
     if (fd > 0)
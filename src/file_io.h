@@ -30,6 +30,9 @@
 namespace mabain {
 
 #define MMAP_ANONYMOUS_MODE 0x80000000 // This bit should not be used in fcntl.h.
+#define MMAP_HUGETLB_MODE 0x40000000 // Same as above
+#define MMAP_HUGE_ADVISE_MODE 0x20000000 // Same as above
+#define MMAP_MODE_MASK (MMAP_ANONYMOUS_MODE | MMAP_HUGETLB_MODE | MMAP_HUGE_ADVISE_MODE)
 
 // This is the basic file io class
 class FileIO {
@@ -40,6 +43,7 @@ public:
     int Open();
     int TruncateFile(off_t filesize);
     bool IsOpen() const;
+    int GetFd() const;
     void Close();
 
     size_t Write(const void* data, size_t bytes);
@@ -57,7 +61,7 @@ protected:
     int options;
     bool sync_on_write;
 
-    void* MapFile(size_t size, int prot, int flags, off_t offset);
+    void* MapFile(size_t size, int prot, int flags, off_t offset, void* start = NULL);
 
 private:
     int mode;
@@ -18,204 +18,379 @@
 
 #include <assert.h>
 #include <errno.h>
-#include <iostream>
+#include <fcntl.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "error.h"
 #include "free_list.h"
-#include "lock_free.h"
 #include "logger.h"
 
 namespace mabain {
 
-FreeList::FreeList(const std::string& file_path, size_t buff_alignment,
-    size_t max_n_buff, size_t max_buff_per_list)
+#define FREE_LIST_HEADER_SIZE 64
+#define FREE_LIST_PAGE_SIZE 4096
+
+FreeList::FreeList(const std::string& file_path, size_t buff_alignment, size_t max_n_buff)
     : list_path(file_path)
+    , fd(-1)
     , alignment(buff_alignment)
     , max_num_buffer(max_n_buff)
-    , max_buffer_per_list(max_buff_per_list)
-    , buffer_free_list(NULL)
-    , count(0)
-    , tot_size(0)
+    , addr(NULL)
+    , map_size(0)
+    , header(NULL)
+    , classes(NULL)
+    , class_map(NULL)
+    , summary_map(NULL)
+    , chunk_base(NULL)
 {
     // rel_parent_off in ResourceCollection is defined as 2-byte signed integer.
     // The maximal buffer size cannot be greather than 32767.
     assert(GetBufferSizeByIndex(max_n_buff - 1) <= 65535);
+    assert(sizeof(FreeListHeader) <= FREE_LIST_HEADER_SIZE);
+
+    size_t num_word = (max_num_buffer + 63) / 64;
+    meta_size = FREE_LIST_HEADER_SIZE + max_num_buffer * sizeof(FreeListClass)
+        + (num_word + (num_word + 63) / 64) * sizeof(uint64_t);
+    meta_size = (meta_size + FREE_LIST_PAGE_SIZE - 1) & ~(size_t)(FREE_LIST_PAGE_SIZE - 1);
 
     Logger::Log(LOG_LEVEL_DEBUG, "%s maximum number of buffers: %d", file_path.c_str(),
         max_num_buffer);
-    buffer_free_list = new MBlsq*[max_num_buffer];
-    for (size_t i = 0; i < max_num_buffer; i++) {
-        buffer_free_list[i] = new MBlsq(NULL);
+
+    bool reuse = false;
+    if (!list_path.empty()) {
+        fd = open(list_path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            Logger::Log(LOG_LEVEL_ERROR, "cannot open file %s: %d", list_path.c_str(), errno);
+            throw(int) MBError::OPEN_FAILURE;
+        }
+        reuse = CheckListFile(fd);
+        if (!reuse && ftruncate(fd, 0) != 0) {
+            Logger::Log(LOG_LEVEL_ERROR, "cannot truncate file %s: %d", list_path.c_str(), errno);
+            close(fd);
+            throw(int) MBError::WRITE_ERROR;
+        }
     }
+
+    struct stat st;
+    size_t size = ListSize(FREE_LIST_MIN_CHUNKS);
+    if (reuse && fstat(fd, &st) == 0)
+        size = st.st_size;
+    if (MapList(size) != MBError::SUCCESS) {
+        if (fd >= 0)
+            close(fd);
+        throw(int) MBError::MMAP_FAILED;
+    }
+
+    if (reuse) {
+        Logger::Log(LOG_LEVEL_DEBUG, "%s opened with %lld buffers: %llu", list_path.c_str(),
+            header->count, header->tot_size);
+    } else {
+        InitList();
+    }
+
+    // The buffers in the list are not used if the writer exits without
+    // closing the list.
+    header->state = FREE_LIST_ACTIVE;
+    if (fd >= 0 && msync(addr, FREE_LIST_PAGE_SIZE, MS_SYNC) != 0)
+        Logger::Log(LOG_LEVEL_WARN, "msync %s failed errno=%d", list_path.c_str(), errno);
 }
 
 FreeList::~FreeList()
 {
-    if (buffer_free_list) {
-        for (size_t i = 0; i < max_num_buffer; i++) {
-            if (buffer_free_list[i]) {
-                while (buffer_free_list[i]->Count())
-                    buffer_free_list[i]->RemoveIntFromHead();
-                delete buffer_free_list[i];
-            }
+    if (addr == NULL)
+        return;
+
+    if (fd >= 0) {
+        if (msync(addr, map_size, MS_SYNC) == 0) {
+            header->state = FREE_LIST_CLOSED;
+            msync(addr, FREE_LIST_PAGE_SIZE, MS_SYNC);
+        } else {
+            Logger::Log(LOG_LEVEL_WARN, "msync %s failed errno=%d", list_path.c_str(), errno);
         }
-        delete[] buffer_free_list;
     }
+    munmap(addr, map_size);
+    if (fd >= 0)
+        close(fd);
 }
 
-int FreeList::ReuseBuffer(size_t buf_index, size_t offset)
+size_t FreeList::ListSize(uint32_t max_chunk) const
 {
-    int rval = MBError::BUFFER_LOST;
-    for (size_t i = buf_index - 1; i > 0; i--) {
-        if (buffer_free_list[i]->Count() > max_buffer_per_list)
-            continue;
-
-        if (buffer_free_list[i]->AddIntToTail(offset) == MBError::SUCCESS) {
-            count++;
-            tot_size += (i + 1) * alignment;
-            rval = MBError::SUCCESS;
-        }
-        break;
+    return meta_size + (size_t)max_chunk * FREE_LIST_CHUNK_SIZE;
+}
+
+// Check if the list file was closed by the previous writer with the same
+// alignment and number of size classes.
+bool FreeList::CheckListFile(int list_fd) const
+{
+    FreeListHeader hdr;
+    struct stat st;
+    if (fstat(list_fd, &st) != 0 || (size_t)st.st_size < ListSize(0))
+        return false;
+    if (pread(list_fd, &hdr, sizeof(hdr), 0) != sizeof(hdr))
+        return false;
+    if (hdr.version != FREE_LIST_VERSION || hdr.state != FREE_LIST_CLOSED)
+        return false;
+    if (hdr.alignment != alignment || hdr.num_class != max_num_buffer)
+        return false;
+    return hdr.num_chunk <= hdr.max_chunk && ListSize(hdr.max_chunk) == (size_t)st.st_size;
+}
+
+// Map the list with the given size. The list is remapped if it is already
+// mapped.
+int FreeList::MapList(size_t size)
+{
+    // The file is truncated after the mapping shrinks.
+    bool shrink = addr != NULL && size < map_size;
+    if (fd >= 0 && !shrink && ftruncate(fd, size) != 0) {
+        Logger::Log(LOG_LEVEL_ERROR, "cannot resize file %s: %d", list_path.c_str(), errno);
+        return MBError::WRITE_ERROR;
     }
 
-    return rval;
+    void* ptr;
+    if (addr == NULL) {
+        if (fd >= 0)
+            ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        else
+            ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    } else {
+        ptr = mremap(addr, map_size, size, MREMAP_MAYMOVE);
+    }
+    if (ptr == MAP_FAILED) {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to map free list %s with size %llu: %d",
+            list_path.c_str(), size, errno);
+        return MBError::MMAP_FAILED;
+    }
+
+    if (fd >= 0 && shrink && ftruncate(fd, size) != 0)
+        Logger::Log(LOG_LEVEL_WARN, "cannot resize file %s: %d", list_path.c_str(), errno);
+
+    addr = static_cast<uint8_t*>(ptr);
+    map_size = size;
+    header = reinterpret_cast<FreeListHeader*>(addr);
+    classes = reinterpret_cast<FreeListClass*>(addr + FREE_LIST_HEADER_SIZE);
+    class_map = reinterpret_cast<uint64_t*>(classes + max_num_buffer);
+    summary_map = class_map + (max_num_buffer + 63) / 64;
+    chunk_base = addr + meta_size;
+    return MBError::SUCCESS;
 }
 
-int FreeList::AddBuffer(size_t offset, size_t size)
+// Initialize a newly created list. Everything else is zero.
+void FreeList::InitList()
 {
-    int rval = MBError::SUCCESS;
+    header->version = FREE_LIST_VERSION;
+    header->alignment = alignment;
+    header->num_class = max_num_buffer;
+    header->max_chunk = (map_size - meta_size) / FREE_LIST_CHUNK_SIZE;
+}
 
-    size_t buf_index = GetBufferIndex(size);
+uint32_t FreeList::AllocChunk()
+{
+    uint32_t chunk = header->free_chunk;
+    if (chunk != 0) {
+        uint64_t* ptr = ChunkPtr(chunk);
+        header->free_chunk = ptr[0];
+        ptr[0] = 0;
+        return chunk;
+    }
+
+    if (header->num_chunk == header->max_chunk) {
+        uint32_t max_chunk = header->max_chunk * 2;
+        if (max_chunk <= header->max_chunk || MapList(ListSize(max_chunk)) != MBError::SUCCESS)
+            return 0;
+        header->max_chunk = max_chunk;
+    }
+    chunk = ++header->num_chunk;
+    ChunkPtr(chunk)[0] = 0;
+    return chunk;
+}
+
+void FreeList::FreeChunk(uint32_t chunk)
+{
+    ChunkPtr(chunk)[0] = header->free_chunk;
+    header->free_chunk = chunk;
+}
+
+int FreeList::Push(size_t buf_index, size_t offset)
+{
+    FreeListClass* fc = &classes[buf_index];
+    if (fc->tail == 0 || fc->tail_pos == FREE_LIST_CHUNK_SLOTS) {
+        uint32_t chunk = AllocChunk();
+        if (chunk == 0) {
+            Logger::Log(LOG_LEVEL_ERROR, "%s failed to add buffer %llu", list_path.c_str(), offset);
+            return MBError::BUFFER_LOST;
+        }
+        // The list may have been remapped.
+        fc = &classes[buf_index];
+        if (fc->tail == 0) {
+            fc->head = chunk;
+            fc->head_pos = 0;
+        } else {
+            ChunkPtr(fc->tail)[0] = chunk;
+        }
+        fc->tail = chunk;
+        fc->tail_pos = 0;
+    }
+
+    ChunkPtr(fc->tail)[1 + fc->tail_pos++] = offset;
+    if (fc->count++ == 0) {
+        class_map[buf_index / 64] |= 1ULL << (buf_index % 64);
+        summary_map[buf_index / 4096] |= 1ULL << ((buf_index / 64) % 64);
+    }
+    header->count++;
+    header->tot_size += (buf_index + 1) * alignment;
+    return MBError::SUCCESS;
+}
+
+size_t FreeList::Pop(size_t buf_index)
+{
+    FreeListClass* fc = &classes[buf_index];
 #ifdef __DEBUG__
-    assert(buf_index < max_num_buffer);
+    assert(fc->count > 0);
 #endif
+    uint64_t* chunk = ChunkPtr(fc->head);
+    size_t offset = chunk[1 + fc->head_pos++];
+    header->count--;
+    header->tot_size -= (buf_index + 1) * alignment;
+
+    if (--fc->count == 0) {
+        FreeChunk(fc->head);
+        memset(fc, 0, sizeof(*fc));
+        class_map[buf_index / 64] &= ~(1ULL << (buf_index % 64));
+        if (class_map[buf_index / 64] == 0)
+            summary_map[buf_index / 4096] &= ~(1ULL << ((buf_index / 64) % 64));
+    } else if (fc->head_pos == FREE_LIST_CHUNK_SLOTS) {
+        uint32_t next = chunk[0];
+        FreeChunk(fc->head);
+        fc->head = next;
+        fc->head_pos = 0;
+    }
+    return offset;
+}
 
-    if (buffer_free_list[buf_index]->Count() > (unsigned)max_buffer_per_list) {
-        ReuseBuffer(buf_index, offset);
-        return rval;
+size_t FreeList::FindClass(size_t buf_index) const
+{
+    size_t num_word = (max_num_buffer + 63) / 64;
+    size_t word = buf_index / 64;
+    if (word >= num_word)
+        return max_num_buffer;
+    uint64_t bits = class_map[word] & (~0ULL << (buf_index % 64));
+    if (bits != 0)
+        return word * 64 + __builtin_ctzll(bits);
+
+    // Look up the next bitmap word with free buffers in the summary.
+    word++;
+    size_t num_summary = (num_word + 63) / 64;
+    size_t sword = word / 64;
+    if (sword >= num_summary)
+        return max_num_buffer;
+    bits = summary_map[sword] & (~0ULL << (word % 64));
+    while (bits == 0) {
+        if (++sword >= num_summary)
+            return max_num_buffer;
+        bits = summary_map[sword];
     }
+    word = sword * 64 + __builtin_ctzll(bits);
+    return word * 64 + __builtin_ctzll(class_map[word]);
+}
 
-    buffer_free_list[buf_index]->AddIntToTail(offset);
-    count++;
-    tot_size += (buf_index + 1) * alignment;
-    return rval;
+int FreeList::AddBuffer(size_t offset, size_t size)
+{
+    return AddBufferByIndex(GetBufferIndex(size), offset);
 }
 
 int FreeList::RemoveBuffer(size_t& offset, size_t size)
 {
-    int rval = MBError::NO_MEMORY;
-
     size_t buf_index = GetBufferIndex(size);
-    if (buffer_free_list[buf_index]->Count() > 0) {
-        offset = buffer_free_list[buf_index]->RemoveIntFromHead();
-        rval = MBError::SUCCESS;
-        count--;
-        tot_size -= (buf_index + 1) * alignment;
-    }
+    if (buf_index >= max_num_buffer || classes[buf_index].count == 0)
+        return MBError::NO_MEMORY;
 
-    return rval;
+    offset = Pop(buf_index);
+    return MBError::SUCCESS;
 }
 
 size_t FreeList::GetTotSize() const
 {
-    return tot_size;
+    return header->tot_size;
 }
 
 int64_t FreeList::Count() const
 {
-    return count;
+    return header->count;
 }
 
-int FreeList::StoreListOnDisk()
+uint32_t FreeList::GetChunkCount() const
 {
-    if (buffer_free_list == NULL)
-        return MBError::NOT_ALLOWED;
-
-    int rval = MBError::SUCCESS;
-
-    if (count == 0)
-        return rval;
+    return header->num_chunk;
+}
 
-    std::ofstream freelist_f(list_path.c_str(), std::fstream::out | std::fstream::binary);
-    if (!freelist_f.is_open()) {
-        Logger::Log(LOG_LEVEL_ERROR, "cannot open file " + list_path);
+int FreeList::Dump(const std::string& file_path) const
+{
+    int dump_fd = open(file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (dump_fd < 0) {
+        Logger::Log(LOG_LEVEL_ERROR, "cannot open file %s: %d", file_path.c_str(), errno);
         return MBError::OPEN_FAILURE;
     }
 
-    Logger::Log(LOG_LEVEL_DEBUG, "%s write %lld buffers to list disk: %llu", list_path.c_str(),
-        count, tot_size);
-    for (size_t buf_index = 0; buf_index < max_num_buffer; buf_index++) {
-        int64_t buf_count = buffer_free_list[buf_index]->Count();
-        if (buf_count > 0) {
-            // write list header (buffer index, buffer count)
-            freelist_f.write((char*)&buf_index, sizeof(size_t));
-            freelist_f.write((char*)&buf_count, sizeof(int64_t));
-            for (int64_t i = 0; i < buf_count; i++) {
-                size_t offset = buffer_free_list[buf_index]->RemoveIntFromHead();
-                freelist_f.write((char*)&offset, sizeof(size_t));
-                count--;
-                tot_size -= (buf_index + 1) * alignment;
-            }
-        }
+    // The list in the file is closed so that it is used when the file is opened.
+    FreeListHeader hdr = *header;
+    hdr.state = FREE_LIST_CLOSED;
+    int rval = MBError::SUCCESS;
+    size_t off = sizeof(hdr);
+    if (pwrite(dump_fd, &hdr, sizeof(hdr), 0) != sizeof(hdr))
+        rval = MBError::WRITE_ERROR;
+    while (rval == MBError::SUCCESS && off < map_size) {
+        ssize_t len = pwrite(dump_fd, addr + off, map_size - off, off);
+        if (len <= 0)
+            rval = MBError::WRITE_ERROR;
+        else
+            off += len;
     }
-
-    freelist_f.close();
-
+    if (rval != MBError::SUCCESS)
+        Logger::Log(LOG_LEVEL_ERROR, "cannot write file %s: %d", file_path.c_str(), errno);
+    close(dump_fd);
     return rval;
 }
 
-int FreeList::LoadListFromDisk()
+int FreeList::Load(const std::string& file_path)
 {
-    if (buffer_free_list == NULL)
-        return MBError::NOT_ALLOWED;
-
-    if (access(list_path.c_str(), F_OK) != 0) {
-        if (errno == ENOENT) {
-            Logger::Log(LOG_LEVEL_INFO, list_path + " does not exist");
-            return MBError::SUCCESS;
-        }
-
-        Logger::Log(LOG_LEVEL_ERROR, "cannot access %s with full permission: %d",
-            list_path.c_str(), errno);
-        return MBError::NOT_ALLOWED;
+    int load_fd = open(file_path.c_str(), O_RDONLY);
+    if (load_fd < 0) {
+        Logger::Log(LOG_LEVEL_ERROR, "cannot open file %s: %d", file_path.c_str(), errno);
+        return MBError::OPEN_FAILURE;
     }
 
-    // Read the file
-    std::ifstream freelist_f(list_path.c_str(), std::fstream::in | std::fstream::binary);
-    if (!freelist_f.is_open())
-        return MBError::OPEN_FAILURE;
+    struct stat st;
+    int rval = MBError::SUCCESS;
+    if (!CheckListFile(load_fd) || fstat(load_fd, &st) != 0) {
+        Logger::Log(LOG_LEVEL_ERROR, "free list file %s does not match", file_path.c_str());
+        rval = MBError::INVALID_SIZE;
+    } else {
+        rval = MapList(st.st_size);
+    }
 
-    while (!freelist_f.eof()) {
-        size_t buf_index;
-        int64_t buf_count;
-        // Read header
-        freelist_f.read((char*)&buf_index, sizeof(size_t));
-        freelist_f.read((char*)&buf_count, sizeof(int64_t));
-        if (freelist_f.eof())
-            break;
-        for (int64_t i = 0; i < buf_count; i++) {
-            size_t offset;
-            freelist_f.read((char*)&offset, sizeof(size_t));
-            buffer_free_list[buf_index]->AddIntToTail(offset);
-            count++;
-            tot_size += (buf_index + 1) * alignment;
+    size_t off = 0;
+    while (rval == MBError::SUCCESS && off < map_size) {
+        ssize_t len = pread(load_fd, addr + off, map_size - off, off);
+        if (len <= 0) {
+            Logger::Log(LOG_LEVEL_ERROR, "cannot read file %s: %d", file_path.c_str(), errno);
+            rval = MBError::READ_ERROR;
+        } else {
+            off += len;
         }
     }
+    close(load_fd);
 
-    freelist_f.close();
-
-    // Remove the file
-    if (unlink(list_path.c_str()) != 0) {
-        Logger::Log(LOG_LEVEL_ERROR, "failed to delete file %s: %d ",
-            list_path.c_str(), errno);
-        return MBError::WRITE_ERROR;
+    if (rval != MBError::SUCCESS) {
+        if (addr != NULL)
+            Empty();
+        return rval;
     }
-
-    Logger::Log(LOG_LEVEL_DEBUG, "%s read %lld buffers to free list: %llu",
-        list_path.c_str(), count, tot_size);
-
+    header->state = FREE_LIST_ACTIVE;
+    Logger::Log(LOG_LEVEL_DEBUG, "%s loaded with %lld buffers: %llu", file_path.c_str(),
+        header->count, header->tot_size);
     return MBError::SUCCESS;
 }
 
@@ -231,29 +406,47 @@ void FreeList::ReleaseAlignmentBuffer(size_t old_offset, size_t alignment_offset
 
 void FreeList::Empty()
 {
-    for (size_t i = 0; i < max_num_buffer; i++) {
-        if (buffer_free_list[i]) {
-            buffer_free_list[i]->Clear();
+    // Only the classes with free buffers need to be cleared.
+    size_t num_word = (max_num_buffer + 63) / 64;
+    for (size_t word = 0; word < num_word; word++) {
+        uint64_t bits = class_map[word];
+        while (bits != 0) {
+            size_t buf_index = word * 64 + __builtin_ctzll(bits);
+            memset(&classes[buf_index], 0, sizeof(FreeListClass));
+            bits &= bits - 1;
         }
+        class_map[word] = 0;
+    }
+    memset(summary_map, 0, (num_word + 63) / 64 * sizeof(uint64_t));
+
+    header->count = 0;
+    header->tot_size = 0;
+    header->num_chunk = 0;
+    header->free_chunk = 0;
+    // Give back the chunks added when the list grew.
+    if (header->max_chunk > FREE_LIST_MIN_CHUNKS
+        && MapList(ListSize(FREE_LIST_MIN_CHUNKS)) == MBError::SUCCESS) {
+        header->max_chunk = FREE_LIST_MIN_CHUNKS;
     }
-    count = 0;
-    tot_size = 0;
 }
 
 bool FreeList::GetBufferByIndex(size_t buf_index, size_t& offset)
 {
-#ifdef __DEBUG__
-    assert(buf_index < max_num_buffer);
-#endif
-    MBlsq* flist = buffer_free_list[buf_index];
-    if (flist->Count() > 0) {
-        offset = flist->RemoveIntFromHead();
-        count--;
-        tot_size -= (buf_index + 1) * alignment;
+    if (buf_index >= max_num_buffer)
+        return false;
+    if (classes[buf_index].count > 0) {
+        offset = Pop(buf_index);
         return true;
     }
 
-    return false;
+    // Split the smallest larger buffer that leaves at least FREE_LIST_MIN_SPLIT
+    // bytes. The rest of it is added back to its size class.
+    size_t split_index = FindClass(buf_index + (FREE_LIST_MIN_SPLIT + alignment - 1) / alignment);
+    if (split_index >= max_num_buffer)
+        return false;
+    offset = Pop(split_index);
+    AddBufferByIndex(split_index - buf_index - 1, offset + GetBufferSizeByIndex(buf_index));
+    return true;
 }
 
 }
@@ -21,15 +21,24 @@
 
 #include <cassert>
 #include <cstdlib>
+#include <stdint.h>
 #include <string>
 
 #include "error.h"
-#include "lock_free.h"
-#include "mb_lsq.h"
 
-#define MAX_BUFFER_PER_LIST 256
+// Each chunk holds the offsets of up to FREE_LIST_CHUNK_SLOTS free buffers.
+#define FREE_LIST_CHUNK_SIZE 512
+#define FREE_LIST_CHUNK_SLOTS (FREE_LIST_CHUNK_SIZE / 8 - 1)
+#define FREE_LIST_MIN_CHUNKS 2048
+// A larger free buffer is split only if the part left is at least this size.
+#define FREE_LIST_MIN_SPLIT 16
+#define FREE_LIST_VERSION 1
 
-// Manage resource allocation/free using linked list
+// States of the list file
+#define FREE_LIST_ACTIVE 1
+#define FREE_LIST_CLOSED 2
+
+// Manage resource allocation/free using segregated size classes
 namespace mabain {
 
 typedef struct _BufferCache {
@@ -37,10 +46,40 @@ typedef struct _BufferCache {
     size_t buf_offset;
 } BufferCache;
 
+typedef struct _FreeListHeader {
+    uint32_t version;
+    uint32_t state;
+    uint64_t alignment;
+    uint64_t num_class;
+    int64_t count;
+    uint64_t tot_size;
+    // number of chunks used and mapped
+    uint32_t num_chunk;
+    uint32_t max_chunk;
+    // head of the unused chunks
+    uint32_t free_chunk;
+} FreeListHeader;
+
+// Free buffers of a size class in FIFO order. Chunk ids start from 1.
+typedef struct _FreeListClass {
+    uint32_t head;
+    uint32_t tail;
+    uint16_t head_pos;
+    uint16_t tail_pos;
+    uint64_t count;
+} FreeListClass;
+
+// Free buffers are kept in one list per size class. The lists, a bitmap of
+// the classes that are not empty and the counters are in a memory-mapped
+// file, so that nothing is loaded or stored when the writer opens or closes
+// the DB. The file is only used if the previous writer closed it. Adding and
+// removing a buffer takes constant time and the number of buffers in a list
+// is not limited. If the class of a reserved size is empty, the smallest
+// larger buffer is split and the rest of it is added back.
 class FreeList {
 public:
-    FreeList(const std::string& file_path, size_t buff_alignment, size_t max_n_buff,
-        size_t max_buff_per_list = MAX_BUFFER_PER_LIST);
+    // The list is kept in anonymous memory if file_path is empty.
+    FreeList(const std::string& file_path, size_t buff_alignment, size_t max_n_buff);
     ~FreeList();
 
     // Free a buffer by adding it to the free list
@@ -50,18 +89,23 @@ public:
     // Release alignment buffer
     void ReleaseAlignmentBuffer(size_t old_offset, size_t alignment_offset);
 
+    // Reserve a buffer of the size class. A larger buffer is split if
+    // there is no free buffer in the class.
     bool GetBufferByIndex(size_t buf_index, size_t& offset);
 
     void Empty();
 
-    // Read buffer list from disk
-    int LoadListFromDisk();
-    // Save buffer list to disk
-    int StoreListOnDisk();
     // Get buffer count
     int64_t Count() const;
     // Get total freed buffer size in the list
     size_t GetTotSize() const;
+    // Get number of chunks used to store the buffer offsets
+    uint32_t GetChunkCount() const;
+
+    // Write the list to a file in the format of a closed list file, and
+    // replace the list with the one in such a file.
+    int Dump(const std::string& file_path) const;
+    int Load(const std::string& file_path);
 
     inline int AddBufferByIndex(size_t buf_index, size_t offset);
     inline size_t RemoveBufferByIndex(size_t buf_index);
@@ -72,23 +116,36 @@ public:
     inline int ReleaseBuffer(size_t offset, size_t size);
 
 private:
-    int ReuseBuffer(size_t buf_index, size_t offset);
-
-    // file path where the list will be serialized and stored
+    int MapList(size_t size);
+    void InitList();
+    int Push(size_t buf_index, size_t offset);
+    size_t Pop(size_t buf_index);
+    uint32_t AllocChunk();
+    void FreeChunk(uint32_t chunk);
+    inline uint64_t* ChunkPtr(uint32_t chunk) const;
+    // Find the first size class not smaller than buf_index with free buffers.
+    // Returns max_num_buffer if there is none.
+    size_t FindClass(size_t buf_index) const;
+    size_t ListSize(uint32_t max_chunk) const;
+    bool CheckListFile(int list_fd) const;
+
+    // file path where the list is mapped
     std::string list_path;
+    int fd;
     // buffer/memory alignment
     size_t alignment;
     // maximum number of buffers
     size_t max_num_buffer;
-    // maximum buffer per list
-    // This restriction is to limit memory usage.
-    size_t max_buffer_per_list;
-    // number of separated buffers
-    MBlsq** buffer_free_list;
-    // total count of freed buffers
-    int64_t count;
-    // totol size allocted for all the buffers
-    size_t tot_size;
+    uint8_t* addr;
+    size_t map_size;
+    // size of the header, the classes and the bitmaps
+    size_t meta_size;
+    FreeListHeader* header;
+    FreeListClass* classes;
+    // One bit for each class and one summary bit for each bitmap word
+    uint64_t* class_map;
+    uint64_t* summary_map;
+    uint8_t* chunk_base;
 };
 
 inline size_t FreeList::GetAlignmentSize(size_t size) const
@@ -115,7 +172,7 @@ inline uint64_t FreeList::GetBufferCountByIndex(size_t buf_index) const
 #ifdef __DEBUG__
     assert(buf_index < max_num_buffer);
 #endif
-    return buffer_free_list[buf_index]->Count();
+    return classes[buf_index].count;
 }
 
 inline size_t FreeList::GetBufferSizeByIndex(size_t buf_index) const
@@ -126,20 +183,16 @@ inline size_t FreeList::GetBufferSizeByIndex(size_t buf_index) const
     return (buf_index + 1) * alignment;
 }
 
-inline int FreeList::AddBufferByIndex(size_t buf_index, size_t offset)
+inline uint64_t* FreeList::ChunkPtr(uint32_t chunk) const
 {
-#ifdef __DEBUG__
-    assert(buf_index < max_num_buffer);
-#endif
-
-    if (buffer_free_list[buf_index]->Count() > (unsigned)max_buffer_per_list) {
-        ReuseBuffer(buf_index, offset);
-        return MBError::SUCCESS;
-    }
+    return reinterpret_cast<uint64_t*>(chunk_base + (size_t)(chunk - 1) * FREE_LIST_CHUNK_SIZE);
+}
 
-    count++;
-    tot_size += (buf_index + 1) * alignment;
-    return buffer_free_list[buf_index]->AddIntToTail(offset);
+inline int FreeList::AddBufferByIndex(size_t buf_index, size_t offset)
+{
+    if (buf_index >= max_num_buffer)
+        return MBError::BUFFER_LOST;
+    return Push(buf_index, offset);
 }
 
 inline size_t FreeList::RemoveBufferByIndex(size_t buf_index)
@@ -147,9 +200,7 @@ inline size_t FreeList::RemoveBufferByIndex(size_t buf_index)
 #ifdef __DEBUG__
     assert(buf_index < max_num_buffer);
 #endif
-    count--;
-    tot_size -= (buf_index + 1) * alignment;
-    return buffer_free_list[buf_index]->RemoveIntFromHead();
+    return Pop(buf_index);
 }
 
 inline int FreeList::ReleaseBuffer(size_t offset, size_t size)
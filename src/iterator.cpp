@@ -16,6 +16,8 @@
 
 // @author Changxue Deng <chadeng@cisco.com>
 
+#include <time.h>
+
 #include "db.h"
 #include "dict.h"
 #include "integer_4b_5b.h"
@@ -28,6 +30,7 @@ typedef struct _iterator_node {
     uint8_t* data;
     int data_len;
     uint16_t bucket_index;
+    uint32_t expire_time;
 } iterator_node;
 
 static void free_iterator_node(void* n)
@@ -53,6 +56,7 @@ static iterator_node* new_iterator_node(const std::string& key, MBData* mbdata)
     inode->key = new std::string(key);
     if (mbdata != NULL) {
         inode->bucket_index = mbdata->bucket_index;
+        inode->expire_time = mbdata->expire_time;
         mbdata->TransferValueTo(inode->data, inode->data_len);
         if (inode->data == NULL || inode->data_len <= 0) {
             free_iterator_node(inode);
@@ -61,6 +65,7 @@ static iterator_node* new_iterator_node(const std::string& key, MBData* mbdata)
     } else {
         inode->data = NULL;
         inode->data_len = 0;
+        inode->expire_time = 0;
     }
 
     return inode;
@@ -78,13 +83,13 @@ static iterator_node* new_iterator_node(const std::string& key, MBData* mbdata)
 // }
 /////////////////////////////////////////////////////////////////////
 
-const DB::iterator DB::begin(bool check_async_mode, bool rc_mode) const
+const DB::iterator DB::begin(bool check_async_mode, bool rc_mode, bool include_expired) const
 {
     DB::iterator iter = iterator(*this, DB_ITER_STATE_INIT);
     iter.prefix = "";
     if (rc_mode)
         iter.value.options |= CONSTS::OPTION_RC_MODE;
-    iter.init(check_async_mode);
+    iter.init(check_async_mode, include_expired);
 
     return iter;
 }
@@ -108,6 +113,8 @@ void DB::iterator::iter_obj_init()
     node_stack = NULL;
     kv_per_node = NULL;
     lfree = NULL;
+    rc_mode = false;
+    include_expired = false;
 
     if (!(db_ref.GetDBOptions() & CONSTS::ACCESS_MODE_WRITER)) {
 #ifdef __LOCK_FREE__
@@ -131,6 +138,8 @@ DB::iterator::iterator(const iterator& rhs)
     , state(rhs.state)
 {
     iter_obj_init();
+    rc_mode = rhs.rc_mode;
+    include_expired = rhs.include_expired;
 }
 
 DB::iterator::~iterator()
@@ -142,7 +151,7 @@ DB::iterator::~iterator()
 }
 
 // Initialize the iterator, get the very first key-value pair.
-void DB::iterator::init(bool check_async_mode)
+void DB::iterator::init(bool check_async_mode, bool include_expired_entries)
 {
     // Writer in async mode cannot be used for lookup
     if (check_async_mode && (db_ref.options & CONSTS::ASYNC_WRITER_MODE)) {
@@ -150,6 +159,10 @@ void DB::iterator::init(bool check_async_mode)
         return;
     }
 
+    rc_mode = value.options & CONSTS::OPTION_RC_MODE;
+    // Tombstones in the rc tree are expired.
+    include_expired = include_expired_entries || rc_mode;
+    db_ref.dict->CheckRetiredBlocks();
     node_stack = new MBlsq(free_iterator_node);
     kv_per_node = new MBlsq(free_iterator_node);
 
@@ -206,7 +219,7 @@ int DB::iterator::get_node_offset(const std::string& node_key,
     node_offset = 0;
     value.options |= CONSTS::OPTION_FIND_AND_STORE_PARENT;
     while (true) {
-        rval = db_ref.dict->Find((const uint8_t*)node_key.data(),
+        rval = db_ref.dict->FindEdge(rc_mode, (const uint8_t*)node_key.data(),
             node_key.size(), value);
         if (rval != MBError::TRY_AGAIN)
             break;
@@ -362,28 +375,41 @@ DB::iterator* DB::iterator::next()
 {
     iterator_node* inode;
 
-    while (kv_per_node->Count() == 0) {
-        inode = (iterator_node*)node_stack->RemoveFromHead();
-        if (inode == NULL)
-            return NULL;
+    while (true) {
+        while (kv_per_node->Count() == 0) {
+            inode = (iterator_node*)node_stack->RemoveFromHead();
+            if (inode == NULL)
+                return NULL;
 
-        int rval = load_kv_for_node(*inode->key);
-        free_iterator_node(inode);
-        if (rval != MBError::SUCCESS)
-            return NULL;
-    }
+            int rval = load_kv_for_node(*inode->key);
+            free_iterator_node(inode);
+            if (rval != MBError::SUCCESS)
+                return NULL;
+        }
 
-    if (kv_per_node->Count() > 0) {
         inode = (iterator_node*)kv_per_node->RemoveFromHead();
+        // Main tree entries removed during resource collection have
+        // tombstones in the rc tree.
+        if (!rc_mode && db_ref.dict->Tombstone_RC((const uint8_t*)inode->key->data(),
+                inode->key->size())) {
+            free_iterator_node(inode);
+            continue;
+        }
+        // Expired entries are treated as missing until they are removed.
+        if (!include_expired && inode->expire_time != 0
+            && inode->expire_time <= static_cast<uint32_t>(time(NULL))) {
+            free_iterator_node(inode);
+            continue;
+        }
+
         match = MATCH_NODE_OR_EDGE;
         key = *inode->key;
         value.TransferValueFrom(inode->data, inode->data_len);
         value.bucket_index = inode->bucket_index;
+        value.expire_time = inode->expire_time;
         free_iterator_node(inode);
         return this;
     }
-
-    return NULL;
 }
 
 // There is no need to perform lock-free check in next_dbt_buffer
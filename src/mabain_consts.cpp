@@ -27,6 +27,15 @@ const int CONSTS::SYNC_ON_WRITE = 0x4;
 const int CONSTS::USE_SLIDING_WINDOW = 0x8;
 const int CONSTS::MEMORY_ONLY_MODE = 0x10;
 const int CONSTS::READ_ONLY_DB = 0x20;
+// Block on a full async queue instead of returning TRY_AGAIN
+const int CONSTS::SHMQ_BLOCKING_MODE = 0x80;
+// Log updates to a redo log synced in groups. See MBConfig for the sync settings.
+const int CONSTS::REDO_LOG = 0x100;
+// Map block files in memory-only mode with MAP_HUGETLB. Regular pages are used
+// if no huge pages are available.
+const int CONSTS::HUGE_PAGE_HUGETLB = 0x200;
+// Ask for transparent huge pages with madvise(MADV_HUGEPAGE) on block files
+const int CONSTS::HUGE_PAGE_ADVISE = 0x400;
 
 const int CONSTS::OPTION_FIND_AND_STORE_PARENT = 0x2;
 const int CONSTS::OPTION_RC_MODE = 0x4;
@@ -34,6 +43,10 @@ const int CONSTS::OPTION_READ_SAVED_EDGE = 0x8;
 const int CONSTS::OPTION_INTERNAL_NODE_BOUND = 0x10;
 const int CONSTS::OPTION_SHMQ_RETRY = 0x20;
 const int CONSTS::OPTION_JEMALLOC = 0x40;
+const int CONSTS::OPTION_NO_REDO_LOG = 0x200;
+// Find returns IN_DICT with the data offset set instead of reading a value
+// that is not in memory. Used by FindBatch.
+const int CONSTS::OPTION_DEFER_COLD_READ = 0x400;
 
 const int CONSTS::MAX_KEY_LENGHTH = 256;
 const int CONSTS::MAX_DATA_SIZE = 0x7FFF;
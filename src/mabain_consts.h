@@ -30,6 +30,10 @@ public:
     static const int USE_SLIDING_WINDOW;
     static const int MEMORY_ONLY_MODE;
     static const int READ_ONLY_DB;
+    static const int SHMQ_BLOCKING_MODE;
+    static const int REDO_LOG;
+    static const int HUGE_PAGE_HUGETLB;
+    static const int HUGE_PAGE_ADVISE;
 
     static const int OPTION_FIND_AND_STORE_PARENT;
     static const int OPTION_RC_MODE;
@@ -39,6 +43,8 @@ public:
     static const int MAX_DATA_SIZE;
     static const int OPTION_SHMQ_RETRY;
     static const int OPTION_JEMALLOC;
+    static const int OPTION_NO_REDO_LOG; // Used internally only
+    static const int OPTION_DEFER_COLD_READ; // Used internally only
 
     static int WriterOptions();
     static int ReaderOptions();
@@ -17,6 +17,7 @@
 // @author Changxue Deng <chadeng@cisco.com>
 
 #include <string.h>
+#include <time.h>
 
 #include "error.h"
 #include "mb_data.h"
@@ -32,6 +33,7 @@ MBData::MBData()
     match_len = 0;
     options = 0;
     free_buffer = false;
+    expire_time = 0;
 }
 
 MBData::MBData(int size, int match_options)
@@ -51,6 +53,7 @@ MBData::MBData(int size, int match_options)
     data_len = 0;
     match_len = 0;
     options = match_options;
+    expire_time = 0;
 }
 
 // Caller must free data.
@@ -102,6 +105,11 @@ MBData::~MBData()
         free(buff);
 }
 
+bool MBData::Expired() const
+{
+    return expire_time != 0 && expire_time <= static_cast<uint32_t>(time(NULL));
+}
+
 // This function is for prefix match only.
 void MBData::Clear()
 {
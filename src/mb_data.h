@@ -77,6 +77,8 @@ public:
     int Resize(int size);
     int TransferValueTo(uint8_t*& data, int& dlen);
     int TransferValueFrom(uint8_t*& data, int dlen);
+    // Check if the expiry time has passed
+    bool Expired() const;
 
     // data length
     int data_len;
@@ -88,6 +90,9 @@ public:
     // data offset
     size_t data_offset;
     uint16_t bucket_index;
+    // Expiry time in seconds since epoch; zero if the entry does not expire.
+    // Set by the caller when adding and returned by lookups.
+    uint32_t expire_time;
 
     // Search options
     int options;
@@ -0,0 +1,149 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <time.h>
+
+#include "db.h"
+#include "dict.h"
+#include "logger.h"
+
+namespace mabain {
+
+void Dict::AddExpiry(const uint8_t* key, int len, uint32_t expire_time)
+{
+    header->ttl_in_use = 1;
+    if (expiry_log == NULL)
+        return;
+    if (expiry_log->Append(key, len, expire_time) != MBError::SUCCESS)
+        Logger::Log(LOG_LEVEL_WARN, "failed to add expiry log record");
+    uint32_t next = next_expire.load(std::memory_order_relaxed);
+    if (next == 0 || expire_time < next)
+        next_expire.store(expire_time, std::memory_order_relaxed);
+}
+
+bool Dict::ExpiryDue() const
+{
+    uint32_t expire_time = next_expire.load(std::memory_order_relaxed);
+    return expire_time != 0 && expire_time <= static_cast<uint32_t>(time(NULL));
+}
+
+void Dict::ResetExpiryLog()
+{
+    if (expiry_log != NULL)
+        expiry_log->Reset();
+    next_expire.store(0, std::memory_order_relaxed);
+}
+
+// The expiry log is only opened by the writer. It is not backed by a file in
+// memory-only or jemalloc mode.
+int Dict::OpenExpiryLog(const std::string& mbdir)
+{
+    if (!(options & CONSTS::ACCESS_MODE_WRITER))
+        return MBError::NOT_ALLOWED;
+
+    try {
+        expiry_log = new ExpiryLog(mbdir, header,
+            options & (CONSTS::MEMORY_ONLY_MODE | CONSTS::OPTION_JEMALLOC));
+    } catch (int error) {
+        Logger::Log(LOG_LEVEL_WARN, "failed to open expiry log: %s", MBError::get_error_str(error));
+        expiry_log = NULL;
+        return error;
+    }
+    next_expire.store(expiry_log->NextExpire(), std::memory_order_relaxed);
+    return MBError::SUCCESS;
+}
+
+// Check if the data buffer at data_off has expired. Called by writer only.
+bool Dict::DataExpired(size_t data_off) const
+{
+    uint16_t size_field;
+    uint32_t expire_time;
+    if (ReadData(reinterpret_cast<uint8_t*>(&size_field), DATA_SIZE_BYTE, data_off) != DATA_SIZE_BYTE)
+        return false;
+    if (!(size_field & DATA_SIZE_TTL_FLAG))
+        return false;
+    if (ReadData(reinterpret_cast<uint8_t*>(&expire_time), DATA_TTL_BYTE, data_off + DATA_HDR_BYTE)
+        != DATA_TTL_BYTE)
+        return false;
+    return expire_time <= static_cast<uint32_t>(time(NULL));
+}
+
+// Remove expired entries in the order of expiry time. At most max_count
+// records in the expiry log are checked so that the writer is not blocked
+// for long. Records of entries that were removed or updated after being added
+// to the log are skipped. Returns the number of entries removed.
+int Dict::RemoveExpired(int max_count)
+{
+    if (!(options & CONSTS::ACCESS_MODE_WRITER) || expiry_log == NULL)
+        return 0;
+    // The main tree cannot be updated while its buffers are being relocated.
+    if (header->rc_root_offset.load(std::memory_order_relaxed) != 0)
+        return 0;
+
+    uint32_t now = static_cast<uint32_t>(time(NULL));
+    int count = 0;
+    uint32_t expire_time;
+    std::string key;
+    MBData data;
+    for (int i = 0; i < max_count && expiry_log->Peek(now, expire_time, key); i++) {
+        const uint8_t* key_ptr = reinterpret_cast<const uint8_t*>(key.data());
+        if (expire_time > now) {
+            // Kept in the last bucket of the log since it expires later
+            expiry_log->Append(key_ptr, key.size(), expire_time);
+            expiry_log->Pop();
+            continue;
+        }
+
+        data.options = 0;
+        int rval = Find_Internal(0, key_ptr, key.size(), data);
+        while (rval == MBError::TRY_AGAIN)
+            rval = Find_Internal(0, key_ptr, key.size(), data);
+        if (rval == MBError::SUCCESS && data.expire_time == expire_time) {
+            data.options = CONSTS::OPTION_FIND_AND_STORE_PARENT;
+            rval = Remove(key_ptr, key.size(), data);
+            if (rval == MBError::SUCCESS) {
+                header->num_expired++;
+                count++;
+            } else {
+                Logger::Log(LOG_LEVEL_DEBUG, "failed to remove expired entry: %s",
+                    MBError::get_error_str(rval));
+            }
+        }
+        // The record is removed after the entry so that it is checked again
+        // if the writer exits in between.
+        expiry_log->Pop();
+        data.Clear();
+    }
+
+    next_expire.store(expiry_log->NextExpire(), std::memory_order_relaxed);
+    return count;
+}
+
+// Opening the expiry log does not read the DB. It is only rebuilt if the DB
+// has entries with expiry time and the log was not maintained, e.g. the log
+// file is missing or the DB is loaded from a snapshot.
+void Dict::RebuildExpiryLog(const DB& db)
+{
+    if (expiry_log == NULL || expiry_log->IsValid())
+        return;
+
+    expiry_log->Rebuild(db);
+    next_expire.store(expiry_log->NextExpire(), std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,172 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string.h>
+
+#include "dict.h"
+#include "mb_merge.h"
+
+namespace mabain {
+
+int Dict::RegisterMergeOperator(int op, MergeOperator merge_op)
+{
+    if (op < MB_MERGE_USER_MIN || op > MB_MERGE_USER_MAX)
+        return MBError::INVALID_ARG;
+    if (merge_op)
+        merge_ops[op] = merge_op;
+    else
+        merge_ops.erase(op);
+    return MBError::SUCCESS;
+}
+
+// Read the current value of the key. Called by writer only, so that the value
+// cannot change before the merged value is stored.
+int Dict::FindMergeValue(const uint8_t* key, int len, MBData& data)
+{
+    int rval;
+    size_t rc_root_offset = header->rc_root_offset.load(std::memory_order_relaxed);
+
+    if (rc_root_offset != 0) {
+        rval = Find_Internal(rc_root_offset, key, len, data);
+        while (rval == MBError::TRY_AGAIN)
+            rval = Find_Internal(rc_root_offset, key, len, data);
+        // Main tree entries removed during rc have tombstones in the rc tree.
+        if (rval == MBError::SUCCESS && data.Expired())
+            return MBError::NOT_EXIST;
+        if (rval != MBError::NOT_EXIST)
+            return rval;
+        data.options &= ~(CONSTS::OPTION_RC_MODE | CONSTS::OPTION_READ_SAVED_EDGE);
+    }
+
+    rval = Find_Internal(0, key, len, data);
+    while (rval == MBError::TRY_AGAIN)
+        rval = Find_Internal(0, key, len, data);
+    if (rval == MBError::SUCCESS && data.Expired())
+        return MBError::NOT_EXIST;
+    return rval;
+}
+
+int Dict::ApplyMerge(int op, const uint8_t* value, int value_len, const uint8_t* operand,
+    int operand_len, std::string& result)
+{
+    switch (op) {
+    case MB_MERGE_INT_ADD: {
+        int64_t delta;
+        int64_t curr = 0;
+        if (operand_len != (int)sizeof(delta))
+            return MBError::INVALID_ARG;
+        memcpy(&delta, operand, sizeof(delta));
+        if (value != NULL) {
+            if (value_len != (int)sizeof(curr))
+                return MBError::VALUE_MISMATCH;
+            memcpy(&curr, value, sizeof(curr));
+        }
+        curr += delta;
+        result.assign((const char*)&curr, sizeof(curr));
+        break;
+    }
+    case MB_MERGE_APPEND: {
+        uint32_t max_len;
+        if (operand_len < (int)sizeof(max_len))
+            return MBError::INVALID_ARG;
+        memcpy(&max_len, operand, sizeof(max_len));
+        if (value != NULL)
+            result.assign((const char*)value, value_len);
+        else
+            result.clear();
+        result.append((const char*)operand + sizeof(max_len), operand_len - sizeof(max_len));
+        if (max_len > 0 && result.size() > max_len)
+            result.erase(0, result.size() - max_len);
+        break;
+    }
+    case MB_MERGE_CAS: {
+        uint32_t expected_len;
+        if (operand_len < (int)sizeof(expected_len))
+            return MBError::INVALID_ARG;
+        memcpy(&expected_len, operand, sizeof(expected_len));
+        const uint8_t* expected = operand + sizeof(expected_len);
+        int left = operand_len - sizeof(expected_len);
+        if (expected_len == MB_MERGE_CAS_ABSENT) {
+            if (value != NULL)
+                return MBError::VALUE_MISMATCH;
+            expected_len = 0;
+        } else {
+            if ((int)expected_len > left)
+                return MBError::INVALID_ARG;
+            if (value == NULL || value_len != (int)expected_len
+                || memcmp(value, expected, expected_len) != 0)
+                return MBError::VALUE_MISMATCH;
+        }
+        result.assign((const char*)expected + expected_len, left - expected_len);
+        break;
+    }
+    default: {
+        auto it = merge_ops.find(op);
+        if (it == merge_ops.end())
+            return MBError::INVALID_ARG;
+        int rval = it->second(value, value_len, operand, operand_len, result);
+        if (rval != MBError::SUCCESS)
+            return rval;
+        break;
+    }
+    }
+
+    if (result.size() == 0 || result.size() > (size_t)CONSTS::MAX_DATA_SIZE)
+        return MBError::OUT_OF_BOUND;
+    return MBError::SUCCESS;
+}
+
+// Apply the merge operator to the current value of the key and store the
+// result. The options of data are used when storing the result, and the
+// merged value is returned in data.
+int Dict::Merge(const uint8_t* key, int len, int op, const uint8_t* operand,
+    int operand_len, MBData& data)
+{
+    if (!(options & CONSTS::ACCESS_MODE_WRITER))
+        return MBError::NOT_ALLOWED;
+    if (len <= 0 || len > CONSTS::MAX_KEY_LENGHTH || operand_len < 0)
+        return MBError::OUT_OF_BOUND;
+
+    MBData curr;
+    int rval = FindMergeValue(key, len, curr);
+    if (rval != MBError::SUCCESS && rval != MBError::NOT_EXIST)
+        return rval;
+
+    // The merged value keeps the expiry time of the current value.
+    uint32_t expire_time = 0;
+    std::string result;
+    if (rval == MBError::SUCCESS) {
+        expire_time = curr.expire_time;
+        rval = ApplyMerge(op, curr.buff, curr.data_len, operand, operand_len, result);
+    } else {
+        rval = ApplyMerge(op, NULL, 0, operand, operand_len, result);
+    }
+    if (rval != MBError::SUCCESS)
+        return rval;
+
+    rval = data.Resize(result.size());
+    if (rval != MBError::SUCCESS)
+        return rval;
+    memcpy(data.buff, result.data(), result.size());
+    data.data_len = result.size();
+    data.expire_time = expire_time;
+    // The merged value, not the operand, is written to the redo log.
+    return Add(key, len, data, true);
+}
+
+}
@@ -0,0 +1,55 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __MB_MERGE_H__
+#define __MB_MERGE_H__
+
+#include <functional>
+#include <stdint.h>
+#include <string>
+
+namespace mabain {
+
+// Merge operators are applied by the writer to the current value of a key, so
+// that a read-modify-write update takes a single request from the producer.
+
+// Add an int64_t operand to the int64_t value. A missing key starts from 0.
+#define MB_MERGE_INT_ADD 1
+// The operand is a uint32_t bound followed by the bytes to append. If the
+// result is longer than a non-zero bound, the leading bytes are dropped.
+#define MB_MERGE_APPEND 2
+// The operand is a uint32_t length, the expected value and the new value. The
+// new value is stored only if the current value matches the expected one. Use
+// MB_MERGE_CAS_ABSENT as the length to expect a missing key.
+#define MB_MERGE_CAS 3
+#define MB_MERGE_CAS_ABSENT 0xFFFFFFFF
+// Operators in this range are registered by DB::RegisterMergeOperator in the
+// writer process.
+#define MB_MERGE_USER_MIN 16
+#define MB_MERGE_USER_MAX 255
+
+// User merge function. value is NULL if the key does not exist. The result is
+// stored if MBError::SUCCESS is returned; otherwise the key is left unchanged
+// and the error is returned to the caller.
+typedef std::function<int(const uint8_t* value, int value_len, const uint8_t* operand,
+    int operand_len, std::string& result)>
+    MergeOperator;
+
+}
+
+#endif
@@ -16,18 +16,22 @@
 
 // @author Changxue Deng <chadeng@cisco.com>
 
+#include <random>
 #include <sys/time.h>
 
 #include "dict.h"
 #include "dict_mem.h"
 #include "integer_4b_5b.h"
 #include "mb_rc.h"
+#include "util/utils.h"
 
 #define MAX_PRUNE_COUNT 3 // maximum lru eviction attempts
 #define NUM_ASYNC_TASK 10 // number of other tasks to be checked during eviction
 #define PRUNE_TASK_CHECK 10 // every Xth eviction check Y number of other tasks
 #define RC_TASK_CHECK 10 // every Xth async task try to reclaim resources
 #define MIN_RC_OFFSET_GAP 1ULL * 1024 * 1024 // 1M
+#define RC_STEP_BUFFER_COUNT 16 // buffers moved between time budget checks
+#define RC_COPY_BATCH_SIZE 4096 // maximum data buffers copied by the copy pool at a time
 
 namespace mabain {
 
@@ -36,10 +40,20 @@ ResourceCollection::ResourceCollection(const DB& db, int rct)
     , rc_type(rct)
 {
     async_writer_ptr = NULL;
+    incremental = false;
+    rc_node_index = 0;
+    rc_done_index = 0;
+    defrag_start = 0;
+    copy_pool = NULL;
+    pending_min_src = 0;
+    copy_batch_cnt = 0;
+    copy_buffer_cnt = 0;
 }
 
 ResourceCollection::~ResourceCollection()
 {
+    if (copy_pool != NULL)
+        delete copy_pool;
 }
 
 #define CIRCULAR_INDEX_DIFF(x, y) ((x) > (y) ? ((x) - (y)) : (0xFFFF - (y) + (x)))
@@ -64,26 +78,25 @@ int ResourceCollection::LRUEviction(int64_t max_dbsz, int64_t max_dbcnt)
         ratio = 0.5;
     uint16_t prune_diff = uint16_t((0xFFFF - index_diff) * ratio);
 
-    DB db_itr(db_ref);
-    for (DB::iterator iter = db_itr.begin(false); iter != db_itr.end(); ++iter) {
-        if (CIRCULAR_PRUNE_DIFF(iter.value.bucket_index, header->eviction_bucket_index) < prune_diff) {
-            if (async_writer_ptr != NULL) {
-                rval = dict->Remove((const uint8_t*)iter.key.data(), iter.key.size());
-            } else
+    EvictionLog* evict_log = dict->GetEvictionLog();
+    if (evict_log != NULL && !evict_log->IsValid())
+        evict_log->Rebuild(db_ref);
+    if (evict_log != NULL && evict_log->IsValid()) {
+        rval = PruneFromLog(evict_log, prune_diff, pruned);
+    } else {
+        DB db_itr(db_ref);
+        for (DB::iterator iter = db_itr.begin(false); iter != db_itr.end(); ++iter) {
+            if (CIRCULAR_PRUNE_DIFF(iter.value.bucket_index, header->eviction_bucket_index) < prune_diff) {
                 rval = dict->Remove((const uint8_t*)iter.key.data(), iter.key.size());
-            if (rval != MBError::SUCCESS)
-                Logger::Log(LOG_LEVEL_DEBUG, "failed to run eviction %s", MBError::get_error_str(rval));
-            else
-                pruned++;
-        }
-
-        if (async_writer_ptr != NULL) {
-            if (count++ > PRUNE_TASK_CHECK) {
-                count = 0;
-                rval = async_writer_ptr->ProcessTask(NUM_ASYNC_TASK, false);
-                if (rval == MBError::RC_SKIPPED)
-                    break;
+                if (rval != MBError::SUCCESS)
+                    Logger::Log(LOG_LEVEL_DEBUG, "failed to run eviction %s", MBError::get_error_str(rval));
+                else
+                    pruned++;
             }
+
+            rval = ProcessAsyncTasks(count);
+            if (rval == MBError::RC_SKIPPED)
+                break;
         }
     }
 
@@ -103,6 +116,153 @@ int ResourceCollection::LRUEviction(int64_t max_dbsz, int64_t max_dbcnt)
     return rval;
 }
 
+// Prune the entries in the oldest prune_diff buckets using the eviction log so
+// that only the records of these buckets are read. Records from buckets older
+// than eviction_bucket_index, which can be left after the bucket index wraps
+// around, are pruned as well. A record is skipped if the key was removed or
+// updated after it was logged.
+int ResourceCollection::PruneFromLog(EvictionLog* evict_log, uint16_t prune_diff,
+    int64_t& pruned)
+{
+    int rval = MBError::SUCCESS;
+    int64_t count = 0;
+    int64_t skipped = 0;
+    uint16_t curr_bucket = (header->num_update / header->entry_per_bucket) % 0xFFFF;
+    uint16_t live_diff = CIRCULAR_PRUNE_DIFF(curr_bucket, header->eviction_bucket_index);
+    uint64_t pos = header->evict_log_head;
+    uint64_t next_pos = pos;
+    uint16_t bucket;
+    std::string key;
+    MBData mbd;
+
+    evict_log->Flush();
+    while (evict_log->Read(next_pos, bucket, key)) {
+        uint16_t diff = CIRCULAR_PRUNE_DIFF(bucket, header->eviction_bucket_index);
+        if (diff >= prune_diff && diff <= live_diff)
+            break;
+        pos = next_pos;
+
+        mbd.Clear();
+        mbd.options = 0;
+        rval = dict->Find((const uint8_t*)key.data(), key.size(), mbd);
+        // Expired entries are not found but are still pruned.
+        if ((rval == MBError::SUCCESS && mbd.bucket_index == bucket) || rval == MBError::NOT_EXIST) {
+            rval = dict->Remove((const uint8_t*)key.data(), key.size());
+            if (rval == MBError::SUCCESS)
+                pruned++;
+            else if (rval == MBError::NOT_EXIST)
+                skipped++;
+            else
+                Logger::Log(LOG_LEVEL_DEBUG, "failed to run eviction %s", MBError::get_error_str(rval));
+        } else {
+            skipped++;
+        }
+
+        rval = ProcessAsyncTasks(count);
+        if (rval == MBError::RC_SKIPPED)
+            break;
+        // Updates processed above may have filled the buffer.
+        evict_log->Flush();
+    }
+    evict_log->Advance(pos);
+
+    Logger::Log(LOG_LEVEL_DEBUG, "eviction log: %lld pruned %lld skipped", pruned, skipped);
+    if (rval != MBError::RC_SKIPPED)
+        rval = MBError::SUCCESS;
+    return rval;
+}
+
+// Let the async writer process some queued updates during a long sweep.
+// Returns MBError::RC_SKIPPED if the sweep should be stopped.
+int ResourceCollection::ProcessAsyncTasks(int64_t& count)
+{
+    if (async_writer_ptr == NULL || count++ <= PRUNE_TASK_CHECK)
+        return MBError::SUCCESS;
+    count = 0;
+    return async_writer_ptr->ProcessTask(NUM_ASYNC_TASK, false);
+}
+
+// Evict the entries with the lowest access counts. The first pass over the DB
+// builds a histogram of the counters to find the count below which entries
+// are evicted. Entries at this count are sampled so that the number evicted
+// is close to the target. The counters are aged when done.
+int ResourceCollection::AccessEviction(int64_t max_dbsz, int64_t max_dbcnt)
+{
+    AccessTracker* tracker = dict->GetAccessTracker();
+    int64_t pruned = 0;
+    int64_t count = 0;
+    int rval = MBError::SUCCESS;
+
+    double ratio = 0.15;
+    int64_t tot_size = (int64_t)(header->m_data_offset + header->m_index_offset);
+    if (tot_size > max_dbsz)
+        ratio = (tot_size - max_dbsz) * 0.88 / max_dbsz;
+    else if (header->count > max_dbcnt)
+        ratio = (header->count - max_dbcnt) * 0.88 / max_dbcnt;
+    if (ratio > 0.5)
+        ratio = 0.5;
+    int64_t target = int64_t(header->count * ratio);
+    if (target <= 0)
+        return MBError::SUCCESS;
+
+    Logger::Log(LOG_LEVEL_INFO, "running %s eviction for %lld entries",
+        tracker->GetPolicy() == MB_EVICTION_CLOCK ? "CLOCK" : "LFU", target);
+
+    int64_t histogram[MB_ACCESS_COUNT_MAX + 1] = { 0 };
+    DB db_itr(db_ref);
+    for (DB::iterator iter = db_itr.begin(false); iter != db_itr.end(); ++iter) {
+        histogram[tracker->Get((const uint8_t*)iter.key.data(), iter.key.size())]++;
+        if (ProcessAsyncTasks(count) == MBError::RC_SKIPPED) {
+            Logger::Log(LOG_LEVEL_INFO, "eviction skipped");
+            return MBError::RC_SKIPPED;
+        }
+    }
+
+    int threshold = 0;
+    int64_t below = 0;
+    while (threshold < MB_ACCESS_COUNT_MAX && below + histogram[threshold] < target)
+        below += histogram[threshold++];
+    // Select need out of the remaining entries at the threshold count.
+    int64_t need = target - below;
+    int64_t remaining = histogram[threshold];
+    std::minstd_rand rand_gen(header->num_update);
+
+    for (DB::iterator iter = db_itr.begin(false); iter != db_itr.end(); ++iter) {
+        int access_count = tracker->Get((const uint8_t*)iter.key.data(), iter.key.size());
+        bool evict = access_count < threshold;
+        if (access_count == threshold && need > 0 && remaining > 0) {
+            if (int64_t(rand_gen() % remaining) < need) {
+                evict = true;
+                need--;
+            }
+            remaining--;
+        }
+        if (evict) {
+            rval = dict->Remove((const uint8_t*)iter.key.data(), iter.key.size());
+            if (rval != MBError::SUCCESS)
+                Logger::Log(LOG_LEVEL_DEBUG, "failed to run eviction %s", MBError::get_error_str(rval));
+            else
+                pruned++;
+        }
+
+        rval = ProcessAsyncTasks(count);
+        if (rval == MBError::RC_SKIPPED)
+            break;
+    }
+    tracker->Age();
+
+    if (rval == MBError::RC_SKIPPED) {
+        Logger::Log(LOG_LEVEL_INFO, "eviction skipped %lld pruned", pruned);
+        return rval;
+    }
+    Logger::Log(LOG_LEVEL_INFO, "eviction done %lld pruned below access count %d", pruned,
+        threshold);
+    // Counters may have changed between the passes.
+    if (pruned < int64_t(target * 0.75))
+        return MBError::TRY_AGAIN;
+    return MBError::SUCCESS;
+}
+
 void ResourceCollection::ReclaimResource(int64_t min_index_size,
     int64_t min_data_size,
     int64_t max_dbsz,
@@ -115,49 +275,57 @@ void ResourceCollection::ReclaimResource(int64_t min_index_size,
         throw db_ref.Status();
 
     async_writer_ptr = awr;
-    timeval start, stop;
-    uint64_t timediff;
+    Evict(max_dbsz, max_dbcnt);
 
-    // Check LRU eviction first
-    if (header->m_data_offset + header->m_index_offset > (size_t)max_dbsz || header->count > max_dbcnt) {
-        int cnt = 0;
-        gettimeofday(&start, NULL);
-        while (cnt < MAX_PRUNE_COUNT) {
-            if (LRUEviction(max_dbsz, max_dbcnt) != MBError::TRY_AGAIN)
-                break;
-            cnt++;
-        }
-        gettimeofday(&stop, NULL);
-        timediff = (stop.tv_sec - start.tv_sec) * 1000000 + (stop.tv_usec - start.tv_usec);
-        if (timediff > 1000000) {
-            Logger::Log(LOG_LEVEL_INFO, "LRU eviction finished in %lf seconds",
-                timediff / 1000000.);
-        } else {
-            Logger::Log(LOG_LEVEL_INFO, "LRU eviction finished in %lf milliseconds",
-                timediff / 1000.);
+    if (min_index_size > 0 || min_data_size > 0) {
+        Prepare(min_index_size, min_data_size);
+        while (!RunDefragStep(0)) {
         }
+        async_writer_ptr = NULL;
     }
+}
 
-    if (min_index_size > 0 || min_data_size > 0) {
-        Prepare(min_index_size, min_data_size);
-        Logger::Log(LOG_LEVEL_INFO, "defragmentation started for [index - %s] [data - %s]",
-            rc_type & RESOURCE_COLLECTION_TYPE_INDEX ? "yes" : "no",
-            rc_type & RESOURCE_COLLECTION_TYPE_DATA ? " yes" : "no");
-        gettimeofday(&start, NULL);
+void ResourceCollection::StartDefrag(int64_t min_index_size, int64_t min_data_size,
+    int64_t max_dbsz, int64_t max_dbcnt, AsyncWriter* awr)
+{
+    if (db_ref.GetDBOptions() & CONSTS::OPTION_JEMALLOC)
+        throw(int) MBError::RC_SKIPPED;
+    if (!db_ref.is_open())
+        throw db_ref.Status();
 
-        ReorderBuffers();
-        CollectBuffers();
-        Finish();
+    async_writer_ptr = awr;
+    Evict(max_dbsz, max_dbcnt);
 
-        gettimeofday(&stop, NULL);
-        async_writer_ptr = NULL;
-        timediff = (stop.tv_sec - start.tv_sec) * 1000000 + (stop.tv_usec - start.tv_usec);
-        if (timediff > 1000000) {
-            Logger::Log(LOG_LEVEL_INFO, "defragmentation finished in %lf seconds",
-                timediff / 1000000.);
-        } else {
-            Logger::Log(LOG_LEVEL_INFO, "defragmentation finished in %lf milliseconds",
-                timediff / 1000.);
+    if (min_index_size <= 0 && min_data_size <= 0)
+        throw(int) MBError::RC_SKIPPED;
+    // Queued updates are processed by the async writer between steps.
+    incremental = true;
+    Prepare(min_index_size, min_data_size);
+}
+
+bool ResourceCollection::RunDefragStep(int64_t step_time)
+{
+    int64_t start = get_current_time_us();
+
+    while (true) {
+        if (!ContinueTraverse(header->rc_phase, RC_STEP_BUFFER_COUNT)) {
+            if (header->rc_phase == RESOURCE_COLLECTION_PHASE_COLLECT) {
+                FlushDataMoves();
+                EndCollect();
+                Finish();
+                return true;
+            }
+            EndReorder();
+            // Reset the progress first so that the collect phase is not skipped
+            // if the writer exits in between.
+            header->rc_progress = 0;
+            header->rc_phase = RESOURCE_COLLECTION_PHASE_COLLECT;
+            StartPhase();
+        }
+
+        if (step_time > 0 && get_current_time_us() - start >= step_time) {
+            FlushDataMoves();
+            return false;
         }
     }
 }
@@ -166,6 +334,36 @@ void ResourceCollection::ReclaimResource(int64_t min_index_size,
 ////////////////// Private Methods //////////////////////
 /////////////////////////////////////////////////////////
 
+void ResourceCollection::Evict(int64_t max_dbsz, int64_t max_dbcnt)
+{
+    if (header->m_data_offset + header->m_index_offset <= (size_t)max_dbsz && header->count <= max_dbcnt)
+        return;
+
+    timeval start, stop;
+    uint64_t timediff;
+    int cnt = 0;
+    gettimeofday(&start, NULL);
+    while (cnt < MAX_PRUNE_COUNT) {
+        int rval;
+        if (dict->GetAccessTracker() != NULL)
+            rval = AccessEviction(max_dbsz, max_dbcnt);
+        else
+            rval = LRUEviction(max_dbsz, max_dbcnt);
+        if (rval != MBError::TRY_AGAIN)
+            break;
+        cnt++;
+    }
+    gettimeofday(&stop, NULL);
+    timediff = (stop.tv_sec - start.tv_sec) * 1000000 + (stop.tv_usec - start.tv_usec);
+    if (timediff > 1000000) {
+        Logger::Log(LOG_LEVEL_INFO, "eviction finished in %lf seconds",
+            timediff / 1000000.);
+    } else {
+        Logger::Log(LOG_LEVEL_INFO, "eviction finished in %lf milliseconds",
+            timediff / 1000.);
+    }
+}
+
 void ResourceCollection::Prepare(int64_t min_index_size, int64_t min_data_size)
 {
     // make sure there is enough grabaged index buffers before initiating collection
@@ -191,16 +389,7 @@ void ResourceCollection::Prepare(int64_t min_index_size, int64_t min_data_size)
         throw(int) MBError::RC_SKIPPED;
     }
 
-    index_free_lists->Empty();
-    data_free_lists->Empty();
-
-    rc_loop_counter = 0;
-    index_reorder_cnt = 0;
-    data_reorder_cnt = 0;
-    index_rc_status = MBError::NOT_INITIALIZED;
-    data_rc_status = MBError::NOT_INITIALIZED;
-    index_reorder_status = MBError::NOT_INITIALIZED;
-    data_reorder_status = MBError::NOT_INITIALIZED;
+    InitCollection();
     header->rc_m_index_off_pre = header->m_index_offset;
     header->rc_m_data_off_pre = header->m_data_offset;
 
@@ -230,17 +419,86 @@ void ResourceCollection::Prepare(int64_t min_index_size, int64_t min_data_size)
 
     Logger::Log(LOG_LEVEL_DEBUG, "setting rc index off start to: %llu", header->m_index_offset);
     Logger::Log(LOG_LEVEL_DEBUG, "setting rc data off start to: %llu", header->m_data_offset);
+
+    header->rc_type = rc_type;
+    header->rc_progress = 0;
+    header->rc_phase = RESOURCE_COLLECTION_PHASE_REORDER;
+
+    Logger::Log(LOG_LEVEL_INFO, "defragmentation started for [index - %s] [data - %s]",
+        rc_type & RESOURCE_COLLECTION_TYPE_INDEX ? "yes" : "no",
+        rc_type & RESOURCE_COLLECTION_TYPE_DATA ? " yes" : "no");
+    defrag_start = get_current_time_us();
+    StartPhase();
 }
 
-void ResourceCollection::CollectBuffers()
+void ResourceCollection::InitCollection()
 {
+    index_free_lists->Empty();
+    data_free_lists->Empty();
+
+    rc_loop_counter = 0;
+    index_reorder_cnt = 0;
+    data_reorder_cnt = 0;
+    index_rc_status = MBError::NOT_INITIALIZED;
+    data_rc_status = MBError::NOT_INITIALIZED;
+    index_reorder_status = MBError::NOT_INITIALIZED;
+    data_reorder_status = MBError::NOT_INITIALIZED;
+}
+
+// Continue the resource collection saved in the header. The main tree is not
+// updated until the collection is done, so the traversal visits the buffers
+// in the same order as before the writer exited.
+void ResourceCollection::Resume()
+{
+    rc_type = header->rc_type;
+    InitCollection();
+    if (header->rc_phase == RESOURCE_COLLECTION_PHASE_COLLECT) {
+        if (rc_type & RESOURCE_COLLECTION_TYPE_INDEX)
+            index_reorder_status = MBError::SUCCESS;
+        if (rc_type & RESOURCE_COLLECTION_TYPE_DATA)
+            data_reorder_status = MBError::SUCCESS;
+    } else if (header->rc_phase != RESOURCE_COLLECTION_PHASE_REORDER) {
+        throw(int) MBError::INVALID_ARG;
+    }
+
+    defrag_start = get_current_time_us();
+    StartPhase();
+}
+
+// Start the traversal for the phase in the header. The first rc_progress
+// buffers are skipped.
+void ResourceCollection::StartPhase()
+{
+    if (header->rc_phase == RESOURCE_COLLECTION_PHASE_REORDER) {
+        if (rc_type & RESOURCE_COLLECTION_TYPE_INDEX)
+            Logger::Log(LOG_LEVEL_INFO, "index size before reorder: %llu", header->m_index_offset);
+        if (rc_type & RESOURCE_COLLECTION_TYPE_DATA)
+            Logger::Log(LOG_LEVEL_INFO, "data size before reorder: %llu", header->m_data_offset);
+
+        db_cnt = 0;
+        edge_str_size = 0;
+        node_cnt = 0;
+    } else if (copy_pool == NULL && dict->GetDefragThreads() > 0) {
+        copy_pool = new CopyPool(dict->GetDefragThreads());
+    }
+
+    rc_node_index = 0;
+    rc_done_index = 0;
+    StartTraverse();
+}
+
+void ResourceCollection::EndCollect()
+{
+    if (copy_pool != NULL) {
+        Logger::Log(LOG_LEVEL_INFO, "%lld data buffers copied in %lld batches",
+            copy_buffer_cnt, copy_batch_cnt);
+    }
+
     if ((rc_type & RESOURCE_COLLECTION_TYPE_INDEX) && (index_reorder_status != MBError::SUCCESS))
         return;
     if ((rc_type & RESOURCE_COLLECTION_TYPE_DATA) && (data_reorder_status != MBError::SUCCESS))
         return;
 
-    TraverseDB(RESOURCE_COLLECTION_PHASE_COLLECT);
-
     if (rc_type & RESOURCE_COLLECTION_TYPE_INDEX)
         index_rc_status = MBError::SUCCESS;
     if (rc_type & RESOURCE_COLLECTION_TYPE_DATA)
@@ -269,6 +527,10 @@ void ResourceCollection::Finish()
             throw(int) MBError::INVALID_ARG;
         header->m_data_offset = header->rc_m_data_off_pre;
     }
+    // Buffers in the main tree are in place. The rc tree is added to the main
+    // tree below, or by ExceptionRecovery if the writer exits.
+    header->rc_phase = 0;
+    header->rc_progress = 0;
 
     if (async_writer_ptr != NULL) {
         index_free_lists->Empty();
@@ -279,10 +541,18 @@ void ResourceCollection::Finish()
     header->rc_m_index_off_pre = 0;
     header->rc_m_data_off_pre = 0;
 
-    // TODO the temp file cannot be removed here. It could cause some
-    // rare race conditons.
-    //dict->RemoveUnused(header->m_data_offset, true);
-    //dmm->RemoveUnused(header->m_index_offset, true);
+    int64_t timediff = get_current_time_us() - defrag_start;
+    if (timediff > 1000000) {
+        Logger::Log(LOG_LEVEL_INFO, "defragmentation finished in %lf seconds",
+            timediff / 1000000.);
+    } else {
+        Logger::Log(LOG_LEVEL_INFO, "defragmentation finished in %lf milliseconds",
+            timediff / 1000.);
+    }
+
+    // The block files beyond the new end of the DB may still be mapped by
+    // readers. They are removed once the readers have released them.
+    dict->RetireBlocks();
 }
 
 bool ResourceCollection::MoveIndexBuffer(int phase, size_t& offset_src, int size)
@@ -358,6 +628,83 @@ bool ResourceCollection::MoveDataBuffer(int phase, size_t& offset_src, int size)
     return true;
 }
 
+void ResourceCollection::UpdateDataLink(size_t edge_offset, size_t link_offset,
+    size_t data_offset)
+{
+    header->excep_lf_offset = edge_offset;
+    Write6BInteger(header->excep_buff, data_offset);
+#ifdef __LOCK_FREE__
+    lfree->WriterLockFreeStart(edge_offset);
+#endif
+    header->excep_offset = link_offset;
+    header->excep_updating_status = EXCEP_STATUS_RC_DATA;
+    dmm->WriteData(header->excep_buff, OFFSET_SIZE, link_offset);
+    header->excep_updating_status = 0;
+#ifdef __LOCK_FREE__
+    lfree->WriterLockFreeStop();
+#endif
+}
+
+// Data buffers in the collect phase are copied by the copy pool in batches
+// and the links are updated by the writer afterwards. Destinations increase
+// in the traversal order and are below the sources of later buffers. Only the
+// source of a pending buffer can be overwritten, so the pending buffers are
+// copied first.
+void ResourceCollection::QueueDataMove(DBTraverseNode& dbt_node)
+{
+    data_size = dict->CheckAlignment(data_size, dbt_node.data_size);
+    if (data_size == dbt_node.data_offset)
+        return;
+
+    if (!pending_moves.empty()
+        && (data_size + dbt_node.data_size > pending_min_src
+            || pending_moves.size() >= RC_COPY_BATCH_SIZE))
+        FlushDataMoves();
+
+    RCDataMove move;
+    move.edge_offset = dbt_node.edge_offset;
+    move.link_offset = dbt_node.data_link_offset;
+    move.offset_src = dbt_node.data_offset;
+    move.offset_dst = data_size;
+    move.size = dbt_node.data_size;
+    move.mapped = false;
+    if (pending_moves.empty() || move.offset_src < pending_min_src)
+        pending_min_src = move.offset_src;
+    pending_moves.push_back(move);
+    dbt_node.data_offset = data_size;
+}
+
+void ResourceCollection::FlushDataMoves()
+{
+    if (pending_moves.empty())
+        return;
+
+    // Buffers not in shared memory are copied by the writer.
+    copy_tasks.clear();
+    for (RCDataMove& move : pending_moves) {
+        uint8_t* ptr_src = dict->GetShmPtr(move.offset_src, move.size);
+        uint8_t* ptr_dst = dict->GetShmPtr(move.offset_dst, move.size);
+        if (ptr_src != NULL && ptr_dst != NULL) {
+            CopyTask task = { ptr_dst, ptr_src, move.size };
+            copy_tasks.push_back(task);
+            move.mapped = true;
+        } else {
+            BufferCopy(move.offset_dst, ptr_dst, move.offset_src, ptr_src, move.size, dict);
+        }
+    }
+    copy_pool->Run(copy_tasks);
+
+    for (const RCDataMove& move : pending_moves) {
+        if (move.mapped)
+            dict->MarkDirty(move.offset_dst, move.size);
+        UpdateDataLink(move.edge_offset, move.link_offset, move.offset_dst);
+    }
+    copy_batch_cnt++;
+    copy_buffer_cnt += pending_moves.size();
+    pending_moves.clear();
+    header->rc_progress = rc_done_index;
+}
+
 void ResourceCollection::DoTask(int phase, DBTraverseNode& dbt_node)
 {
     if (phase == RESOURCE_COLLECTION_PHASE_REORDER) {
@@ -370,6 +717,12 @@ void ResourceCollection::DoTask(int phase, DBTraverseNode& dbt_node)
             node_cnt++;
     }
 
+    // Buffers done before the writer exited abnormally
+    if (rc_node_index++ < header->rc_progress) {
+        SkipBuffers(dbt_node);
+        return;
+    }
+
     header->excep_lf_offset = dbt_node.edge_offset;
     if (rc_type & RESOURCE_COLLECTION_TYPE_INDEX) {
         if (dbt_node.buffer_type & BUFFER_TYPE_NODE) {
@@ -412,27 +765,23 @@ void ResourceCollection::DoTask(int phase, DBTraverseNode& dbt_node)
 
     if (rc_type & RESOURCE_COLLECTION_TYPE_DATA) {
         if (dbt_node.buffer_type & BUFFER_TYPE_DATA) {
-            if (MoveDataBuffer(phase, dbt_node.data_offset, dbt_node.data_size)) {
-                Write6BInteger(header->excep_buff, dbt_node.data_offset);
-#ifdef __LOCK_FREE__
-                lfree->WriterLockFreeStart(dbt_node.edge_offset);
-#endif
-                header->excep_offset = dbt_node.data_link_offset;
-                ;
-                header->excep_updating_status = EXCEP_STATUS_RC_DATA;
-                dmm->WriteData(header->excep_buff, OFFSET_SIZE, dbt_node.data_link_offset);
-                header->excep_updating_status = 0;
-#ifdef __LOCK_FREE__
-                lfree->WriterLockFreeStop();
-#endif
+            if (phase == RESOURCE_COLLECTION_PHASE_COLLECT && copy_pool != NULL) {
+                QueueDataMove(dbt_node);
+            } else if (MoveDataBuffer(phase, dbt_node.data_offset, dbt_node.data_size)) {
+                UpdateDataLink(dbt_node.edge_offset, dbt_node.data_link_offset,
+                    dbt_node.data_offset);
             }
             data_size += dbt_node.data_size;
         }
     }
 
     header->excep_updating_status = 0;
+    rc_done_index = rc_node_index;
+    // The progress is saved when the pending data moves are done.
+    if (pending_moves.empty())
+        header->rc_progress = rc_done_index;
 
-    if (async_writer_ptr != NULL) {
+    if (async_writer_ptr != NULL && !incremental) {
         if (rc_loop_counter++ > RC_TASK_CHECK) {
             rc_loop_counter = 0;
             async_writer_ptr->ProcessTask(NUM_ASYNC_TASK, true);
@@ -440,19 +789,30 @@ void ResourceCollection::DoTask(int phase, DBTraverseNode& dbt_node)
     }
 }
 
-void ResourceCollection::ReorderBuffers()
+// Account for the buffers moved before the writer exited abnormally.
+void ResourceCollection::SkipBuffers(DBTraverseNode& dbt_node)
 {
-    if (rc_type & RESOURCE_COLLECTION_TYPE_INDEX)
-        Logger::Log(LOG_LEVEL_INFO, "index size before reorder: %llu", header->m_index_offset);
-    if (rc_type & RESOURCE_COLLECTION_TYPE_DATA)
-        Logger::Log(LOG_LEVEL_INFO, "data size before reorder: %llu", header->m_data_offset);
-
-    db_cnt = 0;
-    edge_str_size = 0;
-    node_cnt = 0;
+    if (rc_type & RESOURCE_COLLECTION_TYPE_INDEX) {
+        if (dbt_node.buffer_type & BUFFER_TYPE_NODE) {
+            index_size = dmm->CheckAlignment(index_size, dbt_node.node_size);
+            index_size += dbt_node.node_size;
+        }
+        if (dbt_node.buffer_type & BUFFER_TYPE_EDGE_STR) {
+            index_size = dmm->CheckAlignment(index_size, dbt_node.edgestr_size);
+            index_size += dbt_node.edgestr_size;
+        }
+    }
 
-    TraverseDB(RESOURCE_COLLECTION_PHASE_REORDER);
+    if (rc_type & RESOURCE_COLLECTION_TYPE_DATA) {
+        if (dbt_node.buffer_type & BUFFER_TYPE_DATA) {
+            data_size = dict->CheckAlignment(data_size, dbt_node.data_size);
+            data_size += dbt_node.data_size;
+        }
+    }
+}
 
+void ResourceCollection::EndReorder()
+{
     if (rc_type & RESOURCE_COLLECTION_TYPE_INDEX)
         Logger::Log(LOG_LEVEL_INFO, "index size after reorder: %llu", header->m_index_offset);
     if (rc_type & RESOURCE_COLLECTION_TYPE_DATA)
@@ -482,9 +842,28 @@ void ResourceCollection::ProcessRCTree()
     int count = 0;
     int rval;
     DB db_itr(db_ref);
+    // Remove the main tree entries of the tombstones first. Queued updates are
+    // run on the main tree while the rest of the rc tree is added below.
     for (DB::iterator iter = db_itr.begin(false, true); iter != db_itr.end(); ++iter) {
-        iter.value.options = 0;
-        rval = dict->Add((const uint8_t*)iter.key.data(), iter.key.size(), iter.value, true);
+        if (iter.value.Expired())
+            dict->RemoveTombstone_RC((const uint8_t*)iter.key.data(), iter.key.size());
+    }
+
+    for (DB::iterator iter = db_itr.begin(false, true); iter != db_itr.end(); ++iter) {
+        // The iterator loads the entries of a node at once. Queued updates
+        // processed below remove entries from the rc tree after they are
+        // loaded.
+        if (!dict->InTree_RC((const uint8_t*)iter.key.data(), iter.key.size()))
+            continue;
+        // Updates in the rc tree have been logged already.
+        if (iter.value.Expired()) {
+            rval = dict->RemoveTombstone_RC((const uint8_t*)iter.key.data(), iter.key.size());
+            if (rval == MBError::NOT_EXIST)
+                rval = MBError::SUCCESS;
+        } else {
+            iter.value.options = CONSTS::OPTION_NO_REDO_LOG;
+            rval = dict->Add((const uint8_t*)iter.key.data(), iter.key.size(), iter.value, true);
+        }
         if (rval != MBError::SUCCESS)
             Logger::Log(LOG_LEVEL_WARN, "failed to add: %s", MBError::get_error_str(rval));
         if (count++ > RC_TASK_CHECK) {
@@ -515,8 +894,32 @@ int ResourceCollection::ExceptionRecovery()
     if (!db_ref.is_open())
         return db_ref.Status();
 
-    int rval = MBError::SUCCESS;
-    if (header->rc_m_index_off_pre != 0 && header->rc_m_data_off_pre != 0) {
+    // Finish or undo the update the writer was doing when it exited.
+    int rval = dict->ExceptionRecovery();
+    if (rval != MBError::SUCCESS)
+        return rval;
+    // Updates taken during the rc, including tombstones of the removed main
+    // tree entries, are added to the main tree after the buffers are in place.
+    std::vector<RCTreeEntry> rc_entries;
+    if (header->rc_root_offset.load(std::memory_order_relaxed) != 0)
+        LoadRCTree(rc_entries);
+
+    if (header->rc_phase != 0) {
+        Logger::Log(LOG_LEVEL_WARN, "previous rc was not completed, resuming phase %u from buffer %lld",
+            header->rc_phase, header->rc_progress);
+        try {
+            Resume();
+            while (!RunDefragStep(0)) {
+            }
+        } catch (int err) {
+            rval = err;
+        }
+
+        if (rval != MBError::SUCCESS) {
+            Logger::Log(LOG_LEVEL_ERROR, "failed to resume rc: %s, clear db!!!", MBError::get_error_str(rval));
+            dict->RemoveAll();
+        }
+    } else if (header->rc_m_index_off_pre != 0 && header->rc_m_data_off_pre != 0) {
         Logger::Log(LOG_LEVEL_WARN, "previous rc was not completed successfully, retrying...");
         try {
             // This is a blocking call and should be called when writer starts up.
@@ -534,8 +937,49 @@ int ResourceCollection::ExceptionRecovery()
 
     header->rc_root_offset = 0;
     header->rc_count = 0;
+    header->rc_phase = 0;
+    header->rc_progress = 0;
 
+    if (rval == MBError::SUCCESS)
+        AddRCTreeEntries(rc_entries);
     return rval;
 }
 
+void ResourceCollection::LoadRCTree(std::vector<RCTreeEntry>& entries)
+{
+    DB db_itr(db_ref);
+    for (DB::iterator iter = db_itr.begin(false, true); iter != db_itr.end(); ++iter) {
+        RCTreeEntry entry;
+        entry.key = iter.key;
+        entry.value.assign((const char*)iter.value.buff, iter.value.data_len);
+        entry.expire_time = iter.value.expire_time;
+        entries.push_back(std::move(entry));
+    }
+    Logger::Log(LOG_LEVEL_INFO, "loaded %llu entries from the rc tree", entries.size());
+}
+
+void ResourceCollection::AddRCTreeEntries(const std::vector<RCTreeEntry>& entries)
+{
+    int rval;
+    MBData data;
+    for (const RCTreeEntry& entry : entries) {
+        const uint8_t* key = (const uint8_t*)entry.key.data();
+        data.Clear();
+        data.expire_time = entry.expire_time;
+        if (data.Expired()) {
+            rval = dict->RemoveTombstone_RC(key, entry.key.size());
+            if (rval == MBError::NOT_EXIST)
+                rval = MBError::SUCCESS;
+        } else {
+            data.options = CONSTS::OPTION_NO_REDO_LOG;
+            data.buff = (uint8_t*)entry.value.data();
+            data.data_len = entry.value.size();
+            rval = dict->Add(key, entry.key.size(), data, true);
+            data.buff = NULL;
+        }
+        if (rval != MBError::SUCCESS)
+            Logger::Log(LOG_LEVEL_WARN, "failed to add rc tree entry: %s", MBError::get_error_str(rval));
+    }
+}
+
 }
@@ -19,7 +19,11 @@
 #ifndef __MB_RC_H__
 #define __MB_RC_H__
 
+#include <string>
+#include <vector>
+
 #include "async_writer.h"
+#include "copy_pool.h"
 #include "db.h"
 #include "dict.h"
 #include "mbt_base.h"
@@ -32,6 +36,24 @@
 
 namespace mabain {
 
+// A data buffer to be moved by the copy pool
+typedef struct _RCDataMove {
+    size_t edge_offset;
+    size_t link_offset;
+    size_t offset_src;
+    size_t offset_dst;
+    int size;
+    bool mapped;
+} RCDataMove;
+
+// An update in the rc tree left by a writer that exited during resource
+// collection
+typedef struct _RCTreeEntry {
+    std::string key;
+    std::string value;
+    uint32_t expire_time;
+} RCTreeEntry;
+
 // A garbage collector class
 class ResourceCollection : public DBTraverseBase {
 public:
@@ -42,20 +64,41 @@ public:
     void ReclaimResource(int64_t min_index_size, int64_t min_data_size,
         int64_t max_dbsz, int64_t max_dbcnt,
         AsyncWriter* awr = NULL);
+    // Start the defragmentation that is run in steps by RunDefragStep. Eviction
+    // is run here if needed. Throws MBError::RC_SKIPPED if there is nothing to
+    // collect.
+    void StartDefrag(int64_t min_index_size, int64_t min_data_size,
+        int64_t max_dbsz, int64_t max_dbcnt, AsyncWriter* awr);
+    // Relocate buffers for step_time microseconds, or until done if step_time
+    // is zero. Returns true when the defragmentation is done.
+    bool RunDefragStep(int64_t step_time);
 
     // This function should be called when writer starts up.
     int ExceptionRecovery();
 
 private:
     void DoTask(int phase, DBTraverseNode& dbt_node);
+    void Evict(int64_t max_dbsz, int64_t max_dbcnt);
     void Prepare(int64_t min_index_size, int64_t min_data_size);
-    void CollectBuffers();
-    void ReorderBuffers();
+    void InitCollection();
+    void Resume();
+    void StartPhase();
+    void SkipBuffers(DBTraverseNode& dbt_node);
+    void EndReorder();
+    void EndCollect();
     void Finish();
     bool MoveIndexBuffer(int phase, size_t& offset_src, int size);
     bool MoveDataBuffer(int phase, size_t& offset_src, int size);
+    void UpdateDataLink(size_t edge_offset, size_t link_offset, size_t data_offset);
+    void QueueDataMove(DBTraverseNode& dbt_node);
+    void FlushDataMoves();
     int LRUEviction(int64_t max_dbsz, int64_t max_dbcnt);
+    int PruneFromLog(EvictionLog* evict_log, uint16_t prune_diff, int64_t& pruned);
+    int AccessEviction(int64_t max_dbsz, int64_t max_dbcnt);
+    int ProcessAsyncTasks(int64_t& count);
     void ProcessRCTree();
+    void LoadRCTree(std::vector<RCTreeEntry>& entries);
+    void AddRCTreeEntries(const std::vector<RCTreeEntry>& entries);
 
     int rc_type;
     int index_rc_status;
@@ -69,12 +112,27 @@ private:
 
     // Async writer pointer
     AsyncWriter* async_writer_ptr;
+    // Run in steps by the async writer
+    bool incremental;
+    // Buffers visited in the current phase
+    int64_t rc_node_index;
+    // Buffers done in the current phase, including the pending data moves
+    int64_t rc_done_index;
+    int64_t defrag_start;
 
     // resource collection offsets
     size_t rc_index_offset;
     size_t rc_data_offset;
     int64_t rc_loop_counter;
 
+    // Data buffers are copied in parallel in the collect phase if not NULL.
+    CopyPool* copy_pool;
+    std::vector<RCDataMove> pending_moves;
+    std::vector<CopyTask> copy_tasks;
+    size_t pending_min_src;
+    int64_t copy_batch_cnt;
+    int64_t copy_buffer_cnt;
+
     int64_t db_cnt;
     size_t edge_str_size;
     int64_t node_cnt;
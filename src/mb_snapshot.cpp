@@ -0,0 +1,286 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "dict.h"
+#include "logger.h"
+#include "resource_pool.h"
+#include "version.h"
+
+// A snapshot has the same files as a DB on disk: the header, the index and
+// data blocks and the free lists. Only the used part of the blocks is written
+// and read. The blocks are copied in chunks by several threads.
+
+#define MB_SNAPSHOT_MAX_THREAD 32
+#define MB_SNAPSHOT_CHUNK_SIZE (16 * 1024 * 1024)
+
+namespace mabain {
+
+typedef struct _SnapshotChunk {
+    int fd;
+    uint8_t* addr;
+    size_t size;
+    off_t offset;
+} SnapshotChunk;
+
+static void copy_chunks(const std::vector<SnapshotChunk>& chunks, bool dump,
+    std::atomic<size_t>& next, std::atomic<int>& status)
+{
+    size_t index;
+    while ((index = next.fetch_add(1, std::memory_order_relaxed)) < chunks.size()) {
+        const SnapshotChunk& chunk = chunks[index];
+        size_t done = 0;
+        while (done < chunk.size) {
+            ssize_t len;
+            if (dump)
+                len = pwrite(chunk.fd, chunk.addr + done, chunk.size - done, chunk.offset + done);
+            else
+                len = pread(chunk.fd, chunk.addr + done, chunk.size - done, chunk.offset + done);
+            if (len <= 0) {
+                Logger::Log(LOG_LEVEL_ERROR, "snapshot %s failed at offset %llu: %d",
+                    dump ? "write" : "read", chunk.offset + done, errno);
+                status.store(dump ? MBError::WRITE_ERROR : MBError::READ_ERROR,
+                    std::memory_order_relaxed);
+                return;
+            }
+            done += len;
+        }
+    }
+}
+
+// Split the blocks into chunks and copy them with num_threads threads. The
+// block files are opened, and created for dump, by the calling thread.
+static int copy_blocks(const std::string& path,
+    const std::vector<std::pair<uint8_t*, size_t>>& blocks, size_t block_size,
+    std::vector<SnapshotChunk>& chunks, std::vector<int>& fds, bool dump)
+{
+    for (size_t order = 0; order < blocks.size(); order++) {
+        std::string block_path = path + std::to_string(order);
+        int fd;
+        if (dump)
+            fd = open(block_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        else
+            fd = open(block_path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            Logger::Log(LOG_LEVEL_ERROR, "cannot open file %s: %d", block_path.c_str(), errno);
+            return MBError::OPEN_FAILURE;
+        }
+        fds.push_back(fd);
+        // Block files have the full block size so that the snapshot can be
+        // opened as a DB on disk.
+        if (dump && ftruncate(fd, block_size) != 0) {
+            Logger::Log(LOG_LEVEL_ERROR, "cannot resize file %s: %d", block_path.c_str(), errno);
+            return MBError::WRITE_ERROR;
+        }
+        for (size_t off = 0; off < blocks[order].second; off += MB_SNAPSHOT_CHUNK_SIZE) {
+            size_t len = blocks[order].second - off;
+            if (len > MB_SNAPSHOT_CHUNK_SIZE)
+                len = MB_SNAPSHOT_CHUNK_SIZE;
+            chunks.push_back({ fd, blocks[order].first + off, len, (off_t)off });
+        }
+    }
+
+    if (dump) {
+        // Remove the blocks left by a larger snapshot.
+        for (size_t order = blocks.size(); unlink((path + std::to_string(order)).c_str()) == 0;
+             order++) {
+        }
+    }
+    return MBError::SUCCESS;
+}
+
+static int run_copy(const std::vector<SnapshotChunk>& chunks, int num_threads, bool dump)
+{
+    if (num_threads <= 0)
+        num_threads = std::thread::hardware_concurrency();
+    if (num_threads <= 0)
+        num_threads = 1;
+    if (num_threads > MB_SNAPSHOT_MAX_THREAD)
+        num_threads = MB_SNAPSHOT_MAX_THREAD;
+    if (num_threads > (int)chunks.size())
+        num_threads = chunks.size();
+
+    std::atomic<size_t> next(0);
+    std::atomic<int> status(MBError::SUCCESS);
+    std::vector<std::thread> threads;
+    for (int i = 1; i < num_threads; i++) {
+        threads.push_back(std::thread(copy_chunks, std::cref(chunks), dump, std::ref(next),
+            std::ref(status)));
+    }
+    copy_chunks(chunks, dump, next, status);
+    for (auto& th : threads)
+        th.join();
+    return status.load(std::memory_order_relaxed);
+}
+
+static void close_files(const std::vector<int>& fds)
+{
+    for (int fd : fds)
+        close(fd);
+}
+
+int Dict::DumpSnapshot(const std::string& snapshot_dir, int num_threads)
+{
+    if (!(options & CONSTS::MEMORY_ONLY_MODE) || !(options & CONSTS::ACCESS_MODE_WRITER)
+        || (options & CONSTS::OPTION_JEMALLOC))
+        return MBError::NOT_ALLOWED;
+    if (mkdir(snapshot_dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        Logger::Log(LOG_LEVEL_ERROR, "cannot create directory %s: %d", snapshot_dir.c_str(),
+            errno);
+        return MBError::OPEN_FAILURE;
+    }
+    std::string header_path = snapshot_dir + "/_mabain_h";
+    // The previous snapshot cannot be loaded once its blocks are overwritten.
+    if (unlink(header_path.c_str()) != 0 && errno != ENOENT)
+        return MBError::WRITE_ERROR;
+
+    std::vector<std::pair<uint8_t*, size_t>> index_blocks;
+    std::vector<std::pair<uint8_t*, size_t>> data_blocks;
+    mm.GetRollableFile()->GetMappedBlocks(header->m_index_offset, index_blocks);
+    kv_file->GetMappedBlocks(header->m_data_offset, data_blocks);
+    size_t index_block_size = header->index_block_size;
+    size_t data_block_size = header->data_block_size;
+    if (index_blocks.size() != (header->m_index_offset + index_block_size - 1) / index_block_size
+        || data_blocks.size() != (header->m_data_offset + data_block_size - 1) / data_block_size)
+        return MBError::MMAP_FAILED;
+
+    std::vector<SnapshotChunk> chunks;
+    std::vector<int> fds;
+    int rval = copy_blocks(snapshot_dir + "/_mabain_i", index_blocks, index_block_size, chunks,
+        fds, true);
+    if (rval == MBError::SUCCESS) {
+        rval = copy_blocks(snapshot_dir + "/_mabain_d", data_blocks, data_block_size, chunks,
+            fds, true);
+    }
+    if (rval == MBError::SUCCESS)
+        rval = run_copy(chunks, num_threads, true);
+    for (size_t i = 0; i < fds.size() && rval == MBError::SUCCESS; i++) {
+        if (fdatasync(fds[i]) != 0)
+            rval = MBError::WRITE_ERROR;
+    }
+    close_files(fds);
+    if (rval == MBError::SUCCESS)
+        rval = mm.GetFreeList()->Dump(snapshot_dir + "/_ibfl");
+    if (rval == MBError::SUCCESS)
+        rval = free_lists->Dump(snapshot_dir + "/_dbfl");
+    if (rval != MBError::SUCCESS)
+        return rval;
+
+    // The header is written last so that the snapshot is only loaded if it is
+    // complete.
+    std::vector<uint8_t> buff(RollableFile::page_size);
+    memcpy(buff.data(), reinterpret_cast<uint8_t*>(header), buff.size());
+    IndexHeader* hdr = reinterpret_cast<IndexHeader*>(buff.data());
+    hdr->num_writer = 0;
+    hdr->num_reader = 0;
+    hdr->spill_in_use = 0;
+    std::string tmp_path = header_path + ".tmp";
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return MBError::OPEN_FAILURE;
+    if (write(fd, buff.data(), buff.size()) != (ssize_t)buff.size() || fdatasync(fd) != 0)
+        rval = MBError::WRITE_ERROR;
+    close(fd);
+    if (rval == MBError::SUCCESS && rename(tmp_path.c_str(), header_path.c_str()) != 0)
+        rval = MBError::WRITE_ERROR;
+    if (rval != MBError::SUCCESS) {
+        Logger::Log(LOG_LEVEL_ERROR, "cannot write file %s: %d", header_path.c_str(), errno);
+        return rval;
+    }
+
+    Logger::Log(LOG_LEVEL_INFO, "dumped snapshot of %llu index and %llu data bytes to %s",
+        header->m_index_offset, header->m_data_offset, snapshot_dir.c_str());
+    return MBError::SUCCESS;
+}
+
+void Dict::LoadSnapshotHeader(const std::string& snapshot_dir, const std::string& mbdir,
+    int mode)
+{
+    std::string header_path = snapshot_dir + "/_mabain_h";
+    uint16_t hdr_ver[4];
+    ReadHeaderVersion(header_path, hdr_ver);
+    if (hdr_ver[0] != version[0] || hdr_ver[1] != version[1]) {
+        Logger::Log(LOG_LEVEL_ERROR, "snapshot version %u.%u.%u does not match library "
+                                     "version %u.%u.%u",
+            hdr_ver[0], hdr_ver[1], hdr_ver[2], version[0], version[1], version[2]);
+        throw(int) MBError::VERSION_MISMATCH;
+    }
+
+    // The header is mapped here and picked up from the resource pool when the
+    // DB is opened.
+    bool map_hdr = true;
+    std::shared_ptr<MmapFileIO> header_file = ResourcePool::getInstance().OpenFile(
+        mbdir + "_mabain_h", mode, RollableFile::page_size, map_hdr, true);
+    if (header_file == NULL || !map_hdr)
+        throw(int) MBError::MMAP_FAILED;
+    ReadHeader(header_path, header_file->GetMapAddr(), RollableFile::page_size);
+}
+
+int Dict::LoadSnapshot(const std::string& snapshot_dir, int num_threads)
+{
+    if (!(options & CONSTS::MEMORY_ONLY_MODE) || !(options & CONSTS::ACCESS_MODE_WRITER)
+        || (options & CONSTS::OPTION_JEMALLOC))
+        return MBError::NOT_ALLOWED;
+
+    // The blocks are created by this thread. They cannot be created beyond
+    // the memcaps.
+    std::vector<std::pair<uint8_t*, size_t>> index_blocks;
+    std::vector<std::pair<uint8_t*, size_t>> data_blocks;
+    mm.GetRollableFile()->GetMappedBlocks(header->m_index_offset, index_blocks);
+    kv_file->GetMappedBlocks(header->m_data_offset, data_blocks);
+    size_t index_block_size = header->index_block_size;
+    size_t data_block_size = header->data_block_size;
+    if (index_blocks.size() != (header->m_index_offset + index_block_size - 1) / index_block_size
+        || data_blocks.size() != (header->m_data_offset + data_block_size - 1) / data_block_size) {
+        Logger::Log(LOG_LEVEL_ERROR, "snapshot %s does not fit in the memcaps",
+            snapshot_dir.c_str());
+        return MBError::NO_MEMORY;
+    }
+
+    std::vector<SnapshotChunk> chunks;
+    std::vector<int> fds;
+    int rval = copy_blocks(snapshot_dir + "/_mabain_i", index_blocks, index_block_size, chunks,
+        fds, false);
+    if (rval == MBError::SUCCESS) {
+        rval = copy_blocks(snapshot_dir + "/_mabain_d", data_blocks, data_block_size, chunks,
+            fds, false);
+    }
+    if (rval == MBError::SUCCESS)
+        rval = run_copy(chunks, num_threads, false);
+    close_files(fds);
+    if (rval == MBError::SUCCESS)
+        rval = mm.GetFreeList()->Load(snapshot_dir + "/_ibfl");
+    if (rval == MBError::SUCCESS)
+        rval = free_lists->Load(snapshot_dir + "/_dbfl");
+    if (rval != MBError::SUCCESS)
+        return rval;
+
+    Logger::Log(LOG_LEVEL_INFO, "loaded snapshot of %llu index and %llu data bytes from %s",
+        header->m_index_offset, header->m_data_offset, snapshot_dir.c_str());
+    return MBError::SUCCESS;
+}
+
+}
@@ -0,0 +1,162 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <atomic>
+#include <deque>
+#include <sys/mman.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "dict.h"
+#include "integer_4b_5b.h"
+#include "logger.h"
+#include "mb_warmup.h"
+
+namespace mabain {
+
+typedef std::vector<std::pair<uint8_t*, size_t>> WarmupChunks;
+
+// Fault in the pages of a mapped range. MADV_POPULATE_READ does it in one
+// call on newer kernels. Otherwise the readahead is started with
+// MADV_WILLNEED and one byte of each page is read.
+static void prefault_range(uint8_t* addr, size_t size)
+{
+#ifdef MADV_POPULATE_READ
+    if (madvise(addr, size, MADV_POPULATE_READ) == 0)
+        return;
+#endif
+    madvise(addr, size, MADV_WILLNEED);
+    volatile uint8_t sum = 0;
+    for (size_t off = 0; off < size; off += RollableFile::page_size)
+        sum += addr[off];
+    (void)sum;
+}
+
+static void prefault_chunks(const WarmupChunks& chunks, std::atomic<size_t>& next,
+    std::atomic<size_t>& done, const WarmupProgress* progress, size_t total)
+{
+    size_t index;
+    while ((index = next.fetch_add(1, std::memory_order_relaxed)) < chunks.size()) {
+        prefault_range(chunks[index].first, chunks[index].second);
+        size_t curr = done.fetch_add(chunks[index].second, std::memory_order_relaxed)
+            + chunks[index].second;
+        if (progress != NULL)
+            (*progress)(curr, total);
+    }
+}
+
+// Read the top levels of the trie breadth first so that the nodes visited by
+// every lookup are in memory before the rest of the index is prefaulted.
+// Returns the number of nodes read.
+size_t DictMem::WarmupTopLevels(size_t max_nodes) const
+{
+    std::deque<size_t> nodes;
+    uint8_t node_buff[NODE_EDGE_KEY_FIRST + NUM_ALPHABET];
+    uint8_t edge_buff[NUM_ALPHABET * EDGE_SIZE];
+    uint8_t str_buff[CONSTS::MAX_KEY_LENGHTH];
+    size_t index_size = header->m_index_offset;
+    size_t count = 0;
+
+    nodes.push_back(root_offset);
+    while (!nodes.empty() && count < max_nodes) {
+        size_t node_off = nodes.front();
+        nodes.pop_front();
+        if (ReadData(node_buff, NODE_EDGE_KEY_FIRST, node_off) != NODE_EDGE_KEY_FIRST)
+            continue;
+        int nt = node_buff[1] + 1;
+        int edge_size = nt * EDGE_SIZE;
+        if (ReadData(edge_buff, edge_size, node_off + NODE_EDGE_KEY_FIRST + nt) != edge_size)
+            continue;
+        count++;
+
+        for (int i = 0; i < nt; i++) {
+            const uint8_t* edge = edge_buff + i * EDGE_SIZE;
+            int len = edge[EDGE_LEN_POS];
+            if (len > LOCAL_EDGE_LEN)
+                ReadData(str_buff, len - 1, Get5BInteger(edge));
+            if (edge[EDGE_FLAG_POS] & EDGE_FLAG_DATA_OFF)
+                continue;
+            // The DB can be updated during the warm-up. Skip links that are
+            // out of range.
+            size_t child_off = Get6BInteger(edge + EDGE_FLAG_POS + 1);
+            if (child_off != 0 && child_off < index_size)
+                nodes.push_back(child_off);
+        }
+    }
+    return count;
+}
+
+int Dict::Warmup(int warmup_options, int num_threads, const WarmupProgress& progress)
+{
+    // The sizes of the index and data are not kept in the header in jemalloc mode.
+    if (options & CONSTS::OPTION_JEMALLOC)
+        return MBError::NOT_ALLOWED;
+    if (num_threads <= 0)
+        num_threads = std::thread::hardware_concurrency();
+    if (num_threads <= 0)
+        num_threads = 1;
+    if (num_threads > MB_WARMUP_MAX_THREAD)
+        num_threads = MB_WARMUP_MAX_THREAD;
+
+    size_t num_nodes = 0;
+    if (warmup_options & MB_WARMUP_INDEX)
+        num_nodes = mm.WarmupTopLevels(MB_WARMUP_TOP_NODES);
+
+    // Blocks are opened and mapped by this thread. The worker threads only
+    // read the mapped memory.
+    WarmupChunks blocks;
+    if (warmup_options & MB_WARMUP_INDEX)
+        mm.GetRollableFile()->GetMappedBlocks(header->m_index_offset, blocks);
+    if (warmup_options & MB_WARMUP_DATA)
+        kv_file->GetMappedBlocks(header->m_data_offset, blocks);
+
+    WarmupChunks chunks;
+    size_t total = 0;
+    for (auto& block : blocks) {
+        for (size_t off = 0; off < block.second; off += MB_WARMUP_CHUNK_SIZE) {
+            size_t len = block.second - off;
+            if (len > MB_WARMUP_CHUNK_SIZE)
+                len = MB_WARMUP_CHUNK_SIZE;
+            chunks.push_back(std::make_pair(block.first + off, len));
+            total += len;
+        }
+    }
+    if (num_threads > (int)chunks.size())
+        num_threads = chunks.size();
+
+    // Progress is only reported in the calling thread.
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> done(0);
+    std::vector<std::thread> threads;
+    for (int i = 1; i < num_threads; i++) {
+        threads.push_back(std::thread(prefault_chunks, std::cref(chunks), std::ref(next),
+            std::ref(done), nullptr, total));
+    }
+    prefault_chunks(chunks, next, done, progress ? &progress : NULL, total);
+    for (auto& th : threads)
+        th.join();
+    if (progress)
+        progress(total, total);
+
+    Logger::Log(LOG_LEVEL_INFO, "warmed up %llu trie nodes and %llu bytes with %d threads",
+        num_nodes, total, num_threads);
+    return MBError::SUCCESS;
+}
+
+}
@@ -0,0 +1,46 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __MB_WARMUP_H__
+#define __MB_WARMUP_H__
+
+#include <functional>
+#include <stddef.h>
+
+namespace mabain {
+
+// Warm-up options for DB::Warmup and MBConfig::warmup_options
+// Prefault the index blocks
+#define MB_WARMUP_INDEX 0x1
+// Prefault the data blocks
+#define MB_WARMUP_DATA 0x2
+
+#define MB_WARMUP_MAX_THREAD 32
+// The mapped blocks are prefaulted in chunks of this size.
+#define MB_WARMUP_CHUNK_SIZE (4 * 1024 * 1024)
+// Maximal number of trie nodes read breadth first before the blocks are
+// prefaulted
+#define MB_WARMUP_TOP_NODES 65536
+
+// Called by DB::Warmup with the number of bytes prefaulted so far and the
+// total number of bytes to prefault.
+typedef std::function<void(size_t done, size_t total)> WarmupProgress;
+
+}
+
+#endif
@@ -24,6 +24,7 @@ namespace mabain {
 DBTraverseBase::DBTraverseBase(const DB& db)
     : db_ref(db)
     , rw_buffer(NULL)
+    , traverse_iter(NULL)
 {
     if (!(db.GetDBOptions() & CONSTS::ACCESS_MODE_WRITER))
         throw(int) MBError::NOT_ALLOWED;
@@ -60,28 +61,52 @@ DBTraverseBase::~DBTraverseBase()
 {
     if (rw_buffer != NULL)
         delete[] rw_buffer;
+    if (traverse_iter != NULL)
+        delete traverse_iter;
 }
 
 void DBTraverseBase::TraverseDB(int arg)
 {
-    DB::iterator iter = DB::iterator(db_ref, DB_ITER_STATE_INIT);
-    int rval = iter.init_no_next();
+    StartTraverse();
+    while (ContinueTraverse(arg, INT64_MAX)) {
+    }
+}
+
+void DBTraverseBase::StartTraverse()
+{
+    if (traverse_iter != NULL)
+        delete traverse_iter;
+    traverse_iter = new DB::iterator(db_ref, DB_ITER_STATE_INIT);
+    int rval = traverse_iter->init_no_next();
     if (rval != MBError::SUCCESS)
         throw rval;
 
-    DBTraverseNode dbt_node;
     index_size = dmm->GetRootOffset() + dmm->GetNodeSizePtr()[NUM_ALPHABET - 1];
     data_size = dict->GetStartDataOffset();
-    while (iter.next_dbt_buffer(&dbt_node)) {
+}
+
+bool DBTraverseBase::ContinueTraverse(int arg, int64_t max_nodes)
+{
+    if (traverse_iter == NULL)
+        return false;
+
+    DBTraverseNode dbt_node;
+    for (int64_t i = 0; i < max_nodes; i++) {
+        if (!traverse_iter->next_dbt_buffer(&dbt_node)) {
+            delete traverse_iter;
+            traverse_iter = NULL;
+            return false;
+        }
         GetAlignmentSize(dbt_node);
 
         // Run-time determination
         DoTask(arg, dbt_node);
 
         if (dbt_node.buffer_type & BUFFER_TYPE_NODE) {
-            iter.add_node_offset(dbt_node.node_offset);
+            traverse_iter->add_node_offset(dbt_node.node_offset);
         }
     }
+    return true;
 }
 
 void DBTraverseBase::GetAlignmentSize(DBTraverseNode& dbt_node) const
@@ -97,7 +122,7 @@ void DBTraverseBase::GetAlignmentSize(DBTraverseNode& dbt_node) const
         if (dict->ReadData((uint8_t*)&data_size[0], DATA_HDR_BYTE, dbt_node.data_offset)
             != DATA_HDR_BYTE)
             throw(int) MBError::READ_ERROR;
-        dbt_node.data_size = data_free_lists->GetAlignmentSize(data_size[0] + DATA_HDR_BYTE);
+        dbt_node.data_size = data_free_lists->GetAlignmentSize(DataBufferSize(data_size[0]));
     }
 }
 
@@ -108,6 +133,7 @@ void DBTraverseBase::BufferCopy(size_t offset_dst, uint8_t* ptr_dst,
     if (ptr_src != NULL) {
         if (ptr_dst != NULL) {
             memcpy(ptr_dst, ptr_src, size);
+            drm->MarkDirty(offset_dst, size);
         } else {
             drm->WriteData(ptr_src, size, offset_dst);
         }
@@ -119,6 +145,7 @@ void DBTraverseBase::BufferCopy(size_t offset_dst, uint8_t* ptr_dst,
 
         if (ptr_dst != NULL) {
             memcpy(ptr_dst, rw_buffer, size);
+            drm->MarkDirty(offset_dst, size);
         } else {
             drm->WriteData(rw_buffer, size, offset_dst);
         }
@@ -48,6 +48,12 @@ public:
     void TraverseDB(int arg = 0);
 
 protected:
+    // Start a DFS traversal that is run in steps by ContinueTraverse. The
+    // traversal must not be continued after the DB is updated.
+    void StartTraverse();
+    // Run DoTask on at most max_nodes buffers. Returns false if the traversal
+    // is done.
+    bool ContinueTraverse(int arg, int64_t max_nodes);
     virtual void DoTask(int arg, DBTraverseNode& dbt_node) = 0;
     void BufferCopy(size_t offset_dst, uint8_t* ptr_dst,
         size_t offset_src, const uint8_t* ptr_src,
@@ -72,6 +78,7 @@ private:
 
     uint8_t* rw_buffer;
     int rw_buffer_size;
+    DB::iterator* traverse_iter;
 };
 
 }
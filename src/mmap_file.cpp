@@ -20,17 +20,85 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <stdio.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <unistd.h>
 
 #include "error.h"
 #include "file_io.h"
 #include "logger.h"
 #include "mmap_file.h"
 #include "rollable_file.h"
+#include "window_cache.h"
 
 namespace mabain {
 
+MmapRegion::MmapRegion(size_t blk_size, size_t num_blk, size_t alignment)
+    : addr(NULL)
+    , block_size(blk_size)
+    , num_block(num_blk)
+    , used(num_blk, false)
+{
+    size_t size = block_size * num_block;
+    size_t extra = alignment;
+    void* ptr = mmap(NULL, size + extra, PROT_NONE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (ptr == MAP_FAILED) {
+        Logger::Log(LOG_LEVEL_WARN, "failed to reserve %llu blocks of size %llu errno=%d",
+            num_block, block_size, errno);
+        return;
+    }
+    addr = static_cast<uint8_t*>(ptr);
+    if (extra > 0) {
+        // Give back the unaligned head and the rest of the tail.
+        size_t head = (alignment - (uintptr_t)addr % alignment) % alignment;
+        if (head > 0)
+            munmap(addr, head);
+        if (extra > head)
+            munmap(addr + head + size, extra - head);
+        addr += head;
+    }
+}
+
+MmapRegion::~MmapRegion()
+{
+    if (addr != NULL)
+        munmap(addr, block_size * num_block);
+}
+
+uint8_t* MmapRegion::GetAddr() const
+{
+    return addr;
+}
+
+size_t MmapRegion::GetBlockSize() const
+{
+    return block_size;
+}
+
+uint8_t* MmapRegion::AcquireBlock(size_t order)
+{
+    std::lock_guard<std::mutex> lock(region_mutex);
+    if (addr == NULL || order >= num_block || used[order])
+        return NULL;
+    used[order] = true;
+    return addr + order * block_size;
+}
+
+void MmapRegion::ReleaseBlock(size_t order)
+{
+    std::lock_guard<std::mutex> lock(region_mutex);
+    void* ptr = mmap(addr + order * block_size, block_size, PROT_NONE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+    if (ptr == MAP_FAILED) {
+        // Leave the slot used so that it is not mapped again.
+        Logger::Log(LOG_LEVEL_ERROR, "failed to reserve block %llu errno=%d", order, errno);
+        return;
+    }
+    used[order] = false;
+}
+
 MmapFileIO::MmapFileIO(const std::string& fpath, int mode, off_t filesize, bool sync)
     : FileIO(fpath, mode, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH, sync)
 {
@@ -39,10 +107,13 @@ MmapFileIO::MmapFileIO(const std::string& fpath, int mode, off_t filesize, bool
     mmap_start = 0xFFFFFFFFFFFFFFFF;
     mmap_end = 0;
     addr = nullptr;
+    region_order = 0;
     mm_meta = nullptr;
 
     max_offset = 0;
     curr_offset = 0;
+    window_mapped = false;
+    num_access = 0;
 
     if (options & MMAP_ANONYMOUS_MODE) {
         // Do not open file in anonymous mode.
@@ -75,6 +146,8 @@ MmapFileIO::~MmapFileIO()
     if (mm_meta != nullptr) {
         delete mm_meta;
     }
+    if (window_mapped)
+        WindowCache::getInstance().RemoveFile(this);
     UnMapFile();
 }
 
@@ -84,27 +157,59 @@ int MmapFileIO::InitMemoryManager()
     return MBError::SUCCESS;
 }
 
-uint8_t* MmapFileIO::MapFile(size_t size, off_t offset, bool sliding)
+uint8_t* MmapFileIO::MapFile(size_t size, off_t offset, bool sliding,
+    std::shared_ptr<MmapRegion> region, size_t block_order)
 {
     int mode = PROT_READ;
     if (options & O_RDWR)
         mode |= PROT_WRITE;
 
+    uint8_t* start = NULL;
+    int flags = MAP_SHARED;
+    bool hugetlb = false;
+    if (region != nullptr && !sliding && offset == 0 && size <= region->GetBlockSize())
+        start = region->AcquireBlock(block_order);
+    if (start != NULL)
+        flags |= MAP_FIXED;
+
     if (options & MMAP_ANONYMOUS_MODE) {
         assert(offset == 0 && !sliding);
-        addr = reinterpret_cast<unsigned char*>(mmap(NULL, size, mode,
-            MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+        addr = (unsigned char*)MAP_FAILED;
+        if (options & MMAP_HUGETLB_MODE) {
+            addr = reinterpret_cast<unsigned char*>(mmap(start, size, mode,
+                flags | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0));
+            if (addr != MAP_FAILED) {
+                hugetlb = true;
+            } else {
+                Logger::Log(LOG_LEVEL_WARN, "failed to map %s with huge pages errno=%d",
+                    path.c_str(), errno);
+            }
+        }
+        if (addr == MAP_FAILED) {
+            addr = reinterpret_cast<unsigned char*>(mmap(start, size, mode,
+                flags | MAP_ANONYMOUS, -1, 0));
+        }
     } else {
         addr = reinterpret_cast<unsigned char*>(FileIO::MapFile(size, mode,
-            MAP_SHARED, offset));
+            flags, offset, start));
     }
 
     if (addr == MAP_FAILED) {
         Logger::Log(LOG_LEVEL_WARN, "%s mmap (%s) failed errno=%d offset=%llu size=%llu",
             (options & MMAP_ANONYMOUS_MODE) ? "anon" : "",
             path.c_str(), errno, offset, size);
+        if (start != NULL)
+            region->ReleaseBlock(block_order);
         return NULL;
     }
+    if (start != NULL) {
+        map_region = region;
+        region_order = block_order;
+    }
+    if ((options & MMAP_HUGE_ADVISE_MODE) && !hugetlb && madvise(addr, size, MADV_HUGEPAGE) != 0) {
+        Logger::Log(LOG_LEVEL_WARN, "madvise huge page for %s failed errno=%d",
+            path.c_str(), errno);
+    }
 
     if (!sliding) {
         mmap_file = true;
@@ -124,11 +229,83 @@ uint8_t* MmapFileIO::MapFile(size_t size, off_t offset, bool sliding)
 void MmapFileIO::UnMapFile()
 {
     if (mmap_file && addr != NULL) {
-        munmap(addr, mmap_size);
+        if (map_region != nullptr) {
+            map_region->ReleaseBlock(region_order);
+            map_region.reset();
+        } else {
+            munmap(addr, mmap_size);
+        }
         addr = NULL;
     }
 }
 
+int MmapFileIO::MoveToFile(const std::string& dir, size_t size)
+{
+    if (!mmap_file || addr == NULL || !(options & MMAP_ANONYMOUS_MODE))
+        return MBError::NOT_ALLOWED;
+    if (size > mmap_size)
+        size = mmap_size;
+
+    std::string fpath = dir + "/_mabain_spill_XXXXXX";
+    std::vector<char> name(fpath.begin(), fpath.end());
+    name.push_back('\0');
+    int spill_fd = mkstemp(name.data());
+    if (spill_fd < 0) {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to create spill file in %s errno=%d",
+            dir.c_str(), errno);
+        return MBError::OPEN_FAILURE;
+    }
+    // The disk space is freed once the file is unmapped.
+    unlink(name.data());
+
+    int rval = MBError::SUCCESS;
+    if (ftruncate(spill_fd, mmap_size) != 0)
+        rval = MBError::WRITE_ERROR;
+#ifdef __linux__
+    // Reserve the space so that the writeback does not fail on a full disk.
+    else if (fallocate(spill_fd, 0, 0, mmap_size) != 0 && errno == ENOSPC)
+        rval = MBError::NO_RESOURCE;
+#endif
+    size_t copied = 0;
+    while (rval == MBError::SUCCESS && copied < size) {
+        ssize_t bytes = pwrite(spill_fd, addr + copied, size - copied, copied);
+        if (bytes <= 0)
+            rval = MBError::WRITE_ERROR;
+        else
+            copied += bytes;
+    }
+    if (rval == MBError::SUCCESS) {
+        int prot = PROT_READ;
+        if (options & O_RDWR)
+            prot |= PROT_WRITE;
+        void* ptr = mmap(addr, mmap_size, prot, MAP_SHARED | MAP_FIXED, spill_fd, 0);
+        if (ptr == MAP_FAILED)
+            rval = MBError::MMAP_FAILED;
+    }
+    close(spill_fd);
+    if (rval != MBError::SUCCESS) {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to spill %s to %s: %s errno=%d", path.c_str(),
+            dir.c_str(), MBError::get_error_str(rval), errno);
+        return rval;
+    }
+
+    options &= ~(MMAP_ANONYMOUS_MODE | MMAP_HUGETLB_MODE);
+    Logger::Log(LOG_LEVEL_DEBUG, "spilled %s to %s", path.c_str(), dir.c_str());
+    return rval;
+}
+
+bool MmapFileIO::IsAnonymous() const
+{
+    return options & MMAP_ANONYMOUS_MODE;
+}
+
+uint32_t MmapFileIO::TakeAccessCount()
+{
+    uint32_t count = num_access.load(std::memory_order_relaxed);
+    num_access.store(count / 2, std::memory_order_relaxed);
+    return count;
+}
+
 // SeqWrite:
 //     find the current offset first
 //     call RandomWrite using the offset
@@ -293,6 +470,60 @@ bool MmapFileIO::IsMapped() const
     return mmap_file;
 }
 
+uint8_t* MmapFileIO::MapWindow(size_t size, off_t offset)
+{
+    void* ptr = FileIO::MapFile(size, PROT_READ, MAP_SHARED, offset);
+    if (ptr == MAP_FAILED) {
+        Logger::Log(LOG_LEVEL_WARN, "failed to map window of %s errno=%d offset=%llu size=%llu",
+            path.c_str(), errno, offset, size);
+        return NULL;
+    }
+    window_mapped = true;
+    return reinterpret_cast<uint8_t*>(ptr);
+}
+
+// Look up the mapping in /proc/self/smaps. Pages of hugetlb mappings are
+// shown in KernelPageSize and transparent huge pages in the PMD mapped sizes.
+bool MmapFileIO::HugePageMapped() const
+{
+    if (!mmap_file || addr == NULL)
+        return false;
+
+    FILE* fp = fopen("/proc/self/smaps", "r");
+    if (fp == NULL)
+        return false;
+
+    char line[256];
+    bool found = false;
+    bool huge = false;
+    unsigned long start, end;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+            if (found)
+                break;
+            found = (start == (unsigned long)addr);
+            continue;
+        }
+        if (!found)
+            continue;
+
+        char name[64];
+        unsigned long kb;
+        if (sscanf(line, "%63[^:]: %lu kB", name, &kb) != 2)
+            continue;
+        if (strcmp(name, "KernelPageSize") == 0) {
+            if (kb * 1024 > (unsigned long)RollableFile::page_size)
+                huge = true;
+        } else if (strcmp(name, "AnonHugePages") == 0 || strcmp(name, "ShmemPmdMapped") == 0
+            || strcmp(name, "FilePmdMapped") == 0) {
+            if (kb > 0)
+                huge = true;
+        }
+    }
+    fclose(fp);
+    return huge;
+}
+
 uint8_t* MmapFileIO::GetMapAddr() const
 {
     return addr;
@@ -308,4 +539,23 @@ void MmapFileIO::Flush()
     FileIO::Flush();
 }
 
+// Sync the given range of the file only. Falls back to syncing the whole file
+// if the range is not within the mapped region.
+void MmapFileIO::FlushRange(size_t offset, size_t size)
+{
+    if (options & MMAP_ANONYMOUS_MODE)
+        return;
+
+    off_t offset_end = offset + size;
+    if (mmap_file && addr != NULL && static_cast<off_t>(offset) >= mmap_start
+        && offset_end <= mmap_end) {
+        uint8_t* start = addr + (offset - mmap_start);
+        off_t page_off = ((off_t)start) % RollableFile::page_size;
+        if (msync(start - page_off, size + page_off, MS_SYNC) == 0)
+            return;
+        Logger::Log(LOG_LEVEL_WARN, "msync %s failed errno=%d", path.c_str(), errno);
+    }
+    FileIO::Flush();
+}
+
 }
@@ -19,10 +19,14 @@
 #ifndef __MMAP_FILE__
 #define __MMAP_FILE__
 
+#include <atomic>
 #include <cstring>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 #include <fcntl.h>
 #include <sys/stat.h>
@@ -34,14 +38,49 @@
 
 namespace mabain {
 
+// Virtual address range reserved for the blocks of a rollable file. Blocks are
+// mapped at fixed positions in the range, so that the address of a buffer is
+// the start of the range plus its offset. Slots without a block mapped are
+// kept reserved with PROT_NONE. The start of the range is aligned to alignment
+// if it is not zero.
+class MmapRegion {
+public:
+    MmapRegion(size_t block_size, size_t num_block, size_t alignment = 0);
+    ~MmapRegion();
+
+    // Returns NULL if the range cannot be reserved.
+    uint8_t* GetAddr() const;
+    size_t GetBlockSize() const;
+    // Claim the slot of a block. Returns NULL if the slot is out of range or
+    // used by another file.
+    uint8_t* AcquireBlock(size_t order);
+    // Reserve the slot again. This also removes the mapping of the block.
+    void ReleaseBlock(size_t order);
+
+private:
+    uint8_t* addr;
+    size_t block_size;
+    size_t num_block;
+    std::vector<bool> used;
+    std::mutex region_mutex;
+};
+
 // Memory mapped file class
 class MmapFileIO : public FileIO {
 public:
     MmapFileIO(const std::string& fpath, int mode, off_t filesize, bool sync = false);
     ~MmapFileIO();
 
-    uint8_t* MapFile(size_t size, off_t offset, bool sliding = false);
+    // The file is mapped to the slot of block_order if region is given and
+    // the slot is free.
+    uint8_t* MapFile(size_t size, off_t offset, bool sliding = false,
+        std::shared_ptr<MmapRegion> region = nullptr, size_t block_order = 0);
     bool IsMapped() const;
+    // Map a read-only window of the file for WindowCache. The mapping is
+    // owned by the cache.
+    uint8_t* MapWindow(size_t size, off_t offset);
+    // Check if the kernel backs the mapping with huge pages.
+    bool HugePageMapped() const;
     size_t SeqWrite(const void* data, size_t size);
     size_t RandomWrite(const void* data, size_t size, off_t offset);
     size_t SeqRead(void* buff, size_t size);
@@ -49,6 +88,20 @@ public:
     void UnMapFile();
     uint8_t* GetMapAddr() const;
     void Flush();
+    void FlushRange(size_t offset, size_t size);
+
+    // Spill mode: move an anonymous mapping to an unlinked file in dir at the
+    // same address. The first size bytes are copied to the file. The kernel
+    // can then write the pages back and drop them under memory pressure.
+    int MoveToFile(const std::string& dir, size_t size);
+    bool IsAnonymous() const;
+    // Sampled lookups of the buffers in the file
+    void RecordAccess()
+    {
+        num_access.fetch_add(1, std::memory_order_relaxed);
+    }
+    // Returns the count and halves it so that old lookups fade out.
+    uint32_t TakeAccessCount();
 
     // for jemalloc
     int InitMemoryManager();
@@ -60,10 +113,16 @@ private:
     off_t mmap_start;
     off_t mmap_end;
     unsigned char* addr;
+    // region and slot the file is mapped to
+    std::shared_ptr<MmapRegion> map_region;
+    size_t region_order;
     // The maximal offset where data have been written
     size_t max_offset;
     // Current offset for sequential reading of writing only
     off_t curr_offset;
+    // Set once a window of the file is added to WindowCache
+    std::atomic<bool> window_mapped;
+    std::atomic<uint32_t> num_access;
 };
 
 }
@@ -0,0 +1,147 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <cstdlib>
+#include <errno.h>
+#include <fstream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "error.h"
+#include "logger.h"
+#include "numa_policy.h"
+#include "rollable_file.h"
+
+// Same values as in numaif.h
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#define MPOL_BIND 2
+#define MPOL_INTERLEAVE 3
+#endif
+#ifndef MPOL_MF_MOVE
+#define MPOL_MF_MOVE (1 << 1)
+#endif
+
+#define NUMA_COUNT_BATCH 1024
+
+namespace mabain {
+
+uint64_t NumaPolicy::OnlineNodes()
+{
+    // The list looks like "0-1,3".
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string list;
+    if (!std::getline(online, list))
+        return 1;
+
+    uint64_t nodes = 0;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos)
+            end = list.size();
+        std::string range = list.substr(pos, end - pos);
+        size_t dash = range.find('-');
+        int first = atoi(range.c_str());
+        int last = (dash == std::string::npos) ? first : atoi(range.c_str() + dash + 1);
+        for (int node = first; node <= last && node < MB_NUMA_MAX_NODE; node++)
+            nodes |= 1ULL << node;
+        pos = end + 1;
+    }
+    return (nodes != 0) ? nodes : 1;
+}
+
+int NumaPolicy::Apply(void* addr, size_t size, int policy, uint64_t nodes, size_t block_order)
+{
+    if (policy == MB_NUMA_DEFAULT)
+        return MBError::SUCCESS;
+    if (nodes == 0)
+        nodes = OnlineNodes();
+
+    int mode;
+    uint64_t mask;
+    switch (policy) {
+    case MB_NUMA_INTERLEAVE:
+        mode = MPOL_INTERLEAVE;
+        mask = nodes;
+        break;
+    case MB_NUMA_PREFERRED:
+        mode = MPOL_PREFERRED;
+        mask = nodes & (~nodes + 1);
+        break;
+    case MB_NUMA_BIND_BLOCK: {
+        mode = MPOL_BIND;
+        int index = block_order % __builtin_popcountll(nodes);
+        mask = nodes;
+        for (int i = 0; i < index; i++)
+            mask &= mask - 1;
+        mask &= ~mask + 1;
+        break;
+    }
+    default:
+        return MBError::INVALID_ARG;
+    }
+
+    // maxnode is one more than the number of bits in the mask.
+    if (syscall(SYS_mbind, addr, size, mode, &mask, MB_NUMA_MAX_NODE + 1, MPOL_MF_MOVE) != 0) {
+        Logger::Log(LOG_LEVEL_WARN, "mbind policy %d failed for block %llu errno=%d",
+            policy, block_order, errno);
+        return MBError::INVALID_ARG;
+    }
+    return MBError::SUCCESS;
+}
+
+// move_pages without target nodes returns the node of each page, or a
+// negative errno if the page is not resident.
+size_t NumaPolicy::CountPages(void* addr, size_t size, std::vector<size_t>& node_pages)
+{
+    void* pages[NUMA_COUNT_BATCH];
+    int status[NUMA_COUNT_BATCH];
+    size_t page_size = RollableFile::page_size;
+    size_t num_page = (size + page_size - 1) / page_size;
+    size_t resident = 0;
+
+    if (node_pages.size() < MB_NUMA_MAX_NODE)
+        node_pages.resize(MB_NUMA_MAX_NODE, 0);
+    for (size_t start = 0; start < num_page; start += NUMA_COUNT_BATCH) {
+        size_t count = num_page - start;
+        if (count > NUMA_COUNT_BATCH)
+            count = NUMA_COUNT_BATCH;
+        for (size_t i = 0; i < count; i++)
+            pages[i] = (uint8_t*)addr + (start + i) * page_size;
+        if (syscall(SYS_move_pages, 0, count, pages, NULL, status, 0) != 0) {
+            // Without NUMA support all resident pages are on node 0.
+            unsigned char vec[NUMA_COUNT_BATCH];
+            if (mincore(pages[0], count * page_size, vec) != 0)
+                break;
+            for (size_t i = 0; i < count; i++)
+                status[i] = (vec[i] & 1) ? 0 : -ENOENT;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (status[i] >= 0 && status[i] < MB_NUMA_MAX_NODE) {
+                node_pages[status[i]]++;
+                resident++;
+            }
+        }
+    }
+    return resident;
+}
+
+}
@@ -0,0 +1,56 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __NUMA_POLICY_H__
+#define __NUMA_POLICY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace mabain {
+
+// NUMA policies for the block mappings (MBConfig::numa_policy)
+// Pages are placed on the node of the thread that first touches them.
+#define MB_NUMA_DEFAULT 0
+// Pages are spread over the nodes page by page.
+#define MB_NUMA_INTERLEAVE 1
+// Pages are placed on the first node if it has free memory.
+#define MB_NUMA_PREFERRED 2
+// Each block is bound to one node. The nodes are used in turn.
+#define MB_NUMA_BIND_BLOCK 3
+
+// Nodes are given in a 64-bit mask.
+#define MB_NUMA_MAX_NODE 64
+
+// Memory policy calls without libnuma
+class NumaPolicy {
+public:
+    // Mask of the online nodes. Returns node 0 only if NUMA is not available.
+    static uint64_t OnlineNodes();
+    // Set the policy of the mapped block of the given order and move its
+    // resident pages. All online nodes are used if nodes is 0.
+    static int Apply(void* addr, size_t size, int policy, uint64_t nodes, size_t block_order);
+    // Add the number of resident pages of the range on each node to
+    // node_pages. Returns the number of resident pages.
+    static size_t CountPages(void* addr, size_t size, std::vector<size_t>& node_pages);
+};
+
+}
+
+#endif
@@ -0,0 +1,174 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "mabain_consts.h"
+#include "reader_registry.h"
+#include "resource_pool.h"
+
+namespace mabain {
+
+// Byte locked by readers without a slot. Slot i uses byte i + 1.
+#define MB_READER_LOCK_UNREGISTERED 0
+
+ReaderRegistry::ReaderRegistry(const std::string& fpath, bool writer)
+    : table(NULL)
+    , slot(NULL)
+    , released_gen(0)
+    , fd(-1)
+{
+    // Readers may open the table before the writer. A new table is all zeros.
+    bool map_file = true;
+    file = ResourcePool::getInstance().OpenFile(fpath, CONSTS::ACCESS_MODE_WRITER,
+        sizeof(ReaderTable), map_file, true);
+    if (file == NULL || !map_file) {
+        Logger::Log(LOG_LEVEL_WARN, "failed to open reader registry %s", fpath.c_str());
+        return;
+    }
+    fd = open(fpath.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        Logger::Log(LOG_LEVEL_WARN, "failed to open reader registry %s errno %d",
+            fpath.c_str(), errno);
+        return;
+    }
+    table = reinterpret_cast<ReaderTable*>(file->GetMapAddr());
+    if (writer) {
+        released_gen = table->block_gen.load(std::memory_order_acquire);
+        return;
+    }
+
+    for (int i = 0; i < MB_MAX_READER_SLOT; i++) {
+        if (Lock(F_WRLCK, i + 1)) {
+            slot = &table->slots[i];
+            // The writer does not take the slot as released until the
+            // generation read below is stored.
+            slot->block_gen.store(0, std::memory_order_seq_cst);
+            released_gen = table->block_gen.load(std::memory_order_seq_cst);
+            slot->block_gen.store(released_gen, std::memory_order_release);
+            return;
+        }
+    }
+    // The writer cannot tell when this reader releases retired blocks.
+    Logger::Log(LOG_LEVEL_WARN, "no free reader slot in %s", fpath.c_str());
+    if (!Lock(F_RDLCK, MB_READER_LOCK_UNREGISTERED))
+        Logger::Log(LOG_LEVEL_WARN, "failed to lock reader registry %s errno %d",
+            fpath.c_str(), errno);
+    released_gen = table->block_gen.load(std::memory_order_seq_cst);
+}
+
+ReaderRegistry::~ReaderRegistry()
+{
+    if (slot != NULL)
+        slot->block_gen.store(MB_READER_SLOT_FREE, std::memory_order_release);
+    // The locks are released with the file descriptor.
+    if (fd >= 0)
+        close(fd);
+}
+
+bool ReaderRegistry::IsValid() const
+{
+    return table != NULL;
+}
+
+uint64_t ReaderRegistry::GetRetired(size_t& index_size, size_t& data_size) const
+{
+    uint64_t gen = table->block_gen.load(std::memory_order_acquire);
+    index_size = table->index_size.load(std::memory_order_relaxed);
+    data_size = table->data_size.load(std::memory_order_relaxed);
+    return gen;
+}
+
+void ReaderRegistry::Release(uint64_t gen)
+{
+    released_gen = gen;
+    if (slot != NULL)
+        slot->block_gen.store(gen, std::memory_order_release);
+}
+
+uint64_t ReaderRegistry::Retire(size_t index_size, size_t data_size)
+{
+    table->index_size.store(index_size, std::memory_order_relaxed);
+    table->data_size.store(data_size, std::memory_order_relaxed);
+    released_gen = table->block_gen.fetch_add(1, std::memory_order_seq_cst) + 1;
+    return released_gen;
+}
+
+bool ReaderRegistry::Released(uint64_t gen)
+{
+    if (Locked(MB_READER_LOCK_UNREGISTERED))
+        return false;
+
+    for (int i = 0; i < MB_MAX_READER_SLOT; i++) {
+        uint64_t slot_gen = table->slots[i].block_gen.load(std::memory_order_seq_cst);
+        if (slot_gen >= gen)
+            continue;
+        if (Locked(i + 1))
+            return false;
+        // The reader exited without closing the DB. A reader taking the slot
+        // now reads the generation after it was retired.
+        table->slots[i].block_gen.compare_exchange_strong(slot_gen, MB_READER_SLOT_FREE);
+    }
+    return true;
+}
+
+void ReaderRegistry::PrintStats(std::ostream& out_stream) const
+{
+    int num_reader = 0;
+    for (int i = 0; i < MB_MAX_READER_SLOT; i++) {
+        if (table->slots[i].block_gen.load(std::memory_order_relaxed) != MB_READER_SLOT_FREE
+            && Locked(i + 1))
+            num_reader++;
+    }
+    out_stream << "Reader registry: block generation "
+               << table->block_gen.load(std::memory_order_relaxed) << std::endl;
+    out_stream << "\tregistered readers: " << num_reader << std::endl;
+    out_stream << "\tunregistered readers: "
+               << (Locked(MB_READER_LOCK_UNREGISTERED) ? "yes" : "no") << std::endl;
+}
+
+bool ReaderRegistry::Lock(int type, off_t byte)
+{
+    struct flock fl;
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = type;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = byte;
+    fl.l_len = 1;
+    return fcntl(fd, F_OFD_SETLK, &fl) == 0;
+}
+
+// Taken as locked if the lock cannot be checked.
+bool ReaderRegistry::Locked(off_t byte) const
+{
+    struct flock fl;
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = F_WRLCK;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = byte;
+    fl.l_len = 1;
+    if (fcntl(fd, F_OFD_GETLK, &fl) != 0)
+        return true;
+    return fl.l_type != F_UNLCK;
+}
+
+}
@@ -0,0 +1,103 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __READER_REGISTRY_H__
+#define __READER_REGISTRY_H__
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <sys/types.h>
+
+#include "mmap_file.h"
+
+namespace mabain {
+
+#define MB_MAX_READER_SLOT 1024
+
+// Slots not used by any reader have this generation.
+#define MB_READER_SLOT_FREE UINT64_MAX
+
+typedef struct _ReaderSlot {
+    // Last block generation released by the reader
+    std::atomic<uint64_t> block_gen;
+} ReaderSlot;
+
+typedef struct _ReaderTable {
+    // Incremented by the writer when it retires the blocks at and above
+    // index_size and data_size.
+    std::atomic<uint64_t> block_gen;
+    std::atomic<uint64_t> index_size;
+    std::atomic<uint64_t> data_size;
+    ReaderSlot slots[MB_MAX_READER_SLOT];
+} ReaderTable;
+
+// Reader handles registered in shared memory. Blocks left beyond the end of
+// the index and data after defragmentation are retired by the writer, which
+// bumps the block generation. A reader releases its mappings of the retired
+// blocks between lookups and records the generation in its slot. The writer
+// only unlinks the block files once all the readers have released them, so
+// that no reader maps or reads a block file that is removed and created
+// again.
+//
+// A reader owns its slot as long as it holds a write lock on the byte of the
+// slot in the registry file. Readers without a slot hold a read lock on byte
+// zero. The locks are open file description locks, which are released when
+// the reader exits for any reason and are not tied to process ids.
+class ReaderRegistry {
+public:
+    ReaderRegistry(const std::string& fpath, bool writer);
+    ~ReaderRegistry();
+
+    bool IsValid() const;
+
+    // Called by readers. Check if blocks were retired since the last release,
+    // and record the release once the retired blocks are unmapped.
+    inline bool Retired() const;
+    uint64_t GetRetired(size_t& index_size, size_t& data_size) const;
+    void Release(uint64_t gen);
+
+    // Called by the writer. Returns the new generation.
+    uint64_t Retire(size_t index_size, size_t data_size);
+    // Check if all the readers have released the given generation
+    bool Released(uint64_t gen);
+    void PrintStats(std::ostream& out_stream) const;
+
+private:
+    bool Lock(int type, off_t byte);
+    // Check if a reader holds a lock on the byte
+    bool Locked(off_t byte) const;
+
+    std::shared_ptr<MmapFileIO> file;
+    ReaderTable* table;
+    ReaderSlot* slot;
+    uint64_t released_gen;
+    // holds the lock on the slot
+    int fd;
+};
+
+inline bool ReaderRegistry::Retired() const
+{
+    return table->block_gen.load(std::memory_order_relaxed) != released_gen;
+}
+
+}
+
+#endif
@@ -0,0 +1,349 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include "dict.h"
+#include "error.h"
+#include "logger.h"
+#include "mabain_consts.h"
+#include "mb_data.h"
+#include "redo_log.h"
+
+namespace mabain {
+
+RedoLog::RedoLog(const std::string& mbdir, uint32_t interval, uint32_t size,
+    uint64_t cp_size)
+    : path(mbdir + REDO_LOG_FILE)
+    , fd(-1)
+    , sync_interval(interval)
+    , sync_size(size)
+    , checkpoint_size(cp_size)
+    , generation(0)
+    , stop_sync(false)
+    , tid(0)
+    , log_size(0)
+    , num_record(0)
+    , num_sync(0)
+    , num_checkpoint(0)
+{
+    if (sync_interval == 0)
+        sync_interval = REDO_LOG_SYNC_INTERVAL_DEFAULT;
+    if (sync_size == 0)
+        sync_size = REDO_LOG_SYNC_SIZE_DEFAULT;
+    if (checkpoint_size == 0)
+        checkpoint_size = REDO_LOG_CHECKPOINT_SIZE_DEFAULT;
+
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to open redo log %s errno %d", path.c_str(), errno);
+        throw(int) MBError::OPEN_FAILURE;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw(int) MBError::OPEN_FAILURE;
+    }
+    log_size = st.st_size;
+    if (log_size < REDO_LOG_HEADER_SIZE) {
+        if (ftruncate(fd, 0) != 0 || write(fd, REDO_LOG_MAGIC, REDO_LOG_HEADER_SIZE) != REDO_LOG_HEADER_SIZE) {
+            close(fd);
+            throw(int) MBError::WRITE_ERROR;
+        }
+        log_size = REDO_LOG_HEADER_SIZE;
+    }
+
+    if (pthread_create(&tid, NULL, sync_thread_wrapper, this) != 0) {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to create redo log thread");
+        close(fd);
+        throw(int) MBError::THREAD_FAILED;
+    }
+    Logger::Log(LOG_LEVEL_DEBUG, "opened redo log %s with %llu bytes", path.c_str(), log_size);
+}
+
+RedoLog::~RedoLog()
+{
+    {
+        std::lock_guard<std::mutex> guard(buff_mutex);
+        stop_sync = true;
+    }
+    buff_cond.notify_all();
+    pthread_join(tid, NULL);
+
+    // The sync thread writes all pending records before exiting.
+    close(fd);
+}
+
+void RedoLog::LogAdd(const uint8_t* key, int key_len, const uint8_t* data, int data_len,
+    uint32_t expire_time)
+{
+    if (expire_time == 0) {
+        Append(REDO_LOG_TYPE_ADD, key, key_len, data, data_len);
+        return;
+    }
+
+    std::string buff(reinterpret_cast<const char*>(&expire_time), sizeof(expire_time));
+    buff.append(reinterpret_cast<const char*>(data), data_len);
+    Append(REDO_LOG_TYPE_ADD_TTL, key, key_len, reinterpret_cast<const uint8_t*>(buff.data()),
+        buff.size());
+}
+
+void RedoLog::LogRemove(const uint8_t* key, int key_len)
+{
+    Append(REDO_LOG_TYPE_REMOVE, key, key_len, NULL, 0);
+}
+
+void RedoLog::LogRemoveAll()
+{
+    Append(REDO_LOG_TYPE_REMOVE_ALL, NULL, 0, NULL, 0);
+}
+
+// FNV-1a
+uint32_t RedoLog::Checksum(const uint8_t* buff, size_t len, uint32_t hash)
+{
+    for (size_t i = 0; i < len; i++) {
+        hash ^= buff[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+void RedoLog::Append(uint8_t type, const uint8_t* key, int key_len, const uint8_t* data,
+    int data_len)
+{
+    RedoRecordHeader rec;
+    rec.data_len = data_len;
+    rec.key_len = key_len;
+    rec.type = type;
+    rec.reserved = 0;
+    uint32_t hash = Checksum(reinterpret_cast<const uint8_t*>(&rec) + sizeof(rec.checksum),
+        sizeof(rec) - sizeof(rec.checksum), 2166136261U);
+    hash = Checksum(key, key_len, hash);
+    rec.checksum = Checksum(data, data_len, hash);
+
+    bool notify;
+    {
+        std::lock_guard<std::mutex> guard(buff_mutex);
+        pending.append(reinterpret_cast<const char*>(&rec), sizeof(rec));
+        if (key_len > 0)
+            pending.append(reinterpret_cast<const char*>(key), key_len);
+        if (data_len > 0)
+            pending.append(reinterpret_cast<const char*>(data), data_len);
+        notify = (pending.size() == sizeof(rec) + key_len + data_len)
+            || (pending.size() >= sync_size);
+    }
+    log_size += sizeof(rec) + key_len + data_len;
+    num_record++;
+
+    // Wake up the sync thread to start the interval for the first pending
+    // record or to write out the records once sync_size is reached.
+    if (notify)
+        buff_cond.notify_one();
+}
+
+bool RedoLog::CheckpointDue() const
+{
+    return log_size >= checkpoint_size;
+}
+
+void RedoLog::Truncate()
+{
+    std::lock_guard<std::mutex> io_guard(io_mutex);
+    {
+        std::lock_guard<std::mutex> guard(buff_mutex);
+        pending.clear();
+        generation++;
+    }
+
+    if (ftruncate(fd, REDO_LOG_HEADER_SIZE) != 0 || fdatasync(fd) != 0)
+        Logger::Log(LOG_LEVEL_ERROR, "failed to truncate redo log errno %d", errno);
+    log_size = REDO_LOG_HEADER_SIZE;
+    num_checkpoint++;
+}
+
+int RedoLog::WriteRecords(const std::string& records)
+{
+    const char* ptr = records.data();
+    size_t len = records.size();
+    while (len > 0) {
+        ssize_t nbytes = write(fd, ptr, len);
+        if (nbytes < 0) {
+            if (errno == EINTR)
+                continue;
+            Logger::Log(LOG_LEVEL_ERROR, "failed to write redo log errno %d", errno);
+            return MBError::WRITE_ERROR;
+        }
+        ptr += nbytes;
+        len -= nbytes;
+    }
+
+    if (fdatasync(fd) != 0) {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to sync redo log errno %d", errno);
+        return MBError::WRITE_ERROR;
+    }
+    num_sync++;
+    return MBError::SUCCESS;
+}
+
+void* RedoLog::sync_thread()
+{
+    std::string records;
+    std::unique_lock<std::mutex> guard(buff_mutex);
+
+    while (true) {
+        buff_cond.wait(guard, [this] { return stop_sync || !pending.empty(); });
+        // Group all records added within the interval.
+        buff_cond.wait_for(guard, std::chrono::milliseconds(sync_interval),
+            [this] { return stop_sync || pending.size() >= sync_size; });
+
+        if (!pending.empty()) {
+            uint64_t gen = generation;
+            records.swap(pending);
+            guard.unlock();
+            {
+                std::lock_guard<std::mutex> io_guard(io_mutex);
+                // Skip if the log has been truncated in the meantime.
+                if (gen == generation)
+                    WriteRecords(records);
+            }
+            records.clear();
+            guard.lock();
+        }
+
+        if (stop_sync && pending.empty())
+            break;
+    }
+
+    return NULL;
+}
+
+void* RedoLog::sync_thread_wrapper(void* context)
+{
+    RedoLog* log = reinterpret_cast<RedoLog*>(context);
+    return log->sync_thread();
+}
+
+int64_t RedoLog::Replay(Dict* dict)
+{
+    std::lock_guard<std::mutex> io_guard(io_mutex);
+
+    int rfd = open(path.c_str(), O_RDONLY);
+    if (rfd < 0)
+        return 0;
+
+    std::string buff;
+    char chunk[64 * 1024];
+    ssize_t nbytes;
+    while ((nbytes = read(rfd, chunk, sizeof(chunk))) > 0)
+        buff.append(chunk, nbytes);
+    close(rfd);
+
+    if (buff.size() < REDO_LOG_HEADER_SIZE || memcmp(buff.data(), REDO_LOG_MAGIC, REDO_LOG_HEADER_SIZE) != 0) {
+        Logger::Log(LOG_LEVEL_WARN, "invalid redo log header in %s", path.c_str());
+        return 0;
+    }
+
+    int64_t count = 0;
+    size_t pos = REDO_LOG_HEADER_SIZE;
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(buff.data());
+    MBData mbd;
+    int rval;
+    while (pos + sizeof(RedoRecordHeader) <= buff.size()) {
+        RedoRecordHeader rec;
+        memcpy(&rec, base + pos, sizeof(rec));
+        size_t rec_size = sizeof(rec) + rec.key_len + rec.data_len;
+        if (pos + rec_size > buff.size())
+            break;
+        const uint8_t* key = base + pos + sizeof(rec);
+        const uint8_t* data = key + rec.key_len;
+        uint32_t hash = Checksum(base + pos + sizeof(rec.checksum),
+            sizeof(rec) - sizeof(rec.checksum), 2166136261U);
+        hash = Checksum(key, rec.key_len, hash);
+        if (Checksum(data, rec.data_len, hash) != rec.checksum)
+            break;
+
+        try {
+            switch (rec.type) {
+            case REDO_LOG_TYPE_ADD:
+                mbd.options = 0;
+                mbd.buff = const_cast<uint8_t*>(data);
+                mbd.data_len = rec.data_len;
+                mbd.expire_time = 0;
+                rval = dict->Add(key, rec.key_len, mbd, true);
+                mbd.buff = NULL;
+                break;
+            case REDO_LOG_TYPE_ADD_TTL:
+                if (rec.data_len < sizeof(mbd.expire_time)) {
+                    rval = MBError::INVALID_SIZE;
+                    break;
+                }
+                mbd.options = 0;
+                memcpy(&mbd.expire_time, data, sizeof(mbd.expire_time));
+                mbd.buff = const_cast<uint8_t*>(data) + sizeof(mbd.expire_time);
+                mbd.data_len = rec.data_len - sizeof(mbd.expire_time);
+                rval = dict->Add(key, rec.key_len, mbd, true);
+                mbd.buff = NULL;
+                break;
+            case REDO_LOG_TYPE_REMOVE:
+                rval = dict->Remove(key, rec.key_len);
+                if (rval == MBError::NOT_EXIST)
+                    rval = MBError::SUCCESS;
+                break;
+            case REDO_LOG_TYPE_REMOVE_ALL:
+                rval = dict->RemoveAll();
+                break;
+            default:
+                rval = MBError::INVALID_ARG;
+                break;
+            }
+        } catch (int error) {
+            rval = error;
+        }
+        if (rval != MBError::SUCCESS) {
+            Logger::Log(LOG_LEVEL_WARN, "failed to replay redo log record %d: %s",
+                (int)rec.type, MBError::get_error_str(rval));
+        }
+
+        pos += rec_size;
+        count++;
+    }
+
+    if (pos < buff.size()) {
+        Logger::Log(LOG_LEVEL_WARN, "ignored %llu bytes of incomplete records at the end of redo log",
+            buff.size() - pos);
+    }
+    return count;
+}
+
+void RedoLog::PrintStats(std::ostream& out_stream) const
+{
+    out_stream << "Redo log: " << path << std::endl;
+    out_stream << "\tlog size: " << log_size << std::endl;
+    out_stream << "\tnumber of records: " << num_record << std::endl;
+    out_stream << "\tnumber of group commits: " << num_sync << std::endl;
+    out_stream << "\tnumber of checkpoints: " << num_checkpoint << std::endl;
+}
+
+}
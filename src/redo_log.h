@@ -0,0 +1,117 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __REDO_LOG_H__
+#define __REDO_LOG_H__
+
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <pthread.h>
+#include <stdint.h>
+#include <string>
+
+namespace mabain {
+
+#define REDO_LOG_FILE "_mabain_redo"
+#define REDO_LOG_MAGIC "MBREDO01"
+#define REDO_LOG_HEADER_SIZE 8
+
+#define REDO_LOG_SYNC_INTERVAL_DEFAULT 100 // millisecond
+#define REDO_LOG_SYNC_SIZE_DEFAULT (1024 * 1024)
+#define REDO_LOG_CHECKPOINT_SIZE_DEFAULT (64 * 1024 * 1024LL)
+
+#define REDO_LOG_TYPE_ADD 1
+#define REDO_LOG_TYPE_REMOVE 2
+#define REDO_LOG_TYPE_REMOVE_ALL 3
+// The data of the record starts with the uint32_t expiry time.
+#define REDO_LOG_TYPE_ADD_TTL 4
+
+// Each record is a header followed by the key and the data. The checksum
+// covers everything after the checksum field. A torn record at the end of
+// the log fails the check and ends the replay.
+typedef struct _RedoRecordHeader {
+    uint32_t checksum;
+    uint32_t data_len;
+    uint16_t key_len;
+    uint8_t type;
+    uint8_t reserved;
+} RedoRecordHeader;
+
+class Dict;
+
+// Append-only log of the updates applied by the writer. Records are buffered
+// in memory and written and synced to the log file in groups by a background
+// thread, either every sync_interval milliseconds or once sync_size bytes are
+// pending. The log only has to cover the updates since the last checkpoint,
+// i.e., since the mmapped files were last flushed.
+class RedoLog {
+public:
+    RedoLog(const std::string& mbdir, uint32_t sync_interval, uint32_t sync_size,
+        uint64_t checkpoint_size);
+    ~RedoLog();
+
+    void LogAdd(const uint8_t* key, int key_len, const uint8_t* data, int data_len,
+        uint32_t expire_time = 0);
+    void LogRemove(const uint8_t* key, int key_len);
+    void LogRemoveAll();
+
+    // Apply the records in the log file to dict. Returns the number of
+    // records applied.
+    int64_t Replay(Dict* dict);
+    bool CheckpointDue() const;
+    // Drop all records after the mmapped files have been flushed.
+    void Truncate();
+    void PrintStats(std::ostream& out_stream) const;
+
+private:
+    void Append(uint8_t type, const uint8_t* key, int key_len, const uint8_t* data,
+        int data_len);
+    int WriteRecords(const std::string& records);
+    static uint32_t Checksum(const uint8_t* buff, size_t len, uint32_t hash);
+    static void* sync_thread_wrapper(void* context);
+    void* sync_thread();
+
+    std::string path;
+    int fd;
+    uint32_t sync_interval;
+    uint32_t sync_size;
+    uint64_t checkpoint_size;
+
+    // Records not written yet and the states below are guarded by buff_mutex.
+    std::mutex buff_mutex;
+    std::condition_variable buff_cond;
+    std::string pending;
+    // Incremented by Truncate so that records taken by the sync thread before
+    // the truncation are dropped.
+    uint64_t generation;
+    bool stop_sync;
+    // Serializes writing to and truncating the log file
+    std::mutex io_mutex;
+
+    pthread_t tid;
+    // size of the log including pending records
+    uint64_t log_size;
+    uint64_t num_record;
+    uint64_t num_sync;
+    uint64_t num_checkpoint;
+};
+
+}
+
+#endif
@@ -23,12 +23,16 @@
 #include "mabain_consts.h"
 #include "mmap_file.h"
 #include "resource_pool.h"
+#include "window_cache.h"
 
 namespace mabain {
 
 ResourcePool::ResourcePool()
 {
     pthread_mutex_init(&pool_mutex, NULL);
+    // Files in the pool remove their windows from the cache when destroyed,
+    // so the cache is created first to be destroyed after the pool.
+    WindowCache::getInstance();
 }
 
 ResourcePool::~ResourcePool()
@@ -40,6 +44,7 @@ void ResourcePool::RemoveAll()
 {
     pthread_mutex_lock(&pool_mutex);
     file_pool.clear();
+    region_pool.clear();
     pthread_mutex_unlock(&pool_mutex);
 }
 
@@ -61,6 +66,26 @@ void ResourcePool::RemoveResourceByPath(const std::string& path)
     pthread_mutex_unlock(&pool_mutex);
 }
 
+void ResourcePool::ReleaseBlocks(const std::string& path, size_t block_order)
+{
+    pthread_mutex_lock(&pool_mutex);
+
+    for (auto it = file_pool.begin(); it != file_pool.end();) {
+        const std::string& fpath = it->first;
+        if (fpath.size() > path.size() && fpath.compare(0, path.size(), path) == 0
+            && fpath.find_first_not_of("0123456789", path.size()) == std::string::npos
+            && std::stoul(fpath.substr(path.size())) >= block_order
+            && it->second.use_count() == 1) {
+            Logger::Log(LOG_LEVEL_DEBUG, "release block %s", fpath.c_str());
+            it = file_pool.erase(it);
+        } else {
+            it++;
+        }
+    }
+
+    pthread_mutex_unlock(&pool_mutex);
+}
+
 void ResourcePool::RemoveResourceByDB(const std::string& db_path)
 {
     pthread_mutex_lock(&pool_mutex);
@@ -71,6 +96,12 @@ void ResourcePool::RemoveResourceByDB(const std::string& db_path)
         else
             it++;
     }
+    for (auto it = region_pool.begin(); it != region_pool.end();) {
+        if (it->first.compare(0, db_path.size(), db_path) == 0)
+            it = region_pool.erase(it);
+        else
+            it++;
+    }
 
     pthread_mutex_unlock(&pool_mutex);
 }
@@ -79,7 +110,9 @@ std::shared_ptr<MmapFileIO> ResourcePool::OpenFile(const std::string& fpath,
     int mode,
     size_t file_size,
     bool& map_file,
-    bool create_file)
+    bool create_file,
+    std::shared_ptr<MmapRegion> region,
+    size_t block_order)
 {
     std::shared_ptr<MmapFileIO> mmap_file;
 
@@ -93,6 +126,10 @@ std::shared_ptr<MmapFileIO> ResourcePool::OpenFile(const std::string& fpath,
             flags |= O_CREAT;
         if (mode & CONSTS::MEMORY_ONLY_MODE)
             flags |= MMAP_ANONYMOUS_MODE;
+        if (mode & CONSTS::HUGE_PAGE_HUGETLB)
+            flags |= MMAP_HUGETLB_MODE;
+        if (mode & CONSTS::HUGE_PAGE_ADVISE)
+            flags |= MMAP_HUGE_ADVISE_MODE;
 
         mmap_file = std::shared_ptr<MmapFileIO>(
             new MmapFileIO(fpath,
@@ -100,7 +137,7 @@ std::shared_ptr<MmapFileIO> ResourcePool::OpenFile(const std::string& fpath,
                 file_size,
                 mode & CONSTS::SYNC_ON_WRITE));
         if (map_file) {
-            if (mmap_file->MapFile(file_size, 0) != NULL) {
+            if (mmap_file->MapFile(file_size, 0, false, region, block_order) != NULL) {
                 if (!(mode & CONSTS::MEMORY_ONLY_MODE))
                     mmap_file->Close();
                 if (mode & CONSTS::OPTION_JEMALLOC) {
@@ -124,6 +161,28 @@ std::shared_ptr<MmapFileIO> ResourcePool::OpenFile(const std::string& fpath,
     return mmap_file;
 }
 
+std::shared_ptr<MmapRegion> ResourcePool::GetRegion(const std::string& path,
+    size_t block_size, size_t num_block, size_t alignment)
+{
+    std::shared_ptr<MmapRegion> region;
+
+    pthread_mutex_lock(&pool_mutex);
+    auto search = region_pool.find(path);
+    if (search != region_pool.end() && search->second->GetBlockSize() == block_size
+        && (alignment == 0 || (uintptr_t)search->second->GetAddr() % alignment == 0)) {
+        region = search->second;
+    } else {
+        region = std::make_shared<MmapRegion>(block_size, num_block, alignment);
+        if (region->GetAddr() != NULL)
+            region_pool[path] = region;
+        else
+            region = nullptr;
+    }
+    pthread_mutex_unlock(&pool_mutex);
+
+    return region;
+}
+
 int ResourcePool::AddResourceByPath(const std::string& path, std::shared_ptr<MmapFileIO> resource)
 {
     int rval = MBError::IN_DICT;
@@ -38,9 +38,18 @@ public:
 
     std::shared_ptr<MmapFileIO> OpenFile(const std::string& fpath, int mode,
         size_t file_size, bool& map_file,
-        bool create_file);
+        bool create_file, std::shared_ptr<MmapRegion> region = nullptr,
+        size_t block_order = 0);
+    // Get the address range reserved for the blocks of a rollable file. All
+    // db handles for the same file share the range. The range starts at a
+    // multiple of alignment if it is not zero.
+    std::shared_ptr<MmapRegion> GetRegion(const std::string& path, size_t block_size,
+        size_t num_block, size_t alignment = 0);
     void RemoveResourceByDB(const std::string& db_path);
     void RemoveResourceByPath(const std::string& path);
+    // Remove the block files of a rollable file from block_order on that are
+    // not used by any db handle
+    void ReleaseBlocks(const std::string& path, size_t block_order);
     void RemoveAll();
     bool CheckExistence(const std::string& header_path);
     int AddResourceByPath(const std::string& path, std::shared_ptr<MmapFileIO> resource);
@@ -56,6 +65,7 @@ private:
     ResourcePool();
 
     std::unordered_map<std::string, std::shared_ptr<MmapFileIO>> file_pool;
+    std::unordered_map<std::string, std::shared_ptr<MmapRegion>> region_pool;
     pthread_mutex_t pool_mutex;
 };
 
@@ -21,6 +21,7 @@
 #include <cstdlib>
 #include <errno.h>
 #include <fcntl.h>
+#include <fstream>
 #include <sstream>
 #include <stdint.h>
 #include <string.h>
@@ -31,14 +32,17 @@
 #include "db.h"
 #include "error.h"
 #include "logger.h"
+#include "numa_policy.h"
 #include "resource_pool.h"
 #include "rollable_file.h"
+#include "window_cache.h"
 
 namespace mabain {
 
 #define SLIDING_MEM_SIZE 16LLU * 1024 * 1024 // 16M
 #define MAX_NUM_BLOCK 2 * 1024 // 2K
 #define RC_OFFSET_PERCENTAGE 75 // default rc offset is placed at 75% of maximum size
+#define HUGE_PAGE_SIZE_DEFAULT 2 * 1024 * 1024 // 2M
 
 const long RollableFile::page_size = sysconf(_SC_PAGESIZE);
 std::unordered_map<unsigned, RollableFile*> RollableFile::arena_manager_map;
@@ -49,6 +53,30 @@ int RollableFile::ShmSync(uint8_t* addr, int size)
     return msync(addr - page_offset, size + page_offset, MS_SYNC);
 }
 
+size_t RollableFile::HugePageSize(int huge_page_mode)
+{
+    size_t size = 0;
+    if (huge_page_mode & CONSTS::HUGE_PAGE_HUGETLB) {
+        // Default size of the pages from the hugetlb pool
+        std::ifstream meminfo("/proc/meminfo");
+        std::string line;
+        while (std::getline(meminfo, line)) {
+            if (line.compare(0, 13, "Hugepagesize:") == 0) {
+                size = std::stoull(line.substr(13)) * 1024;
+                break;
+            }
+        }
+    } else if (huge_page_mode & CONSTS::HUGE_PAGE_ADVISE) {
+        std::ifstream pmd_size("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size");
+        pmd_size >> size;
+    } else {
+        return page_size;
+    }
+    if (size == 0)
+        size = HUGE_PAGE_SIZE_DEFAULT;
+    return size;
+}
+
 RollableFile::RollableFile(const std::string& fpath, size_t blocksize, size_t memcap, int access_mode,
     long max_block, int in_rc_offset_percentage)
     : path(fpath)
@@ -57,8 +85,17 @@ RollableFile::RollableFile(const std::string& fpath, size_t blocksize, size_t me
     , sliding_mmap(access_mode & CONSTS::USE_SLIDING_WINDOW)
     , mode(access_mode)
     , max_num_block(max_block)
+    , region_addr(NULL)
+    , mapped_size(0)
     , rc_offset_percentage(in_rc_offset_percentage)
     , mem_used(0)
+    , numa_policy(MB_NUMA_DEFAULT)
+    , numa_nodes(0)
+    , dirty(NULL)
+    , prealloc(NULL)
+    , prealloc_percentage(0)
+    , prealloc_offset(0)
+    , spill_demote(false)
 {
     sliding_addr = NULL;
     sliding_mem_size = SLIDING_MEM_SIZE;
@@ -78,6 +115,9 @@ RollableFile::RollableFile(const std::string& fpath, size_t blocksize, size_t me
             rc_offset_percentage = RC_OFFSET_PERCENTAGE;
 
         Logger::Log(LOG_LEVEL_DEBUG, "rc_offset_percentage is set to %d", rc_offset_percentage);
+
+        if (!(mode & (CONSTS::MEMORY_ONLY_MODE | CONSTS::OPTION_JEMALLOC)))
+            dirty = new DirtyTracker(block_size, max_num_block, RollableFile::page_size);
     }
 
     Logger::Log(LOG_LEVEL_DEBUG, "opening rollable file %s for %s, mmap size: %d",
@@ -95,6 +135,21 @@ RollableFile::RollableFile(const std::string& fpath, size_t blocksize, size_t me
     }
 
     files.assign(3, NULL);
+    // Reserve the address range of the blocks that can be mapped.
+    size_t num_region_block = 0;
+    if (block_size > 0)
+        num_region_block = (mmap_mem + block_size - 1) / block_size;
+    if (num_region_block > max_num_block)
+        num_region_block = max_num_block;
+    if (num_region_block > 0) {
+        size_t alignment = 0;
+        if (mode & (CONSTS::HUGE_PAGE_HUGETLB | CONSTS::HUGE_PAGE_ADVISE))
+            alignment = HugePageSize(mode);
+        region = ResourcePool::getInstance().GetRegion(path, block_size, num_region_block,
+            alignment);
+        if (region != nullptr)
+            region_addr = region->GetAddr();
+    }
     if (mode & CONSTS::SYNC_ON_WRITE)
         Logger::Log(LOG_LEVEL_DEBUG, "Sync is turned on for " + fpath);
 }
@@ -118,6 +173,10 @@ void RollableFile::Close()
 RollableFile::~RollableFile()
 {
     Close();
+    if (prealloc != NULL)
+        delete prealloc;
+    if (dirty != NULL)
+        delete dirty;
 }
 
 int RollableFile::OpenAndMapBlockFile(size_t block_order, bool create_file)
@@ -143,8 +202,23 @@ int RollableFile::OpenAndMapBlockFile(size_t block_order, bool create_file)
     else
         map_file = false;
 
-    if (!map_file && (mode & CONSTS::MEMORY_ONLY_MODE))
-        return MBError::NO_MEMORY;
+    bool spill_new = false;
+    if (!map_file && (mode & CONSTS::MEMORY_ONLY_MODE)) {
+        // Blocks mapped by other handles, including the spilled ones, are
+        // shared without counting them in mem_used.
+        MmapFileIO* shared = ResourcePool::getInstance().GetResourceByPath(path + ss.str());
+        if (shared != NULL && shared->IsMapped()) {
+            files[block_order] = ResourcePool::getInstance().OpenFile(path + ss.str(), mode,
+                block_size, map_file, false);
+            UpdateMappedSize();
+            return MBError::SUCCESS;
+        }
+        if (spill_dir.empty() || !create_file)
+            return MBError::NO_MEMORY;
+        if (!spill_demote || SpillColdBlock(block_order) != MBError::SUCCESS)
+            spill_new = true;
+        map_file = true;
+    }
     bool init_jem = false;
     if (block_order == 0 && (mode & CONSTS::OPTION_JEMALLOC)) {
         // Check if jemalloc is initialized already
@@ -157,18 +231,80 @@ int RollableFile::OpenAndMapBlockFile(size_t block_order, bool create_file)
         mode,
         block_size,
         map_file,
-        create_file);
-    if (map_file) {
+        create_file,
+        region,
+        block_order);
+    if (dirty != NULL && files[block_order] != NULL)
+        dirty->AddBlock(block_order, files[block_order]);
+    if (map_file && spill_new) {
+        // Nothing has been written to the new block yet.
+        rval = files[block_order]->MoveToFile(spill_dir, 0);
+        if (rval != MBError::SUCCESS) {
+            ResourcePool::getInstance().RemoveResourceByPath(path + ss.str());
+            files[block_order] = NULL;
+            return rval;
+        }
+    } else if (map_file) {
         mem_used += block_size;
+    }
+    if (map_file) {
+        if (numa_policy != MB_NUMA_DEFAULT) {
+            NumaPolicy::Apply(files[block_order]->GetMapAddr(), block_size, numa_policy,
+                numa_nodes, block_order);
+        }
         if (init_jem) {
             rval = ConfigureJemalloc(files[0]->mm_meta);
         }
     } else if ((mode & CONSTS::MEMORY_ONLY_MODE) || (mode & CONSTS::OPTION_JEMALLOC)) {
         rval = MBError::MMAP_FAILED;
     }
+    UpdateMappedSize();
+    return rval;
+}
+
+// Move the block with the fewest sampled lookups since the last demotion to
+// the spill directory. The last block before the new one is still being
+// filled by the writer and is kept in memory.
+int RollableFile::SpillColdBlock(size_t block_order)
+{
+    size_t cold = max_num_block;
+    uint32_t min_count = UINT32_MAX;
+    for (size_t i = 0; i + 1 < block_order && i < files.size(); i++) {
+        if (files[i] == NULL || !files[i]->IsMapped() || !files[i]->IsAnonymous())
+            continue;
+        uint32_t count = files[i]->TakeAccessCount();
+        if (count < min_count) {
+            min_count = count;
+            cold = i;
+        }
+    }
+    if (cold == max_num_block)
+        return MBError::NOT_EXIST;
+
+    int rval = files[cold]->MoveToFile(spill_dir, block_size);
+    if (rval != MBError::SUCCESS)
+        return rval;
+    if (mem_used >= block_size)
+        mem_used -= block_size;
+    Logger::Log(LOG_LEVEL_DEBUG, "spilled block %d of %s with %u sampled lookups",
+        (int)cold, path.c_str(), min_count);
     return rval;
 }
 
+// Extend mapped_size over the blocks mapped to their slots in the region.
+void RollableFile::UpdateMappedSize()
+{
+    if (region_addr == NULL)
+        return;
+
+    size_t order = mapped_size / block_size;
+    while (order < files.size() && files[order] != NULL && files[order]->IsMapped()
+        && files[order]->GetMapAddr() == region_addr + order * block_size) {
+        order++;
+    }
+    mapped_size = order * block_size;
+}
+
 // Need to make sure the required size at offset is aligned with
 // block_size and mmap_size. We should not write the size in two
 // different blocks or one in mmaped region and the other one on disk.
@@ -197,9 +333,9 @@ int RollableFile::CheckAndOpenFile(size_t order, bool create_file)
     return rval;
 }
 
-// Get shared memory address for existing buffer
+// Get shared memory address for existing buffer not in the region
 // No need to check alignment
-uint8_t* RollableFile::GetShmPtr(size_t offset, int size)
+uint8_t* RollableFile::GetFilePtr(size_t offset, int size)
 {
     size_t order = offset / block_size;
     int rval = CheckAndOpenFile(order, false);
@@ -227,15 +363,25 @@ int RollableFile::Reserve(size_t& offset, int size, uint8_t*& ptr, bool map_new_
     int rval;
     ptr = NULL;
     offset = CheckAlignment(offset, size);
+    if (offset + size <= mapped_size) {
+        ptr = region_addr + offset;
+        MarkDirty(offset, size);
+        if (prealloc != NULL && (offset >= prealloc_offset || offset + block_size < prealloc_offset))
+            PreallocNextBlock(offset);
+        return MBError::SUCCESS;
+    }
 
     size_t order = offset / block_size;
     rval = CheckAndOpenFile(order, true);
     if (rval != MBError::SUCCESS)
         return rval;
+    if (prealloc != NULL && (offset >= prealloc_offset || offset + block_size < prealloc_offset))
+        PreallocNextBlock(offset);
 
     if (files[order]->IsMapped()) {
         size_t index = offset % block_size;
         ptr = files[order]->GetMapAddr() + index;
+        MarkDirty(offset, size);
         return rval;
     }
 
@@ -253,6 +399,8 @@ int RollableFile::Reserve(size_t& offset, int size, uint8_t*& ptr, bool map_new_
         }
     }
 
+    if (ptr != NULL)
+        MarkDirty(offset, size);
     return rval;
 }
 
@@ -296,6 +444,12 @@ uint8_t* RollableFile::NewSlidingMapAddr(size_t offset, int size)
 
 size_t RollableFile::RandomWrite(const void* data, size_t size, off_t offset)
 {
+    if (offset + size <= mapped_size && !(mode & CONSTS::SYNC_ON_WRITE)) {
+        memcpy(region_addr + offset, data, size);
+        MarkDirty(offset, size);
+        return size;
+    }
+
     size_t order = offset / block_size;
     int rval = CheckAndOpenFile(order, false);
     if (rval != MBError::SUCCESS)
@@ -311,12 +465,15 @@ size_t RollableFile::RandomWrite(const void* data, size_t size, off_t offset)
                 if (msync(start_addr - page_off, size + page_off, MS_SYNC) == -1)
                     std::cout << "msync error\n";
             }
+            MarkDirty(offset, size);
             return size;
         }
     }
 
     int index = offset % block_size;
-    return files[order]->RandomWrite(data, size, index);
+    size_t bytes_written = files[order]->RandomWrite(data, size, index);
+    MarkDirty(offset, bytes_written);
+    return bytes_written;
 }
 
 void* RollableFile::NewReaderSlidingMap(size_t order)
@@ -339,7 +496,7 @@ void* RollableFile::NewReaderSlidingMap(size_t order)
     return sliding_addr;
 }
 
-size_t RollableFile::RandomRead(void* buff, size_t size, off_t offset)
+size_t RollableFile::ReadFromFile(void* buff, size_t size, off_t offset)
 {
     size_t order = offset / block_size;
 
@@ -359,9 +516,34 @@ size_t RollableFile::RandomRead(void* buff, size_t size, off_t offset)
     }
 
     int index = offset % block_size;
+    if (!files[order]->IsMapped()) {
+        size_t bytes_read = WindowCache::getInstance().Read(files[order].get(), block_size,
+            buff, size, index);
+        if (bytes_read == size)
+            return size;
+    }
     return files[order]->RandomRead(buff, size, index);
 }
 
+size_t RollableFile::GetReadFile(size_t offset, int& fd, off_t& file_off)
+{
+    if (offset < mapped_size || sliding_mmap || (mode & CONSTS::MEMORY_ONLY_MODE))
+        return 0;
+
+    size_t order = offset / block_size;
+    int rval = CheckAndOpenFile(order, false);
+    if (rval != MBError::SUCCESS && rval != MBError::MMAP_FAILED)
+        return 0;
+    if (files[order]->IsMapped())
+        return 0;
+
+    fd = files[order]->GetFd();
+    if (fd <= 0)
+        return 0;
+    file_off = offset % block_size;
+    return block_size - file_off;
+}
+
 void RollableFile::PrintStats(std::ostream& out_stream) const
 {
     out_stream << "Rollable file: " << path << " stats:" << std::endl;
@@ -370,6 +552,149 @@ void RollableFile::PrintStats(std::ostream& out_stream) const
         out_stream << "\tsliding mmap start: " << sliding_start << std::endl;
         out_stream << "\tsliding mmap size: " << sliding_mem_size << std::endl;
     }
+    if (region_addr != NULL)
+        out_stream << "\tcontiguous mapped size: " << mapped_size << std::endl;
+    if (mode & (CONSTS::HUGE_PAGE_HUGETLB | CONSTS::HUGE_PAGE_ADVISE)) {
+        int num_mapped = 0;
+        int num_huge = 0;
+        for (auto& file : files) {
+            if (file != nullptr && file->IsMapped()) {
+                num_mapped++;
+                if (file->HugePageMapped())
+                    num_huge++;
+            }
+        }
+        out_stream << "\tblocks mapped with huge pages: " << num_huge << "/" << num_mapped
+                   << std::endl;
+    }
+    if (prealloc != NULL)
+        out_stream << "\tpreallocated blocks: " << prealloc->GetCount() << std::endl;
+    if (!spill_dir.empty())
+        out_stream << "\tspilled blocks: " << GetNumSpilled() << std::endl;
+    if (dirty != NULL)
+        dirty->PrintStats(out_stream);
+}
+
+void RollableFile::GetMappedBlocks(size_t size,
+    std::vector<std::pair<uint8_t*, size_t>>& blocks)
+{
+    // The writer may not have created the last block yet.
+    bool create_file = mode & CONSTS::ACCESS_MODE_WRITER;
+    for (size_t order = 0; order * block_size < size; order++) {
+        if (CheckAndOpenFile(order, create_file) != MBError::SUCCESS)
+            break;
+        if (files[order] == NULL || !files[order]->IsMapped())
+            continue;
+        size_t len = size - order * block_size;
+        if (len > block_size)
+            len = block_size;
+        blocks.push_back(std::make_pair(files[order]->GetMapAddr(), len));
+    }
+}
+
+void RollableFile::SetNumaPolicy(int policy, uint64_t nodes)
+{
+    numa_policy = policy;
+    numa_nodes = nodes;
+    if (numa_policy == MB_NUMA_DEFAULT)
+        return;
+    for (size_t order = 0; order < files.size(); order++) {
+        if (files[order] != NULL && files[order]->IsMapped()) {
+            NumaPolicy::Apply(files[order]->GetMapAddr(), block_size, numa_policy,
+                numa_nodes, order);
+        }
+    }
+}
+
+int RollableFile::EnablePrealloc(int percentage)
+{
+    if (!(mode & CONSTS::ACCESS_MODE_WRITER) || (mode & CONSTS::OPTION_JEMALLOC)
+        || percentage <= 0 || percentage > 100 || prealloc != NULL)
+        return MBError::NOT_ALLOWED;
+
+    try {
+        prealloc = new BlockPreallocator(path, mode, block_size, region);
+    } catch (int error) {
+        prealloc = NULL;
+        return error;
+    }
+    prealloc_percentage = percentage;
+    prealloc_offset = 0;
+    return MBError::SUCCESS;
+}
+
+int RollableFile::EnableSpill(const std::string& dir, bool demote)
+{
+    if (!(mode & CONSTS::ACCESS_MODE_WRITER) || !(mode & CONSTS::MEMORY_ONLY_MODE)
+        || (mode & CONSTS::OPTION_JEMALLOC))
+        return MBError::NOT_ALLOWED;
+
+    struct stat st;
+    if (stat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode) || access(dir.c_str(), W_OK) != 0) {
+        Logger::Log(LOG_LEVEL_ERROR, "spill directory %s not writable", dir.c_str());
+        return MBError::OPEN_FAILURE;
+    }
+    spill_dir = dir;
+    spill_demote = demote;
+    return MBError::SUCCESS;
+}
+
+size_t RollableFile::GetNumSpilled() const
+{
+    size_t num_spilled = 0;
+    if (!(mode & CONSTS::MEMORY_ONLY_MODE))
+        return 0;
+    for (auto& file : files) {
+        if (file != nullptr && file->IsMapped() && !file->IsAnonymous())
+            num_spilled++;
+    }
+    return num_spilled;
+}
+
+size_t RollableFile::GetNumPreallocated() const
+{
+    if (prealloc == NULL)
+        return 0;
+    return prealloc->GetCount();
+}
+
+// Called by the writer after the block at offset is opened. Only blocks that
+// the writer will map are preallocated.
+void RollableFile::PreallocNextBlock(size_t offset)
+{
+    size_t order = offset / block_size;
+    size_t threshold = block_size / 100 * prealloc_percentage;
+    if (offset % block_size < threshold) {
+        prealloc_offset = order * block_size + threshold;
+        return;
+    }
+
+    size_t next = order + 1;
+    prealloc_offset = next * block_size + threshold;
+    if (next >= max_num_block || mmap_mem <= mem_used)
+        return;
+    if (next < files.size() && files[next] != NULL)
+        return;
+    prealloc->Request(next, numa_policy, numa_nodes);
+}
+
+void RollableFile::PrintNumaStats(std::ostream& out_stream) const
+{
+    std::vector<size_t> node_pages;
+    size_t num_mapped = 0;
+    size_t resident = 0;
+    for (auto& file : files) {
+        if (file != nullptr && file->IsMapped()) {
+            resident += NumaPolicy::CountPages(file->GetMapAddr(), block_size, node_pages);
+            num_mapped += block_size / page_size;
+        }
+    }
+    out_stream << "Rollable file: " << path << " NUMA policy " << numa_policy << std::endl;
+    out_stream << "\tresident pages: " << resident << "/" << num_mapped << std::endl;
+    for (size_t node = 0; node < node_pages.size(); node++) {
+        if (node_pages[node] > 0)
+            out_stream << "\tnode " << node << ": " << node_pages[node] << std::endl;
+    }
 }
 
 void RollableFile::ResetSlidingWindow()
@@ -386,6 +711,11 @@ void RollableFile::ResetSlidingWindow()
 
 void RollableFile::Flush()
 {
+    if (dirty != NULL) {
+        dirty->Flush();
+        return;
+    }
+
     for (std::vector<std::shared_ptr<MmapFileIO>>::iterator it = files.begin();
          it != files.end(); ++it) {
         if (*it != NULL) {
@@ -394,6 +724,18 @@ void RollableFile::Flush()
     }
 }
 
+size_t RollableFile::FlushDirty(size_t max_bytes)
+{
+    if (dirty == NULL)
+        return 0;
+    return dirty->Flush(max_bytes);
+}
+
+DirtyTracker* RollableFile::GetDirtyTracker() const
+{
+    return dirty;
+}
+
 size_t RollableFile::GetResourceCollectionOffset() const
 {
     return int((rc_offset_percentage / 100.0f) * max_num_block) * block_size;
@@ -401,20 +743,64 @@ size_t RollableFile::GetResourceCollectionOffset() const
 
 void RollableFile::RemoveUnused(size_t max_size, bool writer_mode)
 {
+    if (prealloc != NULL) {
+        prealloc->Wait();
+        prealloc_offset = 0;
+    }
     unsigned ibeg = max_size / (block_size + 1) + 1;
+    if (mapped_size > ibeg * block_size)
+        mapped_size = ibeg * block_size;
     for (auto i = ibeg; i < files.size(); i++) {
         if (files[i] != NULL) {
-            if (files[i]->IsMapped() && mem_used > block_size)
+            // Spilled blocks are not counted in mem_used.
+            if (files[i]->IsMapped() && mem_used > block_size
+                && (!(mode & CONSTS::MEMORY_ONLY_MODE) || files[i]->IsAnonymous()))
                 mem_used -= block_size;
             if (writer_mode) {
                 ResourcePool::getInstance().RemoveResourceByPath(files[i]->GetFilePath());
                 unlink(files[i]->GetFilePath().c_str());
             }
+            if (dirty != NULL)
+                dirty->RemoveBlock(i);
             files[i] = NULL;
         }
     }
 }
 
+void RollableFile::ReleaseBlocks(size_t max_size)
+{
+    RemoveUnused(max_size, false);
+    ResourcePool::getInstance().ReleaseBlocks(path, max_size / (block_size + 1) + 1);
+}
+
+// Returns the number of retired block files.
+size_t RollableFile::RetireBlocks(size_t max_size)
+{
+    ReleaseBlocks(max_size);
+    retired.clear();
+    for (size_t order = max_size / (block_size + 1) + 1; order < max_num_block; order++) {
+        if (access((path + std::to_string(order)).c_str(), F_OK) == 0)
+            retired.push_back(order);
+    }
+    return retired.size();
+}
+
+// Blocks opened again by the writer since they were retired are kept.
+void RollableFile::UnlinkRetired()
+{
+    if (prealloc != NULL)
+        prealloc->Wait();
+    for (size_t order : retired) {
+        std::string fpath = path + std::to_string(order);
+        if ((order < files.size() && files[order] != NULL)
+            || ResourcePool::getInstance().GetResourceByPath(fpath) != NULL)
+            continue;
+        Logger::Log(LOG_LEVEL_DEBUG, "remove retired block %s", fpath.c_str());
+        unlink(fpath.c_str());
+    }
+    retired.clear();
+}
+
 ////////////////////////////////////
 // memory management using jemalloc
 ////////////////////////////////////
@@ -501,6 +887,10 @@ void* RollableFile::Malloc(size_t size, size_t& offset)
 // offset is the total offset. It is used to find the block order and relative offset within the block.
 size_t RollableFile::MemWrite(const void* src, size_t size, size_t offset)
 {
+    if (offset + size <= mapped_size) {
+        memcpy(region_addr + offset, src, size);
+        return size;
+    }
     int block_order = offset / block_size;
     size_t relative_offset = offset % block_size;
     if (relative_offset + size > block_size) {
@@ -512,6 +902,10 @@ size_t RollableFile::MemWrite(const void* src, size_t size, size_t offset)
 
 size_t RollableFile::MemRead(void* dst, size_t size, size_t offset)
 {
+    if (offset + size <= mapped_size) {
+        memcpy(dst, region_addr + offset, size);
+        return size;
+    }
     int block_order = offset / block_size;
     size_t relative_offset = offset % block_size;
     if (relative_offset + size > block_size) {
@@ -531,6 +925,12 @@ void RollableFile::Free(void* ptr) const
 
 void RollableFile::Free(size_t offset) const
 {
+    if (offset < mapped_size) {
+        unsigned arena_index = files[0]->mm_meta->arena_index;
+        dallocx(region_addr + offset, MALLOCX_ARENA(arena_index) | MALLOCX_TCACHE_NONE);
+        return;
+    }
+
     int block_order = offset / block_size;
     size_t relative_offset = offset % block_size;
     if (block_order >= (int)files.size()) {
@@ -716,11 +1116,12 @@ bool RollableFile::custom_extent_merge(extent_hooks_t* extent_hooks, void* addr_
     size_t size_a, void* addr_b, size_t size_b, bool committed, unsigned arena_ind)
 {
     // Check if the two extents are adjacent
-    // Note if addr_a and addr_b are on different blocks, the following condition will
-    // always be true. This is because the two addresses are from different mmaped regions.
     if ((char*)addr_a + size_a != addr_b) {
         return true;
     }
-    return false;
+    // Blocks are adjacent in the reserved region, but an extent cannot
+    // span two block files.
+    RollableFile* mgr = arena_manager_map[arena_ind];
+    return mgr->find_block_index(addr_a) != mgr->find_block_index(addr_b);
 }
 }
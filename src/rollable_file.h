@@ -23,11 +23,14 @@
 #include <atomic>
 #include <memory>
 #include <stdint.h>
+#include <string.h>
 #include <string>
 #include <sys/mman.h>
 #include <unordered_map>
 #include <vector>
 
+#include "block_prealloc.h"
+#include "dirty_tracker.h"
 #include "logger.h"
 #include "mmap_file.h"
 
@@ -52,25 +55,65 @@ public:
     int ResetJemalloc();
 
     size_t RandomWrite(const void* data, size_t size, off_t offset);
-    size_t RandomRead(void* buff, size_t size, off_t offset);
+    inline size_t RandomRead(void* buff, size_t size, off_t offset);
     void InitShmSlidingAddr(std::atomic<size_t>* shm_sliding_addr);
     int Reserve(size_t& offset, int size, uint8_t*& ptr, bool map_new_sliding = true);
-    uint8_t* GetShmPtr(size_t offset, int size);
+    inline uint8_t* GetShmPtr(size_t offset, int size);
+    // Get the descriptor and file offset for reading the buffer at offset from
+    // its block file. Returns the number of bytes to the end of the block, or
+    // 0 if the buffer is in memory or the block file cannot be opened.
+    size_t GetReadFile(size_t offset, int& fd, off_t& file_off);
     size_t CheckAlignment(size_t offset, int size);
     void PrintStats(std::ostream& out_stream = std::cout) const;
+    // Open the blocks holding offsets below size and add the mapped part of
+    // each block to blocks. Blocks that are not mapped are skipped.
+    void GetMappedBlocks(size_t size, std::vector<std::pair<uint8_t*, size_t>>& blocks);
+    // Set the NUMA policy of the mapped blocks and the blocks mapped later
+    void SetNumaPolicy(int policy, uint64_t nodes);
+    // Print the number of resident pages of the mapped blocks on each node
+    void PrintNumaStats(std::ostream& out_stream) const;
+    // Preallocate the next block in the background once the writer has
+    // reserved buffers past the given percentage of the current block
+    int EnablePrealloc(int percentage);
+    size_t GetNumPreallocated() const;
+    // Memory-only mode: back the blocks beyond the memory cap with unlinked
+    // files in dir instead of failing with NO_MEMORY. If demote is set, the
+    // coldest block is moved to dir first so that the new block stays in
+    // memory. Called by the writer only.
+    int EnableSpill(const std::string& dir, bool demote);
+    // Count a sampled lookup of the buffer at offset for demotion
+    inline void RecordAccess(size_t offset);
+    size_t GetNumSpilled() const;
     void Close();
     void ResetSlidingWindow();
 
     void Flush();
+    // Sync up to max_bytes of the dirty pages. Returns the number of bytes synced.
+    size_t FlushDirty(size_t max_bytes);
+    inline void MarkDirty(size_t offset, size_t size);
+    DirtyTracker* GetDirtyTracker() const;
     size_t GetResourceCollectionOffset() const;
     void RemoveUnused(size_t max_size, bool writer_mode);
+    // Drop the blocks beyond max_size after the DB has shrunk. Readers call
+    // ReleaseBlocks once the writer has retired the blocks. The writer keeps
+    // the retired block files until UnlinkRetired is called.
+    void ReleaseBlocks(size_t max_size);
+    size_t RetireBlocks(size_t max_size);
+    void UnlinkRetired();
 
     static const long page_size;
     static int ShmSync(uint8_t* addr, int size);
+    // Size of the huge pages used for the given HUGE_PAGE_* options
+    static size_t HugePageSize(int huge_page_mode);
 
 private:
     int OpenAndMapBlockFile(size_t block_order, bool create_file);
     int CheckAndOpenFile(size_t block_order, bool create_file);
+    int SpillColdBlock(size_t block_order);
+    void UpdateMappedSize();
+    void PreallocNextBlock(size_t offset);
+    size_t ReadFromFile(void* buff, size_t size, off_t offset);
+    uint8_t* GetFilePtr(size_t offset, int size);
     uint8_t* NewSlidingMapAddr(size_t offset, int size);
     void* NewReaderSlidingMap(size_t order);
 
@@ -110,6 +153,11 @@ private:
     size_t max_num_block;
 
     std::vector<std::shared_ptr<MmapFileIO>> files;
+    // Blocks are mapped in order into the region if it can be reserved.
+    // Offsets below mapped_size are at region_addr + offset.
+    std::shared_ptr<MmapRegion> region;
+    uint8_t* region_addr;
+    size_t mapped_size;
     uint8_t* sliding_addr;
     size_t sliding_size;
     off_t sliding_start;
@@ -117,14 +165,64 @@ private:
 
     int rc_offset_percentage;
     size_t mem_used;
+    int numa_policy;
+    uint64_t numa_nodes;
+    // Pages updated by the writer since the last flush. Not used in memory-only
+    // and jemalloc modes.
+    DirtyTracker* dirty;
+    BlockPreallocator* prealloc;
+    int prealloc_percentage;
+    // The next block is requested once the writer reserves a buffer at or
+    // above this offset, or more than one block below it.
+    size_t prealloc_offset;
+    // Orders of the block files retired by the writer
+    std::vector<size_t> retired;
+    // Directory of the spilled blocks in memory-only mode
+    std::string spill_dir;
+    bool spill_demote;
 
     // jemalloc only
     static std::unordered_map<unsigned, RollableFile*> arena_manager_map;
 };
 
+// Called by the writer after updating the buffer at offset. Writes through
+// RandomWrite are tracked already. Callers writing to pointers returned by
+// Reserve or GetShmPtr need to mark the buffer after the update.
+inline void RollableFile::MarkDirty(size_t offset, size_t size)
+{
+    if (dirty != NULL)
+        dirty->MarkDirty(offset, size);
+}
+
+inline void RollableFile::RecordAccess(size_t offset)
+{
+    size_t order = offset / block_size;
+    if (order < files.size() && files[order] != NULL)
+        files[order]->RecordAccess();
+}
+
+inline size_t RollableFile::RandomRead(void* buff, size_t size, off_t offset)
+{
+    if (offset + size <= mapped_size) {
+        memcpy(buff, region_addr + offset, size);
+        return size;
+    }
+    return ReadFromFile(buff, size, offset);
+}
+
+// Get shared memory address for existing buffer
+inline uint8_t* RollableFile::GetShmPtr(size_t offset, int size)
+{
+    if (offset + size <= mapped_size)
+        return region_addr + offset;
+    return GetFilePtr(offset, size);
+}
+
 // Find the block index that contains the given pointer
 inline int RollableFile::find_block_index(void* ptr) const
 {
+    if (ptr >= region_addr && ptr < region_addr + mapped_size)
+        return ((uint8_t*)ptr - region_addr) / block_size;
     for (auto i = 0; i < (int)files.size(); i++) {
         if (files[i] != nullptr && files[i]->IsMapped()) {
             uint8_t* base_ptr = files[i]->GetMapAddr();
@@ -142,6 +240,8 @@ inline int RollableFile::find_block_index(void* ptr) const
 // Note that this is the total offset from the beginning of the first file
 inline size_t RollableFile::get_shm_offset(void* ptr) const
 {
+    if (ptr >= region_addr && ptr < region_addr + mapped_size)
+        return (uint8_t*)ptr - region_addr;
     for (auto i = 0; i < (int)files.size(); i++) {
         if (files[i] != nullptr && files[i]->IsMapped()) {
             uint8_t* base_ptr = files[i]->GetMapAddr();
@@ -158,6 +258,8 @@ inline size_t RollableFile::get_shm_offset(void* ptr) const
 // Get the aligned offset of the given pointer relative to the beginning of the block
 inline size_t RollableFile::get_aligned_offset(void* ptr) const
 {
+    if (ptr >= region_addr && ptr < region_addr + mapped_size)
+        return ((uint8_t*)ptr - region_addr) % block_size;
     for (auto i = 0; i < (int)files.size(); i++) {
         if (files[i] != nullptr && files[i]->IsMapped()) {
             uint8_t* base_ptr = files[i]->GetMapAddr();
@@ -16,9 +16,14 @@
 
 // @author Changxue Deng <chadeng@cisco.com>
 
+#include <errno.h>
+#include <fcntl.h>
 #include <iostream>
+#include <string.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
+#include "drm_base.h"
 #include "error.h"
 #include "logger.h"
 #include "resource_pool.h"
@@ -31,7 +36,8 @@ ShmQueueMgr::ShmQueueMgr()
 {
 }
 
-void ShmQueueMgr::InitShmObjects(shm_lock_and_queue* slaq, int queue_size)
+void ShmQueueMgr::InitShmObjects(shm_lock_and_queue* slaq, int queue_size,
+    uint32_t start_index)
 {
     int rval = MBError::SUCCESS;
 
@@ -39,19 +45,78 @@ void ShmQueueMgr::InitShmObjects(shm_lock_and_queue* slaq, int queue_size)
     if (rval != MBError::SUCCESS)
         throw rval;
 
-    slaq->initialized = 1;
+    // Slot for position pos is queue[pos % queue_size]. Mark the next
+    // queue_size positions starting from start_index as free.
+    for (int i = 0; i < queue_size; i++) {
+        uint32_t pos = start_index + i;
+        AsyncNode* node_ptr = &slaq->queue[pos % queue_size];
+        node_ptr->type = MABAIN_ASYNC_TYPE_NONE;
+        node_ptr->producer.store(0, std::memory_order_relaxed);
+        node_ptr->seq.store(MB_ASYNC_SHM_SEQ_FREE(pos), std::memory_order_relaxed);
+    }
+    slaq->num_waiter.store(0, std::memory_order_relaxed);
+    slaq->doorbell.store(0, std::memory_order_relaxed);
+    slaq->writer_parked.store(0, std::memory_order_relaxed);
+    slaq->num_park.store(0, std::memory_order_relaxed);
+    slaq->num_ring.store(0, std::memory_order_relaxed);
+
+    slaq->initialized = MB_ASYNC_SHM_QUEUE_VERSION;
+}
+
+// Check if the slot sequence numbers are consistent with the indexes in header.
+// Positions in [writer_index, queue_index) have been claimed and the updates may
+// or may not be published. Positions starting from queue_index must be free or
+// skipped in the previous round.
+bool ShmQueueMgr::CheckSlotSequence(const shm_lock_and_queue* slaq, int queue_size,
+    uint32_t writer_index, uint32_t queue_index) const
+{
+    uint32_t nclaimed = queue_index - writer_index;
+    if (nclaimed > static_cast<uint32_t>(queue_size))
+        return false;
+
+    for (uint32_t i = 0; i < static_cast<uint32_t>(queue_size); i++) {
+        uint32_t pos = writer_index + i;
+        uint32_t seq = slaq->queue[pos % queue_size].seq.load(std::memory_order_relaxed);
+        if (seq == MB_ASYNC_SHM_SEQ_FREE(pos))
+            continue;
+        if (i < nclaimed && seq == MB_ASYNC_SHM_SEQ_READY(pos))
+            continue;
+        if (i >= nclaimed && seq == MB_ASYNC_SHM_SEQ_SKIPPED(pos - queue_size))
+            continue;
+        return false;
+    }
+    return true;
+}
+
+// Slots skipped by the previous writer are released if their producers did
+// not release them before the writer opens the DB again.
+void ShmQueueMgr::ReleaseSkippedSlots(shm_lock_and_queue* slaq, int queue_size,
+    uint32_t queue_index)
+{
+    for (uint32_t i = 0; i < static_cast<uint32_t>(queue_size); i++) {
+        uint32_t pos = queue_index + i;
+        uint32_t seq = MB_ASYNC_SHM_SEQ_SKIPPED(pos - queue_size);
+        if (slaq->queue[pos % queue_size].seq.compare_exchange_strong(seq,
+                MB_ASYNC_SHM_SEQ_FREE(pos), std::memory_order_seq_cst)) {
+            Logger::Log(LOG_LEVEL_WARN, "released skipped async queue slot %u",
+                pos - queue_size);
+        }
+    }
+}
+
+std::string ShmQueueMgr::GetFilePath(uint64_t qid, const char* queue_dir)
+{
+    if (queue_dir != NULL)
+        return std::string(queue_dir) + "/_mabain_q" + std::to_string(qid);
+    return "/dev/shm/_mabain_q" + std::to_string(qid);
 }
 
 shm_lock_and_queue* ShmQueueMgr::CreateFile(uint64_t qid, int qsize,
-    const char* queue_dir, int options)
+    const char* queue_dir, int options, IndexHeader* header)
 {
     if (qsize > MB_MAX_NUM_SHM_QUEUE_NODE)
         throw(int) MBError::INVALID_SIZE;
-    std::string qfile_path;
-    if (queue_dir != NULL)
-        qfile_path = std::string(queue_dir) + "/_mabain_q" + std::to_string(qid);
-    else
-        qfile_path = "/dev/shm/_mabain_q" + std::to_string(qid);
+    std::string qfile_path = GetFilePath(qid, queue_dir);
 
     bool init_queue = false;
     if (access(qfile_path.c_str(), F_OK))
@@ -76,12 +141,21 @@ shm_lock_and_queue* ShmQueueMgr::CreateFile(uint64_t qid, int qsize,
     if (options & CONSTS::ACCESS_MODE_WRITER) {
         if (init_queue)
             slaq->initialized = 0;
-        if (slaq->initialized == 0) {
+        if (slaq->initialized == MB_ASYNC_SHM_QUEUE_VERSION
+            && !CheckSlotSequence(slaq, qsize, header->writer_index,
+                header->queue_index.load(std::memory_order_relaxed))) {
+            Logger::Log(LOG_LEVEL_WARN, "shared memory queue does not match header, reset queue");
+            slaq->initialized = 0;
+        }
+        if (slaq->initialized != MB_ASYNC_SHM_QUEUE_VERSION) {
             Logger::Log(LOG_LEVEL_DEBUG, "initializing shared memory queue");
-            InitShmObjects(slaq, qsize);
+            InitShmObjects(slaq, qsize, header->writer_index);
+            header->queue_index.store(header->writer_index, std::memory_order_release);
+        } else {
+            ReleaseSkippedSlots(slaq, qsize, header->queue_index.load(std::memory_order_relaxed));
         }
     } else {
-        if (slaq->initialized == 0) {
+        if (slaq->initialized != MB_ASYNC_SHM_QUEUE_VERSION) {
             Logger::Log(LOG_LEVEL_ERROR, "shared memory queue not intialized");
             throw(int) MBError::NOT_INITIALIZED;
         }
@@ -94,4 +168,64 @@ ShmQueueMgr::~ShmQueueMgr()
 {
 }
 
+// Token t uses byte t of the queue file. The writer only checks the locks.
+ShmQueueProducer::ShmQueueProducer(const std::string& qfile_path, bool writer)
+    : fd(-1)
+    , token(0)
+{
+    fd = open(qfile_path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        Logger::Log(LOG_LEVEL_WARN, "failed to open %s for producer lock errno %d",
+            qfile_path.c_str(), errno);
+        return;
+    }
+    if (writer)
+        return;
+
+    // Start from a different token in each process to avoid probing the
+    // tokens taken by other producers.
+    uint32_t start = static_cast<uint32_t>(getpid()) % MB_ASYNC_SHM_MAX_PRODUCER;
+    for (uint32_t i = 0; i < MB_ASYNC_SHM_MAX_PRODUCER; i++) {
+        uint32_t t = (start + i) % MB_ASYNC_SHM_MAX_PRODUCER + 1;
+        struct flock lock;
+        memset(&lock, 0, sizeof(lock));
+        lock.l_type = F_WRLCK;
+        lock.l_whence = SEEK_SET;
+        lock.l_start = t;
+        lock.l_len = 1;
+        if (fcntl(fd, F_OFD_SETLK, &lock) == 0) {
+            token = t;
+            return;
+        }
+        if (errno != EAGAIN && errno != EACCES)
+            break;
+    }
+    // Slots skipped by this producer are released when the writer opens
+    // the queue again.
+    Logger::Log(LOG_LEVEL_WARN, "no producer token available in %s", qfile_path.c_str());
+}
+
+ShmQueueProducer::~ShmQueueProducer()
+{
+    // The lock is released with the file descriptor.
+    if (fd >= 0)
+        close(fd);
+}
+
+bool ShmQueueProducer::Running(uint32_t t) const
+{
+    if (t == 0 || t > MB_ASYNC_SHM_MAX_PRODUCER || fd < 0)
+        return true;
+
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    lock.l_start = t;
+    lock.l_len = 1;
+    if (fcntl(fd, F_OFD_GETLK, &lock) != 0)
+        return true;
+    return lock.l_type != F_UNLCK;
+}
+
 }
@@ -25,20 +25,49 @@
 
 namespace mabain {
 
+struct _IndexHeader;
+typedef struct _IndexHeader IndexHeader;
+
 #define MABAIN_ASYNC_TYPE_NONE 0
 #define MABAIN_ASYNC_TYPE_ADD 1
 #define MABAIN_ASYNC_TYPE_REMOVE 2
 #define MABAIN_ASYNC_TYPE_REMOVE_ALL 3
 #define MABAIN_ASYNC_TYPE_RC 4
 #define MABAIN_ASYNC_TYPE_BACKUP 5
+#define MABAIN_ASYNC_TYPE_MERGE 6
 
 #define MB_ASYNC_SHM_KEY_SIZE 256
 #define MB_ASYNC_SHM_DATA_SIZE 0x7FFF
 #define MB_ASYNC_SHM_LOCK_TMOUT 5
+// Time in millisecond before the writer gives up a slot that was claimed
+// but never published, e.g., the producer process exited unexpectedly.
+#define MB_ASYNC_SHM_STALL_TMOUT 1000
+// Layout version of the shared memory queue file
+#define MB_ASYNC_SHM_QUEUE_VERSION 6
+// Number of producer tokens. See ShmQueueProducer.
+#define MB_ASYNC_SHM_MAX_PRODUCER 4096
+// Number of polls on the next slot before the async writer parks on the doorbell
+#define MB_ASYNC_WRITER_SPIN_COUNT 4096
+
+// Each slot carries a sequence number (bounded MPSC queue). For the update at
+// queue position pos, the slot queue[pos % queue_size] goes through
+//   MB_ASYNC_SHM_SEQ_FREE(pos):  free, can be claimed by the producer for pos
+//   MB_ASYNC_SHM_SEQ_READY(pos): update published, ready for the async writer
+//   MB_ASYNC_SHM_SEQ_FREE(pos + queue_size): released for the next round
+// If the producer does not publish the update in MB_ASYNC_SHM_STALL_TMOUT, the
+// async writer moves on to pos + 1 and leaves the slot in
+//   MB_ASYNC_SHM_SEQ_SKIPPED(pos): given up by the async writer
+// The slot is only released for the next round by the producer for pos when
+// it fails to publish, since the producer may still be writing to the slot,
+// or by the async writer once the producer has exited.
+#define MB_ASYNC_SHM_SEQ_FREE(pos) (static_cast<uint32_t>(pos) << 2)
+#define MB_ASYNC_SHM_SEQ_READY(pos) ((static_cast<uint32_t>(pos) << 2) | 1)
+#define MB_ASYNC_SHM_SEQ_SKIPPED(pos) ((static_cast<uint32_t>(pos) << 2) | 2)
 
 typedef struct _AsyncNode {
-    std::atomic<bool> in_use;
-    std::atomic<uint16_t> num_reader;
+    std::atomic<uint32_t> seq;
+    // token of the producer claiming the slot
+    std::atomic<uint32_t> producer;
 
     char key[MB_ASYNC_SHM_KEY_SIZE];
     char data[MB_ASYNC_SHM_DATA_SIZE];
@@ -46,11 +75,23 @@ typedef struct _AsyncNode {
     int data_len;
     bool overwrite;
     char type;
+    // merge operator for MABAIN_ASYNC_TYPE_MERGE
+    uint8_t merge_op;
+    // expiry time for MABAIN_ASYNC_TYPE_ADD
+    uint32_t expire_time;
 } AsyncNode;
 
 typedef struct _shm_lock_and_queue {
     int initialized;
     pthread_mutex_t lock;
+    // number of producers blocked on a full queue
+    std::atomic<uint32_t> num_waiter;
+    // Doorbell for waking up the async writer. Producers ring the doorbell
+    // only if the writer is parked.
+    std::atomic<uint32_t> doorbell;
+    std::atomic<uint32_t> writer_parked;
+    std::atomic<uint64_t> num_park; // number of times the writer parked
+    std::atomic<uint64_t> num_ring; // number of doorbell wakeups by producers
     AsyncNode queue[MB_MAX_NUM_SHM_QUEUE_NODE];
 } shm_lock_and_queue;
 
@@ -58,12 +99,43 @@ class ShmQueueMgr {
 public:
     ShmQueueMgr();
     ~ShmQueueMgr();
-    shm_lock_and_queue* CreateFile(uint64_t qid, int qsize, const char* queue_dir, int options);
+    shm_lock_and_queue* CreateFile(uint64_t qid, int qsize, const char* queue_dir, int options,
+        IndexHeader* header);
+    static std::string GetFilePath(uint64_t qid, const char* queue_dir);
+
+private:
+    void InitShmObjects(shm_lock_and_queue* slaq, int queue_size, uint32_t start_index);
+    bool CheckSlotSequence(const shm_lock_and_queue* slaq, int queue_size,
+        uint32_t writer_index, uint32_t queue_index) const;
+    void ReleaseSkippedSlots(shm_lock_and_queue* slaq, int queue_size, uint32_t queue_index);
+};
+
+// Liveness of the producers of a queue. A producer owns a token as long as it
+// holds a write lock on the byte of the token in the queue file, and records
+// the token in the slots it claims. A slot skipped by the async writer is
+// released by the writer once the lock is gone. As in ReaderRegistry, the
+// locks are open file description locks released when the producer exits.
+class ShmQueueProducer {
+public:
+    ShmQueueProducer(const std::string& qfile_path, bool writer);
+    ~ShmQueueProducer();
+
+    // Zero if no token is available
+    uint32_t GetToken() const;
+    // Check if the producer owning the token may still be running. Unknown
+    // producers are taken as running.
+    bool Running(uint32_t token) const;
 
 private:
-    void InitShmObjects(shm_lock_and_queue* slaq, int queue_size);
+    int fd;
+    uint32_t token;
 };
 
+inline uint32_t ShmQueueProducer::GetToken() const
+{
+    return token;
+}
+
 }
 
 #endif
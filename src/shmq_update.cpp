@@ -18,8 +18,13 @@
 
 #include <pthread.h>
 #include <sys/time.h>
+#include <unistd.h>
 
+#include <climits>
+
+#include "./util/futex.h"
 #include "./util/shm_mutex.h"
+#include "./util/utils.h"
 #include "async_writer.h"
 #include "dict.h"
 #include "error.h"
@@ -27,14 +32,15 @@
 namespace mabain {
 
 int Dict::SHMQ_Add(const char* key, int key_len, const char* data, int data_len,
-    bool overwrite)
+    bool overwrite, int timeout, uint32_t expire_time)
 {
     if (key_len > MB_ASYNC_SHM_KEY_SIZE || data_len > MB_ASYNC_SHM_DATA_SIZE) {
         return MBError::OUT_OF_BOUND;
     }
 
     int err = MBError::SUCCESS;
-    AsyncNode* node_ptr = SHMQ_AcquireSlot(err);
+    uint32_t pos;
+    AsyncNode* node_ptr = SHMQ_AcquireSlot(err, pos, timeout);
     if (node_ptr == nullptr)
         return err;
 
@@ -43,39 +49,66 @@ int Dict::SHMQ_Add(const char* key, int key_len, const char* data, int data_len,
     node_ptr->key_len = key_len;
     node_ptr->data_len = data_len;
     node_ptr->overwrite = overwrite;
+    node_ptr->expire_time = expire_time;
 
     node_ptr->type = MABAIN_ASYNC_TYPE_ADD;
-    return SHMQ_PrepareSlot(node_ptr);
+    return SHMQ_PrepareSlot(node_ptr, pos);
 }
 
-int Dict::SHMQ_Remove(const char* key, int len)
+int Dict::SHMQ_Remove(const char* key, int len, int timeout)
 {
     if (len > MB_ASYNC_SHM_KEY_SIZE)
         return MBError::OUT_OF_BOUND;
 
     int err = MBError::SUCCESS;
-    AsyncNode* node_ptr = SHMQ_AcquireSlot(err);
+    uint32_t pos;
+    AsyncNode* node_ptr = SHMQ_AcquireSlot(err, pos, timeout);
     if (node_ptr == nullptr)
         return err;
 
     memcpy(node_ptr->key, key, len);
     node_ptr->key_len = len;
     node_ptr->type = MABAIN_ASYNC_TYPE_REMOVE;
-    return SHMQ_PrepareSlot(node_ptr);
+    return SHMQ_PrepareSlot(node_ptr, pos);
 }
 
-int Dict::SHMQ_RemoveAll()
+int Dict::SHMQ_Merge(const char* key, int key_len, int op, const char* operand,
+    int operand_len, int timeout)
 {
+    if (key_len > MB_ASYNC_SHM_KEY_SIZE || operand_len > MB_ASYNC_SHM_DATA_SIZE)
+        return MBError::OUT_OF_BOUND;
+    if (op <= 0 || op > MB_MERGE_USER_MAX)
+        return MBError::INVALID_ARG;
+
     int err = MBError::SUCCESS;
-    AsyncNode* node_ptr = SHMQ_AcquireSlot(err);
+    uint32_t pos;
+    AsyncNode* node_ptr = SHMQ_AcquireSlot(err, pos, timeout);
+    if (node_ptr == nullptr)
+        return err;
+
+    memcpy(node_ptr->key, key, key_len);
+    memcpy(node_ptr->data, operand, operand_len);
+    node_ptr->key_len = key_len;
+    node_ptr->data_len = operand_len;
+    node_ptr->merge_op = op;
+    node_ptr->expire_time = 0;
+    node_ptr->type = MABAIN_ASYNC_TYPE_MERGE;
+    return SHMQ_PrepareSlot(node_ptr, pos);
+}
+
+int Dict::SHMQ_RemoveAll(int timeout)
+{
+    int err = MBError::SUCCESS;
+    uint32_t pos;
+    AsyncNode* node_ptr = SHMQ_AcquireSlot(err, pos, timeout);
     if (node_ptr == nullptr)
         return err;
 
     node_ptr->type = MABAIN_ASYNC_TYPE_REMOVE_ALL;
-    return SHMQ_PrepareSlot(node_ptr);
+    return SHMQ_PrepareSlot(node_ptr, pos);
 }
 
-int Dict::SHMQ_Backup(const char* backup_dir)
+int Dict::SHMQ_Backup(const char* backup_dir, int timeout)
 {
     if (backup_dir == nullptr)
         return MBError::INVALID_ARG;
@@ -83,21 +116,24 @@ int Dict::SHMQ_Backup(const char* backup_dir)
         return MBError::OUT_OF_BOUND;
 
     int err = MBError::SUCCESS;
-    AsyncNode* node_ptr = SHMQ_AcquireSlot(err);
+    uint32_t pos;
+    AsyncNode* node_ptr = SHMQ_AcquireSlot(err, pos, timeout);
     if (node_ptr == nullptr)
         return err;
     snprintf(node_ptr->data, MB_ASYNC_SHM_DATA_SIZE, "%s", backup_dir);
     node_ptr->type = MABAIN_ASYNC_TYPE_BACKUP;
-    return SHMQ_PrepareSlot(node_ptr);
+    return SHMQ_PrepareSlot(node_ptr, pos);
 }
 
 int Dict::SHMQ_CollectResource(int64_t m_index_rc_size,
     int64_t m_data_rc_size,
     int64_t max_dbsz,
-    int64_t max_dbcnt)
+    int64_t max_dbcnt,
+    int timeout)
 {
     int err = MBError::SUCCESS;
-    AsyncNode* node_ptr = SHMQ_AcquireSlot(err);
+    uint32_t pos;
+    AsyncNode* node_ptr = SHMQ_AcquireSlot(err, pos, timeout);
     if (node_ptr == nullptr)
         return err;
 
@@ -109,41 +145,235 @@ int Dict::SHMQ_CollectResource(int64_t m_index_rc_size,
     data_ptr[3] = max_dbcnt;
     node_ptr->type = MABAIN_ASYNC_TYPE_RC;
 
-    return SHMQ_PrepareSlot(node_ptr);
+    return SHMQ_PrepareSlot(node_ptr, pos);
 }
 
-AsyncNode* Dict::SHMQ_AcquireSlot(int& err) const
+// Claim the slot for the next queue position. Producers compete on queue_index
+// only when the slot sequence shows the slot is free for this round. If the
+// queue is full, wait for the async writer to release the oldest slot for at
+// most timeout milliseconds.
+AsyncNode* Dict::SHMQ_AcquireSlot(int& err, uint32_t& pos, int timeout) const
 {
-    uint32_t index = header->queue_index.fetch_add(1, std::memory_order_release);
-    AsyncNode* node_ptr = queue + (index % header->async_queue_size);
+    uint32_t qsize = static_cast<uint32_t>(header->async_queue_size);
+    bool queue_full = false;
+    int64_t t_end = 0;
+
+    pos = header->queue_index.load(std::memory_order_relaxed);
+    while (true) {
+        AsyncNode* node_ptr = queue + (pos % qsize);
+        uint32_t seq = node_ptr->seq.load(std::memory_order_acquire);
+        int32_t diff = static_cast<int32_t>(seq - MB_ASYNC_SHM_SEQ_FREE(pos));
+        if (diff == 0) {
+            if (header->queue_index.compare_exchange_weak(pos, pos + 1,
+                    std::memory_order_relaxed, std::memory_order_relaxed)) {
+                node_ptr->producer.store(shmq_producer->GetToken(), std::memory_order_relaxed);
+                return node_ptr;
+            }
+            // pos has been reloaded by compare_exchange_weak
+            continue;
+        }
+        if (diff > 0) {
+            // Another producer has claimed this position.
+            pos = header->queue_index.load(std::memory_order_relaxed);
+            continue;
+        }
+
+        // The slot still holds the update from the previous round.
+        if (!queue_full) {
+            queue_full = true;
+            header->shmq_full_count.fetch_add(1, std::memory_order_relaxed);
+            if (timeout > 0)
+                t_end = get_current_time_ms() + timeout;
+        }
+        int64_t t_left = t_end - get_current_time_ms();
+        if (timeout <= 0 || t_left <= 0) {
+            if (timeout > 0)
+                header->shmq_timeout_count.fetch_add(1, std::memory_order_relaxed);
+            err = MBError::TRY_AGAIN;
+            return nullptr;
+        }
 
-    if (node_ptr->in_use.load(std::memory_order_consume)) {
-        // This slot is being processed by writer.
-        err = MBError::TRY_AGAIN;
-        return nullptr;
+        header->shmq_wait_count.fetch_add(1, std::memory_order_relaxed);
+        // The writer checks num_waiter after releasing the slot. Sequential
+        // consistency guarantees either the writer sees the waiter or the
+        // futex sees the new sequence number.
+        slaq->num_waiter.fetch_add(1, std::memory_order_seq_cst);
+        FutexWait(&node_ptr->seq, seq, static_cast<int>(t_left));
+        slaq->num_waiter.fetch_sub(1, std::memory_order_seq_cst);
+        pos = header->queue_index.load(std::memory_order_relaxed);
     }
+}
 
-    uint16_t nreader = node_ptr->num_reader.fetch_add(1, std::memory_order_release);
-    if (nreader != 0) {
-        // This slot is being processed by another reader.
-        err = MBError::TRY_AGAIN;
-        return nullptr;
+int Dict::SHMQ_PrepareSlot(AsyncNode* node_ptr, uint32_t pos)
+{
+    // Publish the update. This fails only if the writer has given up the slot
+    // because the update was not published in MB_ASYNC_SHM_STALL_TMOUT.
+    uint32_t seq = MB_ASYNC_SHM_SEQ_FREE(pos);
+    if (!node_ptr->seq.compare_exchange_strong(seq, MB_ASYNC_SHM_SEQ_READY(pos),
+            std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        // Nothing is written to the slot any more. Release it for the next round.
+        if (seq == MB_ASYNC_SHM_SEQ_SKIPPED(pos)) {
+            node_ptr->seq.store(MB_ASYNC_SHM_SEQ_FREE(pos + header->async_queue_size),
+                std::memory_order_seq_cst);
+            if (slaq->num_waiter.load(std::memory_order_seq_cst) > 0)
+                FutexWake(&node_ptr->seq, INT_MAX);
+        }
+        return MBError::TRY_AGAIN;
     }
 
-    return node_ptr;
+    RingDoorbell(false);
+    return MBError::SUCCESS;
 }
 
-int Dict::SHMQ_PrepareSlot(AsyncNode* node_ptr)
+// Wake up the async writer. Unless forced, no system call is made if the writer
+// is not parked. The seq_cst publish in SHMQ_PrepareSlot and the seq_cst load of
+// writer_parked pair with the writer storing writer_parked before checking the
+// slot in SHMQ_WaitForSlot. Either the writer sees the update or we see the writer
+// parked.
+void Dict::RingDoorbell(bool force)
 {
-    node_ptr->in_use.store(true, std::memory_order_release);
+    if (!force && slaq->writer_parked.load(std::memory_order_seq_cst) == 0)
+        return;
 
-    mbp.Signal();
-    return MBError::SUCCESS;
+    slaq->doorbell.fetch_add(1, std::memory_order_seq_cst);
+    slaq->num_ring.fetch_add(1, std::memory_order_relaxed);
+    // One waiter is enough. A pool thread woken up here wakes up its peers if
+    // there are more queues to serve.
+    FutexWake(&slaq->doorbell, 1);
+}
+
+// Spinning only helps if producers can run on other CPUs at the same time.
+static int GetWriterSpinCount()
+{
+    static int spin_count = (sysconf(_SC_NPROCESSORS_ONLN) > 1) ? MB_ASYNC_WRITER_SPIN_COUNT : 0;
+    return spin_count;
+}
+
+// Used by async writer to wait for the update at position pos to be published.
+// Spin on the slot for a short while first and then park on the doorbell for at
+// most timeout milliseconds. Returns true if the update is ready.
+bool Dict::SHMQ_WaitForSlot(AsyncNode* node_ptr, uint32_t pos, int timeout)
+{
+    uint32_t ready = MB_ASYNC_SHM_SEQ_READY(pos);
+    int spin_count = GetWriterSpinCount();
+    for (int i = 0; i < spin_count; i++) {
+        if (node_ptr->seq.load(std::memory_order_acquire) == ready)
+            return true;
+        MB_CPU_RELAX();
+    }
+
+    uint32_t bell = slaq->doorbell.load(std::memory_order_seq_cst);
+    slaq->writer_parked.store(1, std::memory_order_seq_cst);
+    if (node_ptr->seq.load(std::memory_order_seq_cst) != ready) {
+        slaq->num_park.fetch_add(1, std::memory_order_relaxed);
+        FutexWait(&slaq->doorbell, bell, timeout);
+    }
+    slaq->writer_parked.store(0, std::memory_order_relaxed);
+
+    return node_ptr->seq.load(std::memory_order_acquire) == ready;
+}
+
+// Check if the next update in the queue has been published.
+bool Dict::SHMQ_UpdateReady() const
+{
+    uint32_t windex = header->writer_index;
+    const AsyncNode* node_ptr = &queue[windex % header->async_queue_size];
+    return node_ptr->seq.load(std::memory_order_seq_cst) == MB_ASYNC_SHM_SEQ_READY(windex);
+}
+
+// Used by writer pool threads waiting on the doorbells of multiple queues. Unlike
+// SHMQ_WaitForSlot, several pool threads may be parked on the same queue. The
+// caller must check SHMQ_UpdateReady after parking and before blocking on the
+// returned doorbell with the value in bell.
+std::atomic<uint32_t>* Dict::SHMQ_ParkWriter(uint32_t& bell)
+{
+    bell = slaq->doorbell.load(std::memory_order_seq_cst);
+    slaq->writer_parked.fetch_add(1, std::memory_order_seq_cst);
+    slaq->num_park.fetch_add(1, std::memory_order_relaxed);
+    return &slaq->doorbell;
+}
+
+void Dict::SHMQ_UnparkWriter()
+{
+    slaq->writer_parked.fetch_sub(1, std::memory_order_relaxed);
+}
+
+// Release the slot at position pos after the update has been processed. Blocked
+// producers are woken up if there is any.
+bool Dict::SHMQ_ReleaseSlot(AsyncNode* node_ptr, uint32_t pos)
+{
+    uint32_t seq = MB_ASYNC_SHM_SEQ_READY(pos);
+    if (!node_ptr->seq.compare_exchange_strong(seq, MB_ASYNC_SHM_SEQ_FREE(pos + header->async_queue_size),
+            std::memory_order_seq_cst)) {
+        return false;
+    }
+    header->writer_index = pos + 1;
+
+    if (slaq->num_waiter.load(std::memory_order_seq_cst) > 0)
+        FutexWake(&node_ptr->seq, INT_MAX);
+    return true;
+}
+
+// Give up the slot at position pos claimed by a producer that has not published
+// the update. The slot is not released for the next round here since the
+// producer may still be writing to it. See SHMQ_PrepareSlot.
+bool Dict::SHMQ_SkipSlot(AsyncNode* node_ptr, uint32_t pos)
+{
+    uint32_t seq = MB_ASYNC_SHM_SEQ_FREE(pos);
+    if (!node_ptr->seq.compare_exchange_strong(seq, MB_ASYNC_SHM_SEQ_SKIPPED(pos),
+            std::memory_order_seq_cst)) {
+        return false;
+    }
+    header->writer_index = pos + 1;
+    return true;
+}
+
+// Release the slot at queue_index if it was skipped in the previous round and
+// its producer has exited. Producers waiting for the slot would otherwise be
+// blocked until the writer opens the queue again. The producer token is stored
+// right after the slot is claimed. A producer exiting before that cannot be
+// told from the previous producer of the slot.
+bool Dict::SHMQ_ReleaseBlockedSlot(uint32_t& pos)
+{
+    uint32_t qsize = header->async_queue_size;
+    uint32_t qindex = header->queue_index.load(std::memory_order_acquire);
+    AsyncNode* node_ptr = &queue[qindex % qsize];
+    pos = qindex - qsize;
+    uint32_t seq = MB_ASYNC_SHM_SEQ_SKIPPED(pos);
+    if (node_ptr->seq.load(std::memory_order_acquire) != seq)
+        return false;
+    if (shmq_producer->Running(node_ptr->producer.load(std::memory_order_relaxed)))
+        return false;
+    if (!node_ptr->seq.compare_exchange_strong(seq, MB_ASYNC_SHM_SEQ_FREE(qindex),
+            std::memory_order_seq_cst)) {
+        return false;
+    }
+
+    if (slaq->num_waiter.load(std::memory_order_seq_cst) > 0)
+        FutexWake(&node_ptr->seq, INT_MAX);
+    return true;
+}
+
+// Release published slots for positions in [start, end) after the updates have
+// been processed by async writer.
+void Dict::SHMQ_ReleaseSlots(uint32_t start, uint32_t end)
+{
+    uint32_t qsize = header->async_queue_size;
+    for (uint32_t pos = start; pos != end; pos++) {
+        queue[pos % qsize].seq.store(MB_ASYNC_SHM_SEQ_FREE(pos + qsize),
+            std::memory_order_seq_cst);
+    }
+    header->writer_index = end;
+
+    if (slaq->num_waiter.load(std::memory_order_seq_cst) > 0) {
+        for (uint32_t pos = start; pos != end; pos++)
+            FutexWake(&queue[pos % qsize].seq, INT_MAX);
+    }
 }
 
 void Dict::SHMQ_Signal()
 {
-    mbp.Signal();
+    RingDoorbell(true);
 }
 
 bool Dict::SHMQ_Busy() const
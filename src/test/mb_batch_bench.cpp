@@ -0,0 +1,189 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+// Lookup rate of Find and FindBatch when most of the data is beyond
+// memcap_data. The DB is populated once. Then a reader looks up random keys
+// one by one with Find and in batches with FindBatch. With -c the data block
+// files are dropped from the page cache before each run so that the values
+// beyond the memcap are read from the disk.
+// Usage: mb_batch_bench [-n num_keys] [-v value_size] [-r reads] [-b batch_size]
+//                       [-m memcap_data] [-c] [-d db_dir]
+
+#include <assert.h>
+#include <fcntl.h>
+#include <iostream>
+#include <random>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../db.h"
+#include "../dict.h"
+#include "../resource_pool.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+#define BENCH_BLOCK_SIZE (16 * 1024 * 1024LL)
+
+static const char* db_dir = "/var/tmp/mabain_test/";
+
+static int64_t now_us()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+static void set_config(MBConfig& mbconf, int options, size_t memcap_data)
+{
+    memset(&mbconf, 0, sizeof(mbconf));
+    mbconf.mbdir = db_dir;
+    mbconf.options = options;
+    mbconf.memcap_index = 1024 * 1024 * 1024LL;
+    mbconf.memcap_data = memcap_data;
+    mbconf.block_size_index = BENCH_BLOCK_SIZE;
+    mbconf.block_size_data = BENCH_BLOCK_SIZE;
+}
+
+static size_t populate(int nkeys, int value_size)
+{
+    std::string cmd = std::string("rm -f ") + db_dir + "/_mabain_* " + db_dir + "/_*bfl";
+    if (system(cmd.c_str()) != 0) {
+    }
+
+    MBConfig mbconf;
+    set_config(mbconf, CONSTS::WriterOptions(), 1024 * 1024 * 1024LL);
+    DB db(mbconf);
+    assert(db.is_open());
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+    std::string value(value_size, 'v');
+    for (int i = 0; i < nkeys; i++) {
+        std::string key = tkey.get_key(i);
+        memcpy(&value[0], key.data(), std::min(key.length(), value.length()));
+        db.Add(key, value);
+    }
+    size_t data_size = db.GetDictPtr()->GetHeaderPtr()->m_data_offset;
+    db.Close();
+    ResourcePool::getInstance().RemoveAll();
+    return data_size;
+}
+
+static void drop_page_cache()
+{
+    for (int i = 0;; i++) {
+        std::string path = std::string(db_dir) + "/_mabain_d" + std::to_string(i);
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            break;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int nkeys = 1000000;
+    int value_size = 200;
+    int nreads = 1000000;
+    int batch_size = 64;
+    size_t memcap_data = BENCH_BLOCK_SIZE;
+    bool cold = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            nkeys = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-v") == 0 && i + 1 < argc) {
+            value_size = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            nreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            batch_size = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            memcap_data = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-c") == 0) {
+            cold = true;
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            db_dir = argv[++i];
+        } else {
+            std::cout << "unknown argument " << argv[i] << "\n";
+            return 1;
+        }
+    }
+    if (batch_size <= 0)
+        batch_size = 1;
+    DB::SetLogLevel(0);
+
+    size_t data_size = populate(nkeys, value_size);
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+    std::vector<std::string> keys;
+    for (int i = 0; i < nkeys; i++)
+        keys.push_back(tkey.get_key(i));
+    // Both runs look up the same keys.
+    std::mt19937 rand_gen(1);
+    std::uniform_int_distribution<int> dist(0, nkeys - 1);
+    std::vector<std::string> lookups;
+    for (int i = 0; i < nreads; i++)
+        lookups.push_back(keys[dist(rand_gen)]);
+    std::cout << nkeys << " keys, data size " << data_size << ", memcap_data " << memcap_data
+              << ", " << nreads << " lookups, batch size " << batch_size
+              << (cold ? ", page cache dropped" : "") << "\n";
+
+    MBConfig mbconf;
+    set_config(mbconf, CONSTS::ReaderOptions(), memcap_data);
+    DB db(mbconf);
+    assert(db.is_open());
+
+    if (cold)
+        drop_page_cache();
+    int64_t found = 0;
+    MBData mbd;
+    int64_t t0 = now_us();
+    for (int i = 0; i < nreads; i++) {
+        if (db.Find(lookups[i], mbd) == MBError::SUCCESS)
+            found++;
+    }
+    int64_t elapsed = now_us() - t0;
+    std::cout << "\tFind: " << (int64_t)nreads * 1000000 / elapsed << " lookups/s, "
+              << found << " found\n";
+
+    if (cold)
+        drop_page_cache();
+    found = 0;
+    MBData* data = new MBData[batch_size];
+    std::vector<int> rvals(batch_size);
+    std::vector<std::string> batch;
+    t0 = now_us();
+    for (int i = 0; i < nreads; i += batch_size) {
+        int end = std::min(i + batch_size, nreads);
+        batch.assign(lookups.begin() + i, lookups.begin() + end);
+        db.FindBatch(batch, data, rvals.data());
+        for (int k = 0; k < end - i; k++) {
+            if (rvals[k] == MBError::SUCCESS)
+                found++;
+        }
+    }
+    elapsed = now_us() - t0;
+    std::cout << "\tFindBatch: " << (int64_t)nreads * 1000000 / elapsed << " lookups/s, "
+              << found << " found\n";
+    delete[] data;
+
+    db.Close();
+    ResourcePool::getInstance().RemoveAll();
+    return 0;
+}
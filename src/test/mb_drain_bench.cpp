@@ -0,0 +1,149 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+// Benchmark for the async queue drain rate with multi-process producers.
+// Usage: mb_drain_bench [-p num_producer] [-n num_per_producer] [-q queue_size] [-d db_dir]
+
+#include <assert.h>
+#include <atomic>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../db.h"
+#include "../resource_pool.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+static const char* db_dir = "/var/tmp/mabain_test/";
+
+static int64_t now_us()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+static MBConfig get_config(int options, int qsize)
+{
+    MBConfig mbconf;
+    memset(&mbconf, 0, sizeof(mbconf));
+    mbconf.mbdir = db_dir;
+    mbconf.options = options;
+    mbconf.memcap_index = 256 * 1024 * 1024LL;
+    mbconf.memcap_data = 256 * 1024 * 1024LL;
+    mbconf.block_size_index = 64 * 1024 * 1024LL;
+    mbconf.block_size_data = 64 * 1024 * 1024LL;
+    mbconf.queue_size = qsize;
+    mbconf.queue_timeout = 10000;
+    return mbconf;
+}
+
+static void producer(int id, int num, int qsize)
+{
+    MBConfig mbconf = get_config(CONSTS::ReaderOptions(), qsize);
+    DB db(mbconf);
+    assert(db.is_open());
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_128);
+    for (int i = 0; i < num; i++) {
+        std::string key = tkey.get_key(id * num + i);
+        int rval = db.AddAsync(key.data(), key.size(), key.data(), key.size());
+        if (rval != MBError::SUCCESS)
+            std::cout << "failed to add " << key << ": " << MBError::get_error_str(rval) << "\n";
+    }
+    db.Close();
+}
+
+int main(int argc, char* argv[])
+{
+    int nproducer = 4;
+    int num = 100000;
+    int qsize = MB_MAX_NUM_SHM_QUEUE_NODE;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            nproducer = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            num = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            qsize = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            db_dir = argv[++i];
+        } else {
+            std::cout << "unknown argument " << argv[i] << "\n";
+            return 1;
+        }
+    }
+
+    std::string cmd = std::string("rm -f ") + db_dir + "/_mabain_*";
+    if (system(cmd.c_str()) != 0) {
+    }
+    std::atomic<int>* stop = reinterpret_cast<std::atomic<int>*>(mmap(NULL, sizeof(std::atomic<int>),
+        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+    assert(stop != MAP_FAILED);
+    stop->store(0);
+
+    // writer process
+    MBConfig mbconf = get_config(CONSTS::WriterOptions() | CONSTS::ASYNC_WRITER_MODE, qsize);
+    DB* db = new DB(mbconf);
+    assert(db->is_open());
+    db->Close();
+    delete db;
+    ResourcePool::getInstance().RemoveAll();
+    pid_t writer_pid = fork();
+    if (writer_pid == 0) {
+        DB db_w(mbconf);
+        assert(db_w.is_open());
+        while (!stop->load())
+            usleep(10000);
+        db_w.Close();
+        _exit(0);
+    }
+    sleep(1);
+
+    int64_t t0 = now_us();
+    for (int i = 0; i < nproducer; i++) {
+        if (fork() == 0) {
+            producer(i, num, qsize);
+            _exit(0);
+        }
+    }
+    for (int i = 0; i < nproducer; i++)
+        wait(NULL);
+
+    MBConfig rconf = get_config(CONSTS::ReaderOptions(), qsize);
+    DB db_r(rconf);
+    assert(db_r.is_open());
+    while (db_r.AsyncWriterBusy())
+        usleep(100);
+    int64_t elapsed = now_us() - t0;
+
+    int64_t total = (int64_t)nproducer * num;
+    std::cout << nproducer << " producers, " << total << " updates, queue size " << qsize
+              << ": " << elapsed / 1000 << " ms, " << total * 1000000.0 / elapsed << " updates/s\n";
+    std::cout << "db count: " << db_r.Count() << "\n";
+    db_r.PrintStats();
+    db_r.Close();
+
+    stop->store(1);
+    waitpid(writer_pid, NULL, 0);
+    munmap(stop, sizeof(std::atomic<int>));
+    return 0;
+}
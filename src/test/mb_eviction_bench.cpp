@@ -0,0 +1,162 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+// Cache simulation comparing the hit ratio of the eviction policies under a
+// Zipfian read trace. A missed key is added and entries are evicted once the
+// count exceeds the cache size by 10%.
+// Usage: mb_eviction_bench [-n num_keys] [-c cache_size] [-r num_reads] [-s skew] [-d db_dir]
+
+#include <algorithm>
+#include <assert.h>
+#include <cmath>
+#include <random>
+#include <string.h>
+#include <sys/time.h>
+#include <vector>
+
+#include "../db.h"
+#include "../resource_pool.h"
+
+using namespace mabain;
+
+static const char* db_dir = "/var/tmp/mabain_test/";
+
+static int64_t now_us()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+// Zipfian distribution over [0, n) using the inverse of the cumulative
+// distribution. Ranks are mapped to key ids by a random permutation so that
+// the hot keys are not adjacent.
+class ZipfGenerator {
+public:
+    ZipfGenerator(int n, double skew, uint32_t seed)
+        : cdf(n)
+        , ids(n)
+        , rand_gen(seed)
+    {
+        double sum = 0;
+        for (int i = 0; i < n; i++) {
+            sum += 1.0 / pow(i + 1, skew);
+            cdf[i] = sum;
+        }
+        for (int i = 0; i < n; i++) {
+            cdf[i] /= sum;
+            ids[i] = i;
+        }
+        std::shuffle(ids.begin(), ids.end(), rand_gen);
+    }
+
+    int Next()
+    {
+        double u = std::uniform_real_distribution<double>(0, 1)(rand_gen);
+        size_t rank = std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+        if (rank >= cdf.size())
+            rank = cdf.size() - 1;
+        return ids[rank];
+    }
+
+private:
+    std::vector<double> cdf;
+    std::vector<int> ids;
+    std::mt19937 rand_gen;
+};
+
+static void run(const char* name, int policy, int nkeys, int cache_size, int nreads,
+    double skew)
+{
+    std::string cmd = std::string("rm -f ") + db_dir + "/_mabain_*";
+    if (system(cmd.c_str()) != 0) {
+    }
+
+    MBConfig mbconf;
+    memset(&mbconf, 0, sizeof(mbconf));
+    mbconf.mbdir = db_dir;
+    mbconf.options = CONSTS::WriterOptions();
+    mbconf.memcap_index = 256 * 1024 * 1024LL;
+    mbconf.memcap_data = 256 * 1024 * 1024LL;
+    mbconf.block_size_index = 64 * 1024 * 1024LL;
+    mbconf.block_size_data = 64 * 1024 * 1024LL;
+    mbconf.num_entry_per_bucket = std::max(cache_size / 100, 1);
+    mbconf.eviction_policy = policy;
+    DB db(mbconf);
+    assert(db.is_open());
+
+    // Same trace for all policies
+    ZipfGenerator zipf(nkeys, skew, 12345);
+    MBData mbd;
+    int64_t hits = 0;
+    int64_t nevict = 0;
+    int64_t evict_us = 0;
+    int64_t t0 = now_us();
+    for (int i = 0; i < nreads; i++) {
+        std::string key = "key" + std::to_string(zipf.Next());
+        if (db.Find(key, mbd) == MBError::SUCCESS) {
+            hits++;
+            continue;
+        }
+        db.Add(key, key);
+        if (db.Count() > cache_size + cache_size / 10) {
+            int64_t t1 = now_us();
+            db.CollectResource(1LL << 40, 1LL << 40, 1LL << 40, cache_size);
+            evict_us += now_us() - t1;
+            nevict++;
+        }
+    }
+    int64_t elapsed = now_us() - t0;
+
+    std::cout << name << ": hit ratio " << hits * 100.0 / nreads << "%, " << nevict
+              << " evictions in " << evict_us / 1000 << " ms, total " << elapsed / 1000
+              << " ms, count " << db.Count() << "\n";
+    db.Close();
+    ResourcePool::getInstance().RemoveAll();
+}
+
+int main(int argc, char* argv[])
+{
+    int nkeys = 1000000;
+    int cache_size = 100000;
+    int nreads = 2000000;
+    double skew = 0.99;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            nkeys = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            cache_size = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            nreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            skew = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            db_dir = argv[++i];
+        } else {
+            std::cout << "unknown argument " << argv[i] << "\n";
+            return 1;
+        }
+    }
+
+    std::cout << nkeys << " keys, cache size " << cache_size << ", " << nreads
+              << " reads, skew " << skew << "\n";
+    run("bucket", MB_EVICTION_BUCKET, nkeys, cache_size, nreads, skew);
+    run("clock", MB_EVICTION_CLOCK, nkeys, cache_size, nreads, skew);
+    run("lfu", MB_EVICTION_LFU, nkeys, cache_size, nreads, skew);
+    return 0;
+}
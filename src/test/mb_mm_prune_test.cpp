@@ -106,7 +106,7 @@ void add_random_key_value_pairs(mabain::DB& db, int num_pairs, int key_type, Pru
                 db.WriteDataByOffset(pdata.previous_node_offset, reinterpret_cast<const char*>(&data.data_offset), 4);
             }
             // Save the offset for next add
-            pdata.previous_node_offset = data.data_offset + mabain::DB::GetDataHeaderSize();
+            pdata.previous_node_offset = data.data_offset + mabain::DB::GetDataHeaderSize(data);
             if (need_to_prune(db, pdata)) {
                 perform_prune(db, pdata);
             }
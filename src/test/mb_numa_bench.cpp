@@ -0,0 +1,206 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+// Find throughput of reader threads on each NUMA node under each placement
+// policy. For every policy the DB is rebuilt by a writer running on the first
+// node, which is where the pages land by default. Then reader threads pinned
+// to the CPUs of one node at a time look up random keys. Run with the DB
+// directory on tmpfs (e.g. /dev/shm) so that the policy also places the pages
+// faulted in by the writer.
+// Usage: mb_numa_bench [-n num_keys] [-t threads_per_node] [-r reads_per_thread] [-d db_dir]
+
+#include <assert.h>
+#include <fstream>
+#include <iostream>
+#include <pthread.h>
+#include <random>
+#include <sched.h>
+#include <string.h>
+#include <sys/time.h>
+#include <thread>
+#include <vector>
+
+#include "../db.h"
+#include "../resource_pool.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+static const char* db_dir = "/var/tmp/mabain_test/";
+
+static int64_t now_us()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+// CPUs of the node from a list like "0-7,16-23"
+static std::vector<int> node_cpus(int node)
+{
+    std::vector<int> cpus;
+    std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string list;
+    if (!std::getline(cpulist, list)) {
+        // No NUMA support: all CPUs are on node 0.
+        for (unsigned i = 0; node == 0 && i < std::thread::hardware_concurrency(); i++)
+            cpus.push_back(i);
+        return cpus;
+    }
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos)
+            end = list.size();
+        std::string range = list.substr(pos, end - pos);
+        size_t dash = range.find('-');
+        int first = atoi(range.c_str());
+        int last = (dash == std::string::npos) ? first : atoi(range.c_str() + dash + 1);
+        for (int cpu = first; cpu <= last; cpu++)
+            cpus.push_back(cpu);
+        pos = end + 1;
+    }
+    return cpus;
+}
+
+static void pin_thread(const std::vector<int>& cpus)
+{
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int cpu : cpus)
+        CPU_SET(cpu, &cpu_set);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+}
+
+static void set_config(MBConfig& mbconf, int options, int policy)
+{
+    memset(&mbconf, 0, sizeof(mbconf));
+    mbconf.mbdir = db_dir;
+    mbconf.options = options;
+    mbconf.memcap_index = 1024 * 1024 * 1024LL;
+    mbconf.memcap_data = 1024 * 1024 * 1024LL;
+    mbconf.block_size_index = 64 * 1024 * 1024LL;
+    mbconf.block_size_data = 64 * 1024 * 1024LL;
+    mbconf.numa_policy = policy;
+}
+
+static void populate(int policy, int nkeys, const std::vector<int>& writer_cpus)
+{
+    std::string cmd = std::string("rm -f ") + db_dir + "/_mabain_* " + db_dir + "/_*bfl";
+    if (system(cmd.c_str()) != 0) {
+    }
+
+    std::thread writer([&]() {
+        pin_thread(writer_cpus);
+        MBConfig mbconf;
+        set_config(mbconf, CONSTS::WriterOptions(), policy);
+        DB db(mbconf);
+        assert(db.is_open());
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+        for (int i = 0; i < nkeys; i++) {
+            std::string key = tkey.get_key(i);
+            db.Add(key, key);
+        }
+        db.PrintNumaStats();
+        db.Close();
+    });
+    writer.join();
+}
+
+static double run_readers(int policy, int nkeys, int nthread, int nreads,
+    const std::vector<int>& cpus)
+{
+    std::vector<std::thread> threads;
+    std::vector<int64_t> found(nthread, 0);
+    int64_t t0 = now_us();
+    for (int t = 0; t < nthread; t++) {
+        threads.push_back(std::thread([&, t]() {
+            pin_thread(cpus);
+            MBConfig mbconf;
+            set_config(mbconf, CONSTS::ReaderOptions(), policy);
+            DB db(mbconf);
+            assert(db.is_open());
+            TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+            std::mt19937 rand_gen(t + 1);
+            std::uniform_int_distribution<int> dist(0, nkeys - 1);
+            MBData mbd;
+            for (int i = 0; i < nreads; i++) {
+                if (db.Find(tkey.get_key(dist(rand_gen)), mbd) == MBError::SUCCESS)
+                    found[t]++;
+            }
+            db.Close();
+        }));
+    }
+    for (auto& th : threads)
+        th.join();
+    int64_t elapsed = now_us() - t0;
+
+    int64_t total = 0;
+    for (auto count : found)
+        total += count;
+    if (total != (int64_t)nthread * nreads)
+        std::cout << "\tfound only " << total << " keys\n";
+    return (double)nthread * nreads * 1000000 / elapsed;
+}
+
+int main(int argc, char* argv[])
+{
+    int nkeys = 1000000;
+    int nthread = 4;
+    int nreads = 1000000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            nkeys = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            nthread = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            nreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            db_dir = argv[++i];
+        } else {
+            std::cout << "unknown argument " << argv[i] << "\n";
+            return 1;
+        }
+    }
+    DB::SetLogLevel(0);
+
+    uint64_t nodes = NumaPolicy::OnlineNodes();
+    std::vector<int> node_list;
+    for (int node = 0; node < MB_NUMA_MAX_NODE; node++) {
+        if (nodes & (1ULL << node))
+            node_list.push_back(node);
+    }
+    std::vector<int> writer_cpus = node_cpus(node_list[0]);
+
+    const char* names[] = { "default", "interleave", "preferred", "bind_block" };
+    int policies[] = { MB_NUMA_DEFAULT, MB_NUMA_INTERLEAVE, MB_NUMA_PREFERRED,
+        MB_NUMA_BIND_BLOCK };
+    std::cout << nkeys << " keys, " << nthread << " threads per node, " << nreads
+              << " lookups per thread\n";
+    for (int p = 0; p < 4; p++) {
+        std::cout << "policy " << names[p] << ":\n";
+        populate(policies[p], nkeys, writer_cpus);
+        for (int node : node_list) {
+            double ops = run_readers(policies[p], nkeys, nthread, nreads, node_cpus(node));
+            std::cout << "\treaders on node " << node << ": " << (int64_t)ops
+                      << " lookups/s\n";
+        }
+        ResourcePool::getInstance().RemoveAll();
+    }
+    return 0;
+}
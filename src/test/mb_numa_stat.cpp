@@ -0,0 +1,131 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+// Report the pages of the mabain block files mapped by a running process on
+// each NUMA node. The counts are read from /proc/<pid>/numa_maps, so the
+// pages are not touched. Blocks of memory-only DBs are anonymous and can only
+// be reported in the process with DB::PrintNumaStats.
+// Usage: mb_numa_stat -p pid [-d db_dir]
+
+#include <ctype.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+typedef std::map<int, size_t> NodePages;
+
+static void usage(const char* prog)
+{
+    std::cout << "Usage: " << prog << " -p pid [-d db_dir]\n";
+    exit(1);
+}
+
+// Returns the name of the block file if the mapping is a mabain index or
+// data block in db_dir.
+static bool get_block_file(const std::string& path, const std::string& db_dir,
+    std::string& block)
+{
+    size_t pos = path.rfind('/');
+    std::string dir = path.substr(0, pos + 1);
+    std::string name = path.substr(pos + 1);
+    if (!db_dir.empty() && dir != db_dir)
+        return false;
+    if (name.compare(0, 9, "_mabain_i") != 0 && name.compare(0, 9, "_mabain_d") != 0)
+        return false;
+    block = path;
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string pid;
+    std::string db_dir;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            pid = argv[++i];
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            db_dir = argv[++i];
+            if (db_dir[db_dir.length() - 1] != '/')
+                db_dir += "/";
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (pid.empty())
+        usage(argv[0]);
+
+    std::ifstream numa_maps("/proc/" + pid + "/numa_maps");
+    if (!numa_maps) {
+        std::cerr << "failed to open /proc/" << pid << "/numa_maps\n";
+        return 1;
+    }
+
+    // Lines look like:
+    // 7f2e80000000 interleave:0-1 file=/data/_mabain_i0 mapped=512 N0=256 N1=256 kernelpagesize_kB=4
+    std::map<std::string, std::pair<std::string, NodePages>> blocks;
+    NodePages index_total;
+    NodePages data_total;
+    std::string line;
+    while (std::getline(numa_maps, line)) {
+        std::istringstream tokens(line);
+        std::string addr, policy, token, block;
+        tokens >> addr >> policy;
+        NodePages pages;
+        bool found = false;
+        while (tokens >> token) {
+            if (token.compare(0, 5, "file=") == 0) {
+                found = get_block_file(token.substr(5), db_dir, block);
+            } else if (token.size() > 2 && token[0] == 'N' && isdigit(token[1])) {
+                size_t eq = token.find('=');
+                if (eq != std::string::npos)
+                    pages[atoi(token.c_str() + 1)] += strtoull(token.c_str() + eq + 1, NULL, 10);
+            }
+        }
+        if (!found)
+            continue;
+        blocks[block].first = policy;
+        NodePages& total = (block.find("_mabain_i") != std::string::npos) ? index_total : data_total;
+        for (auto& node : pages) {
+            blocks[block].second[node.first] += node.second;
+            total[node.first] += node.second;
+        }
+    }
+
+    if (blocks.empty()) {
+        std::cout << "no mabain block files mapped by process " << pid << "\n";
+        return 0;
+    }
+    for (auto& block : blocks) {
+        std::cout << block.first << " (" << block.second.first << "):";
+        for (auto& node : block.second.second)
+            std::cout << " N" << node.first << "=" << node.second;
+        std::cout << "\n";
+    }
+    std::cout << "index pages:";
+    for (auto& node : index_total)
+        std::cout << " N" << node.first << "=" << node.second;
+    std::cout << "\ndata pages:";
+    for (auto& node : data_total)
+        std::cout << " N" << node.first << "=" << node.second;
+    std::cout << "\n";
+    return 0;
+}
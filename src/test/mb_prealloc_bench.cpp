@@ -0,0 +1,138 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+// Latency of the writer adds with and without background block
+// preallocation. The DB is populated from scratch in each run. The latency of
+// the adds that move to a new index or data block is reported separately from
+// the other adds.
+// Usage: mb_prealloc_bench [-n num_keys] [-v value_size] [-b block_size_mb]
+//                          [-p threshold] [-m] [-d db_dir]
+
+#include <algorithm>
+#include <assert.h>
+#include <chrono>
+#include <iostream>
+#include <string.h>
+#include <vector>
+
+#include "../db.h"
+#include "../dict.h"
+#include "../resource_pool.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+static const char* db_dir = "/var/tmp/mabain_test/";
+
+static void print_latency(const char* name, std::vector<int64_t>& lat)
+{
+    if (lat.empty())
+        return;
+    std::sort(lat.begin(), lat.end());
+    int64_t sum = 0;
+    for (int64_t t : lat)
+        sum += t;
+    std::cout << "\t" << name << ": " << lat.size() << " adds, avg " << sum / (int64_t)lat.size()
+              << " ns, p99.9 " << lat[lat.size() * 999 / 1000] << " ns, max " << lat.back()
+              << " ns\n";
+}
+
+static void run(int nkeys, int value_size, size_t block_size, int threshold, int mode)
+{
+    std::string cmd = std::string("rm -f ") + db_dir + "/_mabain_* " + db_dir + "/_*bfl";
+    if (system(cmd.c_str()) != 0) {
+    }
+
+    MBConfig mbconf;
+    memset(&mbconf, 0, sizeof(mbconf));
+    mbconf.mbdir = db_dir;
+    mbconf.options = CONSTS::WriterOptions() | mode;
+    mbconf.memcap_index = 4 * 1024 * 1024 * 1024LL;
+    mbconf.memcap_data = 4 * 1024 * 1024 * 1024LL;
+    mbconf.block_size_index = block_size;
+    mbconf.block_size_data = block_size;
+    mbconf.prealloc_threshold = threshold;
+    DB db(mbconf);
+    assert(db.is_open());
+    IndexHeader* header = db.GetDictPtr()->GetHeaderPtr();
+
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+    std::string value(value_size, 'v');
+    std::vector<int64_t> lat;
+    std::vector<int64_t> lat_new_block;
+    lat.reserve(nkeys);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < nkeys; i++) {
+        std::string key = tkey.get_key(i);
+        size_t index_block = header->m_index_offset / block_size;
+        size_t data_block = header->m_data_offset / block_size;
+        auto t0 = std::chrono::steady_clock::now();
+        db.Add(key, value);
+        int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - t0)
+                         .count();
+        if (header->m_index_offset / block_size != index_block
+            || header->m_data_offset / block_size != data_block)
+            lat_new_block.push_back(ns);
+        else
+            lat.push_back(ns);
+    }
+    int64_t total = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start)
+                        .count();
+
+    std::cout << "threshold " << threshold << ": " << total << " ms\n";
+    print_latency("adds within a block", lat);
+    print_latency("adds moving to a new block", lat_new_block);
+    db.Close();
+    ResourcePool::getInstance().RemoveAll();
+}
+
+int main(int argc, char* argv[])
+{
+    int nkeys = 1000000;
+    int value_size = 200;
+    size_t block_size = 64 * 1024 * 1024LL;
+    int threshold = 50;
+    int mode = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            nkeys = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-v") == 0 && i + 1 < argc) {
+            value_size = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            block_size = atoi(argv[++i]) * 1024 * 1024LL;
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            threshold = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-m") == 0) {
+            mode = CONSTS::MEMORY_ONLY_MODE;
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            db_dir = argv[++i];
+        } else {
+            std::cout << "unknown argument " << argv[i] << "\n";
+            return 1;
+        }
+    }
+    DB::SetLogLevel(0);
+
+    std::cout << nkeys << " keys, value size " << value_size << ", block size " << block_size
+              << (mode ? ", memory only" : "") << "\n";
+    run(nkeys, value_size, block_size, 0, mode);
+    run(nkeys, value_size, block_size, threshold, mode);
+    return 0;
+}
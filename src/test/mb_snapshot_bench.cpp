@@ -0,0 +1,123 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+// Time to rebuild a memory-only DB with Add compared with dumping it to a
+// snapshot and loading it back. The snapshot is loaded with each number of
+// threads given with -t.
+// Usage: mb_snapshot_bench [-n num_keys] [-v value_size] [-t threads,...]
+//                          [-d snapshot_dir]
+
+#include <assert.h>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string.h>
+#include <vector>
+
+#include "../db.h"
+#include "../resource_pool.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+static const char* snapshot_dir = "/var/tmp/mabain_test/snapshot";
+static const char* db_name = "mb_snapshot_bench";
+
+static int64_t elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+static void set_config(MBConfig& mbconf, int nkeys, int value_size)
+{
+    memset(&mbconf, 0, sizeof(mbconf));
+    mbconf.mbdir = db_name;
+    mbconf.options = CONSTS::WriterOptions() | CONSTS::MEMORY_ONLY_MODE;
+    mbconf.block_size_index = 64 * 1024 * 1024;
+    mbconf.block_size_data = 64 * 1024 * 1024;
+    mbconf.memcap_index = (size_t)nkeys * 200 + 4 * mbconf.block_size_index;
+    mbconf.memcap_data = (size_t)nkeys * (value_size + 32) + 4 * mbconf.block_size_data;
+}
+
+int main(int argc, char* argv[])
+{
+    int nkeys = 1000000;
+    int value_size = 100;
+    std::vector<int> thread_counts = { 1, 4 };
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            nkeys = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-v") == 0 && i + 1 < argc) {
+            value_size = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            thread_counts.clear();
+            std::stringstream ss(argv[++i]);
+            std::string count;
+            while (std::getline(ss, count, ','))
+                thread_counts.push_back(atoi(count.c_str()));
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            snapshot_dir = argv[++i];
+        } else {
+            std::cout << "unknown argument " << argv[i] << "\n";
+            return 1;
+        }
+    }
+    DB::SetLogLevel(0);
+
+    MBConfig mbconf;
+    set_config(mbconf, nkeys, value_size);
+    DB* db = new DB(mbconf);
+    assert(db->is_open());
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+    std::string value(value_size, 'v');
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < nkeys; i++)
+        db->Add(tkey.get_key(i), value);
+    std::cout << nkeys << " keys, value size " << value_size << "\n";
+    std::cout << "\tbuild with Add: " << elapsed_ms(start) << " ms\n";
+
+    start = std::chrono::steady_clock::now();
+    int rval = db->DumpSnapshot(snapshot_dir, thread_counts.back());
+    if (rval != MBError::SUCCESS) {
+        std::cout << "failed to dump snapshot: " << MBError::get_error_str(rval) << "\n";
+        return 1;
+    }
+    std::cout << "\tdump with " << thread_counts.back() << " threads: " << elapsed_ms(start)
+              << " ms\n";
+    db->Close();
+    delete db;
+    ResourcePool::getInstance().RemoveAll();
+
+    for (int num_threads : thread_counts) {
+        set_config(mbconf, nkeys, value_size);
+        mbconf.snapshot_dir = snapshot_dir;
+        mbconf.snapshot_threads = num_threads;
+        start = std::chrono::steady_clock::now();
+        db = new DB(mbconf);
+        int64_t ms = elapsed_ms(start);
+        assert(db->is_open());
+        assert(db->Count() == nkeys);
+        std::cout << "\tload with " << num_threads << " threads: " << ms << " ms\n";
+        db->Close();
+        delete db;
+        ResourcePool::getInstance().RemoveAll();
+    }
+    return 0;
+}
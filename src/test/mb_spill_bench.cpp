@@ -0,0 +1,129 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+// Insert into a memory-only DB with a data memcap of a fraction of the data
+// size and spill_dir set. The first hot_percent of the keys are looked up
+// while the rest are added, and the lookup latency of the hot and the cold
+// keys is measured at the end.
+// Usage: mb_spill_bench [-n num_keys] [-v value_size] [-m memcap_percent]
+//                       [-h hot_percent] [-d spill_dir]
+
+#include <assert.h>
+#include <chrono>
+#include <iostream>
+#include <string.h>
+
+#include "../db.h"
+#include "../dict.h"
+#include "../resource_pool.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+static const char* spill_dir = "/var/tmp/mabain_test";
+
+static int64_t elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+static int64_t lookup(DB* db, int start, int end)
+{
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+    MBData mbd;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = start; i < end; i++) {
+        int rval = db->Find(tkey.get_key(i), mbd);
+        assert(rval == MBError::SUCCESS);
+        (void)rval;
+    }
+    return elapsed_ns(begin) / (end - start);
+}
+
+int main(int argc, char* argv[])
+{
+    int nkeys = 1000000;
+    int value_size = 1000;
+    int memcap_percent = 25;
+    int hot_percent = 10;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            nkeys = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-v") == 0 && i + 1 < argc) {
+            value_size = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            memcap_percent = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-h") == 0 && i + 1 < argc) {
+            hot_percent = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            spill_dir = argv[++i];
+        } else {
+            std::cout << "unknown argument " << argv[i] << "\n";
+            return 1;
+        }
+    }
+    DB::SetLogLevel(0);
+
+    MBConfig mbconf;
+    memset(&mbconf, 0, sizeof(mbconf));
+    mbconf.mbdir = "mb_spill_bench";
+    mbconf.options = CONSTS::WriterOptions() | CONSTS::MEMORY_ONLY_MODE;
+    mbconf.block_size_index = 64 * 1024 * 1024;
+    mbconf.block_size_data = 64 * 1024 * 1024;
+    mbconf.memcap_index = (size_t)nkeys * 200 + 4 * mbconf.block_size_index;
+    mbconf.memcap_data = (size_t)nkeys * (value_size + 32) / 100 * memcap_percent;
+    if (mbconf.memcap_data < 3 * (size_t)mbconf.block_size_data)
+        mbconf.memcap_data = 3 * (size_t)mbconf.block_size_data;
+    mbconf.spill_dir = spill_dir;
+    DB* db = new DB(mbconf);
+    assert(db->is_open());
+
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+    std::string value(value_size, 'v');
+    int nhot = nkeys / 100 * hot_percent;
+    if (nhot <= 0 || nhot >= nkeys) {
+        std::cout << "invalid hot percentage " << hot_percent << "\n";
+        return 1;
+    }
+    MBData mbd;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < nkeys; i++) {
+        int rval = db->Add(tkey.get_key(i), value);
+        if (rval != MBError::SUCCESS) {
+            std::cout << "failed to add key " << i << ": " << MBError::get_error_str(rval) << "\n";
+            return 1;
+        }
+        // Keep the hot keys looked up while the DB grows.
+        if (i >= nhot && i % 4 == 0)
+            db->Find(tkey.get_key(i % nhot), mbd);
+    }
+    std::cout << nkeys << " keys, value size " << value_size << ", data memcap "
+              << mbconf.memcap_data / (1024 * 1024) << "M\n";
+    std::cout << "\tadd with lookups: " << elapsed_ns(start) / 1000000 << " ms\n";
+    std::cout << "\tspilled data blocks: " << db->GetDictPtr()->GetRollableFile()->GetNumSpilled()
+              << "\n";
+    std::cout << "\thot key lookup: " << lookup(db, 0, nhot) << " ns\n";
+    std::cout << "\tcold key lookup: " << lookup(db, nhot, nkeys) << " ns\n";
+
+    db->Close();
+    delete db;
+    ResourcePool::getInstance().RemoveAll();
+    return 0;
+}
@@ -0,0 +1,213 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+// Benchmark for waking up the async writer
+// 1. Raw cross-process wakeup latency: FIFO pipe (MBPipe) vs futex doorbell
+// 2. Enqueue-to-apply latency through the shared memory queue with the async
+//    writer running in a child process
+
+#include <algorithm>
+#include <assert.h>
+#include <atomic>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../db.h"
+#include "../mb_pipe.h"
+#include "../resource_pool.h"
+#include "../util/futex.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+static const char* db_dir = "/var/tmp/mabain_test/";
+
+struct SharedState {
+    std::atomic<uint32_t> req;
+    std::atomic<uint32_t> ack;
+    std::atomic<uint32_t> doorbell;
+    std::atomic<uint32_t> parked;
+    std::atomic<uint32_t> ready;
+    std::atomic<uint32_t> stop;
+};
+
+static int64_t now_us()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+static void print_latency(const char* name, std::vector<int64_t>& lat, int64_t nsyscall)
+{
+    std::sort(lat.begin(), lat.end());
+    int64_t sum = 0;
+    for (auto t : lat)
+        sum += t;
+    std::cout << name << ": avg " << (double)sum / lat.size() << " us, p50 "
+              << lat[lat.size() / 2] << " us, p99 " << lat[lat.size() * 99 / 100] << " us";
+    if (nsyscall >= 0)
+        std::cout << ", producer syscalls/op " << (double)nsyscall / lat.size();
+    std::cout << "\n";
+}
+
+// Waiter side of the raw wakeup test
+static void waiter(SharedState* st, bool use_pipe)
+{
+    MBPipe mbp;
+    if (use_pipe)
+        mbp = MBPipe(db_dir, CONSTS::ACCESS_MODE_WRITER);
+    st->ready.store(1);
+
+    while (!st->stop.load()) {
+        uint32_t req = st->req.load();
+        if (req == st->ack.load()) {
+            if (use_pipe) {
+                mbp.Wait(1000);
+            } else {
+                uint32_t bell = st->doorbell.load();
+                st->parked.store(1);
+                if (st->req.load() == st->ack.load())
+                    FutexWait(&st->doorbell, bell, 1000);
+                st->parked.store(0);
+            }
+            continue;
+        }
+        st->ack.store(req);
+    }
+}
+
+static void raw_wakeup(SharedState* st, bool use_pipe, int num, int gap)
+{
+    memset((void*)st, 0, sizeof(*st));
+    pid_t pid = fork();
+    if (pid == 0) {
+        waiter(st, use_pipe);
+        _exit(0);
+    }
+    while (!st->ready.load())
+        usleep(100);
+    usleep(10000);
+
+    MBPipe mbp;
+    if (use_pipe)
+        mbp = MBPipe(db_dir, 0);
+    std::vector<int64_t> lat;
+    int64_t nsyscall = 0;
+    for (int i = 0; i < num; i++) {
+        int64_t t0 = now_us();
+        uint32_t req = st->req.fetch_add(1) + 1;
+        if (use_pipe) {
+            // poll + write for every signal
+            mbp.Signal();
+            nsyscall += 2;
+        } else if (st->parked.load()) {
+            st->doorbell.fetch_add(1);
+            FutexWake(&st->doorbell, 1);
+            nsyscall++;
+        }
+        while (st->ack.load() != req)
+            sched_yield();
+        lat.push_back(now_us() - t0);
+        if (gap > 0)
+            usleep(gap);
+    }
+    st->stop.store(1);
+    st->doorbell.fetch_add(1);
+    FutexWake(&st->doorbell, 1);
+    if (use_pipe)
+        mbp.Signal();
+    waitpid(pid, NULL, 0);
+
+    print_latency(use_pipe ? "pipe wakeup" : "futex wakeup", lat, nsyscall);
+}
+
+static void enqueue_to_apply(SharedState* st, int num, int gap)
+{
+    std::string cmd = std::string("rm -f ") + db_dir + "_mabain_*";
+    if (system(cmd.c_str()) != 0) {
+    }
+    memset((void*)st, 0, sizeof(*st));
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        DB db(db_dir, CONSTS::WriterOptions() | CONSTS::ASYNC_WRITER_MODE);
+        assert(db.is_open());
+        st->ready.store(1);
+        while (!st->stop.load())
+            usleep(10000);
+        db.Close();
+        _exit(0);
+    }
+    while (!st->ready.load())
+        usleep(100);
+
+    DB db(db_dir, CONSTS::ReaderOptions());
+    assert(db.is_open());
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+    std::vector<int64_t> lat;
+    for (int i = 0; i < num; i++) {
+        std::string key = tkey.get_key(i);
+        int64_t t0 = now_us();
+        int rval = db.AddAsync(key.data(), key.size(), key.data(), key.size());
+        assert(rval == MBError::SUCCESS);
+        while (db.AsyncWriterBusy())
+            sched_yield();
+        lat.push_back(now_us() - t0);
+        if (gap > 0)
+            usleep(gap);
+    }
+    std::cout << "enqueue-to-apply with " << gap << " us gap:\n";
+    // doorbell count in stats is the number of wakeup system calls by producers
+    print_latency("  latency", lat, -1);
+    db.PrintStats();
+    db.Close();
+    ResourcePool::getInstance().RemoveAll();
+
+    st->stop.store(1);
+    waitpid(pid, NULL, 0);
+}
+
+int main(int argc, char* argv[])
+{
+    int num = 10000;
+    if (argc > 1)
+        num = atoi(argv[1]);
+
+    SharedState* st = reinterpret_cast<SharedState*>(mmap(NULL, sizeof(SharedState),
+        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+    assert(st != MAP_FAILED);
+
+    // back-to-back signals and signals to a parked waiter
+    for (int gap : { 0, 200 }) {
+        std::cout << "raw wakeup with " << gap << " us gap:\n";
+        raw_wakeup(st, true, num, gap);
+        raw_wakeup(st, false, num, gap);
+    }
+
+    for (int gap : { 0, 200 })
+        enqueue_to_apply(st, num, gap);
+
+    munmap(st, sizeof(SharedState));
+    return 0;
+}
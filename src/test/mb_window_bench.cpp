@@ -0,0 +1,184 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+// Lookup rate of readers when only part of the data fits in memcap_data.
+// The DB is populated once. Then reader threads look up random keys with the
+// data memcap set to a decreasing fraction of the data size, first reading
+// the blocks beyond the memcap with pread and then through the window cache.
+// The cache can only grow in a process, so the pread runs are done first.
+// Usage: mb_window_bench [-n num_keys] [-v value_size] [-t threads] [-r reads_per_thread]
+//                        [-c window_cache_size] [-d db_dir]
+
+#include <assert.h>
+#include <iostream>
+#include <random>
+#include <string.h>
+#include <sys/time.h>
+#include <thread>
+#include <vector>
+
+#include "../db.h"
+#include "../dict.h"
+#include "../resource_pool.h"
+#include "../window_cache.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+#define BENCH_BLOCK_SIZE (16 * 1024 * 1024LL)
+
+static const char* db_dir = "/var/tmp/mabain_test/";
+
+static int64_t now_us()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+static void set_config(MBConfig& mbconf, int options, size_t memcap_data, size_t cache_size)
+{
+    memset(&mbconf, 0, sizeof(mbconf));
+    mbconf.mbdir = db_dir;
+    mbconf.options = options;
+    mbconf.memcap_index = 1024 * 1024 * 1024LL;
+    mbconf.memcap_data = memcap_data;
+    mbconf.block_size_index = BENCH_BLOCK_SIZE;
+    mbconf.block_size_data = BENCH_BLOCK_SIZE;
+    mbconf.window_cache_size = cache_size;
+}
+
+static size_t populate(int nkeys, int value_size)
+{
+    std::string cmd = std::string("rm -f ") + db_dir + "/_mabain_* " + db_dir + "/_*bfl";
+    if (system(cmd.c_str()) != 0) {
+    }
+
+    MBConfig mbconf;
+    set_config(mbconf, CONSTS::WriterOptions(), 1024 * 1024 * 1024LL, 0);
+    DB db(mbconf);
+    assert(db.is_open());
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+    std::string value(value_size, 'v');
+    for (int i = 0; i < nkeys; i++) {
+        std::string key = tkey.get_key(i);
+        memcpy(&value[0], key.data(), std::min(key.length(), value.length()));
+        db.Add(key, value);
+    }
+    size_t data_size = db.GetDictPtr()->GetHeaderPtr()->m_data_offset;
+    db.Close();
+    ResourcePool::getInstance().RemoveAll();
+    return data_size;
+}
+
+static double run_readers(const std::vector<std::string>& keys, int nthread, int nreads,
+    size_t memcap_data, size_t cache_size)
+{
+    std::vector<std::thread> threads;
+    std::vector<int64_t> found(nthread, 0);
+    int64_t t0 = now_us();
+    for (int t = 0; t < nthread; t++) {
+        threads.push_back(std::thread([&, t]() {
+            MBConfig mbconf;
+            set_config(mbconf, CONSTS::ReaderOptions(), memcap_data, cache_size);
+            DB db(mbconf);
+            assert(db.is_open());
+            std::mt19937 rand_gen(t + 1);
+            std::uniform_int_distribution<int> dist(0, keys.size() - 1);
+            MBData mbd;
+            for (int i = 0; i < nreads; i++) {
+                if (db.Find(keys[dist(rand_gen)], mbd) == MBError::SUCCESS)
+                    found[t]++;
+            }
+            db.Close();
+        }));
+    }
+    for (auto& th : threads)
+        th.join();
+    int64_t elapsed = now_us() - t0;
+    ResourcePool::getInstance().RemoveAll();
+
+    int64_t total = 0;
+    for (auto count : found)
+        total += count;
+    if (total != (int64_t)nthread * nreads)
+        std::cout << "\tfound only " << total << " keys\n";
+    return (double)nthread * nreads * 1000000 / elapsed;
+}
+
+int main(int argc, char* argv[])
+{
+    int nkeys = 1000000;
+    int value_size = 200;
+    int nthread = 4;
+    int nreads = 1000000;
+    size_t cache_size = 256 * 1024 * 1024LL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            nkeys = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-v") == 0 && i + 1 < argc) {
+            value_size = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            nthread = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            nreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            cache_size = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            db_dir = argv[++i];
+        } else {
+            std::cout << "unknown argument " << argv[i] << "\n";
+            return 1;
+        }
+    }
+    DB::SetLogLevel(0);
+
+    size_t data_size = populate(nkeys, value_size);
+    // Keys are generated before the lookups are timed.
+    std::vector<std::string> keys;
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+    for (int i = 0; i < nkeys; i++)
+        keys.push_back(tkey.get_key(i));
+    std::cout << nkeys << " keys, data size " << data_size << ", " << nthread
+              << " threads, " << nreads << " lookups per thread, window cache "
+              << cache_size << "\n";
+
+    // Fraction of the data blocks within memcap_data
+    const int percents[] = { 100, 50, 25, 10, 0 };
+    size_t num_block = (data_size + BENCH_BLOCK_SIZE - 1) / BENCH_BLOCK_SIZE;
+    for (int cached = 0; cached < 2; cached++) {
+        std::cout << (cached ? "window cache:\n" : "pread:\n");
+        size_t last_mapped = 0;
+        for (int percent : percents) {
+            // At least one block is mapped.
+            size_t mapped_block = num_block * percent / 100;
+            if (mapped_block == 0)
+                mapped_block = 1;
+            if (mapped_block == last_mapped)
+                continue;
+            last_mapped = mapped_block;
+            double ops = run_readers(keys, nthread, nreads, mapped_block * BENCH_BLOCK_SIZE,
+                cached ? cache_size : 0);
+            std::cout << "\t" << mapped_block << "/" << num_block << " data blocks mapped: "
+                      << (int64_t)ops << " lookups/s\n";
+        }
+        if (cached)
+            WindowCache::getInstance().PrintStats(std::cout);
+    }
+    return 0;
+}
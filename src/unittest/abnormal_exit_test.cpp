@@ -522,11 +522,15 @@ TEST_F(AbnormalExitTest, RC_RECOVERY_RC_ROOT_TREE_test)
     ResourceCollection rc(*db);
     rc.ExceptionRecovery();
 
-    // Note the new entries added during rc will be ignored is expection occurs.
-    EXPECT_EQ(count, dict->Count());
-    EXPECT_EQ(1149932U, header->m_index_offset);
-    EXPECT_EQ(844268U, header->m_data_offset);
-    EXPECT_EQ(0U, header->pending_index_buff_size);
+    // The entries added during rc are added to the main tree.
+    EXPECT_EQ(count + count1, dict->Count());
+    for (int key = 1; key <= count1; key++) {
+        key_str = tkey.get_key(count + key);
+        EXPECT_EQ(db->Find(key_str, mbd), MBError::SUCCESS);
+    }
+    EXPECT_EQ(1277233U, header->m_index_offset);
+    EXPECT_EQ(924656U, header->m_data_offset);
+    EXPECT_EQ(20562U, header->pending_index_buff_size);
     EXPECT_EQ(0U, header->pending_data_buff_size);
     EXPECT_EQ(0U, header->rc_m_index_off_pre);
     EXPECT_EQ(0U, header->rc_m_data_off_pre);
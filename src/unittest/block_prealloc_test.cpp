@@ -0,0 +1,217 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../dict.h"
+#include "../resource_pool.h"
+#include "../rollable_file.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+namespace {
+
+#define MB_DIR "/var/tmp/mabain_test/"
+#define PREALLOC_TEST_BLOCK_SIZE (4 * 1024 * 1024)
+
+class BlockPreallocTest : public ::testing::Test {
+public:
+    BlockPreallocTest()
+    {
+        db = NULL;
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~BlockPreallocTest()
+    {
+    }
+    virtual void SetUp()
+    {
+        std::string cmd = std::string("mkdir -p ") + MB_DIR;
+        if (system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -f ") + MB_DIR + "_*";
+        if (system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = MB_DIR;
+        mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+        mbconf.memcap_index = 64 * 1024 * 1024LL;
+        mbconf.memcap_data = 64 * 1024 * 1024LL;
+        mbconf.block_size_index = PREALLOC_TEST_BLOCK_SIZE;
+        mbconf.block_size_data = PREALLOC_TEST_BLOCK_SIZE;
+        mbconf.prealloc_threshold = 50;
+    }
+    virtual void TearDown()
+    {
+        if (db != NULL) {
+            db->Close();
+            delete db;
+            db = NULL;
+        }
+        ResourcePool::getInstance().RemoveAll();
+    }
+
+    // Returns the number of the blocks written. The writer waits for the
+    // next block at 3/4 of each block, up to block max_wait, so that it does
+    // not open the block before the preallocation thread.
+    size_t Populate(int num, size_t max_wait)
+    {
+        RollableFile* data_file = db->GetDictPtr()->GetRollableFile();
+        IndexHeader* header = db->GetDictPtr()->GetHeaderPtr();
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+        size_t waited = 0;
+        for (int i = 0; i < num; i++) {
+            std::string key = tkey.get_key(i);
+            EXPECT_EQ(db->Add(key, GetValue(key)), MBError::SUCCESS);
+            size_t order = header->m_data_offset / PREALLOC_TEST_BLOCK_SIZE;
+            size_t block_off = header->m_data_offset % PREALLOC_TEST_BLOCK_SIZE;
+            if (order + 1 <= max_wait && order + 1 > waited && block_off > PREALLOC_TEST_BLOCK_SIZE / 4 * 3) {
+                waited = order + 1;
+                WaitForBlock(data_file, waited);
+            }
+        }
+        return header->m_data_offset / PREALLOC_TEST_BLOCK_SIZE + 1;
+    }
+
+    static void Check(DB* dbh, int num)
+    {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+        MBData mbd;
+        for (int i = 0; i < num; i++) {
+            std::string key = tkey.get_key(i);
+            ASSERT_EQ(dbh->Find(key, mbd), MBError::SUCCESS);
+            EXPECT_EQ(std::string((const char*)mbd.buff, mbd.data_len), GetValue(key));
+        }
+    }
+
+    static std::string GetValue(const std::string& key)
+    {
+        std::string value;
+        while (value.length() < 1000)
+            value += key;
+        return value.substr(0, 1000);
+    }
+
+    // Wait for the preallocation thread to pick up the block file
+    static bool WaitForBlock(RollableFile* file, size_t count)
+    {
+        for (int retry = 0; retry < 200; retry++) {
+            if (file->GetNumPreallocated() >= count)
+                return true;
+            usleep(10000);
+        }
+        return false;
+    }
+
+    static bool BlockFileExists(const std::string& name)
+    {
+        struct stat st;
+        return stat((std::string(MB_DIR) + name).c_str(), &st) == 0;
+    }
+
+    static size_t BlockFileAllocated(const std::string& name)
+    {
+        struct stat st;
+        if (stat((std::string(MB_DIR) + name).c_str(), &st) != 0)
+            return 0;
+        return st.st_blocks * 512;
+    }
+
+protected:
+    MBConfig mbconf;
+    DB* db;
+};
+
+TEST_F(BlockPreallocTest, prealloc_data_blocks)
+{
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    RollableFile* data_file = db->GetDictPtr()->GetRollableFile();
+
+    // About 10 data blocks are written. Each block is preallocated before
+    // the writer reaches it.
+    int num = 40000;
+    size_t num_block = Populate(num, 1024);
+    EXPECT_GE(num_block, 6u);
+    size_t count = data_file->GetNumPreallocated();
+    EXPECT_GE(count, num_block - 1);
+    // Blocks 1 to count are preallocated. The last one is allocated on disk
+    // although the writer has not filled it.
+    EXPECT_GE(BlockFileAllocated("_mabain_d" + std::to_string(count)),
+        (size_t)PREALLOC_TEST_BLOCK_SIZE);
+    Check(db, num);
+
+    db->Close();
+    delete db;
+    db = NULL;
+    ResourcePool::getInstance().RemoveAll();
+
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    DB db_r(mbconf);
+    ASSERT_TRUE(db_r.is_open());
+    Check(&db_r, num);
+    db_r.Close();
+}
+
+TEST_F(BlockPreallocTest, prealloc_within_memcap)
+{
+    // Only the first 3 data blocks are mapped.
+    mbconf.memcap_data = 3 * PREALLOC_TEST_BLOCK_SIZE;
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    int num = 25000;
+    EXPECT_GT(Populate(num, 2), 4u);
+    usleep(100000);
+    EXPECT_EQ(db->GetDictPtr()->GetRollableFile()->GetNumPreallocated(), 2u);
+    Check(db, num);
+}
+
+TEST_F(BlockPreallocTest, prealloc_memory_only)
+{
+    mbconf.options |= CONSTS::MEMORY_ONLY_MODE;
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    int num = 20000;
+    size_t num_block = Populate(num, 1024);
+    EXPECT_GE(db->GetDictPtr()->GetRollableFile()->GetNumPreallocated(), num_block - 1);
+    Check(db, num);
+}
+
+TEST_F(BlockPreallocTest, prealloc_disabled)
+{
+    mbconf.prealloc_threshold = 0;
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    Populate(10000, 0);
+    EXPECT_EQ(db->GetDictPtr()->GetRollableFile()->GetNumPreallocated(), 0u);
+    EXPECT_FALSE(BlockFileExists("_mabain_d3"));
+    db->Close();
+    delete db;
+    db = NULL;
+
+    mbconf.prealloc_threshold = 101;
+    DB db_invalid(mbconf);
+    EXPECT_FALSE(db_invalid.is_open());
+}
+
+}
@@ -0,0 +1,207 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../dict.h"
+#include "../dirty_tracker.h"
+#include "../resource_pool.h"
+#include "../rollable_file.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+namespace {
+
+#define MB_DIR "/var/tmp/mabain_test/"
+#define DIRTY_TEST_BLOCK_SIZE (1024 * 1024)
+
+class DirtyTrackerTest : public ::testing::Test {
+public:
+    DirtyTrackerTest()
+    {
+        db = NULL;
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~DirtyTrackerTest()
+    {
+    }
+    virtual void SetUp()
+    {
+        std::string cmd = std::string("mkdir -p ") + MB_DIR;
+        if (system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -f ") + MB_DIR + "_*";
+        if (system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = MB_DIR;
+        mbconf.memcap_index = 64 * 1024 * 1024LL;
+        mbconf.memcap_data = 64 * 1024 * 1024LL;
+        mbconf.block_size_index = 8 * 1024 * 1024LL;
+        mbconf.block_size_data = 16 * 1024 * 1024LL;
+    }
+    virtual void TearDown()
+    {
+        if (db != NULL) {
+            db->Close();
+            delete db;
+            db = NULL;
+        }
+        ResourcePool::getInstance().RemoveAll();
+    }
+
+    std::shared_ptr<MmapFileIO> OpenBlock(const std::string& name)
+    {
+        bool map_file = true;
+        return ResourcePool::getInstance().OpenFile(std::string(MB_DIR) + name,
+            CONSTS::ACCESS_MODE_WRITER, DIRTY_TEST_BLOCK_SIZE, map_file, true);
+    }
+
+protected:
+    DB* db;
+    MBConfig mbconf;
+};
+
+TEST_F(DirtyTrackerTest, mark_and_flush_test)
+{
+    size_t page_size = RollableFile::page_size;
+    DirtyTracker tracker(DIRTY_TEST_BLOCK_SIZE, 4, page_size);
+    std::shared_ptr<MmapFileIO> file0 = OpenBlock("_dirty_test0");
+    std::shared_ptr<MmapFileIO> file1 = OpenBlock("_dirty_test1");
+    ASSERT_TRUE(file0 != NULL && file0->IsMapped());
+    ASSERT_TRUE(file1 != NULL && file1->IsMapped());
+    tracker.AddBlock(0, file0);
+    tracker.AddBlock(1, file1);
+
+    // Updates within the same page count once.
+    tracker.MarkDirty(10, 20);
+    tracker.MarkDirty(100, 8);
+    EXPECT_EQ(tracker.DirtySize(), page_size);
+    // Range crossing page and bitmap word boundaries
+    tracker.MarkDirty(63 * page_size + 1, 3 * page_size);
+    EXPECT_EQ(tracker.DirtySize(), 5 * page_size);
+    // Range in the second block
+    tracker.MarkDirty(DIRTY_TEST_BLOCK_SIZE + 2 * page_size, page_size);
+    EXPECT_EQ(tracker.DirtySize(), 6 * page_size);
+    // Blocks that are not added are ignored.
+    tracker.MarkDirty(3 * DIRTY_TEST_BLOCK_SIZE, page_size);
+    EXPECT_EQ(tracker.DirtySize(), 6 * page_size);
+
+    // Rate-limited flushes sync the pages in order.
+    EXPECT_EQ(tracker.Flush(2 * page_size), 2 * page_size);
+    EXPECT_EQ(tracker.DirtySize(), 4 * page_size);
+    EXPECT_EQ(tracker.Flush(3 * page_size), 3 * page_size);
+    EXPECT_EQ(tracker.DirtySize(), page_size);
+
+    // Pages updated after being flushed are flushed again.
+    tracker.MarkDirty(0, page_size);
+    EXPECT_EQ(tracker.Flush(), 2 * page_size);
+    EXPECT_EQ(tracker.DirtySize(), 0u);
+    EXPECT_EQ(tracker.Flush(), 0u);
+
+    // Pages of removed blocks are dropped.
+    tracker.MarkDirty(DIRTY_TEST_BLOCK_SIZE, 4 * page_size);
+    EXPECT_EQ(tracker.DirtySize(), 4 * page_size);
+    tracker.RemoveBlock(1);
+    EXPECT_EQ(tracker.DirtySize(), 0u);
+}
+
+TEST_F(DirtyTrackerTest, db_flush_test)
+{
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    Dict* dict = db->GetDictPtr();
+    DirtyTracker* index_dirty = dict->GetMM()->GetDirtyTracker();
+    DirtyTracker* data_dirty = dict->GetDirtyTracker();
+    ASSERT_TRUE(index_dirty != NULL);
+    ASSERT_TRUE(data_dirty != NULL);
+
+    db->Flush();
+    EXPECT_EQ(index_dirty->DirtySize(), 0u);
+    EXPECT_EQ(data_dirty->DirtySize(), 0u);
+
+    TestKey mkey(MABAIN_TEST_KEY_TYPE_INT);
+    for (int i = 0; i < 1000; i++) {
+        std::string key = mkey.get_key(i);
+        EXPECT_EQ(db->Add(key, key), MBError::SUCCESS);
+    }
+    EXPECT_GT(index_dirty->DirtySize(), 0u);
+    EXPECT_GT(data_dirty->DirtySize(), 0u);
+    db->Flush();
+    EXPECT_EQ(index_dirty->DirtySize(), 0u);
+    EXPECT_EQ(data_dirty->DirtySize(), 0u);
+
+    // Overwriting one entry only dirties a few pages.
+    EXPECT_EQ(db->Add(mkey.get_key(10), "new value", true), MBError::SUCCESS);
+    EXPECT_GT(data_dirty->DirtySize(), 0u);
+    EXPECT_LE(data_dirty->DirtySize(), 2 * (size_t)RollableFile::page_size);
+    db->Flush();
+    EXPECT_EQ(data_dirty->DirtySize(), 0u);
+
+    MBData mbd;
+    EXPECT_EQ(db->Find(mkey.get_key(10), mbd), MBError::SUCCESS);
+    EXPECT_EQ(std::string((const char*)mbd.buff, mbd.data_len), "new value");
+}
+
+TEST_F(DirtyTrackerTest, background_flusher_test)
+{
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+    mbconf.flush_rate = 64 * 1024 * 1024LL;
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    Dict* dict = db->GetDictPtr();
+    DirtyTracker* index_dirty = dict->GetMM()->GetDirtyTracker();
+    DirtyTracker* data_dirty = dict->GetDirtyTracker();
+
+    TestKey mkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+    for (int i = 0; i < 5000; i++) {
+        std::string key = mkey.get_key(i);
+        EXPECT_EQ(db->Add(key, key), MBError::SUCCESS);
+    }
+
+    int retry = 0;
+    while (index_dirty->DirtySize() + data_dirty->DirtySize() > 0 && retry++ < 100)
+        usleep(20000);
+    EXPECT_EQ(index_dirty->DirtySize(), 0u);
+    EXPECT_EQ(data_dirty->DirtySize(), 0u);
+
+    db->Close();
+    delete db;
+    db = NULL;
+    ResourcePool::getInstance().RemoveAll();
+
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    mbconf.flush_rate = 0;
+    DB reader(mbconf);
+    ASSERT_TRUE(reader.is_open());
+    EXPECT_EQ(reader.Count(), 5000);
+    MBData mbd;
+    for (int i = 0; i < 5000; i += 100) {
+        std::string key = mkey.get_key(i);
+        EXPECT_EQ(reader.Find(key, mbd), MBError::SUCCESS);
+        EXPECT_EQ(std::string((const char*)mbd.buff, mbd.data_len), key);
+    }
+    reader.Close();
+}
+
+}
@@ -6,6 +6,8 @@
 
 #include "../async_writer.h"
 #include "../db.h"
+#include "../dict.h"
+#include "../eviction_log.h"
 #include "../resource_pool.h"
 #include "./test_key.h"
 
@@ -62,6 +64,47 @@ public:
             assert(db->Add(key, key) == MBError::SUCCESS);
         }
     }
+    void OpenWriter(int entry_per_bucket)
+    {
+        mbconf.num_entry_per_bucket = entry_per_bucket;
+        mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+        db = new DB(mbconf);
+        assert(db->is_open());
+    }
+    void CloseWriter()
+    {
+        db->Close();
+        delete db;
+        db = NULL;
+        ResourcePool::getInstance().RemoveAll();
+    }
+    void WaitForWriter()
+    {
+        while (db->AsyncWriterBusy()) {
+            usleep(100);
+        }
+    }
+    // Read keys in [n0, n0 + n) count times through the reader handle
+    void Read(int n0, int n, int count)
+    {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+        MBData mbd;
+        for (int c = 0; c < count; c++) {
+            for (int i = 0; i < n; i++)
+                db->Find(tkey.get_key(i + n0), mbd);
+        }
+    }
+    int CountFound(int n0, int n)
+    {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+        MBData mbd;
+        int found = 0;
+        for (int i = 0; i < n; i++) {
+            if (db->Find(tkey.get_key(i + n0), mbd) == MBError::SUCCESS)
+                found++;
+        }
+        return found;
+    }
     virtual void TearDown()
     {
         if (db != NULL) {
@@ -145,6 +188,111 @@ TEST_F(EvictionTest, bucket_256_test)
     }
 }
 
+TEST_F(EvictionTest, bucket_log_test)
+{
+    int num = 10000;
+    OpenWriter(100);
+    Insert(0, num);
+    // Updated entries move to the newest bucket.
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+    for (int i = 0; i < 100; i++)
+        EXPECT_EQ(db->Add(tkey.get_key(i), "updated", true), MBError::SUCCESS);
+    // Removed entries leave stale records in the log.
+    for (int i = 100; i < 200; i++)
+        EXPECT_EQ(db->Remove(tkey.get_key(i)), MBError::SUCCESS);
+    EXPECT_EQ(db->Count(), num - 100);
+
+    IndexHeader* header = db->GetDictPtr()->GetHeaderPtr();
+    EXPECT_EQ(header->evict_log_state, (uint32_t)EVICTION_LOG_ACTIVE);
+    EXPECT_EQ(db->CollectResource(1000000000, 1000000000, 1000000000, num / 2), MBError::SUCCESS);
+    EXPECT_GT(header->evict_log_head, 0u);
+    EXPECT_EQ(CountFound(0, 100), 100);
+    EXPECT_EQ(CountFound(200, 4800), 0);
+    EXPECT_EQ(CountFound(5100, num - 5100), num - 5100);
+
+    // The log is kept when the writer closes the DB.
+    CloseWriter();
+    OpenWriter(100);
+    header = db->GetDictPtr()->GetHeaderPtr();
+    EXPECT_EQ(header->evict_log_state, (uint32_t)EVICTION_LOG_ACTIVE);
+    int64_t count = db->Count();
+    EXPECT_EQ(db->CollectResource(1000000000, 1000000000, 1000000000, count / 2), MBError::SUCCESS);
+    EXPECT_LT(db->Count(), count);
+    EXPECT_EQ(CountFound(num - 1000, 1000), 1000);
+}
+
+TEST_F(EvictionTest, bucket_log_rebuild_test)
+{
+    int num = 10000;
+    OpenWriter(100);
+    Insert(0, num);
+    // As if the previous writer did not close the DB
+    IndexHeader* header = db->GetDictPtr()->GetHeaderPtr();
+    db->GetDictPtr()->GetEvictionLog()->Invalidate();
+    Insert(num, 1000);
+    num += 1000;
+
+    EXPECT_EQ(db->CollectResource(1000000000, 1000000000, 1000000000, num / 2), MBError::SUCCESS);
+    EXPECT_EQ(header->evict_log_state, (uint32_t)EVICTION_LOG_ACTIVE);
+    int64_t count = db->Count();
+    EXPECT_LT(count, num * 6 / 10);
+    EXPECT_EQ(CountFound(0, 4000), 0);
+    EXPECT_EQ(CountFound(num - 4000, 4000), 4000);
+}
+
+TEST_F(EvictionTest, lfu_test)
+{
+    int num = 2000;
+    mbconf.eviction_policy = MB_EVICTION_LFU;
+    OpenDB(256);
+    Insert(0, num);
+    WaitForWriter();
+    // The hot keys are scattered in insertion order.
+    Read(0, 100, 5);
+    Read(num - 100, 100, 3);
+
+    EXPECT_EQ(db->CollectResource(1000000000, 1000000000, 1000000000, num / 2), MBError::SUCCESS);
+    WaitForWriter();
+    int64_t count = db->Count();
+    EXPECT_LE(count, num / 2 + num / 20);
+    EXPECT_GE(count, num / 2 - num / 20);
+    EXPECT_EQ(CountFound(0, 100), 100);
+    EXPECT_EQ(CountFound(num - 100, 100), 100);
+}
+
+TEST_F(EvictionTest, clock_test)
+{
+    int num = 2000;
+    mbconf.eviction_policy = MB_EVICTION_CLOCK;
+    OpenDB(256);
+    Insert(0, num);
+    WaitForWriter();
+
+    // New entries start referenced. Evict some to clear the reference bits.
+    EXPECT_EQ(db->CollectResource(1000000000, 1000000000, 1000000000, num - num / 10),
+        MBError::SUCCESS);
+    WaitForWriter();
+    int64_t count = db->Count();
+    EXPECT_LT(count, num);
+
+    // Keys read since the last eviction are kept.
+    Read(0, 200, 1);
+    int hot = CountFound(0, 200);
+    EXPECT_EQ(db->CollectResource(1000000000, 1000000000, 1000000000, count / 2),
+        MBError::SUCCESS);
+    WaitForWriter();
+    EXPECT_LT(db->Count(), count);
+    EXPECT_EQ(CountFound(0, 200), hot);
+}
+
+TEST_F(EvictionTest, invalid_policy_test)
+{
+    mbconf.eviction_policy = MB_EVICTION_LFU + 1;
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+    DB db_inv(mbconf);
+    EXPECT_FALSE(db_inv.is_open());
+}
+
 #ifdef __SHM_QUEUE__
 TEST_F(EvictionTest, different_queue_size_test)
 {
@@ -0,0 +1,267 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <atomic>
+#include <fcntl.h>
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../async_reader.h"
+#include "../db.h"
+#include "../resource_pool.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+namespace {
+
+#define MB_DIR "/var/tmp/mabain_test/"
+#define BATCH_TEST_BLOCK_SIZE (4 * 1024 * 1024)
+
+// Only the first data block is mapped. Values in the other blocks are read
+// from the block files.
+class FindBatchTest : public ::testing::Test {
+public:
+    FindBatchTest()
+    {
+        db = NULL;
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~FindBatchTest()
+    {
+    }
+    virtual void SetUp()
+    {
+        std::string cmd = std::string("mkdir -p ") + MB_DIR;
+        if (system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -f ") + MB_DIR + "_*";
+        if (system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = MB_DIR;
+        mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+        mbconf.memcap_index = 64 * 1024 * 1024LL;
+        mbconf.memcap_data = BATCH_TEST_BLOCK_SIZE;
+        mbconf.block_size_index = 16 * 1024 * 1024LL;
+        mbconf.block_size_data = BATCH_TEST_BLOCK_SIZE;
+    }
+    virtual void TearDown()
+    {
+        if (db != NULL) {
+            db->Close();
+            delete db;
+            db = NULL;
+        }
+        ResourcePool::getInstance().RemoveAll();
+    }
+
+    // Every 10th value is larger than the first read of a cold value.
+    static std::string GetValue(const std::string& key, int i, int version)
+    {
+        size_t size = (i % 10 == 0) ? 6000 : 500;
+        std::string value = std::to_string(version) + ":";
+        while (value.length() < size)
+            value += key;
+        return value.substr(0, size);
+    }
+
+    void Populate(int num, int version)
+    {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+        for (int i = 0; i < num; i++) {
+            std::string key = tkey.get_key(i);
+            std::string value = GetValue(key, i, version);
+            if (i % 3 == 0) {
+                EXPECT_EQ(db->AddWithTTL(key.data(), key.size(), value.data(), value.size(),
+                              3600, true),
+                    MBError::SUCCESS);
+            } else {
+                EXPECT_EQ(db->Add(key, value, true), MBError::SUCCESS);
+            }
+        }
+    }
+
+    // Every other key of the batch does not exist if with_missing is set.
+    static void CheckBatch(DB* dbh, int num, int version, bool with_missing)
+    {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+        const int batch_size = 300;
+        std::vector<std::string> keys;
+        std::vector<int> ids;
+        for (int n = 0; n < num; n++) {
+            int i = (n * 7) % num;
+            ids.push_back(i);
+            keys.push_back(tkey.get_key(i));
+            if (with_missing) {
+                ids.push_back(-1);
+                keys.push_back(tkey.get_key(num + n));
+            }
+            if (keys.size() < batch_size && n < num - 1)
+                continue;
+
+            MBData* data = new MBData[keys.size()];
+            std::vector<int> rvals(keys.size());
+            ASSERT_EQ(dbh->FindBatch(keys, data, rvals.data()), MBError::SUCCESS);
+            for (size_t k = 0; k < keys.size(); k++) {
+                if (ids[k] < 0) {
+                    EXPECT_EQ(rvals[k], MBError::NOT_EXIST);
+                    continue;
+                }
+                ASSERT_EQ(rvals[k], MBError::SUCCESS);
+                EXPECT_EQ(std::string((const char*)data[k].buff, data[k].data_len),
+                    GetValue(keys[k], ids[k], version));
+                EXPECT_EQ(data[k].match_len, (int)keys[k].size());
+                EXPECT_EQ(data[k].expire_time != 0, ids[k] % 3 == 0);
+
+                MBData mbd;
+                ASSERT_EQ(dbh->Find(keys[k], mbd), MBError::SUCCESS);
+                EXPECT_EQ(mbd.data_offset, data[k].data_offset);
+                EXPECT_EQ(mbd.bucket_index, data[k].bucket_index);
+            }
+            delete[] data;
+            keys.clear();
+            ids.clear();
+        }
+    }
+
+protected:
+    MBConfig mbconf;
+    DB* db;
+};
+
+TEST_F(FindBatchTest, find_batch_in_memory)
+{
+    int num = 2000;
+    mbconf.memcap_data = 64 * 1024 * 1024LL;
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    Populate(num, 0);
+    CheckBatch(db, num, 0, true);
+}
+
+TEST_F(FindBatchTest, find_batch_beyond_memcap)
+{
+    int num = 20000;
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    Populate(num, 0);
+    CheckBatch(db, num, 0, true);
+
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    DB db_r(mbconf);
+    ASSERT_TRUE(db_r.is_open());
+    CheckBatch(&db_r, num, 0, true);
+
+    // Updated values are read.
+    Populate(num, 1);
+    CheckBatch(&db_r, num, 1, false);
+    db_r.Close();
+}
+
+TEST_F(FindBatchTest, find_batch_concurrent_writer)
+{
+    int num = 10000;
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    Populate(num, 0);
+
+    std::atomic<bool> done(false);
+    std::thread reader([&]() {
+        MBConfig conf = mbconf;
+        conf.options = CONSTS::ACCESS_MODE_READER;
+        DB db_r(conf);
+        ASSERT_TRUE(db_r.is_open());
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+        std::vector<std::string> keys;
+        for (int i = 0; i < 200; i++)
+            keys.push_back(tkey.get_key(i * 37 % num));
+        MBData* data = new MBData[keys.size()];
+        std::vector<int> rvals(keys.size());
+        while (!done.load()) {
+            ASSERT_EQ(db_r.FindBatch(keys, data, rvals.data()), MBError::SUCCESS);
+            for (size_t k = 0; k < keys.size(); k++) {
+                ASSERT_EQ(rvals[k], MBError::SUCCESS);
+                // The value is either the old one or the new one.
+                std::string value((const char*)data[k].buff, data[k].data_len);
+                int i = k * 37 % num;
+                if (value != GetValue(keys[k], i, 0)) {
+                    EXPECT_EQ(value, GetValue(keys[k], i, 1));
+                }
+            }
+        }
+        delete[] data;
+        db_r.Close();
+    });
+    Populate(num, 1);
+    done.store(true);
+    reader.join();
+}
+
+TEST_F(FindBatchTest, find_batch_invalid_args)
+{
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    std::vector<std::string> keys(1, "key");
+    int rval;
+    MBData data;
+    EXPECT_EQ(db->FindBatch(keys, NULL, &rval), MBError::INVALID_ARG);
+    EXPECT_EQ(db->FindBatch(keys, &data, NULL), MBError::INVALID_ARG);
+    EXPECT_EQ(db->FindBatch(std::vector<std::string>(), &data, &rval), MBError::SUCCESS);
+}
+
+TEST_F(FindBatchTest, async_reader)
+{
+    // More reads than the ring depth, including reads past the end of file.
+    std::string path = std::string(MB_DIR) + "_async_reader_test";
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    ASSERT_GT(fd, 0);
+    std::string content;
+    for (int i = 0; i < 100000; i++)
+        content += (char)('a' + i % 26);
+    ASSERT_EQ(write(fd, content.data(), content.size()), (ssize_t)content.size());
+
+    int num = MB_ASYNC_READ_DEPTH * 3 + 1;
+    std::vector<std::string> buffs(num, std::string(100, '\0'));
+    std::vector<AsyncRead> reads;
+    for (int i = 0; i < num; i++) {
+        AsyncRead read;
+        read.fd = fd;
+        read.buff = reinterpret_cast<uint8_t*>(&buffs[i][0]);
+        read.size = 100;
+        read.offset = i * 257;
+        reads.push_back(read);
+    }
+    reads.back().offset = content.size() - 40;
+
+    AsyncReader reader;
+    reader.Read(reads);
+    for (int i = 0; i < num - 1; i++) {
+        EXPECT_EQ(reads[i].result, 100);
+        EXPECT_EQ(buffs[i], content.substr(i * 257, 100));
+    }
+    EXPECT_EQ(reads.back().result, 40);
+    EXPECT_EQ(buffs.back().substr(0, 40), content.substr(content.size() - 40));
+    close(fd);
+    unlink(path.c_str());
+}
+
+}
@@ -16,6 +16,7 @@
 
 // @author Changxue Deng <chadeng@cisco.com>
 
+#include <fstream>
 #include <list>
 #include <stdlib.h>
 #include <unistd.h>
@@ -33,8 +34,15 @@ class FreeListTest : public ::testing::Test {
 public:
     FreeListTest() { }
     virtual ~FreeListTest() { }
-    virtual void SetUp() { }
-    virtual void TearDown() { }
+    virtual void SetUp()
+    {
+        unlink("./freelist");
+    }
+    virtual void TearDown()
+    {
+        unlink("./freelist");
+        unlink("./freelist_copy");
+    }
 
 protected:
 };
@@ -190,37 +198,32 @@ TEST_F(FreeListTest, GetTotSize_test)
     EXPECT_EQ(flist.Count(), 4);
 }
 
-TEST_F(FreeListTest, StoreLoadEmpty_test)
+TEST_F(FreeListTest, ReopenEmpty_test)
 {
-    int rval;
+    {
+        FreeList flist("./freelist", 4, 555);
+        EXPECT_EQ(flist.Count(), 0);
+    }
     FreeList flist("./freelist", 4, 555);
-
-    rval = flist.StoreListOnDisk();
-    EXPECT_EQ(rval, MBError::SUCCESS);
-    rval = access("./freelist", R_OK);
-    EXPECT_EQ(rval, -1);
+    EXPECT_EQ(flist.Count(), 0);
+    EXPECT_EQ(flist.GetTotSize(), 0u);
 }
 
-TEST_F(FreeListTest, StoreLoadSmallFilling_test)
+TEST_F(FreeListTest, ReopenSmallFilling_test)
 {
     int rval;
     size_t offset;
-    FreeList flist("./freelist", 4, 555);
-
-    flist.AddBuffer(32, 17);
-    flist.AddBuffer(84, 11);
-    flist.AddBuffer(144, 23);
-    flist.AddBuffer(444, 3);
-    rval = flist.StoreListOnDisk();
-    EXPECT_EQ(rval, MBError::SUCCESS);
-    rval = access("./freelist", F_OK);
-    EXPECT_EQ(rval, 0);
-    EXPECT_EQ(flist.Count(), 0);
-    EXPECT_EQ(flist.GetTotSize(), 0u);
+    {
+        FreeList flist("./freelist", 4, 555);
+        flist.AddBuffer(32, 17);
+        flist.AddBuffer(84, 11);
+        flist.AddBuffer(144, 23);
+        flist.AddBuffer(444, 3);
+    }
 
-    flist.LoadListFromDisk();
-    rval = access("./freelist", R_OK);
-    EXPECT_EQ(rval, -1);
+    FreeList flist("./freelist", 4, 555);
+    EXPECT_EQ(flist.Count(), 4);
+    EXPECT_EQ(flist.GetTotSize(), 20u + 12u + 24u + 4u);
     rval = flist.RemoveBuffer(offset, 11);
     EXPECT_EQ(rval, MBError::SUCCESS);
     EXPECT_EQ(offset, 84u);
@@ -235,37 +238,30 @@ TEST_F(FreeListTest, StoreLoadSmallFilling_test)
     EXPECT_EQ(offset, 444u);
 }
 
-TEST_F(FreeListTest, StoreLoadFullFilling_test)
+TEST_F(FreeListTest, ReopenFullFilling_test)
 {
     int rval;
     size_t offset;
     int size;
     int num_buff = 1011;
-    FreeList flist("./freelist", 4, num_buff);
     std::list<size_t> buff_list;
 
     srand(time(NULL));
 
-    offset = 0;
-    for (int i = 0; i < num_buff; i++) {
-        size = rand() % 111 + 2;
-        flist.AddBuffer(offset, size);
-        buff_list.push_back(offset);
-        buff_list.push_back(size);
-        offset += flist.GetAlignmentSize(size);
+    {
+        FreeList flist("./freelist", 4, num_buff);
+        offset = 0;
+        for (int i = 0; i < num_buff; i++) {
+            size = rand() % 111 + 2;
+            flist.AddBuffer(offset, size);
+            buff_list.push_back(offset);
+            buff_list.push_back(size);
+            offset += flist.GetAlignmentSize(size);
+        }
     }
 
-    rval = flist.StoreListOnDisk();
-    EXPECT_EQ(rval, MBError::SUCCESS);
-    rval = access("./freelist", F_OK);
-    EXPECT_EQ(rval, 0);
-    EXPECT_EQ(flist.Count(), 0);
-    EXPECT_EQ(flist.GetTotSize(), 0u);
-
-    flist.LoadListFromDisk();
-    rval = access("./freelist", R_OK);
-    EXPECT_EQ(rval, -1);
-
+    FreeList flist("./freelist", 4, num_buff);
+    EXPECT_EQ(flist.Count(), num_buff);
     for (std::list<size_t>::iterator it = buff_list.begin(); it != buff_list.end(); ++it) {
         offset = *it;
         it++;
@@ -278,49 +274,111 @@ TEST_F(FreeListTest, StoreLoadFullFilling_test)
     EXPECT_EQ(rval, MBError::NO_MEMORY);
 }
 
-TEST_F(FreeListTest, StoreLoadHalfFilling_test)
+TEST_F(FreeListTest, ReopenMismatch_test)
 {
-    int rval;
-    size_t offset;
-    int size;
-    int num_buff = 1000;
-    FreeList flist("./freelist", 4, num_buff);
-    std::list<size_t> buff_list;
+    {
+        FreeList flist("./freelist", 4, 1000);
+        flist.AddBuffer(32, 17);
+        flist.AddBuffer(84, 11);
+    }
 
-    srand(time(NULL));
+    // Lists with a different number of size classes are not used.
+    {
+        FreeList flist("./freelist", 4, 1001);
+        EXPECT_EQ(flist.Count(), 0);
+    }
+    FreeList flist("./freelist", 4, 1000);
+    EXPECT_EQ(flist.Count(), 0);
+    EXPECT_EQ(flist.GetTotSize(), 0u);
+}
 
-    offset = 24;
-    for (int i = 0; i < num_buff; i++) {
-        size = rand() % 98 + 1;
-        if (i % 2 == 0) {
-            flist.AddBuffer(offset, size);
-            buff_list.push_back(offset);
-            buff_list.push_back(size);
-        }
-        offset += flist.GetAlignmentSize(size);
+TEST_F(FreeListTest, NotClosed_test)
+{
+    FreeList flist("./freelist", 4, 555);
+    flist.AddBuffer(32, 17);
+    flist.AddBuffer(84, 11);
+
+    // A copy of a list in use is what a writer that did not exit normally
+    // leaves behind.
+    {
+        std::ifstream src("./freelist", std::ios::binary);
+        std::ofstream dst("./freelist_copy", std::ios::binary);
+        dst << src.rdbuf();
     }
+    FreeList flist_copy("./freelist_copy", 4, 555);
+    EXPECT_EQ(flist_copy.Count(), 0);
+    EXPECT_EQ(flist_copy.GetTotSize(), 0u);
+    EXPECT_EQ(flist.Count(), 2);
+}
 
-    rval = flist.StoreListOnDisk();
-    EXPECT_EQ(rval, MBError::SUCCESS);
-    rval = access("./freelist", F_OK);
-    EXPECT_EQ(rval, 0);
+TEST_F(FreeListTest, NoListLimit_test)
+{
+    FreeList flist("./freelist", 1, 8192);
+    int num_buff = 200000;
+
+    for (int i = 0; i < num_buff; i++)
+        EXPECT_EQ(flist.AddBufferByIndex(99, i * 100), MBError::SUCCESS);
+    EXPECT_EQ(flist.Count(), num_buff);
+    EXPECT_EQ(flist.GetBufferCountByIndex(99), (uint64_t)num_buff);
+    EXPECT_EQ(flist.GetTotSize(), (size_t)num_buff * 100);
+    EXPECT_GT(flist.GetChunkCount(), (uint32_t)FREE_LIST_MIN_CHUNKS);
+
+    for (int i = 0; i < num_buff; i++)
+        EXPECT_EQ(flist.RemoveBufferByIndex(99), (size_t)i * 100);
     EXPECT_EQ(flist.Count(), 0);
     EXPECT_EQ(flist.GetTotSize(), 0u);
 
-    flist.LoadListFromDisk();
-    rval = access("./freelist", R_OK);
-    EXPECT_EQ(rval, -1);
+    // Chunks are reused after the buffers are removed.
+    for (int i = 0; i < num_buff; i++)
+        flist.AddBufferByIndex(i % 8192, i);
+    EXPECT_EQ(flist.Count(), num_buff);
+    flist.Empty();
+    EXPECT_EQ(flist.Count(), 0);
+    EXPECT_EQ(flist.GetChunkCount(), 0u);
+    for (int i = 0; i < 8192; i++)
+        EXPECT_EQ(flist.GetBufferCountByIndex(i), 0u);
+}
 
-    for (std::list<size_t>::iterator it = buff_list.begin(); it != buff_list.end(); ++it) {
-        offset = *it;
-        it++;
-        size = *it;
-        rval = flist.RemoveBuffer(offset, size);
-        EXPECT_EQ(rval, MBError::SUCCESS);
-    }
-    size = 34;
-    rval = flist.RemoveBuffer(offset, size);
-    EXPECT_EQ(rval, MBError::NO_MEMORY);
+TEST_F(FreeListTest, SplitBuffer_test)
+{
+    size_t offset;
+    FreeList flist("./freelist", 1, 8192);
+
+    flist.AddBuffer(1000, 100);
+    flist.AddBuffer(5000, 5000);
+    flist.AddBuffer(3000, 40);
+
+    // Exact size first
+    EXPECT_TRUE(flist.GetBufferByIndex(flist.GetBufferIndex(40), offset));
+    EXPECT_EQ(offset, 3000u);
+    // The remainder is too small to split the 100-byte buffer.
+    EXPECT_TRUE(flist.GetBufferByIndex(flist.GetBufferIndex(90), offset));
+    EXPECT_EQ(offset, 5000u);
+    EXPECT_EQ(flist.GetBufferCountByIndex(flist.GetBufferIndex(4910)), 1u);
+    EXPECT_TRUE(flist.GetBufferByIndex(flist.GetBufferIndex(60), offset));
+    EXPECT_EQ(offset, 1000u);
+    EXPECT_EQ(flist.GetBufferCountByIndex(flist.GetBufferIndex(40)), 1u);
+    EXPECT_EQ(flist.Count(), 2);
+    EXPECT_EQ(flist.GetTotSize(), 4910u + 40u);
+
+    EXPECT_TRUE(flist.GetBufferByIndex(flist.GetBufferIndex(40), offset));
+    EXPECT_EQ(offset, 1060u);
+    EXPECT_FALSE(flist.GetBufferByIndex(flist.GetBufferIndex(4900), offset));
+    EXPECT_TRUE(flist.GetBufferByIndex(flist.GetBufferIndex(4910), offset));
+    EXPECT_EQ(offset, 5090u);
+    EXPECT_FALSE(flist.GetBufferByIndex(0, offset));
+    EXPECT_EQ(flist.Count(), 0);
+}
+
+TEST_F(FreeListTest, AnonymousList_test)
+{
+    size_t offset;
+    FreeList flist("", 4, 555);
+
+    flist.AddBuffer(32, 17);
+    EXPECT_EQ(flist.RemoveBuffer(offset, 17), MBError::SUCCESS);
+    EXPECT_EQ(offset, 32u);
+    EXPECT_EQ(access("./freelist", F_OK), -1);
 }
 
 }
@@ -0,0 +1,155 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <sstream>
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../resource_pool.h"
+#include "../rollable_file.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+namespace {
+
+#define MB_DIR "/var/tmp/mabain_test/"
+
+// The tests do not depend on huge pages being available. Blocks are mapped
+// with regular pages if the kernel cannot provide huge pages.
+class HugePageTest : public ::testing::Test {
+public:
+    HugePageTest()
+    {
+        db = NULL;
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~HugePageTest()
+    {
+    }
+    virtual void SetUp()
+    {
+        std::string cmd = std::string("mkdir -p ") + MB_DIR;
+        if (system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -f ") + MB_DIR + "_*";
+        if (system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = MB_DIR;
+        mbconf.memcap_index = 64 * 1024 * 1024LL;
+        mbconf.memcap_data = 64 * 1024 * 1024LL;
+        mbconf.block_size_index = 32 * 1024 * 1024LL;
+        mbconf.block_size_data = 32 * 1024 * 1024LL;
+    }
+    virtual void TearDown()
+    {
+        if (db != NULL) {
+            db->Close();
+            delete db;
+            db = NULL;
+        }
+        ResourcePool::getInstance().RemoveAll();
+    }
+
+    void AddAndFind(DB* dbh, int num)
+    {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+        for (int i = 0; i < num; i++) {
+            std::string key = tkey.get_key(i);
+            EXPECT_EQ(dbh->Add(key, key), MBError::SUCCESS);
+        }
+        MBData mbd;
+        for (int i = 0; i < num; i++) {
+            std::string key = tkey.get_key(i);
+            EXPECT_EQ(dbh->Find(key, mbd), MBError::SUCCESS);
+            EXPECT_EQ(std::string((const char*)mbd.buff, mbd.data_len), key);
+        }
+    }
+
+    std::string GetStats(DB* dbh)
+    {
+        std::stringstream ss;
+        dbh->PrintStats(ss);
+        return ss.str();
+    }
+
+protected:
+    MBConfig mbconf;
+    DB* db;
+};
+
+TEST_F(HugePageTest, advise)
+{
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER | CONSTS::HUGE_PAGE_ADVISE;
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    AddAndFind(db, 20000);
+    EXPECT_NE(GetStats(db).find("blocks mapped with huge pages"), std::string::npos);
+
+    mbconf.options = CONSTS::ACCESS_MODE_READER | CONSTS::HUGE_PAGE_ADVISE;
+    DB db_r(mbconf);
+    ASSERT_TRUE(db_r.is_open());
+    MBData mbd;
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+    EXPECT_EQ(db_r.Find(tkey.get_key(100), mbd), MBError::SUCCESS);
+    db_r.Close();
+}
+
+TEST_F(HugePageTest, hugetlb_memory_only)
+{
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER | CONSTS::MEMORY_ONLY_MODE
+        | CONSTS::HUGE_PAGE_HUGETLB;
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    AddAndFind(db, 20000);
+    EXPECT_NE(GetStats(db).find("blocks mapped with huge pages"), std::string::npos);
+}
+
+TEST_F(HugePageTest, hugetlb_on_disk)
+{
+    // Transparent huge pages are used instead for block files on disk.
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER | CONSTS::HUGE_PAGE_HUGETLB;
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    AddAndFind(db, 1000);
+}
+
+TEST_F(HugePageTest, block_size)
+{
+    size_t huge_page_size = RollableFile::HugePageSize(CONSTS::HUGE_PAGE_ADVISE);
+    mbconf.block_size_index = huge_page_size + 4 * 1024 * 1024LL;
+    mbconf.block_size_data = 2 * huge_page_size;
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER | CONSTS::HUGE_PAGE_ADVISE;
+    db = new DB(mbconf);
+    EXPECT_EQ(db->is_open(), mbconf.block_size_index % huge_page_size == 0);
+    db->Close();
+    delete db;
+    db = NULL;
+    ResourcePool::getInstance().RemoveAll();
+    std::string cmd = std::string("rm -f ") + MB_DIR + "_*";
+    if (system(cmd.c_str()) != 0) {
+    }
+
+    mbconf.block_size_index = 2 * huge_page_size;
+    db = new DB(mbconf);
+    EXPECT_TRUE(db->is_open());
+}
+
+}
@@ -0,0 +1,250 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../dict.h"
+#include "../mb_merge.h"
+#include "../resource_pool.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+namespace {
+
+#define MB_DIR "/var/tmp/mabain_test/"
+
+class MergeTest : public ::testing::Test {
+public:
+    MergeTest()
+    {
+        db = NULL;
+        db_r = NULL;
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~MergeTest()
+    {
+    }
+    virtual void SetUp()
+    {
+        std::string cmd = std::string("mkdir -p ") + MB_DIR;
+        if (system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -f ") + MB_DIR + "_*";
+        if (system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = MB_DIR;
+        mbconf.memcap_index = 64 * 1024 * 1024LL;
+        mbconf.memcap_data = 64 * 1024 * 1024LL;
+        mbconf.block_size_index = 8 * 1024 * 1024LL;
+        mbconf.block_size_data = 16 * 1024 * 1024LL;
+    }
+    virtual void TearDown()
+    {
+        if (db_r != NULL) {
+            db_r->Close();
+            delete db_r;
+            db_r = NULL;
+        }
+        if (db != NULL) {
+            db->Close();
+            delete db;
+            db = NULL;
+        }
+        ResourcePool::getInstance().RemoveAll();
+    }
+
+    void OpenDB(int writer_options)
+    {
+        mbconf.options = CONSTS::ACCESS_MODE_WRITER | writer_options;
+        db = new DB(mbconf);
+        ASSERT_TRUE(db->is_open());
+        if (writer_options & CONSTS::ASYNC_WRITER_MODE) {
+            mbconf.options = CONSTS::ACCESS_MODE_READER;
+            db_r = new DB(mbconf);
+            ASSERT_TRUE(db_r->is_open());
+        }
+    }
+
+    bool WaitForQueue(int timeout_ms)
+    {
+        for (int i = 0; i < timeout_ms; i++) {
+            if (!db_r->AsyncWriterBusy())
+                return true;
+            usleep(1000);
+        }
+        return false;
+    }
+
+    int64_t GetInt(DB* dbh, const std::string& key)
+    {
+        MBData mbd;
+        int64_t val = -1;
+        EXPECT_EQ(dbh->Find(key, mbd), MBError::SUCCESS);
+        EXPECT_EQ(mbd.data_len, (int)sizeof(val));
+        if (mbd.data_len == (int)sizeof(val))
+            memcpy(&val, mbd.buff, sizeof(val));
+        return val;
+    }
+
+    std::string GetValue(DB* dbh, const std::string& key)
+    {
+        MBData mbd;
+        if (dbh->Find(key, mbd) != MBError::SUCCESS)
+            return "";
+        return std::string((const char*)mbd.buff, mbd.data_len);
+    }
+
+protected:
+    MBConfig mbconf;
+    DB* db;
+    DB* db_r;
+};
+
+TEST_F(MergeTest, increment)
+{
+    OpenDB(0);
+    std::string key = "counter";
+    EXPECT_EQ(db->Increment(key.data(), key.size(), 5), MBError::SUCCESS);
+    EXPECT_EQ(GetInt(db, key), 5);
+    EXPECT_EQ(db->Count(), 1);
+    for (int i = 0; i < 100; i++)
+        EXPECT_EQ(db->Increment(key.data(), key.size(), 2), MBError::SUCCESS);
+    EXPECT_EQ(GetInt(db, key), 205);
+    EXPECT_EQ(db->Increment(key.data(), key.size(), -210), MBError::SUCCESS);
+    EXPECT_EQ(GetInt(db, key), -5);
+    EXPECT_EQ(db->Count(), 1);
+
+    // Values that are not 8 bytes are left unchanged.
+    EXPECT_EQ(db->Add("text", "hello"), MBError::SUCCESS);
+    EXPECT_EQ(db->Increment("text", 4, 1), MBError::VALUE_MISMATCH);
+    EXPECT_EQ(GetValue(db, "text"), "hello");
+}
+
+TEST_F(MergeTest, append)
+{
+    OpenDB(0);
+    std::string key = "log";
+    EXPECT_EQ(db->Append(key.data(), key.size(), "abc", 3), MBError::SUCCESS);
+    EXPECT_EQ(db->Append(key.data(), key.size(), "defg", 4), MBError::SUCCESS);
+    EXPECT_EQ(GetValue(db, key), "abcdefg");
+    // Bounded append drops the oldest bytes.
+    EXPECT_EQ(db->Append(key.data(), key.size(), "hij", 3, 5), MBError::SUCCESS);
+    EXPECT_EQ(GetValue(db, key), "fghij");
+    EXPECT_EQ(db->Append(key.data(), key.size(), "0123456789", 10, 4), MBError::SUCCESS);
+    EXPECT_EQ(GetValue(db, key), "6789");
+    EXPECT_EQ(db->Count(), 1);
+}
+
+TEST_F(MergeTest, compare_and_swap)
+{
+    OpenDB(0);
+    std::string key = "state";
+    EXPECT_EQ(db->CompareAndSwap(key.data(), key.size(), NULL, 0, "init", 4), MBError::SUCCESS);
+    EXPECT_EQ(GetValue(db, key), "init");
+    EXPECT_EQ(db->CompareAndSwap(key.data(), key.size(), NULL, 0, "again", 5),
+        MBError::VALUE_MISMATCH);
+    EXPECT_EQ(db->CompareAndSwap(key.data(), key.size(), "wrong", 5, "next", 4),
+        MBError::VALUE_MISMATCH);
+    EXPECT_EQ(GetValue(db, key), "init");
+    EXPECT_EQ(db->CompareAndSwap(key.data(), key.size(), "init", 4, "running", 7),
+        MBError::SUCCESS);
+    EXPECT_EQ(GetValue(db, key), "running");
+    EXPECT_EQ(db->CompareAndSwap("missing", 7, "init", 4, "running", 7),
+        MBError::VALUE_MISMATCH);
+    EXPECT_EQ(db->Count(), 1);
+}
+
+TEST_F(MergeTest, user_merge_operator)
+{
+    OpenDB(0);
+    // Keep the maximum of the stored and the given value.
+    MergeOperator max_op = [](const uint8_t* value, int value_len, const uint8_t* operand,
+                               int operand_len, std::string& result) {
+        if (value != NULL && (value_len != operand_len || memcmp(value, operand, value_len) > 0))
+            result.assign((const char*)value, value_len);
+        else
+            result.assign((const char*)operand, operand_len);
+        return (int)MBError::SUCCESS;
+    };
+
+    EXPECT_EQ(db->Merge("max", 3, MB_MERGE_USER_MIN, "5", 1), MBError::INVALID_ARG);
+    EXPECT_EQ(db->RegisterMergeOperator(MB_MERGE_INT_ADD, max_op), MBError::INVALID_ARG);
+    EXPECT_EQ(db->RegisterMergeOperator(MB_MERGE_USER_MIN, max_op), MBError::SUCCESS);
+    EXPECT_EQ(db->Merge("max", 3, MB_MERGE_USER_MIN, "5", 1), MBError::SUCCESS);
+    EXPECT_EQ(db->Merge("max", 3, MB_MERGE_USER_MIN, "3", 1), MBError::SUCCESS);
+    EXPECT_EQ(GetValue(db, "max"), "5");
+    EXPECT_EQ(db->Merge("max", 3, MB_MERGE_USER_MIN, "8", 1), MBError::SUCCESS);
+    EXPECT_EQ(GetValue(db, "max"), "8");
+
+    // Errors from the operator are returned and the value is unchanged.
+    MergeOperator reject_op = [](const uint8_t*, int, const uint8_t*, int, std::string&) {
+        return (int)MBError::NOT_ALLOWED;
+    };
+    EXPECT_EQ(db->RegisterMergeOperator(MB_MERGE_USER_MIN + 1, reject_op), MBError::SUCCESS);
+    EXPECT_EQ(db->Merge("max", 3, MB_MERGE_USER_MIN + 1, "9", 1), MBError::NOT_ALLOWED);
+    EXPECT_EQ(GetValue(db, "max"), "8");
+}
+
+TEST_F(MergeTest, async_increment)
+{
+    OpenDB(CONSTS::ASYNC_WRITER_MODE);
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+    int num_keys = 50;
+    int num_threads = 4;
+    int num_updates = 200;
+
+    // Concurrent increments from multiple threads are not lost.
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+        threads.push_back(std::thread([&]() {
+            TestKey thread_key(MABAIN_TEST_KEY_TYPE_INT);
+            for (int n = 0; n < num_updates; n++) {
+                for (int i = 0; i < num_keys; i++) {
+                    std::string key = thread_key.get_key(i);
+                    EXPECT_EQ(db_r->Increment(key.data(), key.size(), i), MBError::SUCCESS);
+                }
+            }
+        }));
+    }
+    for (auto& th : threads)
+        th.join();
+
+    // Updates sent through the shared memory queue
+    Dict* dict = db->GetDictPtr();
+    for (int i = 0; i < num_keys; i++) {
+        std::string key = tkey.get_key(i);
+        int64_t delta = 1;
+        EXPECT_EQ(dict->SHMQ_Merge(key.data(), key.size(), MB_MERGE_INT_ADD,
+                      (const char*)&delta, sizeof(delta), 1000),
+            MBError::SUCCESS);
+    }
+    EXPECT_TRUE(WaitForQueue(5000));
+
+    EXPECT_EQ(db_r->Count(), num_keys);
+    for (int i = 0; i < num_keys; i++)
+        EXPECT_EQ(GetInt(db_r, tkey.get_key(i)), (int64_t)i * num_threads * num_updates + 1);
+}
+
+}
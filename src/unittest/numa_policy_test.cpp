@@ -0,0 +1,153 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <sstream>
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../numa_policy.h"
+#include "../resource_pool.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+namespace {
+
+#define MB_DIR "/var/tmp/mabain_test/"
+
+// The tests also run on machines with a single node, where all pages are
+// reported on node 0.
+class NumaPolicyTest : public ::testing::Test {
+public:
+    NumaPolicyTest()
+    {
+        db = NULL;
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~NumaPolicyTest()
+    {
+    }
+    virtual void SetUp()
+    {
+        std::string cmd = std::string("mkdir -p ") + MB_DIR;
+        if (system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -f ") + MB_DIR + "_*";
+        if (system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = MB_DIR;
+        mbconf.memcap_index = 64 * 1024 * 1024LL;
+        mbconf.memcap_data = 64 * 1024 * 1024LL;
+        mbconf.block_size_index = 16 * 1024 * 1024LL;
+        mbconf.block_size_data = 16 * 1024 * 1024LL;
+    }
+    virtual void TearDown()
+    {
+        if (db != NULL) {
+            db->Close();
+            delete db;
+            db = NULL;
+        }
+        ResourcePool::getInstance().RemoveAll();
+    }
+
+    void AddAndFind(DB* dbh, int num)
+    {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+        for (int i = 0; i < num; i++) {
+            std::string key = tkey.get_key(i);
+            EXPECT_EQ(dbh->Add(key, key), MBError::SUCCESS);
+        }
+        MBData mbd;
+        for (int i = 0; i < num; i++) {
+            std::string key = tkey.get_key(i);
+            EXPECT_EQ(dbh->Find(key, mbd), MBError::SUCCESS);
+            EXPECT_EQ(std::string((const char*)mbd.buff, mbd.data_len), key);
+        }
+    }
+
+    std::string GetNumaStats(DB* dbh)
+    {
+        std::stringstream ss;
+        dbh->PrintNumaStats(ss);
+        return ss.str();
+    }
+
+protected:
+    MBConfig mbconf;
+    DB* db;
+};
+
+TEST_F(NumaPolicyTest, online_nodes)
+{
+    uint64_t nodes = NumaPolicy::OnlineNodes();
+    EXPECT_NE(nodes, 0ULL);
+}
+
+TEST_F(NumaPolicyTest, interleave)
+{
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+    mbconf.numa_policy = MB_NUMA_INTERLEAVE;
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    AddAndFind(db, 20000);
+    std::string stats = GetNumaStats(db);
+    EXPECT_NE(stats.find("resident pages"), std::string::npos);
+    EXPECT_NE(stats.find("node "), std::string::npos);
+
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    DB db_r(mbconf);
+    ASSERT_TRUE(db_r.is_open());
+    MBData mbd;
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+    EXPECT_EQ(db_r.Find(tkey.get_key(100), mbd), MBError::SUCCESS);
+    db_r.Close();
+}
+
+TEST_F(NumaPolicyTest, bind_block_memory_only)
+{
+    // Each block is bound to one of the online nodes in turn.
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER | CONSTS::MEMORY_ONLY_MODE;
+    mbconf.numa_policy = MB_NUMA_BIND_BLOCK;
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    AddAndFind(db, 50000);
+    EXPECT_NE(GetNumaStats(db).find("resident pages"), std::string::npos);
+}
+
+TEST_F(NumaPolicyTest, preferred_nodes)
+{
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+    mbconf.numa_policy = MB_NUMA_PREFERRED;
+    mbconf.numa_nodes = NumaPolicy::OnlineNodes();
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    AddAndFind(db, 5000);
+}
+
+TEST_F(NumaPolicyTest, invalid_policy)
+{
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+    mbconf.numa_policy = 7;
+    db = new DB(mbconf);
+    EXPECT_FALSE(db->is_open());
+}
+
+}
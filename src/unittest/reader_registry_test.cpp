@@ -0,0 +1,345 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <signal.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../dict.h"
+#include "../reader_registry.h"
+#include "../resource_pool.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+namespace {
+
+#define MB_DIR "/var/tmp/mabain_test/"
+#define REGISTRY_TEST_BLOCK_SIZE (4 * 1024 * 1024)
+
+class ReaderRegistryTest : public ::testing::Test {
+public:
+    ReaderRegistryTest()
+    {
+        db = NULL;
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~ReaderRegistryTest()
+    {
+    }
+    virtual void SetUp()
+    {
+        std::string cmd = std::string("mkdir -p ") + MB_DIR;
+        if (system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -f ") + MB_DIR + "_*";
+        if (system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = MB_DIR;
+        mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+        mbconf.memcap_index = 64 * 1024 * 1024LL;
+        mbconf.memcap_data = 64 * 1024 * 1024LL;
+        mbconf.block_size_index = REGISTRY_TEST_BLOCK_SIZE;
+        mbconf.block_size_data = REGISTRY_TEST_BLOCK_SIZE;
+        mbconf.queue_dir = MB_DIR;
+    }
+    virtual void TearDown()
+    {
+        if (db != NULL) {
+            db->Close();
+            delete db;
+            db = NULL;
+        }
+        ResourcePool::getInstance().RemoveAll();
+    }
+
+    static std::string GetValue(const std::string& key, int version)
+    {
+        std::string value = std::to_string(version) + ":";
+        while (value.length() < 1000)
+            value += key;
+        return value.substr(0, 1000);
+    }
+
+    void Populate(int start, int end, int version)
+    {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+        for (int i = start; i < end; i++) {
+            std::string key = tkey.get_key(i);
+            ASSERT_EQ(db->Add(key, GetValue(key, version), true), MBError::SUCCESS);
+        }
+    }
+
+    // Keep every 10th key of the first num keys and defragment the DB
+    void Shrink(int num)
+    {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+        for (int i = 0; i < num; i++) {
+            if (i % 10 != 0) {
+                ASSERT_EQ(db->Remove(tkey.get_key(i)), MBError::SUCCESS);
+            }
+        }
+        ASSERT_EQ(db->CollectResource(1, 1), MBError::SUCCESS);
+    }
+
+    static void Check(DB* dbh, int start, int end, int step, int version)
+    {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+        MBData mbd;
+        for (int i = start; i < end; i += step) {
+            std::string key = tkey.get_key(i);
+            ASSERT_EQ(dbh->Find(key, mbd), MBError::SUCCESS);
+            EXPECT_EQ(std::string((const char*)mbd.buff, mbd.data_len), GetValue(key, version));
+        }
+    }
+
+    static int NumBlockFiles(const std::string& prefix)
+    {
+        int num = 0;
+        for (int i = 0; i < 1024; i++) {
+            struct stat st;
+            if (stat((std::string(MB_DIR) + prefix + std::to_string(i)).c_str(), &st) == 0)
+                num++;
+        }
+        return num;
+    }
+
+protected:
+    MBConfig mbconf;
+    DB* db;
+};
+
+TEST_F(ReaderRegistryTest, registry_slots)
+{
+    std::string path = std::string(MB_DIR) + "_mabain_r_test";
+    ReaderRegistry writer(path, true);
+    ASSERT_TRUE(writer.IsValid());
+    ReaderRegistry* reader = new ReaderRegistry(path, false);
+    ASSERT_TRUE(reader->IsValid());
+    EXPECT_FALSE(reader->Retired());
+
+    uint64_t gen = writer.Retire(100, 200);
+    EXPECT_TRUE(reader->Retired());
+    EXPECT_FALSE(writer.Released(gen));
+    size_t index_size;
+    size_t data_size;
+    EXPECT_EQ(reader->GetRetired(index_size, data_size), gen);
+    EXPECT_EQ(index_size, 100u);
+    EXPECT_EQ(data_size, 200u);
+    reader->Release(gen);
+    EXPECT_FALSE(reader->Retired());
+    EXPECT_TRUE(writer.Released(gen));
+
+    // The writer cannot tell if readers without a slot have released the
+    // blocks. Each reader has its own file descriptor.
+    struct rlimit rlim;
+    ASSERT_EQ(getrlimit(RLIMIT_NOFILE, &rlim), 0);
+    if (rlim.rlim_cur < rlim.rlim_max) {
+        rlim.rlim_cur = rlim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rlim);
+    }
+    std::vector<ReaderRegistry*> readers;
+    for (int i = 0; i < MB_MAX_READER_SLOT; i++)
+        readers.push_back(new ReaderRegistry(path, false));
+    gen = writer.Retire(100, 200);
+    for (auto r : readers)
+        r->Release(gen);
+    reader->Release(gen);
+    EXPECT_FALSE(writer.Released(gen));
+    delete readers.back();
+    readers.pop_back();
+    EXPECT_TRUE(writer.Released(gen));
+
+    delete reader;
+    for (auto r : readers)
+        delete r;
+    unlink(path.c_str());
+}
+
+// Run a reader in a child process until it is killed.
+static pid_t StartReader(const std::string& path)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+        return -1;
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        ReaderRegistry reader(path, false);
+        char c = reader.IsValid() ? 1 : 0;
+        if (write(fds[1], &c, 1) != 1) {
+        }
+        while (true)
+            pause();
+    }
+    close(fds[1]);
+    char c = 0;
+    if (pid < 0 || read(fds[0], &c, 1) != 1 || c != 1)
+        pid = -1;
+    close(fds[0]);
+    return pid;
+}
+
+static void StopReader(pid_t pid)
+{
+    int status;
+    kill(pid, SIGKILL);
+    waitpid(pid, &status, 0);
+}
+
+TEST_F(ReaderRegistryTest, killed_reader)
+{
+    std::string path = std::string(MB_DIR) + "_mabain_r_test";
+    unlink(path.c_str());
+    ReaderRegistry writer(path, true);
+    ASSERT_TRUE(writer.IsValid());
+
+    // The slot is freed by the lock on it, not by the process id.
+    pid_t pid = StartReader(path);
+    ASSERT_GT(pid, 0);
+    uint64_t gen = writer.Retire(100, 200);
+    EXPECT_FALSE(writer.Released(gen));
+    StopReader(pid);
+    EXPECT_TRUE(writer.Released(gen));
+
+    // Killed readers without a slot do not block the writer either.
+    std::vector<ReaderRegistry*> readers;
+    for (int i = 0; i < MB_MAX_READER_SLOT; i++)
+        readers.push_back(new ReaderRegistry(path, false));
+    pid = StartReader(path);
+    ASSERT_GT(pid, 0);
+    gen = writer.Retire(100, 200);
+    for (auto r : readers)
+        r->Release(gen);
+    EXPECT_FALSE(writer.Released(gen));
+    StopReader(pid);
+    EXPECT_TRUE(writer.Released(gen));
+
+    for (auto r : readers)
+        delete r;
+    unlink(path.c_str());
+}
+
+TEST_F(ReaderRegistryTest, exited_reader)
+{
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    Populate(0, 20000, 0);
+    int num_data_block = NumBlockFiles("_mabain_d");
+
+    // The reader exits without closing the DB.
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        MBConfig conf = mbconf;
+        conf.options = CONSTS::ACCESS_MODE_READER;
+        DB* db_r = new DB(conf);
+        MBData mbd;
+        db_r->Find(TestKey(MABAIN_TEST_KEY_TYPE_INT).get_key(19999), mbd);
+        _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+
+    Shrink(20000);
+    EXPECT_LT(NumBlockFiles("_mabain_d"), num_data_block);
+    Check(db, 0, 20000, 10, 0);
+}
+
+TEST_F(ReaderRegistryTest, unlink_after_release)
+{
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    Populate(0, 20000, 0);
+    int num_data_block = NumBlockFiles("_mabain_d");
+    int num_index_block = NumBlockFiles("_mabain_i");
+    EXPECT_GE(num_data_block, 5);
+
+    MBConfig conf = mbconf;
+    conf.options = CONSTS::ACCESS_MODE_READER;
+    DB db_r(conf);
+    ASSERT_TRUE(db_r.is_open());
+    Check(&db_r, 0, 20000, 1, 0);
+
+    // The retired blocks are kept until the reader releases them.
+    Shrink(20000);
+    EXPECT_LT(db->GetDictPtr()->GetHeaderPtr()->m_data_offset,
+        (size_t)(num_data_block - 2) * REGISTRY_TEST_BLOCK_SIZE);
+    EXPECT_EQ(NumBlockFiles("_mabain_d"), num_data_block);
+    Check(db, 0, 20000, 10, 0);
+
+    Check(&db_r, 0, 20000, 10, 0);
+    db->GetDictPtr()->UnlinkRetiredBlocks();
+    EXPECT_LT(NumBlockFiles("_mabain_d"), num_data_block);
+    EXPECT_LE(NumBlockFiles("_mabain_i"), num_index_block);
+
+    // Blocks removed are created again as the DB grows.
+    Populate(20000, 40000, 1);
+    Check(db, 20000, 40000, 1, 1);
+    Check(&db_r, 0, 20000, 10, 0);
+    Check(&db_r, 20000, 40000, 1, 1);
+    db_r.Close();
+}
+
+TEST_F(ReaderRegistryTest, retired_blocks_reused)
+{
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    Populate(0, 20000, 0);
+
+    MBConfig conf = mbconf;
+    conf.options = CONSTS::ACCESS_MODE_READER;
+    DB db_r(conf);
+    ASSERT_TRUE(db_r.is_open());
+    Check(&db_r, 0, 20000, 1, 0);
+
+    // The writer grows into the retired blocks before the reader releases
+    // them. The blocks in use are not removed.
+    Shrink(20000);
+    Populate(20000, 40000, 1);
+    Check(&db_r, 0, 20000, 10, 0);
+    Check(&db_r, 20000, 40000, 1, 1);
+    db->GetDictPtr()->UnlinkRetiredBlocks();
+    Populate(40000, 45000, 2);
+    Check(db, 0, 20000, 10, 0);
+    Check(db, 20000, 40000, 1, 1);
+    Check(db, 40000, 45000, 1, 2);
+    Check(&db_r, 20000, 40000, 1, 1);
+    Check(&db_r, 40000, 45000, 1, 2);
+    db_r.Close();
+
+    db->Close();
+    delete db;
+    db = NULL;
+    ResourcePool::getInstance().RemoveAll();
+    DB db_r2(conf);
+    ASSERT_TRUE(db_r2.is_open());
+    Check(&db_r2, 0, 20000, 10, 0);
+    Check(&db_r2, 20000, 40000, 1, 1);
+    Check(&db_r2, 40000, 45000, 1, 2);
+    db_r2.Close();
+}
+
+}
@@ -0,0 +1,297 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../redo_log.h"
+#include "../resource_pool.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+namespace {
+
+#define MB_DIR "/var/tmp/mabain_test/"
+#define REDO_LOG_COPY "/var/tmp/mabain_test_redo_copy"
+
+class RedoLogTest : public ::testing::Test {
+public:
+    RedoLogTest()
+    {
+        db = NULL;
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~RedoLogTest()
+    {
+    }
+    virtual void SetUp()
+    {
+        std::string cmd = std::string("mkdir -p ") + MB_DIR;
+        if (system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -f ") + MB_DIR + "_* " + REDO_LOG_COPY;
+        if (system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = MB_DIR;
+        mbconf.memcap_index = 64 * 1024 * 1024LL;
+        mbconf.memcap_data = 64 * 1024 * 1024LL;
+        mbconf.block_size_index = 8 * 1024 * 1024LL;
+        mbconf.block_size_data = 16 * 1024 * 1024LL;
+        mbconf.redo_sync_interval = 10;
+    }
+    virtual void TearDown()
+    {
+        CloseDB();
+        ResourcePool::getInstance().RemoveAll();
+    }
+
+    void OpenDB(int options)
+    {
+        mbconf.options = CONSTS::ACCESS_MODE_WRITER | options;
+        db = new DB(mbconf);
+        ASSERT_TRUE(db->is_open());
+    }
+
+    void CloseDB()
+    {
+        if (db != NULL) {
+            db->Close();
+            delete db;
+            db = NULL;
+        }
+    }
+
+    static off_t LogSize()
+    {
+        struct stat st;
+        std::string path = std::string(MB_DIR) + REDO_LOG_FILE;
+        if (stat(path.c_str(), &st) != 0)
+            return -1;
+        return st.st_size;
+    }
+
+    static void CopyFile(const std::string& src, const std::string& dst)
+    {
+        std::string cmd = "cp " + src + " " + dst;
+        ASSERT_EQ(system(cmd.c_str()), 0);
+    }
+
+    // Save the synced log as if the writer was killed at this point.
+    void SaveLog()
+    {
+        // wait for the group commit
+        usleep(200000);
+        CopyFile(std::string(MB_DIR) + REDO_LOG_FILE, REDO_LOG_COPY);
+    }
+
+    // Clear the DB without logging and put the saved log back.
+    void ClearDBAndRestoreLog()
+    {
+        OpenDB(0);
+        EXPECT_EQ(db->RemoveAll(), MBError::SUCCESS);
+        CloseDB();
+        CopyFile(REDO_LOG_COPY, std::string(MB_DIR) + REDO_LOG_FILE);
+    }
+
+    void Update(int num)
+    {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_128);
+        std::string key;
+        for (int i = 0; i < num; i++) {
+            key = tkey.get_key(i);
+            EXPECT_EQ(db->Add(key, key), MBError::SUCCESS);
+        }
+        for (int i = 0; i < num; i += 3) {
+            key = tkey.get_key(i);
+            EXPECT_EQ(db->Remove(key), MBError::SUCCESS);
+        }
+        for (int i = 0; i < num; i += 5) {
+            key = tkey.get_key(i);
+            EXPECT_EQ(db->Add(key, key + "_new", true), MBError::SUCCESS);
+        }
+    }
+
+    void Verify(int num)
+    {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_128);
+        std::string key;
+        MBData mbd;
+        int64_t count = 0;
+        for (int i = 0; i < num; i++) {
+            key = tkey.get_key(i);
+            int rval = db->Find(key, mbd);
+            if (i % 5 == 0) {
+                ASSERT_EQ(rval, MBError::SUCCESS);
+                EXPECT_EQ(std::string((const char*)mbd.buff, mbd.data_len), key + "_new");
+            } else if (i % 3 == 0) {
+                EXPECT_EQ(rval, MBError::NOT_EXIST);
+                continue;
+            } else {
+                ASSERT_EQ(rval, MBError::SUCCESS);
+                EXPECT_EQ(std::string((const char*)mbd.buff, mbd.data_len), key);
+            }
+            count++;
+        }
+        EXPECT_EQ(db->Count(), count);
+    }
+
+protected:
+    MBConfig mbconf;
+    DB* db;
+};
+
+TEST_F(RedoLogTest, replay_test)
+{
+    int num = 5000;
+    OpenDB(CONSTS::REDO_LOG);
+    Update(num);
+    SaveLog();
+    CloseDB();
+    // The log is truncated at the checkpoint when closing the DB.
+    EXPECT_EQ(LogSize(), REDO_LOG_HEADER_SIZE);
+
+    ClearDBAndRestoreLog();
+    OpenDB(CONSTS::REDO_LOG);
+    Verify(num);
+    EXPECT_EQ(LogSize(), REDO_LOG_HEADER_SIZE);
+}
+
+TEST_F(RedoLogTest, torn_record_test)
+{
+    int num = 2000;
+    OpenDB(CONSTS::REDO_LOG);
+    Update(num);
+    SaveLog();
+    CloseDB();
+
+    // A record header without the key and data at the end of the log
+    RedoRecordHeader rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.type = REDO_LOG_TYPE_REMOVE_ALL;
+    rec.key_len = 16;
+    FILE* fp = fopen(REDO_LOG_COPY, "a");
+    ASSERT_TRUE(fp != NULL);
+    EXPECT_EQ(fwrite(&rec, sizeof(rec), 1, fp), 1u);
+    fclose(fp);
+
+    ClearDBAndRestoreLog();
+    OpenDB(CONSTS::REDO_LOG);
+    Verify(num);
+}
+
+TEST_F(RedoLogTest, checkpoint_test)
+{
+    int num = 20000;
+    mbconf.redo_checkpoint_size = 64 * 1024;
+    OpenDB(CONSTS::REDO_LOG);
+    Update(num);
+    usleep(200000);
+    EXPECT_LT(LogSize(), 64 * 1024);
+    Verify(num);
+    CloseDB();
+    EXPECT_EQ(LogSize(), REDO_LOG_HEADER_SIZE);
+
+    OpenDB(0);
+    Verify(num);
+}
+
+TEST_F(RedoLogTest, async_writer_test)
+{
+    int num = 3000;
+    OpenDB(CONSTS::REDO_LOG | CONSTS::ASYNC_WRITER_MODE);
+    mbconf.options = CONSTS::ACCESS_MODE_READER | CONSTS::SHMQ_BLOCKING_MODE;
+    mbconf.queue_timeout = 5000;
+    DB* db_r = new DB(mbconf);
+    ASSERT_TRUE(db_r->is_open());
+
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_128);
+    std::string key;
+    for (int i = 0; i < num; i++) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db_r->Add(key, key), MBError::SUCCESS);
+    }
+    for (int i = 0; i < num; i += 3) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db_r->Remove(key), MBError::SUCCESS);
+    }
+    for (int i = 0; i < num; i += 5) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db_r->Add(key, key + "_new", true), MBError::SUCCESS);
+    }
+    while (db_r->AsyncWriterBusy())
+        usleep(1000);
+    // The queue is empty once the last update is taken by the writer, which
+    // may not have applied and logged it yet.
+    MBData mbd;
+    key = tkey.get_key((num - 1) / 5 * 5);
+    while (db_r->Find(key, mbd) != MBError::SUCCESS
+        || std::string((const char*)mbd.buff, mbd.data_len) != key + "_new")
+        usleep(1000);
+    db_r->Close();
+    delete db_r;
+
+    SaveLog();
+    EXPECT_GT(LogSize(), REDO_LOG_HEADER_SIZE);
+    CloseDB();
+
+    ClearDBAndRestoreLog();
+    OpenDB(CONSTS::REDO_LOG | CONSTS::ASYNC_WRITER_MODE);
+    // Replayed by the async writer thread at startup
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    db_r = new DB(mbconf);
+    while (db_r->Count() == 0)
+        usleep(1000);
+    db_r->Close();
+    delete db_r;
+    CloseDB();
+
+    OpenDB(0);
+    Verify(num);
+}
+
+
+TEST_F(RedoLogTest, ttl_test)
+{
+    OpenDB(CONSTS::REDO_LOG);
+    EXPECT_EQ(db->AddWithTTL("key1", 4, "value1", 6, 3600), MBError::SUCCESS);
+    EXPECT_EQ(db->Add("key2", "value2"), MBError::SUCCESS);
+    MBData mbd;
+    EXPECT_EQ(db->Find("key1", mbd), MBError::SUCCESS);
+    uint32_t expire_time = mbd.expire_time;
+    EXPECT_NE(expire_time, 0u);
+    SaveLog();
+    CloseDB();
+
+    // The expiry time is restored by the replay.
+    ClearDBAndRestoreLog();
+    OpenDB(CONSTS::REDO_LOG);
+    mbd.Clear();
+    EXPECT_EQ(db->Find("key1", mbd), MBError::SUCCESS);
+    EXPECT_EQ(std::string((const char*)mbd.buff, mbd.data_len), "value1");
+    EXPECT_EQ(mbd.expire_time, expire_time);
+    mbd.Clear();
+    EXPECT_EQ(db->Find("key2", mbd), MBError::SUCCESS);
+    EXPECT_EQ(mbd.expire_time, 0u);
+}
+
+}
@@ -19,8 +19,10 @@
 #include <iostream>
 #include <openssl/sha.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -304,4 +306,355 @@ TEST_F(ResourceCollectionTest, RC_delete_random_collect_index_data_add_test)
     delete[] exist;
 }
 
+TEST_F(ResourceCollectionTest, RC_resume_after_abnormal_exit_test)
+{
+    key_type = MABAIN_TEST_KEY_TYPE_SHA_128;
+    IndexHeader* header = db->GetDictPtr()->GetHeaderPtr();
+    long tot = 40000;
+    bool* exist = new bool[tot];
+    Populate(tot, exist);
+
+    // Stop the collection in each phase as if the writer exited.
+    uint32_t phases[] = { RESOURCE_COLLECTION_PHASE_REORDER, RESOURCE_COLLECTION_PHASE_COLLECT };
+    for (uint32_t phase : phases) {
+        DeleteRandom(tot / 4, exist);
+        size_t index_off = header->m_index_offset;
+        size_t data_off = header->m_data_offset;
+
+        ResourceCollection* rc = new ResourceCollection(*db);
+        rc->StartDefrag(1, 1, MAX_6B_OFFSET, MAX_6B_OFFSET, NULL);
+        while (header->rc_phase != phase)
+            ASSERT_FALSE(rc->RunDefragStep(1));
+        for (int i = 0; i < 10; i++)
+            ASSERT_FALSE(rc->RunDefragStep(1));
+        EXPECT_GT(header->rc_progress, 0);
+        delete rc;
+
+        ResourceCollection rc_recovery(*db);
+        EXPECT_EQ(rc_recovery.ExceptionRecovery(), MBError::SUCCESS);
+        EXPECT_EQ(header->rc_phase, 0u);
+        EXPECT_EQ(header->rc_m_index_off_pre, 0u);
+        EXPECT_LT(header->m_index_offset, index_off);
+        EXPECT_LT(header->m_data_offset, data_off);
+
+        long count = 0;
+        for (long i = 0; i < tot; i++) {
+            VerifyKeyValue(i, exist[i]);
+            if (exist[i])
+                count++;
+        }
+        EXPECT_EQ(db->Count(), count);
+    }
+
+    db->Close();
+    delete db;
+    db = new DB(DB_DIR, CONSTS::ACCESS_MODE_WRITER, 128ULL * 1024 * 1024, 128ULL * 1024 * 1024);
+    ASSERT_TRUE(db->is_open());
+    for (long i = 0; i < tot; i++)
+        VerifyKeyValue(i, exist[i]);
+    EXPECT_EQ(db->Add("resumed", "yes"), MBError::SUCCESS);
+
+    delete[] exist;
+}
+
+TEST_F(ResourceCollectionTest, RC_parallel_collect_test)
+{
+    key_type = MABAIN_TEST_KEY_TYPE_SHA_128;
+    IndexHeader* header = db->GetDictPtr()->GetHeaderPtr();
+    db->GetDictPtr()->SetDefragThreads(4);
+    long tot = 60000;
+    bool* exist = new bool[tot];
+    Populate(tot, exist);
+
+    DeleteRandom(tot / 2, exist);
+    size_t data_off = header->m_data_offset;
+    ResourceCollection rc(*db);
+    rc.ReclaimResource(1, 1, MAX_6B_OFFSET, MAX_6B_OFFSET);
+    EXPECT_LT(header->m_data_offset, data_off);
+    for (long i = 0; i < tot; i++)
+        VerifyKeyValue(i, exist[i]);
+
+    // Stop in the collect phase with data buffers pending in the copy pool.
+    DeleteRandom(tot / 8, exist);
+    ResourceCollection* rc_stopped = new ResourceCollection(*db);
+    rc_stopped->StartDefrag(1, 1, MAX_6B_OFFSET, MAX_6B_OFFSET, NULL);
+    while (header->rc_phase != RESOURCE_COLLECTION_PHASE_COLLECT)
+        ASSERT_FALSE(rc_stopped->RunDefragStep(1));
+    for (int i = 0; i < 20; i++)
+        ASSERT_FALSE(rc_stopped->RunDefragStep(1));
+    delete rc_stopped;
+
+    ResourceCollection rc_recovery(*db);
+    EXPECT_EQ(rc_recovery.ExceptionRecovery(), MBError::SUCCESS);
+    EXPECT_EQ(header->rc_phase, 0u);
+    for (long i = 0; i < tot; i++)
+        VerifyKeyValue(i, exist[i]);
+
+    db->Close();
+    delete db;
+    db = new DB(DB_DIR, CONSTS::ACCESS_MODE_WRITER, 128ULL * 1024 * 1024, 128ULL * 1024 * 1024);
+    ASSERT_TRUE(db->is_open());
+    for (long i = 0; i < tot; i++)
+        VerifyKeyValue(i, exist[i]);
+
+    delete[] exist;
+}
+
+class ResourceCollectionAsyncTest : public ::testing::Test {
+public:
+    ResourceCollectionAsyncTest()
+        : db_async(NULL)
+        , db(NULL)
+    {
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual void SetUp()
+    {
+        std::string cmd = std::string("mkdir -p ") + DB_DIR;
+        if (system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm ") + DB_DIR + "_*";
+        if (system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = DB_DIR;
+        mbconf.memcap_index = 64 * 1024 * 1024LL;
+        mbconf.memcap_data = 64 * 1024 * 1024LL;
+        mbconf.block_size_index = 8 * 1024 * 1024LL;
+        mbconf.block_size_data = 16 * 1024 * 1024LL;
+        mbconf.queue_timeout = 5000;
+    }
+    virtual void TearDown()
+    {
+        if (db != NULL) {
+            db->Close();
+            delete db;
+        }
+        if (db_async != NULL) {
+            db_async->Close();
+            delete db_async;
+        }
+        ResourcePool::getInstance().RemoveAll();
+    }
+
+    void OpenDB()
+    {
+        mbconf.options = CONSTS::ACCESS_MODE_WRITER | CONSTS::ASYNC_WRITER_MODE;
+        db_async = new DB(mbconf);
+        ASSERT_TRUE(db_async->is_open());
+        mbconf.options = CONSTS::ACCESS_MODE_READER | CONSTS::SHMQ_BLOCKING_MODE;
+        db = new DB(mbconf);
+        ASSERT_TRUE(db->is_open());
+    }
+
+    // DB::Add bypasses the queue when the async writer runs in the same
+    // process. Enqueue directly so that adds are run in order with removals.
+    int QueueAdd(const std::string& key)
+    {
+        return db_async->GetDictPtr()->SHMQ_Add(key.data(), key.size(), key.data(), key.size(),
+            false, mbconf.queue_timeout);
+    }
+
+    void Wait()
+    {
+        while (db->AsyncWriterBusy())
+            usleep(100);
+    }
+
+    void RemoveDuringCollection();
+
+protected:
+    MBConfig mbconf;
+    DB* db_async;
+    DB* db;
+};
+
+void ResourceCollectionAsyncTest::RemoveDuringCollection()
+{
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_128);
+    long tot = 40000;
+    long nadd = tot / 10;
+    std::vector<bool> exist(tot + nadd, false);
+    std::string key;
+
+    for (long i = 0; i < tot; i++) {
+        key = tkey.get_key(i);
+        ASSERT_EQ(db->Add(key, key), MBError::SUCCESS);
+        exist[i] = true;
+    }
+    // Create some garbage buffers so that collection is not skipped.
+    for (long i = 0; i < tot; i += 4) {
+        key = tkey.get_key(i);
+        ASSERT_EQ(db->Remove(key), MBError::SUCCESS);
+        exist[i] = false;
+    }
+    Wait();
+
+    // Updates queued behind the collection are run by the writer while the
+    // rc tree is in use. Removals hit both the main tree and the rc tree.
+    ASSERT_EQ(db->CollectResource(1, 1, 0xFFFFFFFFFFFF, 0xFFFFFFFFFFFF), MBError::SUCCESS);
+    for (long i = 1; i < tot; i += 4) {
+        key = tkey.get_key(i);
+        ASSERT_EQ(db->Remove(key), MBError::SUCCESS);
+        exist[i] = false;
+
+        long j = tot + i / 10;
+        if (!exist[j]) {
+            key = tkey.get_key(j);
+            ASSERT_EQ(QueueAdd(key), MBError::SUCCESS);
+            exist[j] = true;
+        }
+        if (j % 2 == 0 && j > tot && exist[j - 1]) {
+            // Remove a new entry added earlier
+            key = tkey.get_key(j - 1);
+            ASSERT_EQ(db->Remove(key), MBError::SUCCESS);
+            exist[j - 1] = false;
+        }
+        if (i % 40 == 1) {
+            // Removed and added back
+            key = tkey.get_key(i);
+            ASSERT_EQ(QueueAdd(key), MBError::SUCCESS);
+            exist[i] = true;
+        }
+    }
+    Wait();
+
+    MBData mbd;
+    long count = 0;
+    for (long i = 0; i < tot + nadd; i++) {
+        key = tkey.get_key(i);
+        int rval = db->Find(key, mbd);
+        if (exist[i]) {
+            EXPECT_EQ(rval, MBError::SUCCESS);
+            EXPECT_EQ(key, std::string((const char*)mbd.buff, mbd.data_len));
+            count++;
+        } else {
+            EXPECT_EQ(rval, MBError::NOT_EXIST);
+        }
+    }
+    EXPECT_EQ(db->Count(), count);
+}
+
+TEST_F(ResourceCollectionAsyncTest, RC_remove_during_collection_test)
+{
+    OpenDB();
+    RemoveDuringCollection();
+}
+
+TEST_F(ResourceCollectionAsyncTest, RC_incremental_collection_test)
+{
+    // Buffers are moved in steps of 200 microseconds between queued updates.
+    mbconf.defrag_step_time = 200;
+    OpenDB();
+    RemoveDuringCollection();
+
+    IndexHeader* header = db_async->GetDictPtr()->GetHeaderPtr();
+    EXPECT_EQ(header->rc_phase, 0u);
+    EXPECT_EQ(header->rc_root_offset, 0u);
+}
+
+TEST_F(ResourceCollectionAsyncTest, RC_parallel_incremental_collection_test)
+{
+    mbconf.defrag_step_time = 200;
+    mbconf.defrag_threads = 4;
+    OpenDB();
+    RemoveDuringCollection();
+    EXPECT_EQ(db_async->GetDictPtr()->GetHeaderPtr()->rc_phase, 0u);
+}
+
+TEST_F(ResourceCollectionAsyncTest, RC_incremental_pooled_collection_test)
+{
+    // Steps are run by the writer pool like queued updates.
+    mbconf.defrag_step_time = 200;
+    mbconf.writer_pool_size = 1;
+    OpenDB();
+    RemoveDuringCollection();
+    EXPECT_EQ(db_async->GetDictPtr()->GetHeaderPtr()->rc_phase, 0u);
+}
+
+TEST_F(ResourceCollectionAsyncTest, RC_tombstone_test)
+{
+    OpenDB();
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_128);
+    long tot = 4000;
+    std::vector<bool> exist(tot + 1, false);
+    std::string key;
+    for (long i = 0; i < tot; i++) {
+        key = tkey.get_key(i);
+        ASSERT_EQ(db->Add(key, key), MBError::SUCCESS);
+        exist[i] = true;
+    }
+    for (long i = 0; i < tot; i += 4) {
+        key = tkey.get_key(i);
+        ASSERT_EQ(db->Remove(key), MBError::SUCCESS);
+        exist[i] = false;
+    }
+    Wait();
+
+    // Start the collection as the async writer does and run updates in rc
+    // mode. The collection is then stopped as if the writer exited.
+    Dict* dict = db_async->GetDictPtr();
+    IndexHeader* header = dict->GetHeaderPtr();
+    ResourceCollection* rc = new ResourceCollection(*db_async);
+    rc->StartDefrag(1, 1, MAX_6B_OFFSET, MAX_6B_OFFSET,
+        AsyncWriter::GetInstance(db_async->GetDBDir()));
+    ASSERT_NE(header->rc_root_offset, 0u);
+    for (int i = 0; i < 10; i++)
+        ASSERT_FALSE(rc->RunDefragStep(1));
+
+    MBData mbd;
+    for (long i = 1; i < tot; i += 4) {
+        key = tkey.get_key(i);
+        mbd.options = CONSTS::OPTION_FIND_AND_STORE_PARENT | CONSTS::OPTION_RC_MODE;
+        ASSERT_EQ(dict->Remove((const uint8_t*)key.data(), key.size(), mbd), MBError::SUCCESS);
+        exist[i] = false;
+    }
+    mbd.options = CONSTS::OPTION_FIND_AND_STORE_PARENT | CONSTS::OPTION_RC_MODE;
+    EXPECT_EQ(dict->Remove((const uint8_t*)key.data(), key.size(), mbd), MBError::NOT_EXIST);
+    // Removed and added back, and added during the collection
+    for (long i : { 5L, tot }) {
+        key = tkey.get_key(i);
+        MBData value;
+        value.options = CONSTS::OPTION_RC_MODE;
+        value.buff = (uint8_t*)key.data();
+        value.data_len = key.size();
+        EXPECT_EQ(dict->Add((const uint8_t*)key.data(), key.size(), value, true), MBError::SUCCESS);
+        value.buff = NULL;
+        exist[i] = true;
+    }
+
+    // Removed entries are hidden from lookups and iterators at once.
+    mbd.options = 0;
+    long count = 0;
+    for (long i = 0; i <= tot; i++) {
+        key = tkey.get_key(i);
+        if (exist[i]) {
+            EXPECT_EQ(db->Find(key, mbd), MBError::SUCCESS);
+            EXPECT_EQ(key, std::string((const char*)mbd.buff, mbd.data_len));
+            count++;
+        } else {
+            EXPECT_EQ(db->Find(key, mbd), MBError::NOT_EXIST);
+            EXPECT_EQ(db->FindLongestPrefix(key, mbd), MBError::NOT_EXIST);
+        }
+    }
+    long iter_count = 0;
+    for (DB::iterator iter = db->begin(); iter != db->end(); ++iter) {
+        EXPECT_NE(iter.key, tkey.get_key(1));
+        iter_count++;
+    }
+    // The entry added during the collection is only in the rc tree.
+    EXPECT_EQ(iter_count, count - 1);
+    delete rc;
+
+    // The removals survive the exit of the writer.
+    ResourceCollection rc_recovery(*db_async);
+    EXPECT_EQ(rc_recovery.ExceptionRecovery(), MBError::SUCCESS);
+    EXPECT_EQ(header->rc_root_offset, 0u);
+    EXPECT_EQ(header->rc_phase, 0u);
+    for (long i = 0; i <= tot; i++) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db->Find(key, mbd), exist[i] ? MBError::SUCCESS : MBError::NOT_EXIST);
+    }
+    EXPECT_EQ(db->Count(), count);
+}
+
 }
@@ -0,0 +1,321 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <atomic>
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../dict.h"
+#include "../drm_base.h"
+#include "../resource_pool.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+namespace {
+
+#define MB_DIR "/var/tmp/mabain_test/"
+
+class ShmQueueTest : public ::testing::Test {
+public:
+    ShmQueueTest()
+    {
+        db = NULL;
+        db_r = NULL;
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~ShmQueueTest()
+    {
+    }
+    virtual void SetUp()
+    {
+        std::string cmd = std::string("mkdir -p ") + MB_DIR;
+        if (system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm ") + MB_DIR + "_*";
+        if (system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = MB_DIR;
+        mbconf.memcap_index = 64 * 1024 * 1024LL;
+        mbconf.memcap_data = 64 * 1024 * 1024LL;
+        mbconf.block_size_index = 8 * 1024 * 1024LL;
+        mbconf.block_size_data = 16 * 1024 * 1024LL;
+    }
+    virtual void TearDown()
+    {
+        if (db_r != NULL) {
+            db_r->Close();
+            delete db_r;
+            db_r = NULL;
+        }
+        if (db != NULL) {
+            db->Close();
+            delete db;
+            db = NULL;
+        }
+        ResourcePool::getInstance().RemoveAll();
+    }
+
+    void OpenDB(int writer_options, int reader_options, uint32_t qsize, uint32_t timeout)
+    {
+        mbconf.options = CONSTS::ACCESS_MODE_WRITER | writer_options;
+        mbconf.queue_size = qsize;
+        mbconf.queue_timeout = timeout;
+        db = new DB(mbconf);
+        ASSERT_TRUE(db->is_open());
+        header = db->GetDictPtr()->GetHeaderPtr();
+
+        mbconf.options = CONSTS::ACCESS_MODE_READER | reader_options;
+        db_r = new DB(mbconf);
+        ASSERT_TRUE(db_r->is_open());
+    }
+
+    bool WaitForQueue(int timeout_ms)
+    {
+        for (int i = 0; i < timeout_ms; i++) {
+            if (!db_r->AsyncWriterBusy())
+                return true;
+            usleep(1000);
+        }
+        return false;
+    }
+
+protected:
+    MBConfig mbconf;
+    DB* db;
+    DB* db_r;
+    IndexHeader* header;
+};
+
+TEST_F(ShmQueueTest, full_queue_no_wait)
+{
+    // No async writer is running. Nothing will be removed from the queue.
+    OpenDB(0, 0, 4, 0);
+
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+    std::string key;
+    for (int i = 0; i < 4; i++) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db_r->Add(key, key), MBError::SUCCESS);
+    }
+    key = tkey.get_key(4);
+    EXPECT_EQ(db_r->Add(key, key), MBError::TRY_AGAIN);
+    EXPECT_EQ(db_r->Remove(key), MBError::TRY_AGAIN);
+    // A failed enqueue must not consume a queue position.
+    EXPECT_EQ(header->queue_index.load(), 4u);
+    EXPECT_EQ(header->writer_index, 0u);
+    EXPECT_EQ(header->shmq_full_count.load(), 2u);
+    EXPECT_EQ(header->shmq_wait_count.load(), 0u);
+    EXPECT_EQ(header->shmq_timeout_count.load(), 0u);
+}
+
+TEST_F(ShmQueueTest, full_queue_timeout)
+{
+    OpenDB(0, 0, 2, 50);
+
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+    std::string key;
+    for (int i = 0; i < 2; i++) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(db_r->AddAsync(key.data(), key.size(), key.data(), key.size()), MBError::SUCCESS);
+    }
+
+    struct timeval start, stop;
+    key = tkey.get_key(2);
+    gettimeofday(&start, NULL);
+    EXPECT_EQ(db_r->AddAsync(key.data(), key.size(), key.data(), key.size()), MBError::TRY_AGAIN);
+    EXPECT_EQ(db_r->RemoveAsync(key.data(), key.size()), MBError::TRY_AGAIN);
+    gettimeofday(&stop, NULL);
+    int64_t elapsed = (stop.tv_sec - start.tv_sec) * 1000 + (stop.tv_usec - start.tv_usec) / 1000;
+    EXPECT_GE(elapsed, 90);
+    EXPECT_EQ(header->shmq_full_count.load(), 2u);
+    EXPECT_GE(header->shmq_wait_count.load(), 2u);
+    EXPECT_EQ(header->shmq_timeout_count.load(), 2u);
+    EXPECT_EQ(header->queue_index.load(), 2u);
+}
+
+TEST_F(ShmQueueTest, blocking_mode)
+{
+    OpenDB(0, CONSTS::SHMQ_BLOCKING_MODE, 1, 20);
+
+    std::string key = "blocking_mode_key";
+    EXPECT_EQ(db_r->Add(key, key), MBError::SUCCESS);
+    EXPECT_EQ(db_r->Add(key, key), MBError::TRY_AGAIN);
+    EXPECT_EQ(header->shmq_timeout_count.load(), 1u);
+}
+
+TEST_F(ShmQueueTest, blocked_producers)
+{
+    OpenDB(CONSTS::ASYNC_WRITER_MODE, 0, 2, 5000);
+    Dict* dict = db->GetDictPtr();
+
+    int nthread = 8;
+    int num = 500;
+    std::atomic<int> nfail(0);
+    std::vector<std::thread> producers;
+    for (int t = 0; t < nthread; t++) {
+        producers.push_back(std::thread([&, t]() {
+            TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+            for (int i = 0; i < num; i++) {
+                std::string key = tkey.get_key(t * num + i);
+                int rval = dict->SHMQ_Add(key.data(), key.size(), key.data(), key.size(),
+                    false, 5000);
+                if (rval != MBError::SUCCESS)
+                    nfail++;
+            }
+        }));
+    }
+    for (auto& th : producers)
+        th.join();
+
+    EXPECT_EQ(nfail.load(), 0);
+    EXPECT_TRUE(WaitForQueue(5000));
+    EXPECT_EQ(db->Count(), nthread * num);
+    EXPECT_EQ(header->queue_index.load(), static_cast<uint32_t>(nthread * num));
+    EXPECT_EQ(header->writer_index, static_cast<uint32_t>(nthread * num));
+    EXPECT_EQ(header->shmq_timeout_count.load(), 0u);
+
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+    MBData mbd;
+    for (int i = 0; i < nthread * num; i++) {
+        std::string key = tkey.get_key(i);
+        EXPECT_EQ(db_r->Find(key, mbd), MBError::SUCCESS);
+        EXPECT_EQ(std::string((const char*)mbd.buff, mbd.data_len), key);
+    }
+}
+
+TEST_F(ShmQueueTest, stalled_slot)
+{
+    OpenDB(CONSTS::ASYNC_WRITER_MODE, 0, 4, 0);
+    Dict* dict = db->GetDictPtr();
+
+    // Simulate a producer that claimed a slot and exited without publishing.
+    header->queue_index.fetch_add(1);
+
+    std::string key = "stalled_slot_key";
+    EXPECT_EQ(dict->SHMQ_Add(key.data(), key.size(), key.data(), key.size(), false),
+        MBError::SUCCESS);
+    EXPECT_TRUE(WaitForQueue(MB_ASYNC_SHM_STALL_TMOUT * 4));
+    EXPECT_EQ(header->writer_index, 2u);
+
+    MBData mbd;
+    EXPECT_EQ(db_r->Find(key, mbd), MBError::SUCCESS);
+
+    // The skipped slot is not reused until its producer releases it.
+    AsyncNode* queue = dict->GetAsyncQueuePtr();
+    EXPECT_EQ(queue[0].seq.load(), MB_ASYNC_SHM_SEQ_SKIPPED(0));
+    for (int i = 2; i < 4; i++) {
+        key = "key" + std::to_string(i);
+        EXPECT_EQ(dict->SHMQ_Add(key.data(), key.size(), key.data(), key.size(), false),
+            MBError::SUCCESS);
+    }
+    EXPECT_TRUE(WaitForQueue(MB_ASYNC_SHM_STALL_TMOUT));
+    key = "key4";
+    EXPECT_EQ(dict->SHMQ_Add(key.data(), key.size(), key.data(), key.size(), false),
+        MBError::TRY_AGAIN);
+    EXPECT_EQ(header->queue_index.load(), 4u);
+
+    // The slot is released when the writer opens the DB again.
+    db_r->Close();
+    delete db_r;
+    db_r = NULL;
+    db->Close();
+    delete db;
+    db = NULL;
+    ResourcePool::getInstance().RemoveAll();
+    OpenDB(CONSTS::ASYNC_WRITER_MODE, 0, 4, 0);
+    dict = db->GetDictPtr();
+    EXPECT_EQ(dict->SHMQ_Add(key.data(), key.size(), key.data(), key.size(), false),
+        MBError::SUCCESS);
+    EXPECT_TRUE(WaitForQueue(MB_ASYNC_SHM_STALL_TMOUT));
+    EXPECT_EQ(db_r->Find(key, mbd), MBError::SUCCESS);
+}
+
+TEST_F(ShmQueueTest, killed_producer)
+{
+    OpenDB(CONSTS::ASYNC_WRITER_MODE, 0, 4, 0);
+    Dict* dict = db->GetDictPtr();
+    AsyncNode* queue = dict->GetAsyncQueuePtr();
+
+    // The child claims the first slot with its producer token and is killed
+    // before publishing the update.
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        close(fds[0]);
+        ShmQueueProducer producer(ShmQueueMgr::GetFilePath(header->shm_queue_id, NULL), false);
+        uint32_t pos = header->queue_index.fetch_add(1);
+        queue[pos % 4].producer.store(producer.GetToken());
+        char c = (producer.GetToken() != 0) ? 'y' : 'n';
+        if (write(fds[1], &c, 1) != 1)
+            _exit(1);
+        pause();
+        _exit(0);
+    }
+    close(fds[1]);
+    char c = 0;
+    EXPECT_EQ(read(fds[0], &c, 1), 1);
+    close(fds[0]);
+    EXPECT_EQ(c, 'y');
+
+    std::string key = "key1";
+    EXPECT_EQ(dict->SHMQ_Add(key.data(), key.size(), key.data(), key.size(), false),
+        MBError::SUCCESS);
+    EXPECT_TRUE(WaitForQueue(MB_ASYNC_SHM_STALL_TMOUT * 4));
+    EXPECT_EQ(queue[0].seq.load(), MB_ASYNC_SHM_SEQ_SKIPPED(0));
+
+    // The slot is kept while the producer is running.
+    for (int i = 2; i < 4; i++) {
+        key = "key" + std::to_string(i);
+        EXPECT_EQ(dict->SHMQ_Add(key.data(), key.size(), key.data(), key.size(), false),
+            MBError::SUCCESS);
+    }
+    EXPECT_TRUE(WaitForQueue(MB_ASYNC_SHM_STALL_TMOUT));
+    usleep(MB_ASYNC_SHM_STALL_TMOUT * 2 * 1000);
+    EXPECT_EQ(queue[0].seq.load(), MB_ASYNC_SHM_SEQ_SKIPPED(0));
+
+    // The writer releases the slot once the producer is gone. More updates
+    // than the queue size go through without opening the writer again.
+    kill(pid, SIGKILL);
+    int status;
+    EXPECT_EQ(waitpid(pid, &status, 0), pid);
+    for (int i = 4; i < 12; i++) {
+        key = "key" + std::to_string(i);
+        EXPECT_EQ(dict->SHMQ_Add(key.data(), key.size(), key.data(), key.size(), false,
+                      MB_ASYNC_SHM_STALL_TMOUT * 4),
+            MBError::SUCCESS);
+    }
+    EXPECT_TRUE(WaitForQueue(MB_ASYNC_SHM_STALL_TMOUT * 4));
+    MBData mbd;
+    for (int i = 1; i < 12; i++) {
+        key = "key" + std::to_string(i);
+        EXPECT_EQ(db_r->Find(key, mbd), MBError::SUCCESS);
+    }
+}
+
+}
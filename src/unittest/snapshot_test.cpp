@@ -0,0 +1,229 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../dict.h"
+#include "../resource_pool.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+namespace {
+
+#define SNAPSHOT_TEST_DB "test_snapshot"
+#define SNAPSHOT_TEST_DIR "/var/tmp/mabain_test/snapshot"
+
+class SnapshotTest : public ::testing::Test {
+public:
+    SnapshotTest()
+    {
+        db = NULL;
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~SnapshotTest()
+    {
+    }
+    virtual void SetUp()
+    {
+        std::string cmd = std::string("rm -rf ") + SNAPSHOT_TEST_DIR;
+        if (system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = SNAPSHOT_TEST_DB;
+        mbconf.options = CONSTS::WriterOptions() | CONSTS::MEMORY_ONLY_MODE;
+        mbconf.memcap_index = 64 * 1024 * 1024LL;
+        mbconf.memcap_data = 64 * 1024 * 1024LL;
+        mbconf.block_size_index = 4 * 1024 * 1024;
+        mbconf.block_size_data = 4 * 1024 * 1024;
+    }
+    virtual void TearDown()
+    {
+        Restart();
+    }
+
+    // Drop the memory-only DB as if the process was restarted.
+    void Restart()
+    {
+        if (db != NULL) {
+            db->Close();
+            delete db;
+            db = NULL;
+        }
+        ResourcePool::getInstance().RemoveAll();
+    }
+
+    void Open(const char* snapshot_dir)
+    {
+        mbconf.snapshot_dir = snapshot_dir;
+        mbconf.snapshot_threads = 4;
+        db = new DB(mbconf);
+    }
+
+    void Populate(int start, int end)
+    {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+        for (int i = start; i < end; i++) {
+            std::string key = tkey.get_key(i);
+            ASSERT_EQ(db->Add(key, key + key), MBError::SUCCESS);
+        }
+    }
+
+    void Check(int start, int end, int step)
+    {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+        MBData mbd;
+        for (int i = start; i < end; i++) {
+            std::string key = tkey.get_key(i);
+            int rval = db->Find(key, mbd);
+            if (i % step != 0) {
+                EXPECT_EQ(rval, MBError::NOT_EXIST);
+                continue;
+            }
+            ASSERT_EQ(rval, MBError::SUCCESS);
+            EXPECT_EQ(std::string((const char*)mbd.buff, mbd.data_len), key + key);
+        }
+    }
+
+protected:
+    MBConfig mbconf;
+    DB* db;
+};
+
+TEST_F(SnapshotTest, dump_and_load)
+{
+    Open(NULL);
+    ASSERT_TRUE(db->is_open());
+    Populate(0, 100000);
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+    for (int i = 0; i < 100000; i++) {
+        if (i % 3 != 0) {
+            EXPECT_EQ(db->Remove(tkey.get_key(i)), MBError::SUCCESS);
+        }
+    }
+    IndexHeader* header = db->GetDictPtr()->GetHeaderPtr();
+    size_t index_size = header->m_index_offset;
+    size_t data_size = header->m_data_offset;
+    int64_t count = db->Count();
+    int64_t num_free_index = db->GetDictPtr()->GetMM()->GetFreeList()->Count();
+    int64_t num_free_data = db->GetDictPtr()->GetFreeList()->Count();
+    EXPECT_GT(index_size, (size_t)mbconf.block_size_index);
+    EXPECT_GT(num_free_data, 0);
+    ASSERT_EQ(db->DumpSnapshot(SNAPSHOT_TEST_DIR, 4), MBError::SUCCESS);
+
+    Restart();
+    Open(SNAPSHOT_TEST_DIR);
+    ASSERT_TRUE(db->is_open());
+    header = db->GetDictPtr()->GetHeaderPtr();
+    EXPECT_EQ(header->m_index_offset, index_size);
+    EXPECT_EQ(header->m_data_offset, data_size);
+    EXPECT_EQ(header->num_writer, 1);
+    EXPECT_EQ(db->Count(), count);
+    EXPECT_EQ(db->GetDictPtr()->GetMM()->GetFreeList()->Count(), num_free_index);
+    EXPECT_EQ(db->GetDictPtr()->GetFreeList()->Count(), num_free_data);
+    Check(0, 100000, 3);
+
+    // The freed buffers are reused after the DB is loaded.
+    Populate(100000, 120000);
+    EXPECT_LT(db->GetDictPtr()->GetFreeList()->Count(), num_free_data);
+    Check(0, 100000, 3);
+    Check(100000, 120000, 1);
+
+    // A second snapshot replaces the first one.
+    ASSERT_EQ(db->DumpSnapshot(SNAPSHOT_TEST_DIR, 1), MBError::SUCCESS);
+    Restart();
+    Open(SNAPSHOT_TEST_DIR);
+    ASSERT_TRUE(db->is_open());
+    EXPECT_EQ(db->Count(), count + 20000);
+    Check(0, 100000, 3);
+    Check(100000, 120000, 1);
+}
+
+TEST_F(SnapshotTest, no_snapshot)
+{
+    Open(SNAPSHOT_TEST_DIR);
+    ASSERT_TRUE(db->is_open());
+    EXPECT_EQ(db->Count(), 0);
+    Populate(0, 1000);
+    Check(0, 1000, 1);
+}
+
+TEST_F(SnapshotTest, incomplete_snapshot)
+{
+    Open(NULL);
+    ASSERT_TRUE(db->is_open());
+    Populate(0, 50000);
+    ASSERT_EQ(db->DumpSnapshot(SNAPSHOT_TEST_DIR), MBError::SUCCESS);
+
+    // A snapshot without the header is not loaded.
+    std::string header_path = std::string(SNAPSHOT_TEST_DIR) + "/_mabain_h";
+    std::string tmp_path = header_path + ".tmp";
+    ASSERT_EQ(rename(header_path.c_str(), tmp_path.c_str()), 0);
+    Restart();
+    Open(SNAPSHOT_TEST_DIR);
+    ASSERT_TRUE(db->is_open());
+    EXPECT_EQ(db->Count(), 0);
+
+    // The data blocks are shorter than the header says.
+    Restart();
+    ASSERT_EQ(rename(tmp_path.c_str(), header_path.c_str()), 0);
+    std::string data_path = std::string(SNAPSHOT_TEST_DIR) + "/_mabain_d0";
+    ASSERT_EQ(truncate(data_path.c_str(), 4096), 0);
+    Open(SNAPSHOT_TEST_DIR);
+    EXPECT_FALSE(db->is_open());
+
+    // The snapshot must fit in the memcaps.
+    Restart();
+    Open(NULL);
+    Populate(0, 50000);
+    ASSERT_EQ(db->DumpSnapshot(SNAPSHOT_TEST_DIR), MBError::SUCCESS);
+    Restart();
+    mbconf.memcap_data = mbconf.block_size_data;
+    Open(SNAPSHOT_TEST_DIR);
+    EXPECT_EQ(db->Status(), MBError::NO_MEMORY);
+}
+
+TEST_F(SnapshotTest, not_allowed)
+{
+    Open(NULL);
+    ASSERT_TRUE(db->is_open());
+    Populate(0, 1000);
+    ASSERT_EQ(db->DumpSnapshot(SNAPSHOT_TEST_DIR), MBError::SUCCESS);
+
+    MBConfig conf = mbconf;
+    conf.options = CONSTS::ReaderOptions() | CONSTS::MEMORY_ONLY_MODE;
+    conf.snapshot_dir = NULL;
+    DB db_r(conf);
+    ASSERT_TRUE(db_r.is_open());
+    EXPECT_EQ(db_r.DumpSnapshot(SNAPSHOT_TEST_DIR), MBError::NOT_ALLOWED);
+    db_r.Close();
+
+    // DBs on disk are not dumped.
+    std::string cmd = std::string("mkdir -p /var/tmp/mabain_test && rm -f /var/tmp/mabain_test/_*");
+    if (system(cmd.c_str()) != 0) {
+    }
+    DB db_disk("/var/tmp/mabain_test", CONSTS::WriterOptions());
+    ASSERT_TRUE(db_disk.is_open());
+    EXPECT_EQ(db_disk.DumpSnapshot(SNAPSHOT_TEST_DIR), MBError::NOT_ALLOWED);
+    db_disk.Close();
+}
+
+}
@@ -0,0 +1,195 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <dirent.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../dict.h"
+#include "../resource_pool.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+namespace {
+
+#define SPILL_TEST_DB "test_spill"
+#define SPILL_TEST_DIR "/var/tmp/mabain_test/spill"
+#define SPILL_TEST_VALUE_SIZE 1000
+
+class SpillTest : public ::testing::Test {
+public:
+    SpillTest()
+    {
+        db = NULL;
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~SpillTest()
+    {
+    }
+    virtual void SetUp()
+    {
+        std::string cmd = std::string("rm -rf ") + SPILL_TEST_DIR + " && mkdir -p " + SPILL_TEST_DIR;
+        if (system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = SPILL_TEST_DB;
+        mbconf.options = CONSTS::WriterOptions() | CONSTS::MEMORY_ONLY_MODE;
+        mbconf.memcap_index = 64 * 1024 * 1024LL;
+        mbconf.memcap_data = 3 * 4 * 1024 * 1024LL;
+        mbconf.block_size_index = 4 * 1024 * 1024;
+        mbconf.block_size_data = 4 * 1024 * 1024;
+    }
+    virtual void TearDown()
+    {
+        if (db != NULL) {
+            db->Close();
+            delete db;
+            db = NULL;
+        }
+        ResourcePool::getInstance().RemoveAll();
+    }
+
+    void Open(const char* spill_dir)
+    {
+        mbconf.spill_dir = spill_dir;
+        db = new DB(mbconf);
+    }
+
+    int Populate(int start, int end)
+    {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+        std::string value(SPILL_TEST_VALUE_SIZE, 'v');
+        for (int i = start; i < end; i++) {
+            int rval = db->Add(tkey.get_key(i), value + std::to_string(i));
+            if (rval != MBError::SUCCESS)
+                return rval;
+        }
+        return MBError::SUCCESS;
+    }
+
+    void Check(DB* handle, int start, int end)
+    {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+        std::string value(SPILL_TEST_VALUE_SIZE, 'v');
+        MBData mbd;
+        for (int i = start; i < end; i++) {
+            ASSERT_EQ(handle->Find(tkey.get_key(i), mbd), MBError::SUCCESS);
+            EXPECT_EQ(std::string((const char*)mbd.buff, mbd.data_len), value + std::to_string(i));
+        }
+    }
+
+    bool InMemory(int block_order)
+    {
+        std::string fpath = std::string(SPILL_TEST_DB) + "/_mabain_d" + std::to_string(block_order);
+        MmapFileIO* file = ResourcePool::getInstance().GetResourceByPath(fpath);
+        return file != NULL && file->IsAnonymous();
+    }
+
+protected:
+    MBConfig mbconf;
+    DB* db;
+};
+
+TEST_F(SpillTest, no_spill_dir)
+{
+    Open(NULL);
+    ASSERT_TRUE(db->is_open());
+    // The writer throws if a new block cannot be mapped.
+    int rval;
+    try {
+        rval = Populate(0, 20000);
+    } catch (int error) {
+        rval = error;
+    }
+    EXPECT_EQ(rval, MBError::NO_MEMORY);
+}
+
+TEST_F(SpillTest, insert_past_memcap)
+{
+    Open(SPILL_TEST_DIR);
+    ASSERT_TRUE(db->is_open());
+    ASSERT_EQ(Populate(0, 30000), MBError::SUCCESS);
+    EXPECT_EQ(db->Count(), 30000);
+    RollableFile* data_file = db->GetDictPtr()->GetRollableFile();
+    EXPECT_GT(data_file->GetNumSpilled(), 0u);
+    Check(db, 0, 30000);
+
+    // Readers share the spilled blocks.
+    MBConfig conf = mbconf;
+    conf.options = CONSTS::ReaderOptions() | CONSTS::MEMORY_ONLY_MODE;
+    conf.spill_dir = NULL;
+    DB db_r(conf);
+    ASSERT_TRUE(db_r.is_open());
+    Check(&db_r, 0, 30000);
+    db_r.Close();
+
+    // The spilled blocks are unlinked files.
+    DIR* dir = opendir(SPILL_TEST_DIR);
+    ASSERT_TRUE(dir != NULL);
+    int num_files = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] != '.')
+            num_files++;
+    }
+    closedir(dir);
+    EXPECT_EQ(num_files, 0);
+
+    // Removed buffers in the spilled blocks are reused.
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+    for (int i = 0; i < 30000; i += 2)
+        EXPECT_EQ(db->Remove(tkey.get_key(i)), MBError::SUCCESS);
+    size_t data_offset = db->GetDictPtr()->GetHeaderPtr()->m_data_offset;
+    std::string value(SPILL_TEST_VALUE_SIZE, 'v');
+    for (int i = 0; i < 10000; i += 2)
+        ASSERT_EQ(db->Add(tkey.get_key(i), value + std::to_string(i)), MBError::SUCCESS);
+    EXPECT_EQ(db->GetDictPtr()->GetHeaderPtr()->m_data_offset, data_offset);
+    Check(db, 0, 10000);
+}
+
+TEST_F(SpillTest, cold_blocks_demoted)
+{
+    Open(SPILL_TEST_DIR);
+    ASSERT_TRUE(db->is_open());
+    ASSERT_EQ(Populate(0, 2000), MBError::SUCCESS);
+    MBConfig conf = mbconf;
+    conf.options = CONSTS::ReaderOptions() | CONSTS::MEMORY_ONLY_MODE;
+    conf.spill_dir = NULL;
+    DB db_r(conf);
+    ASSERT_TRUE(db_r.is_open());
+    for (int i = 0; i < 20; i++)
+        Check(&db_r, 0, 2000);
+
+    ASSERT_EQ(Populate(2000, 40000), MBError::SUCCESS);
+    RollableFile* data_file = db->GetDictPtr()->GetRollableFile();
+    size_t num_block = db->GetDictPtr()->GetHeaderPtr()->m_data_offset / mbconf.block_size_data + 1;
+    EXPECT_GT(num_block, 6u);
+    EXPECT_EQ(data_file->GetNumSpilled(), num_block - 3);
+    // The block of the keys looked up and the blocks written last are kept.
+    EXPECT_TRUE(InMemory(0));
+    EXPECT_FALSE(InMemory(1));
+    EXPECT_TRUE(InMemory(num_block - 2));
+    EXPECT_TRUE(InMemory(num_block - 1));
+    Check(&db_r, 0, 40000);
+    db_r.Close();
+}
+
+}
@@ -0,0 +1,309 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../dict.h"
+#include "../drm_base.h"
+#include "../resource_pool.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+namespace {
+
+#define MB_DIR "/var/tmp/mabain_test/"
+
+class TTLTest : public ::testing::Test {
+public:
+    TTLTest()
+    {
+        db = NULL;
+        db_r = NULL;
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~TTLTest()
+    {
+    }
+    virtual void SetUp()
+    {
+        std::string cmd = std::string("mkdir -p ") + MB_DIR;
+        if (system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -f ") + MB_DIR + "_*";
+        if (system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = MB_DIR;
+        mbconf.memcap_index = 64 * 1024 * 1024LL;
+        mbconf.memcap_data = 64 * 1024 * 1024LL;
+        mbconf.block_size_index = 8 * 1024 * 1024LL;
+        mbconf.block_size_data = 16 * 1024 * 1024LL;
+    }
+    virtual void TearDown()
+    {
+        CloseDB();
+        ResourcePool::getInstance().RemoveAll();
+    }
+
+    void OpenDB(int writer_options)
+    {
+        mbconf.options = CONSTS::ACCESS_MODE_WRITER | writer_options;
+        db = new DB(mbconf);
+        ASSERT_TRUE(db->is_open());
+        if (writer_options & CONSTS::ASYNC_WRITER_MODE) {
+            mbconf.options = CONSTS::ACCESS_MODE_READER;
+            db_r = new DB(mbconf);
+            ASSERT_TRUE(db_r->is_open());
+        }
+    }
+
+    void CloseDB()
+    {
+        if (db_r != NULL) {
+            db_r->Close();
+            delete db_r;
+            db_r = NULL;
+        }
+        if (db != NULL) {
+            db->Close();
+            delete db;
+            db = NULL;
+        }
+    }
+
+    // Add an entry with the given expiry time so that tests do not need to
+    // wait for it to expire.
+    int AddExpireAt(DB* dbh, const std::string& key, const std::string& value,
+        uint32_t expire_time, bool overwrite = false)
+    {
+        MBData mbd;
+        mbd.buff = (uint8_t*)value.data();
+        mbd.data_len = value.size();
+        mbd.expire_time = expire_time;
+        int rval = dbh->Add(key.data(), key.size(), mbd, overwrite);
+        mbd.buff = NULL;
+        return rval;
+    }
+
+    uint32_t Now() const
+    {
+        return static_cast<uint32_t>(time(NULL));
+    }
+
+protected:
+    MBConfig mbconf;
+    DB* db;
+    DB* db_r;
+};
+
+TEST_F(TTLTest, find_and_lazy_expiry)
+{
+    OpenDB(0);
+    MBData mbd;
+    EXPECT_EQ(db->AddWithTTL("live", 4, "value1", 6, 3600), MBError::SUCCESS);
+    EXPECT_EQ(db->Add("plain", "value2"), MBError::SUCCESS);
+    EXPECT_EQ(AddExpireAt(db, "dead", "value3", Now() - 1), MBError::SUCCESS);
+
+    EXPECT_EQ(db->Find("live", mbd), MBError::SUCCESS);
+    EXPECT_EQ(std::string((const char*)mbd.buff, mbd.data_len), "value1");
+    EXPECT_GE(mbd.expire_time, Now() + 3599);
+    mbd.Clear();
+    EXPECT_EQ(db->Find("plain", mbd), MBError::SUCCESS);
+    EXPECT_EQ(std::string((const char*)mbd.buff, mbd.data_len), "value2");
+    EXPECT_EQ(mbd.expire_time, 0u);
+    mbd.Clear();
+    EXPECT_EQ(db->Find("dead", mbd), MBError::NOT_EXIST);
+
+    // An expired entry does not block an add without overwrite.
+    EXPECT_EQ(db->Add("dead", "value4"), MBError::SUCCESS);
+    mbd.Clear();
+    EXPECT_EQ(db->Find("dead", mbd), MBError::SUCCESS);
+    EXPECT_EQ(std::string((const char*)mbd.buff, mbd.data_len), "value4");
+    EXPECT_EQ(mbd.expire_time, 0u);
+    EXPECT_EQ(db->Count(), 3);
+}
+
+TEST_F(TTLTest, data_header_size)
+{
+    OpenDB(0);
+    MBData mbd;
+    EXPECT_EQ(AddExpireAt(db, "live", "value1", Now() + 3600), MBError::SUCCESS);
+    EXPECT_EQ(db->Add("plain", "value2"), MBError::SUCCESS);
+
+    EXPECT_EQ(db->Find("live", mbd), MBError::SUCCESS);
+    EXPECT_EQ(DB::GetDataHeaderSize(mbd), DB::GetDataHeaderSize() + DATA_TTL_BYTE);
+    const uint8_t* ptr = db->GetDataPtrByOffset(mbd.data_offset + DB::GetDataHeaderSize(mbd));
+    ASSERT_TRUE(ptr != nullptr);
+    EXPECT_EQ(memcmp(ptr, "value1", 6), 0);
+    mbd.Clear();
+    EXPECT_EQ(db->Find("plain", mbd), MBError::SUCCESS);
+    EXPECT_EQ(DB::GetDataHeaderSize(mbd), DB::GetDataHeaderSize());
+    ptr = db->GetDataPtrByOffset(mbd.data_offset + DB::GetDataHeaderSize(mbd));
+    ASSERT_TRUE(ptr != nullptr);
+    EXPECT_EQ(memcmp(ptr, "value2", 6), 0);
+}
+
+TEST_F(TTLTest, short_ttl)
+{
+    OpenDB(0);
+    MBData mbd;
+    EXPECT_EQ(db->AddWithTTL("key", 3, "value", 5, 1), MBError::SUCCESS);
+    EXPECT_EQ(db->Find("key", mbd), MBError::SUCCESS);
+    sleep(2);
+    mbd.Clear();
+    EXPECT_EQ(db->Find("key", mbd), MBError::NOT_EXIST);
+    EXPECT_EQ(db->RemoveExpired(), 1);
+    EXPECT_EQ(db->Count(), 0);
+}
+
+TEST_F(TTLTest, remove_expired)
+{
+    OpenDB(0);
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+    int num = 1000;
+    for (int i = 0; i < num; i++) {
+        uint32_t expire_time = (i % 2 == 0) ? Now() - 10 : Now() + 3600;
+        EXPECT_EQ(AddExpireAt(db, tkey.get_key(i), "value", expire_time), MBError::SUCCESS);
+    }
+    // Entries updated after being added to the expiry log are not removed.
+    EXPECT_EQ(db->Add(tkey.get_key(0), "updated", true), MBError::SUCCESS);
+    EXPECT_EQ(db->Remove(tkey.get_key(2)), MBError::SUCCESS);
+    EXPECT_EQ(db->Count(), num - 1);
+
+    // The sweep is incremental.
+    EXPECT_EQ(db->RemoveExpired(100), 98);
+    int removed = 98;
+    int rval;
+    while ((rval = db->RemoveExpired()) > 0)
+        removed += rval;
+    EXPECT_EQ(removed, num / 2 - 2);
+    EXPECT_EQ(db->Count(), num / 2 + 1);
+
+    MBData mbd;
+    EXPECT_EQ(db->Find(tkey.get_key(0), mbd), MBError::SUCCESS);
+    for (int i = 1; i < num; i++) {
+        mbd.Clear();
+        EXPECT_EQ(db->Find(tkey.get_key(i), mbd),
+            (i % 2 == 0) ? MBError::NOT_EXIST : MBError::SUCCESS);
+    }
+}
+
+TEST_F(TTLTest, async_sweeper)
+{
+    OpenDB(CONSTS::ASYNC_WRITER_MODE);
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+    int num = 500;
+    // The writer does not remove expired entries itself in async mode.
+    EXPECT_EQ(db->RemoveExpired(), 0);
+    for (int i = 0; i < num; i++) {
+        uint32_t expire_time = (i < num / 2) ? Now() - 1 : 0;
+        EXPECT_EQ(AddExpireAt(db_r, tkey.get_key(i), "value", expire_time), MBError::SUCCESS);
+    }
+    int64_t count = -1;
+    for (int i = 0; i < 5000; i++) {
+        count = db_r->Count();
+        if (count == num / 2)
+            break;
+        usleep(1000);
+    }
+    EXPECT_EQ(count, num / 2);
+}
+
+TEST_F(TTLTest, log_kept_on_open)
+{
+    OpenDB(0);
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+    int num = 200;
+    for (int i = 0; i < num; i++) {
+        uint32_t expire_time = (i < num / 2) ? Now() - 1 : Now() + 3600;
+        EXPECT_EQ(AddExpireAt(db, tkey.get_key(i), "value", expire_time), MBError::SUCCESS);
+    }
+    CloseDB();
+
+    // The expiry log is used without reading the DB when the writer opens it.
+    OpenDB(0);
+    IndexHeader* header = db->GetDictPtr()->GetHeaderPtr();
+    EXPECT_EQ(header->expiry_log_state, (uint32_t)EXPIRY_LOG_ACTIVE);
+    EXPECT_EQ(db->Count(), num);
+    EXPECT_EQ(db->RemoveExpired(num), num / 2);
+    EXPECT_EQ(db->Count(), num / 2);
+}
+
+TEST_F(TTLTest, rebuild_on_open)
+{
+    OpenDB(0);
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+    int num = 200;
+    for (int i = 0; i < num; i++) {
+        uint32_t expire_time = (i < num / 2) ? Now() - 1 : Now() + 3600;
+        EXPECT_EQ(AddExpireAt(db, tkey.get_key(i), "value", expire_time), MBError::SUCCESS);
+    }
+    CloseDB();
+
+    // The expiry log is rebuilt if it was not maintained.
+    std::string cmd = std::string("rm -f ") + MB_DIR + EXPIRY_LOG_FILE;
+    if (system(cmd.c_str()) != 0) {
+    }
+    OpenDB(0);
+    EXPECT_EQ(db->Count(), num);
+    EXPECT_EQ(db->RemoveExpired(num), num / 2);
+    EXPECT_EQ(db->Count(), num / 2);
+}
+
+TEST_F(TTLTest, far_expiry)
+{
+    OpenDB(0);
+    // Kept in the last bucket of the log and moved when the bucket is due
+    EXPECT_EQ(AddExpireAt(db, "far", "value", Now() + 3 * EXPIRY_NUM_BUCKET), MBError::SUCCESS);
+    EXPECT_EQ(AddExpireAt(db, "near", "value", Now() - 1), MBError::SUCCESS);
+    EXPECT_EQ(db->RemoveExpired(), 1);
+    MBData mbd;
+    EXPECT_EQ(db->Find("far", mbd), MBError::SUCCESS);
+    EXPECT_EQ(db->Count(), 1);
+}
+
+TEST_F(TTLTest, iterator_skips_expired)
+{
+    OpenDB(0);
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+    int num = 100;
+    for (int i = 0; i < num; i++) {
+        uint32_t expire_time = (i % 2 == 0) ? Now() - 1 : 0;
+        EXPECT_EQ(AddExpireAt(db, tkey.get_key(i), "value", expire_time), MBError::SUCCESS);
+    }
+
+    int count = 0;
+    for (DB::iterator iter = db->begin(); iter != db->end(); ++iter) {
+        EXPECT_EQ(iter.value.expire_time, 0u);
+        count++;
+    }
+    EXPECT_EQ(count, num / 2);
+
+    // Internal passes can still see them.
+    count = 0;
+    for (DB::iterator iter = db->begin(false, false, true); iter != db->end(); ++iter)
+        count++;
+    EXPECT_EQ(count, num);
+}
+
+}
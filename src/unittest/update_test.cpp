@@ -1,11 +1,16 @@
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
 #include <list>
+#include <pthread.h>
 #include <stdlib.h>
+#include <thread>
 #include <unistd.h>
 
 #include <gtest/gtest.h>
 
 #include "../db.h"
+#include "../dict.h"
 #include "../mb_data.h"
 #include "../resource_pool.h"
 #include "./test_key.h"
@@ -165,4 +170,151 @@ TEST_F(UpdateTest, Update_random)
     delete[] added;
 }
 
+TEST_F(UpdateTest, Update_in_place)
+{
+    IndexHeader* header = db->GetDictPtr()->GetHeaderPtr();
+    MBData mbd;
+    // "key" is stored in a node since "key1" shares its prefix.
+    std::string keys[] = { "key", "key1", "key2" };
+    for (const std::string& key : keys)
+        EXPECT_EQ(db->Add(key, "value_00"), MBError::SUCCESS);
+
+    for (const std::string& key : keys) {
+        EXPECT_EQ(db->Find(key, mbd), MBError::SUCCESS);
+        size_t data_offset = mbd.data_offset;
+        int64_t pending = header->pending_data_buff_size;
+        uint64_t num_inplace = header->num_inplace_update;
+
+        // Same size class: the buffer is updated in place.
+        EXPECT_EQ(db->Add(key, "value_01", true), MBError::SUCCESS);
+        EXPECT_EQ(db->Find(key, mbd), MBError::SUCCESS);
+        EXPECT_EQ(std::string((const char*)mbd.buff, mbd.data_len), "value_01");
+        EXPECT_EQ(mbd.data_offset, data_offset);
+        EXPECT_EQ(header->pending_data_buff_size, pending);
+        EXPECT_EQ(header->num_inplace_update, num_inplace + 1);
+
+        // A larger value needs a new buffer.
+        std::string large(200, 'x');
+        EXPECT_EQ(db->Add(key, large, true), MBError::SUCCESS);
+        EXPECT_EQ(db->Find(key, mbd), MBError::SUCCESS);
+        EXPECT_EQ(std::string((const char*)mbd.buff, mbd.data_len), large);
+        EXPECT_NE(mbd.data_offset, data_offset);
+        EXPECT_EQ(header->num_inplace_update, num_inplace + 1);
+    }
+    EXPECT_EQ(db->Count(), 3);
+}
+
+TEST_F(UpdateTest, Update_in_place_recovery)
+{
+    EXPECT_EQ(db->Add("key", "value_00"), MBError::SUCCESS);
+    EXPECT_EQ(db->Add("key", "value_01", true), MBError::SUCCESS);
+    IndexHeader* header = db->GetDictPtr()->GetHeaderPtr();
+    EXPECT_EQ(header->num_inplace_update, 1u);
+
+    // The writer exits in the middle of the overwrite. The old value is
+    // restored when the writer opens the DB again.
+    header->excep_updating_status = EXCEP_STATUS_OVERWRITE_DATA;
+    db->Close();
+    delete db;
+    ResourcePool::getInstance().RemoveAll();
+    db = new DB(MB_DIR, CONSTS::WriterOptions());
+    ASSERT_TRUE(db->is_open());
+    header = db->GetDictPtr()->GetHeaderPtr();
+    EXPECT_EQ(header->excep_updating_status, EXCEP_STATUS_NONE);
+    MBData mbd;
+    EXPECT_EQ(db->Find("key", mbd), MBError::SUCCESS);
+    EXPECT_EQ(std::string((const char*)mbd.buff, mbd.data_len), "value_00");
+
+    // Values larger than the undo area are not overwritten in place.
+    std::string large(MB_INPLACE_UNDO_SIZE, 'x');
+    EXPECT_EQ(db->Add("large", large), MBError::SUCCESS);
+    uint64_t num_inplace = header->num_inplace_update;
+    large[0] = 'y';
+    EXPECT_EQ(db->Add("large", large, true), MBError::SUCCESS);
+    EXPECT_EQ(db->Find("large", mbd), MBError::SUCCESS);
+    EXPECT_EQ(header->num_inplace_update, num_inplace);
+    EXPECT_EQ(std::string((const char*)mbd.buff, mbd.data_len), large);
+}
+
+TEST_F(UpdateTest, Update_in_place_read_retry)
+{
+    EXPECT_EQ(db->Add("key", "value_00"), MBError::SUCCESS);
+
+    // Lookups wait for an update that takes long instead of returning the
+    // value read during the update.
+    DB reader(MB_DIR, CONSTS::ReaderOptions());
+    ASSERT_TRUE(reader.is_open());
+    std::atomic<uint32_t>* seq = db->GetDictPtr()->GetHeaderPtr()->data_update_seq;
+    for (int i = 0; i < MB_DATA_UPDATE_SEQ_NUM; i++)
+        seq[i].fetch_add(1);
+    std::thread updater([seq]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        for (int i = 0; i < MB_DATA_UPDATE_SEQ_NUM; i++)
+            seq[i].fetch_add(1);
+    });
+    auto start = std::chrono::steady_clock::now();
+    MBData mbd;
+    EXPECT_EQ(reader.Find("key", mbd), MBError::SUCCESS);
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+    EXPECT_EQ(std::string((const char*)mbd.buff, mbd.data_len), "value_00");
+    updater.join();
+    reader.Close();
+}
+
+TEST_F(UpdateTest, Update_in_place_writer_exited)
+{
+    EXPECT_EQ(db->Add("key", "value_00"), MBError::SUCCESS);
+
+    // The sequence numbers are left odd if the writer exits in the middle of
+    // an in-place update. Lookups return instead of waiting for the update.
+    DB reader(MB_DIR, CONSTS::ReaderOptions());
+    ASSERT_TRUE(reader.is_open());
+    std::atomic<uint32_t>* seq = db->GetDictPtr()->GetHeaderPtr()->data_update_seq;
+    for (int i = 0; i < MB_DATA_UPDATE_SEQ_NUM; i++)
+        seq[i].fetch_add(1);
+    auto start = std::chrono::steady_clock::now();
+    MBData mbd;
+    EXPECT_EQ(reader.Find("key", mbd), MBError::DATA_UPDATING);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+    for (int i = 0; i < MB_DATA_UPDATE_SEQ_NUM; i++)
+        seq[i].fetch_add(1);
+    EXPECT_EQ(reader.Find("key", mbd), MBError::SUCCESS);
+    EXPECT_EQ(std::string((const char*)mbd.buff, mbd.data_len), "value_00");
+    reader.Close();
+}
+
+static void* in_place_reader(void* arg)
+{
+    std::atomic<bool>* stop = reinterpret_cast<std::atomic<bool>*>(arg);
+    DB reader(MB_DIR, CONSTS::ReaderOptions());
+    EXPECT_TRUE(reader.is_open());
+    MBData mbd;
+    int64_t num_read = 0;
+    while (!stop->load() || num_read < 1000) {
+        EXPECT_EQ(reader.Find("counter", mbd), MBError::SUCCESS);
+        std::string value((const char*)mbd.buff, mbd.data_len);
+        // All bytes are written by the same update.
+        EXPECT_EQ(value, std::string(value.size(), value[0]));
+        num_read++;
+    }
+    reader.Close();
+    return NULL;
+}
+
+TEST_F(UpdateTest, Update_in_place_concurrent_read)
+{
+    EXPECT_EQ(db->Add("counter", std::string(64, 'a')), MBError::SUCCESS);
+
+    std::atomic<bool> stop(false);
+    pthread_t tid;
+    ASSERT_EQ(pthread_create(&tid, NULL, in_place_reader, &stop), 0);
+    for (int i = 0; i < 20000; i++) {
+        std::string value(64, 'a' + i % 26);
+        EXPECT_EQ(db->Add("counter", value, true), MBError::SUCCESS);
+    }
+    stop.store(true);
+    pthread_join(tid, NULL);
+    EXPECT_GE(db->GetDictPtr()->GetHeaderPtr()->num_inplace_update, 20000u);
+}
+
 }
@@ -0,0 +1,160 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../resource_pool.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+namespace {
+
+#define MB_DIR "/var/tmp/mabain_test/"
+
+class WarmupTest : public ::testing::Test {
+public:
+    WarmupTest()
+    {
+        db = NULL;
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~WarmupTest()
+    {
+    }
+    virtual void SetUp()
+    {
+        std::string cmd = std::string("mkdir -p ") + MB_DIR;
+        if (system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -f ") + MB_DIR + "_*";
+        if (system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = MB_DIR;
+        mbconf.memcap_index = 64 * 1024 * 1024LL;
+        mbconf.memcap_data = 64 * 1024 * 1024LL;
+        mbconf.block_size_index = 8 * 1024 * 1024LL;
+        mbconf.block_size_data = 8 * 1024 * 1024LL;
+    }
+    virtual void TearDown()
+    {
+        if (db != NULL) {
+            db->Close();
+            delete db;
+            db = NULL;
+        }
+        ResourcePool::getInstance().RemoveAll();
+    }
+
+    void Populate(int num)
+    {
+        mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+        DB db_w(mbconf);
+        ASSERT_TRUE(db_w.is_open());
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+        for (int i = 0; i < num; i++) {
+            std::string key = tkey.get_key(i);
+            ASSERT_EQ(db_w.Add(key, key), MBError::SUCCESS);
+        }
+        db_w.Close();
+        ResourcePool::getInstance().RemoveAll();
+    }
+
+    void CheckKeys(int num)
+    {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+        MBData mbd;
+        for (int i = 0; i < num; i++) {
+            std::string key = tkey.get_key(i);
+            ASSERT_EQ(db->Find(key, mbd), MBError::SUCCESS);
+            EXPECT_EQ(std::string((const char*)mbd.buff, mbd.data_len), key);
+        }
+    }
+
+protected:
+    MBConfig mbconf;
+    DB* db;
+};
+
+TEST_F(WarmupTest, warmup_reader)
+{
+    int num = 50000;
+    Populate(num);
+
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+
+    size_t last_done = 0;
+    size_t last_total = 0;
+    int num_calls = 0;
+    int rval = db->Warmup(MB_WARMUP_INDEX | MB_WARMUP_DATA, 4,
+        [&](size_t done, size_t total) {
+            EXPECT_GE(done, last_done);
+            EXPECT_LE(done, total);
+            last_done = done;
+            last_total = total;
+            num_calls++;
+        });
+    EXPECT_EQ(rval, MBError::SUCCESS);
+    EXPECT_GT(num_calls, 0);
+    EXPECT_GT(last_total, 0u);
+    EXPECT_EQ(last_done, last_total);
+    CheckKeys(num);
+}
+
+TEST_F(WarmupTest, warmup_on_open)
+{
+    int num = 20000;
+    Populate(num);
+
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    mbconf.warmup_options = MB_WARMUP_INDEX;
+    mbconf.warmup_threads = 2;
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    CheckKeys(num);
+}
+
+TEST_F(WarmupTest, warmup_writer)
+{
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    // Nothing to prefault but the root node
+    EXPECT_EQ(db->Warmup(MB_WARMUP_INDEX | MB_WARMUP_DATA), MBError::SUCCESS);
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+    for (int i = 0; i < 1000; i++) {
+        std::string key = tkey.get_key(i);
+        EXPECT_EQ(db->Add(key, key), MBError::SUCCESS);
+    }
+    EXPECT_EQ(db->Warmup(MB_WARMUP_INDEX | MB_WARMUP_DATA, 1), MBError::SUCCESS);
+    CheckKeys(1000);
+    db->Close();
+    delete db;
+
+    mbconf.options = CONSTS::ACCESS_MODE_WRITER | CONSTS::ASYNC_WRITER_MODE;
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    EXPECT_EQ(db->Warmup(), MBError::NOT_ALLOWED);
+}
+
+}
@@ -0,0 +1,184 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <sstream>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../resource_pool.h"
+#include "../window_cache.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+namespace {
+
+#define MB_DIR "/var/tmp/mabain_test/"
+#define WINDOW_TEST_BLOCK_SIZE (4 * 1024 * 1024)
+
+// Only the first data block is mapped. The other blocks are read through
+// the window cache, which holds fewer windows than the blocks.
+class WindowCacheTest : public ::testing::Test {
+public:
+    WindowCacheTest()
+    {
+        db = NULL;
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~WindowCacheTest()
+    {
+    }
+    virtual void SetUp()
+    {
+        std::string cmd = std::string("mkdir -p ") + MB_DIR;
+        if (system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm -f ") + MB_DIR + "_*";
+        if (system(cmd.c_str()) != 0) {
+        }
+        mbconf.mbdir = MB_DIR;
+        mbconf.options = CONSTS::ACCESS_MODE_WRITER;
+        mbconf.memcap_index = 64 * 1024 * 1024LL;
+        mbconf.memcap_data = WINDOW_TEST_BLOCK_SIZE;
+        mbconf.block_size_index = 16 * 1024 * 1024LL;
+        mbconf.block_size_data = WINDOW_TEST_BLOCK_SIZE;
+        mbconf.window_cache_size = 4 * 1024 * 1024LL;
+    }
+    virtual void TearDown()
+    {
+        if (db != NULL) {
+            db->Close();
+            delete db;
+            db = NULL;
+        }
+        ResourcePool::getInstance().RemoveAll();
+    }
+
+    static std::string GetValue(const std::string& key, int version)
+    {
+        std::string value = std::to_string(version) + ":";
+        while (value.length() < 1000)
+            value += key;
+        return value.substr(0, 1000);
+    }
+
+    void Populate(int num, int version)
+    {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+        for (int i = 0; i < num; i++) {
+            std::string key = tkey.get_key(i);
+            EXPECT_EQ(db->Add(key, GetValue(key, version), true), MBError::SUCCESS);
+        }
+    }
+
+    static void FindAll(DB* dbh, int num, int version, int start = 0)
+    {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+        MBData mbd;
+        for (int n = 0; n < num; n++) {
+            int i = (start + n * 7) % num;
+            std::string key = tkey.get_key(i);
+            ASSERT_EQ(dbh->Find(key, mbd), MBError::SUCCESS);
+            EXPECT_EQ(std::string((const char*)mbd.buff, mbd.data_len), GetValue(key, version));
+        }
+    }
+
+protected:
+    MBConfig mbconf;
+    DB* db;
+};
+
+TEST_F(WindowCacheTest, find_beyond_memcap)
+{
+    int num = 20000;
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    Populate(num, 0);
+    FindAll(db, num, 0);
+
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    DB db_r(mbconf);
+    ASSERT_TRUE(db_r.is_open());
+    FindAll(&db_r, num, 0);
+    EXPECT_GT(WindowCache::getInstance().MappedSize(), 0u);
+
+    std::stringstream ss;
+    db_r.PrintStats(ss);
+    EXPECT_NE(ss.str().find("Window cache stats"), std::string::npos);
+    db_r.Close();
+}
+
+TEST_F(WindowCacheTest, concurrent_readers)
+{
+    int num = 20000;
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    Populate(num, 0);
+
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; t++) {
+        readers.push_back(std::thread([&, t]() {
+            DB db_r(mbconf);
+            ASSERT_TRUE(db_r.is_open());
+            FindAll(&db_r, num, 0, t * 1000);
+            db_r.Close();
+        }));
+    }
+    for (auto& reader : readers)
+        reader.join();
+}
+
+TEST_F(WindowCacheTest, writer_updates)
+{
+    // Updates written with pwrite are seen in the cached windows.
+    int num = 20000;
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    Populate(num, 0);
+
+    mbconf.options = CONSTS::ACCESS_MODE_READER;
+    DB db_r(mbconf);
+    ASSERT_TRUE(db_r.is_open());
+    FindAll(&db_r, num, 0);
+    Populate(num, 1);
+    FindAll(&db_r, num, 1);
+    db_r.Close();
+}
+
+TEST_F(WindowCacheTest, remove_files)
+{
+    int num = 10000;
+    db = new DB(mbconf);
+    ASSERT_TRUE(db->is_open());
+    Populate(num, 0);
+    FindAll(db, num, 0);
+    db->Close();
+    delete db;
+    db = NULL;
+
+    // Windows are unmapped once the files are closed.
+    ResourcePool::getInstance().RemoveAll();
+    EXPECT_EQ(WindowCache::getInstance().MappedSize(), 0u);
+}
+
+}
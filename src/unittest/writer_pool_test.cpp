@@ -0,0 +1,275 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <atomic>
+#include <dirent.h>
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../dict.h"
+#include "../resource_pool.h"
+#include "../writer_pool.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+namespace {
+
+#define MB_DIR "/var/tmp/mabain_test/"
+#define NUM_POOL_TEST_DB 6
+
+class WriterPoolTest : public ::testing::Test {
+public:
+    WriterPoolTest()
+    {
+        memset(&mbconf, 0, sizeof(mbconf));
+    }
+    virtual ~WriterPoolTest()
+    {
+    }
+    virtual void SetUp()
+    {
+        for (int i = 0; i < NUM_POOL_TEST_DB; i++) {
+            std::string dir = DBDir(i);
+            std::string cmd = std::string("mkdir -p ") + dir;
+            if (system(cmd.c_str()) != 0) {
+            }
+            cmd = std::string("rm -f ") + dir + "_*";
+            if (system(cmd.c_str()) != 0) {
+            }
+        }
+        mbconf.memcap_index = 16 * 1024 * 1024LL;
+        mbconf.memcap_data = 16 * 1024 * 1024LL;
+        mbconf.block_size_index = 8 * 1024 * 1024LL;
+        mbconf.block_size_data = 8 * 1024 * 1024LL;
+        mbconf.queue_timeout = 5000;
+    }
+    virtual void TearDown()
+    {
+        for (DB* db : readers) {
+            db->Close();
+            delete db;
+        }
+        readers.clear();
+        for (DB* db : writers) {
+            db->Close();
+            delete db;
+        }
+        writers.clear();
+        ResourcePool::getInstance().RemoveAll();
+    }
+
+    std::string DBDir(int i) const
+    {
+        return std::string(MB_DIR) + "pool_" + std::to_string(i) + "/";
+    }
+
+    void OpenDBs(int num, uint32_t pool_size)
+    {
+        for (int i = 0; i < num; i++) {
+            std::string dir = DBDir(i);
+            mbconf.mbdir = dir.c_str();
+            mbconf.options = CONSTS::ACCESS_MODE_WRITER | CONSTS::ASYNC_WRITER_MODE;
+            mbconf.writer_pool_size = pool_size;
+            DB* db = new DB(mbconf);
+            ASSERT_TRUE(db->is_open());
+            writers.push_back(db);
+
+            mbconf.options = CONSTS::ACCESS_MODE_READER | CONSTS::SHMQ_BLOCKING_MODE;
+            mbconf.writer_pool_size = 0;
+            db = new DB(mbconf);
+            ASSERT_TRUE(db->is_open());
+            readers.push_back(db);
+        }
+    }
+
+    // Add through the shared memory queue as other processes do.
+    int QueueAdd(int i, const std::string& key, const std::string& value)
+    {
+        return writers[i]->GetDictPtr()->SHMQ_Add(key.data(), key.size(), value.data(),
+            value.size(), false, mbconf.queue_timeout);
+    }
+
+    bool WaitForQueues(int timeout_ms)
+    {
+        for (int t = 0; t < timeout_ms; t++) {
+            bool busy = false;
+            for (DB* db : readers) {
+                if (db->AsyncWriterBusy()) {
+                    busy = true;
+                    break;
+                }
+            }
+            if (!busy)
+                return true;
+            usleep(1000);
+        }
+        return false;
+    }
+
+    static int CountThreads()
+    {
+        int count = 0;
+        DIR* dir = opendir("/proc/self/task");
+        if (dir == NULL)
+            return -1;
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (entry->d_name[0] != '.')
+                count++;
+        }
+        closedir(dir);
+        return count;
+    }
+
+    void CheckDB(int i, int num_key)
+    {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_128);
+        MBData mbd;
+        std::string key;
+        std::string value;
+        for (int k = 0; k < num_key; k++) {
+            key = tkey.get_key(k);
+            ASSERT_EQ(readers[i]->Find(key, mbd), MBError::SUCCESS);
+            value = std::string((const char*)mbd.buff, mbd.data_len);
+            EXPECT_EQ(value, key + "_" + std::to_string(i));
+        }
+        EXPECT_EQ(readers[i]->Count(), num_key);
+    }
+
+protected:
+    MBConfig mbconf;
+    std::vector<DB*> writers;
+    std::vector<DB*> readers;
+};
+
+TEST_F(WriterPoolTest, dedicated_writers_test)
+{
+    // Each DB has its own async writer thread.
+    int num_db = 3;
+    OpenDBs(num_db, 0);
+
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_128);
+    std::string key;
+    int num_key = 2000;
+    for (int k = 0; k < num_key; k++) {
+        key = tkey.get_key(k);
+        for (int i = 0; i < num_db; i++) {
+            // In-process updates must go to the writer of the same DB.
+            if (k % 2 == 0)
+                EXPECT_EQ(readers[i]->Add(key, key + "_" + std::to_string(i)), MBError::SUCCESS);
+            else
+                EXPECT_EQ(QueueAdd(i, key, key + "_" + std::to_string(i)), MBError::SUCCESS);
+        }
+    }
+    EXPECT_TRUE(WaitForQueues(5000));
+
+    for (int i = 0; i < num_db; i++)
+        CheckDB(i, num_key);
+}
+
+TEST_F(WriterPoolTest, pooled_writers_test)
+{
+    int num_thread_before = CountThreads();
+    OpenDBs(NUM_POOL_TEST_DB, 2);
+    EXPECT_EQ(WriterPool::getInstance().NumThreads(), 2);
+    // No dedicated thread for any of the DBs
+    EXPECT_EQ(CountThreads() - num_thread_before, 2);
+
+    int num_key = 3000;
+    std::vector<std::thread> producers;
+    for (int i = 0; i < NUM_POOL_TEST_DB; i++) {
+        producers.push_back(std::thread([this, i, num_key]() {
+            TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_128);
+            std::string key;
+            for (int k = 0; k < num_key; k++) {
+                key = tkey.get_key(k);
+                EXPECT_EQ(QueueAdd(i, key, key + "_" + std::to_string(i)), MBError::SUCCESS);
+            }
+            // Remove some and add them back.
+            for (int k = 0; k < num_key; k += 10) {
+                key = tkey.get_key(k);
+                EXPECT_EQ(readers[i]->Remove(key), MBError::SUCCESS);
+                EXPECT_EQ(QueueAdd(i, key, key + "_" + std::to_string(i)), MBError::SUCCESS);
+            }
+        }));
+    }
+    for (auto& producer : producers)
+        producer.join();
+    EXPECT_TRUE(WaitForQueues(5000));
+
+    for (int i = 0; i < NUM_POOL_TEST_DB; i++)
+        CheckDB(i, num_key);
+
+    // Pool threads are stopped after the last pooled DB is closed.
+    for (int i = NUM_POOL_TEST_DB - 1; i >= 0; i--) {
+        readers[i]->Close();
+        delete readers[i];
+        readers.pop_back();
+        writers[i]->Close();
+        delete writers[i];
+        writers.pop_back();
+        if (i > 0) {
+            EXPECT_EQ(WriterPool::getInstance().NumThreads(), 2);
+        }
+    }
+    EXPECT_EQ(WriterPool::getInstance().NumThreads(), 0);
+    EXPECT_EQ(CountThreads(), num_thread_before);
+}
+
+TEST_F(WriterPoolTest, pool_fairness_test)
+{
+    // A single pool thread serves a busy DB and a DB with a few updates. The
+    // few updates must not wait for the busy DB to be drained.
+    OpenDBs(2, 1);
+
+    std::atomic<bool> busy_done(false);
+    int num_busy = 50000;
+    std::thread busy_producer([this, num_busy, &busy_done]() {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_128);
+        std::string key;
+        for (int k = 0; k < num_busy; k++) {
+            key = tkey.get_key(k);
+            EXPECT_EQ(QueueAdd(0, key, key + "_0"), MBError::SUCCESS);
+        }
+        busy_done.store(true);
+    });
+
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_128);
+    std::string key;
+    int num_key = 200;
+    for (int k = 0; k < num_key; k++) {
+        key = tkey.get_key(k);
+        EXPECT_EQ(QueueAdd(1, key, key + "_1"), MBError::SUCCESS);
+    }
+    while (readers[1]->AsyncWriterBusy())
+        usleep(100);
+    EXPECT_FALSE(busy_done.load());
+
+    busy_producer.join();
+    EXPECT_TRUE(WaitForQueues(5000));
+    CheckDB(0, num_busy);
+    CheckDB(1, num_key);
+}
+
+}
@@ -0,0 +1,167 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#ifndef __APPLE__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include "futex.h"
+
+namespace mabain {
+
+// Used if the words cannot be waited on together in the kernel.
+static int PollMulti(std::atomic<uint32_t>* const* addrs, const uint32_t* expected, int n,
+    int timeout)
+{
+    int waited = 0;
+    while (true) {
+        for (int i = 0; i < n; i++) {
+            if (addrs[i]->load(std::memory_order_acquire) != expected[i])
+                return 0;
+        }
+        if (timeout >= 0 && waited >= timeout * 10)
+            return ETIMEDOUT;
+        usleep(100);
+        waited++;
+    }
+    return 0;
+}
+
+#ifndef __APPLE__
+
+// The futex words live in files mapped with MAP_SHARED by multiple processes.
+// Therefore FUTEX_PRIVATE_FLAG must not be used.
+int FutexWait(std::atomic<uint32_t>* addr, uint32_t expected, int timeout)
+{
+    struct timespec ts;
+    struct timespec* ts_ptr = NULL;
+    if (timeout >= 0) {
+        ts.tv_sec = timeout / 1000;
+        ts.tv_nsec = (timeout % 1000) * 1000000L;
+        ts_ptr = &ts;
+    }
+
+    long rval = syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAIT,
+        expected, ts_ptr, NULL, 0);
+    if (rval < 0 && errno == ETIMEDOUT)
+        return ETIMEDOUT;
+    // EAGAIN (value changed) and EINTR are treated as wakeups.
+    return 0;
+}
+
+int FutexWake(std::atomic<uint32_t>* addr, int nwake)
+{
+    long rval = syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAKE,
+        nwake, NULL, NULL, 0);
+    if (rval < 0)
+        return errno;
+    return 0;
+}
+
+// futex_waitv was added in Linux 5.16.
+#ifndef SYS_futex_waitv
+#define SYS_futex_waitv 449
+#endif
+#define MB_FUTEX_32 2
+
+struct mb_futex_waitv {
+    uint64_t val;
+    uint64_t uaddr;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+int FutexWaitMulti(std::atomic<uint32_t>* const* addrs, const uint32_t* expected, int n,
+    int timeout)
+{
+    static std::atomic<bool> waitv_supported(true);
+
+    if (n > MB_FUTEX_WAITV_MAX)
+        n = MB_FUTEX_WAITV_MAX;
+    if (!waitv_supported.load(std::memory_order_relaxed))
+        return PollMulti(addrs, expected, n, timeout);
+
+    struct mb_futex_waitv waiters[MB_FUTEX_WAITV_MAX];
+    for (int i = 0; i < n; i++) {
+        waiters[i].val = expected[i];
+        waiters[i].uaddr = reinterpret_cast<uint64_t>(addrs[i]);
+        waiters[i].flags = MB_FUTEX_32;
+        waiters[i].reserved = 0;
+    }
+
+    // The timeout of futex_waitv is absolute.
+    struct timespec ts;
+    struct timespec* ts_ptr = NULL;
+    if (timeout >= 0) {
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        ts.tv_sec += timeout / 1000;
+        ts.tv_nsec += (timeout % 1000) * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        ts_ptr = &ts;
+    }
+
+    long rval = syscall(SYS_futex_waitv, waiters, n, 0, ts_ptr, CLOCK_MONOTONIC);
+    if (rval < 0) {
+        if (errno == ENOSYS) {
+            waitv_supported.store(false, std::memory_order_relaxed);
+            return PollMulti(addrs, expected, n, timeout);
+        }
+        if (errno == ETIMEDOUT)
+            return ETIMEDOUT;
+    }
+    return 0;
+}
+
+#else
+
+// No futex on macOS. Poll the word instead.
+int FutexWait(std::atomic<uint32_t>* addr, uint32_t expected, int timeout)
+{
+    int waited = 0;
+    while (addr->load(std::memory_order_acquire) == expected) {
+        if (timeout >= 0 && waited >= timeout * 10)
+            return ETIMEDOUT;
+        usleep(100);
+        waited++;
+    }
+    return 0;
+}
+
+int FutexWake(std::atomic<uint32_t>* addr, int nwake)
+{
+    return 0;
+}
+
+int FutexWaitMulti(std::atomic<uint32_t>* const* addrs, const uint32_t* expected, int n,
+    int timeout)
+{
+    if (n > MB_FUTEX_WAITV_MAX)
+        n = MB_FUTEX_WAITV_MAX;
+    return PollMulti(addrs, expected, n, timeout);
+}
+
+#endif
+
+}
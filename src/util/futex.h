@@ -0,0 +1,52 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __MB_FUTEX_H__
+#define __MB_FUTEX_H__
+
+#include <atomic>
+#include <stdint.h>
+
+namespace mabain {
+
+// Hint to the CPU in busy-wait loops
+#if defined(__x86_64__) || defined(__i386__)
+#define MB_CPU_RELAX() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define MB_CPU_RELAX() asm volatile("yield" ::: "memory")
+#else
+#define MB_CPU_RELAX() asm volatile("" ::: "memory")
+#endif
+
+// Inter-process wait/wake on a 32-bit word in shared memory.
+// FutexWait blocks only if *addr still equals expected. timeout is in millisecond.
+// Returns 0 if woken up or the value changed, ETIMEDOUT if timed out.
+int FutexWait(std::atomic<uint32_t>* addr, uint32_t expected, int timeout);
+// Wake up at most nwake waiters blocked on addr.
+int FutexWake(std::atomic<uint32_t>* addr, int nwake);
+// Block until any of the n words no longer equals its expected value, a waker
+// calls FutexWake on one of them, or the timeout expires. n must not exceed
+// MB_FUTEX_WAITV_MAX. Falls back to polling if futex_waitv is not supported.
+// Returns 0 if woken up or a value changed, ETIMEDOUT if timed out.
+#define MB_FUTEX_WAITV_MAX 128
+int FutexWaitMulti(std::atomic<uint32_t>* const* addrs, const uint32_t* expected, int n,
+    int timeout);
+
+}
+
+#endif
@@ -23,6 +23,7 @@
 #include <iostream>
 #include <stdint.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "error.h"
@@ -122,8 +123,23 @@ static int remove_matched_files(const std::string& dpath, const std::string& pat
 int remove_db_files(const std::string& db_dir)
 {
     remove_matched_files("/dev/shm", "_mabain_q");
+    remove_matched_files("/dev/shm", "_mabain_a");
     remove_matched_files(db_dir, "_mabain_");
     return 0;
 }
 
+int64_t get_current_time_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+int64_t get_current_time_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
 }
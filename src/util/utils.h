@@ -19,6 +19,7 @@
 #ifndef __UTILS_H__
 #define __UTILS_H__
 
+#include <stdint.h>
 #include <string>
 
 namespace mabain {
@@ -29,6 +30,10 @@ void release_file_lock(int& fd);
 uint64_t get_file_inode(const std::string& path);
 int directory_exists(const std::string& path);
 int remove_db_files(const std::string& db_dir);
+// monotonic clock in millisecond
+int64_t get_current_time_ms();
+// monotonic clock in microsecond
+int64_t get_current_time_us();
 
 }
 
@@ -0,0 +1,301 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <string.h>
+#include <sys/mman.h>
+
+#include "mmap_file.h"
+#include "window_cache.h"
+
+namespace mabain {
+
+WindowCache::WindowCache()
+    : capacity(0)
+{
+    for (auto& shard : shards) {
+        shard.mapped = 0;
+        shard.hits = 0;
+        shard.misses = 0;
+        shard.maps = 0;
+        shard.evictions = 0;
+        shard.recent_reads = 0;
+        shard.recent_hits = 0;
+        shard.recent_maps = 0;
+        for (auto& key : shard.ghost)
+            key = WindowKey(NULL, 0);
+    }
+}
+
+WindowCache::~WindowCache()
+{
+    for (auto& shard : shards) {
+        for (auto& window : shard.lru)
+            munmap(window.addr, window.size);
+    }
+}
+
+void WindowCache::SetCapacity(size_t size)
+{
+    size_t curr = capacity.load(std::memory_order_relaxed);
+    while (size > curr && !capacity.compare_exchange_weak(curr, size))
+        ;
+}
+
+size_t WindowCache::GetCapacity() const
+{
+    return capacity.load(std::memory_order_relaxed);
+}
+
+WindowCache::WindowShard& WindowCache::GetShard(const WindowKey& key)
+{
+    return shards[WindowKeyHash()(key) % MB_WINDOW_CACHE_SHARDS];
+}
+
+size_t WindowCache::Read(MmapFileIO* file, size_t file_size, void* buff, size_t size,
+    off_t offset)
+{
+    if (capacity.load(std::memory_order_relaxed) == 0)
+        return 0;
+
+    uint8_t* ptr = reinterpret_cast<uint8_t*>(buff);
+    size_t bytes_read = 0;
+    // A buffer may span two windows.
+    while (bytes_read < size) {
+        size_t index = offset / MB_WINDOW_SIZE;
+        size_t window_off = offset % MB_WINDOW_SIZE;
+        Window* window = Acquire(file, file_size, index);
+        if (window == NULL)
+            break;
+        if (window_off >= window->size) {
+            Release(window);
+            break;
+        }
+        size_t len = window->size - window_off;
+        if (len > size - bytes_read)
+            len = size - bytes_read;
+        memcpy(ptr, window->addr + window_off, len);
+        Release(window);
+        ptr += len;
+        offset += len;
+        bytes_read += len;
+    }
+    return bytes_read;
+}
+
+WindowCache::Window* WindowCache::Acquire(MmapFileIO* file, size_t file_size, size_t index)
+{
+    WindowKey key(file, index);
+    WindowShard& shard = GetShard(key);
+
+    std::unique_lock<std::mutex> lock(shard.shard_mutex);
+    auto it = shard.windows.find(key);
+    if (it != shard.windows.end()) {
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        it->second->refcount++;
+        shard.hits++;
+        shard.recent_hits++;
+        Decay(shard);
+        return &(*it->second);
+    }
+    shard.misses++;
+    Decay(shard);
+    if (!Admit(shard, key))
+        return NULL;
+    lock.unlock();
+
+    // Map the window without holding the lock.
+    size_t start = index * MB_WINDOW_SIZE;
+    if (start >= file_size)
+        return NULL;
+    size_t size = file_size - start;
+    if (size > MB_WINDOW_SIZE)
+        size = MB_WINDOW_SIZE;
+    uint8_t* addr = file->MapWindow(size, start);
+    if (addr == NULL)
+        return NULL;
+
+    std::list<Window> evicted;
+    Window* window;
+    lock.lock();
+    it = shard.windows.find(key);
+    if (it != shard.windows.end()) {
+        // Mapped by another thread in the meantime
+        it->second->refcount++;
+        shard.hits++;
+        window = &(*it->second);
+        lock.unlock();
+        munmap(addr, size);
+        return window;
+    }
+    shard.lru.push_front(Window { key, addr, size, 1, false });
+    shard.windows[key] = shard.lru.begin();
+    shard.mapped += size;
+    shard.maps++;
+    shard.recent_maps++;
+    window = &shard.lru.front();
+    Evict(shard, evicted);
+    lock.unlock();
+
+    for (auto& old_window : evicted)
+        munmap(old_window.addr, old_window.size);
+    return window;
+}
+
+bool WindowCache::Admit(WindowShard& shard, const WindowKey& key)
+{
+    WindowKey& ghost = shard.ghost[(WindowKeyHash()(key) / MB_WINDOW_CACHE_SHARDS)
+        % MB_WINDOW_GHOST_SLOTS];
+    if (ghost != key) {
+        ghost = key;
+        return false;
+    }
+    // Mapping a window costs many preads. Once the shard is full, windows are
+    // only replaced if the cached ones have been hit enough since the last
+    // ones were mapped. The counts decay so that a shard holding windows no
+    // longer read is refilled.
+    if (shard.mapped + MB_WINDOW_SIZE > ShardCapacity()
+        && shard.recent_hits < MB_WINDOW_HITS_PER_MAP * shard.recent_maps) {
+        return false;
+    }
+    ghost = WindowKey(NULL, 0);
+    return true;
+}
+
+void WindowCache::Decay(WindowShard& shard)
+{
+    if (++shard.recent_reads > MB_WINDOW_RECENT_COUNT) {
+        shard.recent_hits /= 2;
+        shard.recent_maps /= 2;
+        shard.recent_reads = 0;
+    }
+}
+
+size_t WindowCache::ShardCapacity() const
+{
+    size_t shard_capacity = capacity.load(std::memory_order_relaxed) / MB_WINDOW_CACHE_SHARDS;
+    if (shard_capacity < MB_WINDOW_SIZE)
+        shard_capacity = MB_WINDOW_SIZE;
+    return shard_capacity;
+}
+
+void WindowCache::Release(Window* window)
+{
+    WindowShard& shard = GetShard(window->key);
+    std::list<Window> evicted;
+    std::unique_lock<std::mutex> lock(shard.shard_mutex);
+    window->refcount--;
+    if (window->refcount == 0 && window->removed) {
+        for (auto it = shard.lru.begin(); it != shard.lru.end(); ++it) {
+            if (&(*it) == window) {
+                shard.mapped -= it->size;
+                evicted.splice(evicted.begin(), shard.lru, it);
+                break;
+            }
+        }
+    } else {
+        // Windows in use may have kept the shard over its capacity.
+        Evict(shard, evicted);
+    }
+    lock.unlock();
+
+    for (auto& old_window : evicted)
+        munmap(old_window.addr, old_window.size);
+}
+
+void WindowCache::Evict(WindowShard& shard, std::list<Window>& evicted)
+{
+    size_t shard_capacity = ShardCapacity();
+    auto it = shard.lru.end();
+    while (shard.mapped > shard_capacity && it != shard.lru.begin()) {
+        --it;
+        if (it->refcount > 0)
+            continue;
+        auto victim = it++;
+        if (!victim->removed)
+            shard.windows.erase(victim->key);
+        shard.mapped -= victim->size;
+        shard.evictions++;
+        evicted.splice(evicted.begin(), shard.lru, victim);
+    }
+}
+
+void WindowCache::RemoveFile(const MmapFileIO* file)
+{
+    for (auto& shard : shards) {
+        std::list<Window> evicted;
+        std::unique_lock<std::mutex> lock(shard.shard_mutex);
+        auto it = shard.lru.begin();
+        while (it != shard.lru.end()) {
+            if (it->key.first != file || it->removed) {
+                ++it;
+                continue;
+            }
+            shard.windows.erase(it->key);
+            if (it->refcount > 0) {
+                it->removed = true;
+                ++it;
+                continue;
+            }
+            auto victim = it++;
+            shard.mapped -= victim->size;
+            evicted.splice(evicted.begin(), shard.lru, victim);
+        }
+        lock.unlock();
+
+        for (auto& window : evicted)
+            munmap(window.addr, window.size);
+    }
+}
+
+size_t WindowCache::MappedSize() const
+{
+    size_t mapped = 0;
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.shard_mutex);
+        mapped += shard.mapped;
+    }
+    return mapped;
+}
+
+void WindowCache::PrintStats(std::ostream& out_stream) const
+{
+    size_t mapped = 0;
+    size_t num_window = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t maps = 0;
+    uint64_t evictions = 0;
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.shard_mutex);
+        mapped += shard.mapped;
+        num_window += shard.lru.size();
+        hits += shard.hits;
+        misses += shard.misses;
+        maps += shard.maps;
+        evictions += shard.evictions;
+    }
+    out_stream << "Window cache stats:" << std::endl;
+    out_stream << "\tcapacity: " << capacity.load(std::memory_order_relaxed) << std::endl;
+    out_stream << "\tmapped size: " << mapped << " in " << num_window << " windows" << std::endl;
+    out_stream << "\thits: " << hits << std::endl;
+    out_stream << "\tmisses: " << misses << std::endl;
+    out_stream << "\twindows mapped: " << maps << std::endl;
+    out_stream << "\tevictions: " << evictions << std::endl;
+}
+
+}
@@ -0,0 +1,130 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __WINDOW_CACHE_H__
+#define __WINDOW_CACHE_H__
+
+#include <atomic>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <stdint.h>
+#include <sys/types.h>
+#include <unordered_map>
+#include <utility>
+
+namespace mabain {
+
+#define MB_WINDOW_SIZE (1024 * 1024) // 1M
+#define MB_WINDOW_CACHE_SHARDS 16
+// Windows missed recently in each shard
+#define MB_WINDOW_GHOST_SLOTS 64
+// Hits needed for each window replaced in a full shard
+#define MB_WINDOW_HITS_PER_MAP 256
+// The recent hit and map counts are halved after this many reads.
+#define MB_WINDOW_RECENT_COUNT 4096
+
+class MmapFileIO;
+
+// A singleton class caching read-only mappings of fixed-size windows of the
+// block files that are not mapped within the memcap. Reads beyond the memcap
+// copy from a cached window instead of calling pread. Windows are kept in LRU
+// order and the least recently used ones are unmapped once the cache exceeds
+// its capacity. A window is only mapped when it is missed a second time while
+// still in the shard's list of recent misses, and is read with pread before
+// that. Once a shard is full, a window is only replaced for every
+// MB_WINDOW_HITS_PER_MAP recent hits, so that a cache smaller than the working
+// set is not remapped for every read. Each window has a reference count so that
+// a window being read by a thread is not unmapped by another one. The windows
+// are split into shards with their own lock and LRU list.
+class WindowCache {
+public:
+    ~WindowCache();
+
+    // Raise the capacity in bytes of the cache. Nothing is cached if the
+    // capacity is 0.
+    void SetCapacity(size_t size);
+    size_t GetCapacity() const;
+    // Copy size bytes at offset in the file of file_size bytes. Returns the
+    // number of bytes copied, which is less than size if a window is not
+    // cached. The caller reads the rest from the file.
+    size_t Read(MmapFileIO* file, size_t file_size, void* buff, size_t size, off_t offset);
+    // Unmap the windows of a file being closed.
+    void RemoveFile(const MmapFileIO* file);
+    size_t MappedSize() const;
+    void PrintStats(std::ostream& out_stream) const;
+
+    static WindowCache& getInstance()
+    {
+        static WindowCache instance; // only one instance per process
+        return instance;
+    }
+
+private:
+    typedef std::pair<const MmapFileIO*, size_t> WindowKey;
+    struct WindowKeyHash {
+        size_t operator()(const WindowKey& key) const
+        {
+            return std::hash<uintptr_t>()(reinterpret_cast<uintptr_t>(key.first)
+                ^ (key.second * 0x9E3779B97F4A7C15ULL));
+        }
+    };
+    typedef struct _Window {
+        WindowKey key;
+        uint8_t* addr;
+        size_t size;
+        int refcount;
+        // Removed from the map while in use. Unmapped by the last reader.
+        bool removed;
+    } Window;
+    typedef struct _WindowShard {
+        mutable std::mutex shard_mutex;
+        // Most recently used windows first
+        std::list<Window> lru;
+        std::unordered_map<WindowKey, std::list<Window>::iterator, WindowKeyHash> windows;
+        // Keys of recent misses indexed by hash
+        WindowKey ghost[MB_WINDOW_GHOST_SLOTS];
+        size_t mapped;
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t maps;
+        uint64_t evictions;
+        uint64_t recent_reads;
+        uint64_t recent_hits;
+        uint64_t recent_maps;
+    } WindowShard;
+
+    WindowCache();
+    Window* Acquire(MmapFileIO* file, size_t file_size, size_t index);
+    void Release(Window* window);
+    // Check if a missed window is mapped. Called with the shard locked.
+    bool Admit(WindowShard& shard, const WindowKey& key);
+    void Decay(WindowShard& shard);
+    size_t ShardCapacity() const;
+    // Remove unused windows from the end of the LRU list while the shard is
+    // over its capacity. The windows are unmapped by the caller.
+    void Evict(WindowShard& shard, std::list<Window>& evicted);
+    WindowShard& GetShard(const WindowKey& key);
+
+    std::atomic<size_t> capacity;
+    WindowShard shards[MB_WINDOW_CACHE_SHARDS];
+};
+
+}
+
+#endif
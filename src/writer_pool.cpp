@@ -0,0 +1,240 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#include <climits>
+
+#include "async_writer.h"
+#include "error.h"
+#include "logger.h"
+#include "util/futex.h"
+#include "writer_pool.h"
+
+namespace mabain {
+
+WriterPool::WriterPool()
+    : next_writer(0)
+    , stop_threads(false)
+    , num_parked(0)
+    , pool_bell(0)
+{
+}
+
+WriterPool::~WriterPool()
+{
+    std::unique_lock<std::mutex> guard(pool_mutex);
+    if (!threads.empty())
+        StopThreads(guard);
+}
+
+int WriterPool::Register(AsyncWriter* awr, uint32_t nthread)
+{
+    std::lock_guard<std::mutex> admin_guard(admin_mutex);
+    std::unique_lock<std::mutex> guard(pool_mutex);
+
+    if (nthread > MB_WRITER_POOL_MAX_THREAD)
+        nthread = MB_WRITER_POOL_MAX_THREAD;
+    writers.push_back(awr);
+    while (threads.size() < nthread) {
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, pool_thread_wrapper, this) != 0) {
+            Logger::Log(LOG_LEVEL_ERROR, "failed to create writer pool thread");
+            if (threads.empty()) {
+                writers.pop_back();
+                return MBError::THREAD_FAILED;
+            }
+            break;
+        }
+        threads.push_back(tid);
+    }
+    Logger::Log(LOG_LEVEL_DEBUG, "writer pool serving %d queues with %d threads",
+        (int)writers.size(), (int)threads.size());
+
+    // The queue may have pending updates already.
+    WakeThread(1);
+    return MBError::SUCCESS;
+}
+
+void WriterPool::Unregister(AsyncWriter* awr)
+{
+    std::lock_guard<std::mutex> admin_guard(admin_mutex);
+    std::unique_lock<std::mutex> guard(pool_mutex);
+
+    for (size_t i = 0; i < writers.size(); i++) {
+        if (writers[i] == awr) {
+            writers.erase(writers.begin() + i);
+            if (next_writer > i)
+                next_writer--;
+            break;
+        }
+    }
+
+    // Parked threads referencing awr are woken up to drop the reference. A thread
+    // serving the queue returns soon since stop_processing has been set.
+    if (awr->pool_refs > 0)
+        WakeThread(INT_MAX);
+    pool_cond.wait(guard, [awr] { return awr->pool_refs == 0; });
+
+    if (writers.empty())
+        StopThreads(guard);
+}
+
+int WriterPool::NumThreads()
+{
+    std::lock_guard<std::mutex> guard(pool_mutex);
+    return static_cast<int>(threads.size());
+}
+
+void WriterPool::StopThreads(std::unique_lock<std::mutex>& guard)
+{
+    std::vector<pthread_t> tids;
+    tids.swap(threads);
+    stop_threads = true;
+    WakeThread(INT_MAX);
+
+    guard.unlock();
+    Logger::Log(LOG_LEVEL_DEBUG, "joining %d writer pool threads", (int)tids.size());
+    for (pthread_t tid : tids)
+        pthread_join(tid, NULL);
+    guard.lock();
+
+    stop_threads = false;
+    next_writer = 0;
+}
+
+// Caller must hold pool_mutex.
+void WriterPool::WakeThread(int nwake)
+{
+    if (num_parked == 0)
+        return;
+    pool_bell.fetch_add(1, std::memory_order_seq_cst);
+    FutexWake(&pool_bell, nwake);
+}
+
+// Pick the next queue with published updates or a defragmentation in progress
+// in round-robin order. Another parked thread is woken up if more queues are
+// ready. Stalled slots of idle queues are checked on the way. Caller must hold
+// pool_mutex.
+AsyncWriter* WriterPool::NextWriter()
+{
+    AsyncWriter* next = NULL;
+    size_t num = writers.size();
+
+    for (size_t i = 0; i < num; i++) {
+        size_t index = (next_writer + i) % num;
+        AsyncWriter* awr = writers[index];
+        if (awr->pool_busy)
+            continue;
+        if (awr->defrag == NULL && !awr->dict->SHMQ_UpdateReady()) {
+            awr->CheckStalledSlot();
+            continue;
+        }
+
+        if (next != NULL) {
+            WakeThread(1);
+            break;
+        }
+        next = awr;
+        next_writer = index + 1;
+    }
+
+    if (next != NULL) {
+        next->pool_busy = true;
+        next->pool_refs++;
+    }
+    return next;
+}
+
+// Park on the doorbells of all idle queues and the pool bell. Queues that do
+// not fit in one futex_waitv call are polled. Caller must hold pool_mutex.
+void WriterPool::Park(std::unique_lock<std::mutex>& guard)
+{
+    std::atomic<uint32_t>* addrs[MB_FUTEX_WAITV_MAX];
+    uint32_t bells[MB_FUTEX_WAITV_MAX];
+    AsyncWriter* parked[MB_FUTEX_WAITV_MAX];
+    int num_addr = 0;
+    int num_writer = 0;
+    int timeout = MB_ASYNC_SHM_STALL_TMOUT;
+
+    addrs[num_addr] = &pool_bell;
+    bells[num_addr++] = pool_bell.load(std::memory_order_seq_cst);
+    for (AsyncWriter* awr : writers) {
+        if (awr->pool_busy)
+            continue;
+        if (num_addr == MB_FUTEX_WAITV_MAX) {
+            timeout = 1;
+            break;
+        }
+        addrs[num_addr] = awr->dict->SHMQ_ParkWriter(bells[num_addr]);
+        num_addr++;
+        awr->pool_refs++;
+        parked[num_writer++] = awr;
+    }
+    num_parked++;
+    guard.unlock();
+
+    bool ready = false;
+    for (int i = 0; i < num_writer; i++) {
+        if (parked[i]->dict->SHMQ_UpdateReady()) {
+            ready = true;
+            break;
+        }
+    }
+    if (!ready)
+        FutexWaitMulti(addrs, bells, num_addr, timeout);
+    for (int i = 0; i < num_writer; i++)
+        parked[i]->dict->SHMQ_UnparkWriter();
+
+    guard.lock();
+    num_parked--;
+    for (int i = 0; i < num_writer; i++) {
+        if (--parked[i]->pool_refs == 0)
+            pool_cond.notify_all();
+    }
+}
+
+void* WriterPool::pool_thread()
+{
+    std::unique_lock<std::mutex> guard(pool_mutex);
+
+    while (!stop_threads) {
+        AsyncWriter* awr = NextWriter();
+        if (awr == NULL) {
+            Park(guard);
+            continue;
+        }
+
+        guard.unlock();
+        awr->ServiceQueue(MB_WRITER_POOL_QUANTUM);
+        awr->SweepExpired();
+        guard.lock();
+
+        awr->pool_busy = false;
+        if (--awr->pool_refs == 0)
+            pool_cond.notify_all();
+    }
+
+    return NULL;
+}
+
+void* WriterPool::pool_thread_wrapper(void* context)
+{
+    WriterPool* pool = reinterpret_cast<WriterPool*>(context);
+    return pool->pool_thread();
+}
+
+}
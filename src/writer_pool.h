@@ -0,0 +1,86 @@
+/**
+ * Copyright (C) 2025 Cisco Inc.
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// @author Changxue Deng <chadeng@cisco.com>
+
+#ifndef __WRITER_POOL_H__
+#define __WRITER_POOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <pthread.h>
+#include <stdint.h>
+#include <vector>
+
+namespace mabain {
+
+// Maximum number of adds/removes applied for one DB before the pool thread
+// moves on to the next DB with pending updates
+#define MB_WRITER_POOL_QUANTUM 256
+#define MB_WRITER_POOL_MAX_THREAD 64
+
+class AsyncWriter;
+
+// A singleton pool of writer threads serving the async queues of all DBs opened
+// with MBConfig::writer_pool_size in this process. DBs with pending updates are
+// served in round-robin order, one quantum at a time, and a queue is never
+// served by two threads at the same time. Idle pool threads park on the
+// doorbells of all idle queues using futex_waitv.
+class WriterPool {
+public:
+    ~WriterPool();
+
+    // Start serving the queue of awr. The pool grows to nthread threads if it
+    // is smaller. Threads are stopped after the last writer is unregistered.
+    int Register(AsyncWriter* awr, uint32_t nthread);
+    // Stop serving the queue of awr. Returns after no pool thread references awr.
+    void Unregister(AsyncWriter* awr);
+    int NumThreads();
+
+    static WriterPool& getInstance()
+    {
+        static WriterPool instance; // only one instance per process
+        return instance;
+    }
+
+private:
+    WriterPool();
+    static void* pool_thread_wrapper(void* context);
+    void* pool_thread();
+    AsyncWriter* NextWriter();
+    void Park(std::unique_lock<std::mutex>& guard);
+    void WakeThread(int nwake);
+    void StopThreads(std::unique_lock<std::mutex>& guard);
+
+    // serializes Register and Unregister
+    std::mutex admin_mutex;
+    // guards the states below and the pool states in AsyncWriter
+    std::mutex pool_mutex;
+    std::condition_variable pool_cond;
+    std::vector<AsyncWriter*> writers;
+    // round-robin position in writers
+    size_t next_writer;
+    std::vector<pthread_t> threads;
+    bool stop_threads;
+    int num_parked;
+    // process-local doorbell for waking up parked pool threads
+    std::atomic<uint32_t> pool_bell;
+};
+
+}
+
+#endif